@@ -0,0 +1,215 @@
+#include "boot.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "BOOT";
+
+#define BOOT_REPORT_MS 60000    // Log the timeline by then even if boot is incomplete
+
+typedef enum {
+    STAGE_PENDING = 0,
+    STAGE_DONE,
+    STAGE_FAILED,
+    STAGE_SKIPPED,              // Requires a milestone that a failed stage would have reached
+} stage_state_t;
+
+typedef struct {
+    stage_state_t state;
+    esp_err_t err;
+    int32_t start_ms;
+    int32_t end_ms;
+} stage_timing_t;
+
+static EventGroupHandle_t s_events;
+static int32_t s_deadline_ms;     // 0: wait as long as it takes
+static stage_timing_t s_timing[BOOT_MAX_STAGES];
+static int32_t s_reached_ms[BOOT_MAX_MILESTONES];   // Time since reset, -1 until reached
+
+static int32_t uptime_ms(void)
+{
+    return (int32_t)(esp_timer_get_time() / 1000);
+}
+
+void boot_set_deadline(uint32_t ms)
+{
+    s_deadline_ms = (int32_t)ms;
+}
+
+void boot_signal(EventBits_t milestones)
+{
+    int32_t now = uptime_ms();
+
+    if (s_events == NULL) {
+        return;
+    }
+    for (int i = 0; i < BOOT_MAX_MILESTONES; i++) {
+        if ((milestones & (1u << i)) && s_reached_ms[i] < 0) {
+            s_reached_ms[i] = now;
+        }
+    }
+    xEventGroupSetBits(s_events, milestones);
+}
+
+bool boot_reached(EventBits_t milestones)
+{
+    return s_events != NULL && (xEventGroupGetBits(s_events) & milestones) == milestones;
+}
+
+static int bit_index(EventBits_t bit)
+{
+    for (int i = 0; i < BOOT_MAX_MILESTONES; i++) {
+        if (bit & (1u << i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Milestones not reached yet that only failed or skipped stages would reach
+static EventBits_t lost_milestones(const boot_stage_t *stages, int stage_count)
+{
+    EventBits_t lost = 0;
+    EventBits_t coming = 0;
+
+    for (int i = 0; i < stage_count; i++) {
+        EventBits_t bits = stages[i].provides | stages[i].signals;
+        if (s_timing[i].state == STAGE_FAILED || s_timing[i].state == STAGE_SKIPPED) {
+            lost |= bits;
+        } else {
+            coming |= bits;
+        }
+    }
+    return lost & ~coming & ~xEventGroupGetBits(s_events);
+}
+
+static void log_timeline(const boot_stage_t *stages, int stage_count,
+                         const boot_milestone_t *milestones, int milestone_count)
+{
+    ESP_LOGI(TAG, "Boot timeline (ms since reset):");
+    for (int i = 0; i < stage_count; i++) {
+        const stage_timing_t *t = &s_timing[i];
+        if (t->state == STAGE_PENDING) {
+            ESP_LOGW(TAG, "  %-10s waiting", stages[i].name);
+        } else if (t->state == STAGE_SKIPPED) {
+            ESP_LOGW(TAG, "  %-10s skipped", stages[i].name);
+        } else if (t->state == STAGE_FAILED) {
+            ESP_LOGW(TAG, "  %-10s %6d +%4d ms  failed: %s", stages[i].name, t->start_ms,
+                     t->end_ms - t->start_ms, esp_err_to_name(t->err));
+        } else {
+            ESP_LOGI(TAG, "  %-10s %6d +%4d ms", stages[i].name, t->start_ms, t->end_ms - t->start_ms);
+        }
+    }
+    for (int i = 0; i < milestone_count; i++) {
+        int index = bit_index(milestones[i].bit);
+        if (index >= 0 && s_reached_ms[index] >= 0) {
+            ESP_LOGI(TAG, "  %-10s %6d", milestones[i].name, s_reached_ms[index]);
+        } else {
+            ESP_LOGW(TAG, "  %-10s not reached", milestones[i].name);
+        }
+    }
+}
+
+esp_err_t boot_run(const boot_stage_t *stages, int stage_count,
+                   const boot_milestone_t *milestones, int milestone_count)
+{
+    EventBits_t awaited = 0;
+    bool reported = false;
+
+    if (stage_count > BOOT_MAX_STAGES || s_events != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_events = xEventGroupCreate();
+    if (s_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(s_timing, 0, sizeof(s_timing));
+    for (int i = 0; i < BOOT_MAX_MILESTONES; i++) {
+        s_reached_ms[i] = -1;
+    }
+    for (int i = 0; i < milestone_count; i++) {
+        awaited |= milestones[i].bit;
+    }
+
+    while (1) {
+        EventBits_t wanted = 0;
+        EventBits_t lost = lost_milestones(stages, stage_count);
+        bool progress = false;
+
+        // Run every stage that became ready; a stage can unlock later ones in the table
+        for (int i = 0; i < stage_count; i++) {
+            stage_timing_t *t = &s_timing[i];
+            EventBits_t reached = xEventGroupGetBits(s_events);
+
+            if (t->state != STAGE_PENDING) {
+                continue;
+            }
+            if (stages[i].requires & lost) {
+                // Waiting would be forever; the failure further up is already logged
+                t->state = STAGE_SKIPPED;
+                ESP_LOGW(TAG, "Stage %s skipped: a stage it requires failed", stages[i].name);
+                progress = true;
+                continue;
+            }
+            if ((reached & stages[i].requires) != stages[i].requires) {
+                wanted |= stages[i].requires & ~reached;
+                continue;
+            }
+
+            t->start_ms = uptime_ms();
+            if (reported) {
+                ESP_LOGI(TAG, "Stage %s started at %d ms", stages[i].name, t->start_ms);
+            }
+            t->err = stages[i].run();
+            t->end_ms = uptime_ms();
+            if (t->err == ESP_OK) {
+                t->state = STAGE_DONE;
+                boot_signal(stages[i].provides);
+            } else {
+                t->state = STAGE_FAILED;
+                ESP_LOGE(TAG, "Stage %s failed: %s", stages[i].name, esp_err_to_name(t->err));
+            }
+            progress = true;
+        }
+        if (progress) {
+            continue;
+        }
+
+        wanted |= awaited & ~xEventGroupGetBits(s_events) & ~lost;
+        if (wanted == 0) {
+            break;
+        }
+
+        int32_t now = uptime_ms();
+        if (s_deadline_ms > 0 && now >= s_deadline_ms) {
+            ESP_LOGW(TAG, "Deadline of %d ms reached, giving up on the rest", s_deadline_ms);
+            if (!reported) {
+                log_timeline(stages, stage_count, milestones, milestone_count);
+            }
+            return ESP_ERR_TIMEOUT;
+        }
+        int32_t left = BOOT_REPORT_MS - now;
+        if (!reported && left <= 0) {
+            log_timeline(stages, stage_count, milestones, milestone_count);
+            reported = true;
+            // Listed milestones no longer hold up the return, only pending stages do
+            awaited = 0;
+            continue;
+        }
+        TickType_t wait = reported ? portMAX_DELAY : pdMS_TO_TICKS((uint32_t)left) + 1;
+        if (s_deadline_ms > 0 && pdMS_TO_TICKS((uint32_t)(s_deadline_ms - now)) + 1 < wait) {
+            wait = pdMS_TO_TICKS((uint32_t)(s_deadline_ms - now)) + 1;
+        }
+        xEventGroupWaitBits(s_events, wanted, pdFALSE, pdFALSE, wait);
+    }
+
+    if (!reported) {
+        log_timeline(stages, stage_count, milestones, milestone_count);
+    }
+    for (int i = 0; i < stage_count; i++) {
+        if (s_timing[i].state == STAGE_FAILED) {
+            return s_timing[i].err;
+        }
+    }
+    return ESP_OK;
+}
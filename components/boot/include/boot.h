@@ -0,0 +1,72 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+/*
+ * Dependency-driven start-up.
+ *
+ * Each stage names the milestones it requires and the ones it provides. A
+ * stage runs as soon as its requirements are reached; its provided milestones
+ * are reached when it returns ESP_OK. Milestones that complete later (an IP
+ * address, time sync, a first reading) are reached with boot_signal() from
+ * whatever callback sees them, so slow network setup never holds back stages
+ * that do not need it. Stages must not block: long work belongs in a task or
+ * callback that signals a milestone when done.
+ *
+ * When a stage fails, the milestones it provides or signals will not come:
+ * stages that require them are skipped, and so on down the chain.
+ */
+
+#define BOOT_MAX_STAGES     16
+#define BOOT_MAX_MILESTONES 24      // Usable event group bits
+
+typedef struct {
+    const char *name;
+    EventBits_t requires;
+    EventBits_t provides;
+    esp_err_t (*run)(void);
+    EventBits_t signals;        // Reached later with boot_signal() by work the stage starts
+} boot_stage_t;
+
+typedef struct {
+    EventBits_t bit;
+    const char *name;
+} boot_milestone_t;
+
+/**
+ * @brief Run stages as their requirements are reached, then log the timeline
+ *
+ * Returns once every stage has run, failed or been skipped and every listed
+ * milestone that can still come is reached; the timeline is logged then, or
+ * after BOOT_REPORT_MS if something is still missing, and the call keeps
+ * waiting for the remaining stages.
+ *
+ * @return ESP_OK, or the error of the first stage that failed
+ */
+esp_err_t boot_run(const boot_stage_t *stages, int stage_count,
+                   const boot_milestone_t *milestones, int milestone_count);
+
+/**
+ * @brief Make boot_run() give up at this time since reset, for short runs such as a deep-sleep cycle
+ *
+ * boot_run() then logs the timeline and returns ESP_ERR_TIMEOUT with stages
+ * or milestones still pending. Set before boot_run().
+ */
+void boot_set_deadline(uint32_t ms);
+
+/**
+ * @brief Mark milestones as reached (any task, not from an ISR)
+ */
+void boot_signal(EventBits_t milestones);
+
+/**
+ * @brief Check whether all of the given milestones have been reached
+ */
+bool boot_reached(EventBits_t milestones);
+
+#endif // BOOT_H
@@ -0,0 +1,198 @@
+#include "datalog.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "datalog_ring.h"
+
+static const char *TAG = "DATALOG";
+
+#define DATALOG_PARTITION_LABEL "datalog"
+#ifdef CONFIG_DATALOG_FLUSH_INTERVAL
+#define DATALOG_FLUSH_MS ((int64_t)CONFIG_DATALOG_FLUSH_INTERVAL * 60 * 1000)
+#else
+#define DATALOG_FLUSH_MS (60 * 60 * 1000)
+#endif
+
+static datalog_ring_t s_ring;
+static datalog_flash_t s_flash;
+static SemaphoreHandle_t s_lock;
+static int64_t s_oldest_buffered_ms;
+
+static esp_err_t partition_read(void *ctx, uint32_t addr, void *buf, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, addr, buf, len);
+}
+
+static esp_err_t partition_write(void *ctx, uint32_t addr, const void *buf, size_t len)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, addr, buf, len);
+}
+
+static esp_err_t partition_erase(void *ctx, uint32_t addr)
+{
+    return esp_partition_erase_range((const esp_partition_t *)ctx, addr, DATALOG_SECTOR_SIZE);
+}
+
+esp_err_t datalog_init(void)
+{
+    if (s_lock != NULL) {
+        return ESP_OK;
+    }
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY,
+                                                           DATALOG_PARTITION_LABEL);
+    if (part == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition, readings will not be logged", DATALOG_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    s_flash.read = partition_read;
+    s_flash.write = partition_write;
+    s_flash.erase = partition_erase;
+    s_flash.ctx = (void *)part;
+    s_flash.size = part->size;
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = datalog_ring_mount(&s_ring, &s_flash);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mount log: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "%u records in %u/%u sectors, %u torn records skipped (mounted in %d ms)",
+             datalog_ring_records(&s_ring), s_ring.used, s_ring.sectors, s_ring.corrupt,
+             (int)((esp_timer_get_time() - start) / 1000));
+    return ESP_OK;
+}
+
+static esp_err_t flush_locked(void)
+{
+    if (s_ring.buffered == 0) {
+        return ESP_OK;
+    }
+
+    uint16_t pending = s_ring.buffered;
+    esp_err_t err = datalog_ring_flush(&s_ring);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Flush failed: %s (%u records still buffered)", esp_err_to_name(err), s_ring.buffered);
+    } else {
+        ESP_LOGD(TAG, "Wrote %u records", pending);
+    }
+    s_oldest_buffered_ms = esp_timer_get_time() / 1000;
+    return err;
+}
+
+esp_err_t datalog_append(datalog_kind_t kind, uint8_t source, int16_t value0, int16_t value1)
+{
+    datalog_record_t record = {
+        .time = (uint32_t)time(NULL),
+        .kind = kind,
+        .source = source,
+        .value = { value0, value1 },
+    };
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    esp_err_t err = ESP_OK;
+
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_ring.buffered == 0) {
+        s_oldest_buffered_ms = now_ms;
+    }
+    // Batches go out when full, or when the oldest record has waited long enough
+    if (datalog_ring_append(&s_ring, &record) || now_ms - s_oldest_buffered_ms >= DATALOG_FLUSH_MS) {
+        err = flush_locked();
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t datalog_flush(void)
+{
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = flush_locked();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+int datalog_query(uint32_t from, uint32_t to, datalog_record_t *out, int max_records)
+{
+    datalog_iter_t it;
+    int count = 0;
+
+    if (s_lock == NULL || out == NULL) {
+        return 0;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    datalog_ring_iter_begin(&s_ring, &it, from, to);
+    while (count < max_records && datalog_ring_iter_next(&s_ring, &it, &out[count])) {
+        count++;
+    }
+    xSemaphoreGive(s_lock);
+    return count;
+}
+
+esp_err_t datalog_export_csv(uint32_t from, uint32_t to, datalog_write_cb_t write, void *ctx)
+{
+    datalog_iter_t it;
+    datalog_record_t record;
+    char line[48];
+    esp_err_t err = ESP_OK;
+
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Appends wait until the export is done, so no sector can be reclaimed under it
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    datalog_ring_iter_begin(&s_ring, &it, from, to);
+    while (datalog_ring_iter_next(&s_ring, &it, &record)) {
+        int len = snprintf(line, sizeof(line), "%u,%u,%u,%d,%d\n", record.time, record.kind,
+                           record.source, record.value[0], record.value[1]);
+        if (write(ctx, line, len) != 0) {
+            err = ESP_FAIL;
+            break;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void datalog_get_stats(datalog_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (s_lock == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    stats->records = datalog_ring_records(&s_ring);
+    stats->buffered = s_ring.buffered;
+    stats->sectors = s_ring.sectors;
+    stats->sectors_used = s_ring.used;
+    stats->erases = s_ring.erases;
+    stats->flushes = s_ring.flushes;
+    stats->corrupt = s_ring.corrupt;
+    if (s_ring.used > 0 && s_ring.first_time[s_ring.tail] != UINT32_MAX) {
+        stats->oldest = s_ring.first_time[s_ring.tail];
+    }
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,333 @@
+#include "datalog_ring.h"
+#include <string.h>
+
+#define DATALOG_MAGIC   0x474F4C44  // "DLOG"
+#define DATALOG_VERSION 1
+
+// Same size as a record so slots stay word-aligned for the flash driver
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint16_t version;
+    uint16_t crc;
+} datalog_header_t;
+
+_Static_assert(sizeof(datalog_record_t) == DATALOG_RECORD_SIZE, "record layout");
+_Static_assert(sizeof(datalog_header_t) == DATALOG_RECORD_SIZE, "header layout");
+
+// CRC-16/CCITT-FALSE
+static uint16_t crc16(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint16_t crc = 0xFFFF;
+
+    while (len--) {
+        crc ^= (uint16_t)*p++ << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+void datalog_record_seal(datalog_record_t *record)
+{
+    record->crc = crc16(record, offsetof(datalog_record_t, crc));
+}
+
+static bool record_valid(const datalog_record_t *record)
+{
+    return record->crc == crc16(record, offsetof(datalog_record_t, crc));
+}
+
+static bool slot_erased(const void *slot)
+{
+    const uint8_t *p = (const uint8_t *)slot;
+    for (int i = 0; i < DATALOG_RECORD_SIZE; i++) {
+        if (p[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t slot_addr(uint16_t sector, uint16_t slot)
+{
+    return (uint32_t)sector * DATALOG_SECTOR_SIZE + (uint32_t)slot * DATALOG_RECORD_SIZE;
+}
+
+static esp_err_t read_slot(const datalog_ring_t *ring, uint16_t sector, uint16_t slot, void *out)
+{
+    return ring->flash->read(ring->flash->ctx, slot_addr(sector, slot), out, DATALOG_RECORD_SIZE);
+}
+
+static bool read_header(const datalog_ring_t *ring, uint16_t sector, uint32_t *seq)
+{
+    datalog_header_t header;
+
+    if (read_slot(ring, sector, 0, &header) != ESP_OK || header.magic != DATALOG_MAGIC ||
+        header.version != DATALOG_VERSION || header.crc != crc16(&header, offsetof(datalog_header_t, crc))) {
+        return false;
+    }
+    *seq = header.seq;
+    return true;
+}
+
+// Index entry and fill level of a sector; only the head can be partly filled
+static void scan_sector(datalog_ring_t *ring, uint16_t sector, bool is_head)
+{
+    datalog_record_t record;
+    uint16_t slot;
+
+    ring->first_time[sector] = UINT32_MAX;
+    for (slot = 1; slot < DATALOG_SLOTS; slot++) {
+        if (read_slot(ring, sector, slot, &record) != ESP_OK || slot_erased(&record)) {
+            break;
+        }
+        if (!record_valid(&record)) {
+            ring->corrupt++;
+            continue;
+        }
+        if (ring->first_time[sector] == UINT32_MAX) {
+            ring->first_time[sector] = record.time;
+            if (!is_head) {
+                break;
+            }
+        }
+        if (is_head) {
+            ring->last_time = record.time;
+        }
+    }
+
+    if (is_head) {
+        ring->head_slot = slot;
+        ring->count[sector] = slot - 1;
+    } else {
+        ring->count[sector] = DATALOG_SLOTS - 1;
+    }
+}
+
+esp_err_t datalog_ring_mount(datalog_ring_t *ring, const datalog_flash_t *flash)
+{
+    uint32_t seq[DATALOG_MAX_SECTORS];
+    bool valid[DATALOG_MAX_SECTORS];
+    bool any = false;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->flash = flash;
+    ring->sectors = flash->size / DATALOG_SECTOR_SIZE;
+    if (ring->sectors > DATALOG_MAX_SECTORS) {
+        ring->sectors = DATALOG_MAX_SECTORS;
+    }
+    if (ring->sectors < 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    for (uint16_t s = 0; s < ring->sectors; s++) {
+        valid[s] = read_header(ring, s, &seq[s]);
+        if (valid[s] && (!any || seq[s] > ring->head_seq)) {
+            ring->head = s;
+            ring->head_seq = seq[s];
+            any = true;
+        }
+        ring->first_time[s] = UINT32_MAX;
+    }
+
+    if (!any) {
+        // Empty log: the first flush opens sector 0
+        ring->head = ring->sectors - 1;
+        ring->head_slot = DATALOG_SLOTS;
+        return ESP_OK;
+    }
+
+    // The ring is the chain of consecutive sequence numbers ending at the head;
+    // anything else (e.g. a sector whose erase was interrupted) is free space
+    uint16_t sector = ring->head;
+    while (ring->used < ring->sectors && valid[sector] && seq[sector] == ring->head_seq - ring->used) {
+        ring->tail = sector;
+        ring->used++;
+        sector = (sector + ring->sectors - 1) % ring->sectors;
+    }
+
+    for (uint16_t i = 0; i < ring->used; i++) {
+        uint16_t s = (ring->tail + i) % ring->sectors;
+        scan_sector(ring, s, s == ring->head);
+    }
+    if (ring->count[ring->head] == 0 && ring->used > 1) {
+        // Head opened but still empty: the newest record ends the sector before it
+        uint16_t prev = (ring->head + ring->sectors - 1) % ring->sectors;
+        datalog_record_t record;
+        for (uint16_t slot = DATALOG_SLOTS - 1; slot > 0; slot--) {
+            if (read_slot(ring, prev, slot, &record) == ESP_OK && record_valid(&record)) {
+                ring->last_time = record.time;
+                break;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+bool datalog_ring_append(datalog_ring_t *ring, const datalog_record_t *record)
+{
+    datalog_record_t *slot = &ring->buffer[ring->buffered];
+
+    if (ring->buffered >= DATALOG_BATCH_RECORDS) {
+        return true;
+    }
+    *slot = *record;
+    if (slot->time < ring->last_time) {
+        slot->time = ring->last_time;
+    }
+    ring->last_time = slot->time;
+    datalog_record_seal(slot);
+    ring->buffered++;
+    return ring->buffered >= DATALOG_BATCH_RECORDS;
+}
+
+static esp_err_t open_sector(datalog_ring_t *ring)
+{
+    uint16_t next = (ring->head + 1) % ring->sectors;
+
+    if (ring->used == ring->sectors) {
+        // Full ring: the oldest sector is reclaimed
+        ring->tail = (ring->tail + 1) % ring->sectors;
+        ring->used--;
+    }
+
+    esp_err_t err = ring->flash->erase(ring->flash->ctx, (uint32_t)next * DATALOG_SECTOR_SIZE);
+    ring->erases++;
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    datalog_header_t header = {
+        .magic = DATALOG_MAGIC,
+        .seq = ring->head_seq + 1,
+        .version = DATALOG_VERSION,
+    };
+    header.crc = crc16(&header, offsetof(datalog_header_t, crc));
+    err = ring->flash->write(ring->flash->ctx, slot_addr(next, 0), &header, sizeof(header));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (ring->used == 0) {
+        ring->tail = next;
+    }
+    ring->head = next;
+    ring->head_seq++;
+    ring->head_slot = 1;
+    ring->used++;
+    ring->count[next] = 0;
+    ring->first_time[next] = UINT32_MAX;
+    return ESP_OK;
+}
+
+esp_err_t datalog_ring_flush(datalog_ring_t *ring)
+{
+    uint16_t done = 0;
+    esp_err_t err = ESP_OK;
+
+    while (done < ring->buffered) {
+        if (ring->head_slot >= DATALOG_SLOTS) {
+            err = open_sector(ring);
+            if (err != ESP_OK) {
+                break;
+            }
+        }
+
+        uint16_t n = ring->buffered - done;
+        if (n > DATALOG_SLOTS - ring->head_slot) {
+            n = DATALOG_SLOTS - ring->head_slot;
+        }
+        err = ring->flash->write(ring->flash->ctx, slot_addr(ring->head, ring->head_slot),
+                                 &ring->buffer[done], n * DATALOG_RECORD_SIZE);
+
+        // Even a failed write may have programmed part of the slots, so they are never reused
+        if (ring->count[ring->head] == 0) {
+            ring->first_time[ring->head] = ring->buffer[done].time;
+        }
+        ring->head_slot += n;
+        ring->count[ring->head] += n;
+        if (err != ESP_OK) {
+            break;
+        }
+        done += n;
+    }
+
+    if (done > 0) {
+        ring->flushes++;
+    }
+    ring->buffered -= done;
+    memmove(ring->buffer, &ring->buffer[done], ring->buffered * sizeof(datalog_record_t));
+    return err;
+}
+
+void datalog_ring_iter_begin(const datalog_ring_t *ring, datalog_iter_t *it, uint32_t from, uint32_t to)
+{
+    memset(it, 0, sizeof(*it));
+    it->from = from;
+    it->to = to;
+    it->slot = 1;
+
+    // Last sector starting at or before 'from'; sectors are in time order
+    uint16_t lo = 0;
+    uint16_t hi = ring->used;
+    while (hi - lo > 1) {
+        uint16_t mid = (lo + hi) / 2;
+        if (ring->first_time[(ring->tail + mid) % ring->sectors] <= from) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    it->position = lo;
+    it->sector = (ring->tail + lo) % ring->sectors;
+}
+
+static bool in_range(datalog_iter_t *it, const datalog_record_t *record)
+{
+    if (record->time > it->to) {
+        it->done = true;
+        return false;
+    }
+    return record->time >= it->from;
+}
+
+bool datalog_ring_iter_next(datalog_ring_t *ring, datalog_iter_t *it, datalog_record_t *record)
+{
+    while (!it->done && it->position < ring->used) {
+        if (it->slot > ring->count[it->sector]) {
+            it->position++;
+            it->sector = (it->sector + 1) % ring->sectors;
+            it->slot = 1;
+            continue;
+        }
+        if (read_slot(ring, it->sector, it->slot++, record) != ESP_OK || slot_erased(record)) {
+            it->slot = DATALOG_SLOTS;
+            continue;
+        }
+        if (record_valid(record) && in_range(it, record)) {
+            return true;
+        }
+    }
+
+    while (!it->done && it->buffered < ring->buffered) {
+        *record = ring->buffer[it->buffered++];
+        if (in_range(it, record)) {
+            return true;
+        }
+    }
+    it->done = true;
+    return false;
+}
+
+uint32_t datalog_ring_records(const datalog_ring_t *ring)
+{
+    uint32_t total = 0;
+
+    for (uint16_t i = 0; i < ring->used; i++) {
+        total += ring->count[(ring->tail + i) % ring->sectors];
+    }
+    return total;
+}
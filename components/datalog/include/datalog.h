@@ -0,0 +1,82 @@
+#ifndef DATALOG_H
+#define DATALOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*
+ * Persistent log of sensor readings and fetched observations.
+ *
+ * Records are 12-byte binary entries appended to a ring of flash sectors in
+ * the "datalog" partition; the oldest sector is reclaimed when the ring is
+ * full, so every sector is erased once per lap. Appends are buffered in RAM
+ * and written in batches. Records are kept in time order.
+ */
+
+#define DATALOG_NO_VALUE INT16_MIN
+
+typedef enum {
+    DATALOG_SENSOR = 1,         // value[0] = temperature, value[1] = humidity (tenths)
+    DATALOG_WEATHER,            // value[0] = temperature (tenths), value[1] = weather_condition_t
+} datalog_kind_t;
+
+typedef struct {
+    uint32_t time;              // Unix time, seconds
+    uint8_t kind;               // datalog_kind_t
+    uint8_t source;             // Sensor index or location slot
+    int16_t value[2];           // DATALOG_NO_VALUE when not available
+    uint16_t crc;               // CRC-16 of the fields above
+} datalog_record_t;
+
+typedef struct {
+    uint32_t records;           // Records on flash
+    uint32_t buffered;          // Records waiting in RAM
+    uint32_t oldest;            // Time of the oldest record, 0 if empty
+    uint16_t sectors;           // Sectors in the ring
+    uint16_t sectors_used;
+    uint32_t erases;            // Sector erases since boot
+    uint32_t flushes;           // Batch writes since boot
+    uint32_t corrupt;           // Torn or damaged records skipped
+} datalog_stats_t;
+
+/**
+ * @brief Text sink for datalog_export_csv()
+ * @return 0 to continue, anything else to stop the export
+ */
+typedef int (*datalog_write_cb_t)(void *ctx, const char *data, size_t len);
+
+/**
+ * @brief Mount the log partition, recovering the write position after a reset
+ * @return ESP_ERR_NOT_FOUND if the partition table has no datalog partition
+ */
+esp_err_t datalog_init(void);
+
+/**
+ * @brief Add a record (any task); written to flash when the batch is full or old
+ */
+esp_err_t datalog_append(datalog_kind_t kind, uint8_t source, int16_t value0, int16_t value1);
+
+/**
+ * @brief Write buffered records now, e.g. before a restart
+ */
+esp_err_t datalog_flush(void);
+
+/**
+ * @brief Copy records with from <= time <= to, oldest first
+ * @return Number of records written to out
+ */
+int datalog_query(uint32_t from, uint32_t to, datalog_record_t *out, int max_records);
+
+/**
+ * @brief Stream records with from <= time <= to as CSV lines
+ *        ("time,kind,source,value0,value1"), oldest first
+ */
+esp_err_t datalog_export_csv(uint32_t from, uint32_t to, datalog_write_cb_t write, void *ctx);
+
+/**
+ * @brief Usage and wear counters
+ */
+void datalog_get_stats(datalog_stats_t *stats);
+
+#endif // DATALOG_H
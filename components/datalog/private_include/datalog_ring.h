@@ -0,0 +1,101 @@
+#ifndef DATALOG_RING_H
+#define DATALOG_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "datalog.h"
+
+/*
+ * Append-only ring of records over raw flash, independent of the flash driver.
+ *
+ * Each sector starts with a header slot holding a magic and a sequence number
+ * that increases with every sector opened; the sector with the highest valid
+ * sequence is the one being appended to. Record slots that are still erased
+ * (all 0xFF) are free. A record torn by a reset fails its CRC and is skipped;
+ * a sector whose header was never completed is treated as free.
+ */
+
+#define DATALOG_SECTOR_SIZE     4096
+#define DATALOG_RECORD_SIZE     12
+#define DATALOG_SLOTS           (DATALOG_SECTOR_SIZE / DATALOG_RECORD_SIZE)    // Slot 0 is the header
+#define DATALOG_MAX_SECTORS     64
+
+#ifdef CONFIG_DATALOG_BATCH_RECORDS
+#define DATALOG_BATCH_RECORDS   CONFIG_DATALOG_BATCH_RECORDS
+#else
+#define DATALOG_BATCH_RECORDS   32
+#endif
+
+typedef struct {
+    esp_err_t (*read)(void *ctx, uint32_t addr, void *buf, size_t len);
+    esp_err_t (*write)(void *ctx, uint32_t addr, const void *buf, size_t len);
+    esp_err_t (*erase)(void *ctx, uint32_t addr);      // One DATALOG_SECTOR_SIZE sector
+    void *ctx;
+    uint32_t size;
+} datalog_flash_t;
+
+typedef struct {
+    const datalog_flash_t *flash;
+    uint16_t sectors;
+    uint16_t used;                  // Sectors holding a valid header
+    uint16_t tail;                  // Oldest sector
+    uint16_t head;                  // Sector being appended to
+    uint16_t head_slot;             // Next free slot in head, DATALOG_SLOTS when full
+    uint32_t head_seq;
+    uint32_t last_time;
+    uint32_t first_time[DATALOG_MAX_SECTORS];   // Index for range queries, UINT32_MAX if none
+    uint16_t count[DATALOG_MAX_SECTORS];        // Slots used (records and torn slots)
+    datalog_record_t buffer[DATALOG_BATCH_RECORDS];
+    uint16_t buffered;
+    uint32_t erases;
+    uint32_t flushes;
+    uint32_t corrupt;
+} datalog_ring_t;
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    uint16_t position;              // Sectors visited from the start sector
+    uint16_t sector;
+    uint16_t slot;
+    uint16_t buffered;              // Next RAM record once flash is exhausted
+    bool done;
+} datalog_iter_t;
+
+/**
+ * @brief Scan the flash and recover the ring state
+ */
+esp_err_t datalog_ring_mount(datalog_ring_t *ring, const datalog_flash_t *flash);
+
+/**
+ * @brief Buffer a record; time is raised to the last record's if it went backwards
+ * @return true when the batch is full and should be flushed
+ */
+bool datalog_ring_append(datalog_ring_t *ring, const datalog_record_t *record);
+
+/**
+ * @brief Write buffered records, opening (erasing) sectors as needed
+ */
+esp_err_t datalog_ring_flush(datalog_ring_t *ring);
+
+/**
+ * @brief Start a range query; the ring must not be flushed until it ends
+ */
+void datalog_ring_iter_begin(const datalog_ring_t *ring, datalog_iter_t *it, uint32_t from, uint32_t to);
+
+/**
+ * @brief Next record in range, flash first, then records still in RAM
+ */
+bool datalog_ring_iter_next(datalog_ring_t *ring, datalog_iter_t *it, datalog_record_t *record);
+
+/**
+ * @brief Number of records on flash
+ */
+uint32_t datalog_ring_records(const datalog_ring_t *ring);
+
+/**
+ * @brief Fill in a record's CRC
+ */
+void datalog_record_seal(datalog_record_t *record);
+
+#endif // DATALOG_RING_H
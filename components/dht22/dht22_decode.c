@@ -0,0 +1,68 @@
+#include "dht22_decode.h"
+#include <string.h>
+
+// Falling-to-falling periods in microseconds; generous margins absorb
+// interrupt latency, which lengthens one period and shortens the next
+#define RESPONSE_MIN_US 135
+#define RESPONSE_MAX_US 220
+#define BIT_MIN_US      55
+#define BIT_MAX_US      160
+#define BIT_ONE_US      98      // Midpoint between ~76 us ('0') and ~120 us ('1')
+
+static uint32_t period_us(const uint32_t *edges, int i, uint32_t cycles_per_us)
+{
+    // Unsigned subtraction stays correct across a cycle counter wrap
+    return (edges[i + 1] - edges[i]) / cycles_per_us;
+}
+
+dht22_decode_status_t dht22_decode(const uint32_t *edges, int count, uint32_t cycles_per_us,
+                                   uint8_t data[5])
+{
+    memset(data, 0, 5);
+
+    if (count == 0) {
+        return DHT22_DECODE_NO_RESPONSE;
+    }
+
+    // Locate the response: the first period long enough to be 80 us low + 80 us high
+    int start = -1;
+    for (int i = 0; i + 1 < count; i++) {
+        uint32_t us = period_us(edges, i, cycles_per_us);
+        if (us >= RESPONSE_MIN_US && us <= RESPONSE_MAX_US) {
+            start = i + 1;
+            break;
+        }
+    }
+    if (start < 0 || count - start < DHT22_FRAME_EDGES - 1) {
+        return DHT22_DECODE_INCOMPLETE;
+    }
+
+    for (int bit = 0; bit < 40; bit++) {
+        uint32_t us = period_us(edges, start + bit, cycles_per_us);
+        if (us < BIT_MIN_US || us > BIT_MAX_US) {
+            return DHT22_DECODE_TIMING;
+        }
+        if (us > BIT_ONE_US) {
+            data[bit / 8] |= 1 << (7 - (bit % 8));
+        }
+    }
+
+    uint8_t checksum = data[0] + data[1] + data[2] + data[3];
+    return (checksum == data[4]) ? DHT22_DECODE_OK : DHT22_DECODE_CHECKSUM;
+}
+
+void dht22_decode_values(const uint8_t data[5], int16_t *temperature, uint16_t *humidity)
+{
+    uint16_t raw_humidity = (data[0] << 8) | data[1];
+    uint16_t raw_temperature = (data[2] << 8) | data[3];
+
+    // Sensor already reports tenths, keep them as-is
+    *humidity = raw_humidity;
+
+    // Temperature is sign-magnitude encoded
+    if (raw_temperature & 0x8000) {
+        *temperature = -(int16_t)(raw_temperature & 0x7FFF);
+    } else {
+        *temperature = (int16_t)raw_temperature;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef DHT22_DECODE_H
+#define DHT22_DECODE_H
+
+#include <stdint.h>
+
+/*
+ * DHT22 frame decoder working on captured falling-edge timestamps.
+ *
+ * After the start signal the sensor answers with 80 us low + 80 us high,
+ * then sends 40 bits, each a 50 us low followed by a 26-28 us ('0') or
+ * 70 us ('1') high. Falling edge to falling edge is therefore ~160 us for
+ * the response and ~76 us / ~120 us per bit, so 42 falling edges carry a
+ * whole frame. No hardware access here; timestamps are CPU cycle counts.
+ */
+
+#define DHT22_FRAME_EDGES 42
+
+typedef enum {
+    DHT22_DECODE_OK = 0,
+    DHT22_DECODE_NO_RESPONSE,   // No edges at all
+    DHT22_DECODE_INCOMPLETE,    // Response found but fewer than 40 bits followed
+    DHT22_DECODE_TIMING,        // A bit period outside the valid range
+    DHT22_DECODE_CHECKSUM,      // Frame received but checksum mismatch
+} dht22_decode_status_t;
+
+/**
+ * @brief Decode one frame from falling-edge timestamps
+ * @param edges Timestamps in CPU cycles, in capture order (wrap-around safe)
+ * @param count Number of timestamps
+ * @param cycles_per_us CPU cycles per microsecond
+ * @param data Receives the 5 frame bytes (humidity, temperature, checksum)
+ */
+dht22_decode_status_t dht22_decode(const uint32_t *edges, int count, uint32_t cycles_per_us,
+                                   uint8_t data[5]);
+
+/**
+ * @brief Convert frame bytes to tenths of a degree Celsius and tenths of a percent
+ */
+void dht22_decode_values(const uint8_t data[5], int16_t *temperature, uint16_t *humidity);
+
+#endif // DHT22_DECODE_H
@@ -0,0 +1,168 @@
+#include "duty_cycle.h"
+#include <stddef.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "DUTY_CYCLE";
+
+#ifdef CONFIG_DEEP_SLEEP_PERIOD
+#define DUTY_PERIOD_MS      ((int64_t)CONFIG_DEEP_SLEEP_PERIOD * 1000)
+#else
+#define DUTY_PERIOD_MS      (300 * 1000)
+#endif
+#define DUTY_MIN_SLEEP_MS   1000
+#define DUTY_MAGIC          0x44435931  // "DCY1"
+
+// Deep-sleep wake options of the RF calibration
+#define RF_NO_CAL           2   // RF on, calibration skipped: shortest radio start
+#define RF_DISABLED         4   // RF off until the next wake, lowest current
+
+// Typical ESP8266 supply currents; the display and sensors are not included
+#define SUPPLY_MV           3300
+#define CPU_UA              15000   // Running with the radio off
+#define RADIO_UA            70000   // Associated and exchanging data, on average
+#define SLEEP_UA            20      // Deep sleep
+
+// Survives deep sleep; must not be reloaded by the bootloader
+#ifdef RTC_NOINIT_ATTR
+#define DUTY_RTC_ATTR RTC_NOINIT_ATTR
+#else
+#define DUTY_RTC_ATTR RTC_DATA_ATTR
+#endif
+
+typedef struct {
+    uint32_t magic;
+    uint32_t cycle;
+    int64_t sleep_at_ms;        // Cycle clock when the last sleep started
+    uint32_t sleep_ms;          // Requested length of that sleep
+    uint32_t job_s[DUTY_CYCLE_MAX_JOBS];    // Cycle clock of the last run, in seconds
+    uint8_t job_done;           // Jobs that ever ran
+    uint8_t radio;              // RF enabled for this wake
+    uint16_t reserved;
+    uint32_t last_awake_ms;
+    uint32_t last_radio_ms;
+    uint32_t check;             // Over everything above
+} duty_state_t;
+
+static DUTY_RTC_ATTR duty_state_t s_state;
+static int64_t s_base_ms;       // Cycle clock at reset
+static int64_t s_radio_ms = -1; // Uptime when WiFi was started this cycle
+
+static uint32_t state_check(void)
+{
+    const uint32_t *word = (const uint32_t *)&s_state;
+    uint32_t sum = 0x5A5A5A5A;
+
+    for (size_t i = 0; i < offsetof(duty_state_t, check) / sizeof(uint32_t); i++) {
+        sum = (sum << 5 | sum >> 27) ^ word[i];
+    }
+    return sum;
+}
+
+// Energy in millijoules and mean current for one cycle
+static void estimate(uint32_t awake_ms, uint32_t radio_ms, uint32_t sleep_ms,
+                     uint32_t *energy_mj, uint32_t *average_ua)
+{
+    uint64_t charge = (uint64_t)CPU_UA * (awake_ms - radio_ms) + (uint64_t)RADIO_UA * radio_ms +
+                      (uint64_t)SLEEP_UA * sleep_ms;    // Microamp-milliseconds
+
+    *energy_mj = (uint32_t)(charge * SUPPLY_MV / 1000000000ULL);
+    *average_ua = (uint32_t)(charge / (awake_ms + sleep_ms));
+}
+
+void duty_cycle_begin(void)
+{
+    if (esp_reset_reason() != ESP_RST_DEEPSLEEP ||
+        s_state.magic != DUTY_MAGIC || s_state.check != state_check()) {
+        memset(&s_state, 0, sizeof(s_state));
+        s_state.magic = DUTY_MAGIC;
+        s_state.radio = true;
+        s_state.check = state_check();
+        s_base_ms = 0;
+        ESP_LOGI(TAG, "Cold start, waking every %d s", (int)(DUTY_PERIOD_MS / 1000));
+        return;
+    }
+
+    // The sleep timer runs from the RTC oscillator, so this is within a few percent
+    s_base_ms = s_state.sleep_at_ms + s_state.sleep_ms;
+    ESP_LOGI(TAG, "Cycle %u, radio %s", s_state.cycle, s_state.radio ? "on" : "off");
+}
+
+int64_t duty_cycle_now_ms(void)
+{
+    return s_base_ms + esp_timer_get_time() / 1000;
+}
+
+bool duty_cycle_radio_enabled(void)
+{
+    return s_state.radio;
+}
+
+void duty_cycle_radio_started(void)
+{
+    if (s_radio_ms < 0) {
+        s_radio_ms = esp_timer_get_time() / 1000;
+    }
+}
+
+bool duty_cycle_job_due(int job, uint32_t interval_s, bool next_wake)
+{
+    if (job < 0 || job >= DUTY_CYCLE_MAX_JOBS || !(s_state.job_done & (1 << job))) {
+        return true;
+    }
+    // Run at the wake nearest to the due time rather than always the one after it
+    int64_t at_ms = duty_cycle_now_ms() + (next_wake ? DUTY_PERIOD_MS : 0) + DUTY_PERIOD_MS / 2;
+    return at_ms / 1000 - s_state.job_s[job] >= interval_s;
+}
+
+void duty_cycle_job_done(int job)
+{
+    if (job < 0 || job >= DUTY_CYCLE_MAX_JOBS) {
+        return;
+    }
+    s_state.job_s[job] = (uint32_t)(duty_cycle_now_ms() / 1000);
+    s_state.job_done |= 1 << job;
+    s_state.check = state_check();
+}
+
+void duty_cycle_get_stats(duty_cycle_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->cycle = s_state.cycle;
+    stats->radio = s_state.radio;
+    stats->last_awake_ms = s_state.last_awake_ms;
+    stats->last_radio_ms = s_state.last_radio_ms;
+    if (s_state.cycle > 0) {
+        estimate(s_state.last_awake_ms, s_state.last_radio_ms, s_state.sleep_ms,
+                 &stats->last_energy_mj, &stats->last_average_ua);
+    }
+}
+
+void duty_cycle_sleep(bool radio_next)
+{
+    uint32_t awake_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    uint32_t radio_ms = (s_radio_ms >= 0) ? awake_ms - (uint32_t)s_radio_ms : 0;
+    uint32_t sleep_ms = (DUTY_PERIOD_MS > awake_ms + DUTY_MIN_SLEEP_MS) ?
+                        (uint32_t)(DUTY_PERIOD_MS - awake_ms) : DUTY_MIN_SLEEP_MS;
+    uint32_t energy_mj, average_ua;
+
+    estimate(awake_ms, radio_ms, sleep_ms, &energy_mj, &average_ua);
+    ESP_LOGI(TAG, "Cycle %u: awake %u ms (radio %u ms), about %u mJ, %u uA on average; sleeping %u ms%s",
+             s_state.cycle, awake_ms, radio_ms, energy_mj, average_ua, sleep_ms,
+             radio_next ? "" : ", radio off at the next wake");
+
+    s_state.cycle++;
+    s_state.sleep_at_ms = duty_cycle_now_ms();
+    s_state.sleep_ms = sleep_ms;
+    s_state.radio = radio_next;
+    s_state.last_awake_ms = awake_ms;
+    s_state.last_radio_ms = radio_ms;
+    s_state.check = state_check();
+
+    esp_deep_sleep_set_rf_option(radio_next ? RF_NO_CAL : RF_DISABLED);
+    esp_deep_sleep((uint64_t)sleep_ms * 1000);
+}
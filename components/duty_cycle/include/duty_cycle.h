@@ -0,0 +1,71 @@
+#ifndef DUTY_CYCLE_H
+#define DUTY_CYCLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Deep-sleep duty cycle for battery operation (CONFIG_DEEP_SLEEP_MODE).
+ *
+ * The unit wakes every CONFIG_DEEP_SLEEP_PERIOD seconds, does what is due
+ * and sleeps again. A few bytes of RTC memory carry a clock that keeps
+ * running through deep sleep, the time each job last ran and whether the
+ * next wake needs the radio: wakes that do not are started with RF disabled.
+ * Each cycle logs its awake time and an energy estimate.
+ */
+
+#define DUTY_CYCLE_MAX_JOBS 4
+
+typedef struct {
+    uint32_t cycle;             // Wakes since power-on, 0 for the first
+    bool radio;                 // RF enabled on this wake
+    uint32_t last_awake_ms;     // Previous cycle, from start-up to sleep
+    uint32_t last_radio_ms;     // Of that, with WiFi started
+    uint32_t last_energy_mj;    // Estimated for the whole previous cycle, sleep included
+    uint32_t last_average_ua;   // Estimated mean supply current over that cycle
+} duty_cycle_stats_t;
+
+/**
+ * @brief Load the cycle state from RTC memory; call first thing after a reset
+ */
+void duty_cycle_begin(void);
+
+/**
+ * @brief Milliseconds on a clock that keeps running through deep sleep
+ */
+int64_t duty_cycle_now_ms(void);
+
+/**
+ * @brief Whether the radio can be used on this wake
+ */
+bool duty_cycle_radio_enabled(void);
+
+/**
+ * @brief Mark the start of network use in this cycle, for the energy estimate
+ */
+void duty_cycle_radio_started(void);
+
+/**
+ * @brief Whether a job never ran or last ran at least interval_s ago
+ * @param job 0 .. DUTY_CYCLE_MAX_JOBS - 1
+ * @param next_wake Check at the next wake instead of now
+ */
+bool duty_cycle_job_due(int job, uint32_t interval_s, bool next_wake);
+
+/**
+ * @brief Record that a job ran now
+ */
+void duty_cycle_job_done(int job);
+
+/**
+ * @brief This cycle and estimates for the previous one
+ */
+void duty_cycle_get_stats(duty_cycle_stats_t *stats);
+
+/**
+ * @brief Log the cycle, save the state and enter deep sleep until the next period
+ * @param radio_next Leave RF enabled at the next wake
+ */
+void duty_cycle_sleep(bool radio_next) __attribute__((noreturn));
+
+#endif // DUTY_CYCLE_H
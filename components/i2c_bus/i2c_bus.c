@@ -0,0 +1,86 @@
+#include "i2c_bus.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "I2C_BUS";
+
+static SemaphoreHandle_t s_bus_lock;
+
+// Updated under the bus lock
+static i2c_bus_stats_t s_stats;
+static uint64_t s_busy_us;
+
+esp_err_t i2c_bus_init(void)
+{
+    if (s_bus_lock != NULL) {
+        return ESP_OK;
+    }
+
+    // The display pins are the shared bus
+    i2c_config_t conf;
+    conf.mode = I2C_MODE_MASTER;
+    conf.sda_io_num = CONFIG_SSD1306_SDA_GPIO;
+    conf.scl_io_num = CONFIG_SSD1306_SCL_GPIO;
+    conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
+    conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
+    conf.clk_stretch_tick = 300; // Maximum wait time for clock stretch
+
+    esp_err_t err = i2c_driver_install(I2C_BUS_PORT, conf.mode);
+    if (err == ESP_OK) {
+        err = i2c_param_config(I2C_BUS_PORT, &conf);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up I2C: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_bus_lock = xSemaphoreCreateMutex();
+    if (s_bus_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "I2C bus on SDA GPIO%d, SCL GPIO%d", CONFIG_SSD1306_SDA_GPIO, CONFIG_SSD1306_SCL_GPIO);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_cmd_begin(i2c_cmd_handle_t cmd, TickType_t timeout)
+{
+    if (s_bus_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t wait_start = esp_timer_get_time();
+    if (xSemaphoreTake(s_bus_lock, timeout) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = i2c_master_cmd_begin(I2C_BUS_PORT, cmd, timeout);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+    uint32_t wait_us = (uint32_t)(start - wait_start);
+
+    s_stats.transactions++;
+    s_stats.errors += (err != ESP_OK);
+    s_busy_us += us;
+    s_stats.busy_ms = (uint32_t)(s_busy_us / 1000);
+    if (us > s_stats.max_us) {
+        s_stats.max_us = us;
+    }
+    if (wait_us > s_stats.max_wait_us) {
+        s_stats.max_wait_us = wait_us;
+    }
+    xSemaphoreGive(s_bus_lock);
+    return err;
+}
+
+void i2c_bus_get_stats(i2c_bus_stats_t *stats)
+{
+    if (s_bus_lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_bus_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_bus_lock);
+}
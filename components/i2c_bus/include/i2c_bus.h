@@ -0,0 +1,37 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include "esp_err.h"
+#include "driver/i2c.h"
+
+/*
+ * The I2C bus shared by the display and I2C sensors. Transactions from
+ * different tasks are serialized by one lock.
+ */
+
+#define I2C_BUS_PORT I2C_NUM_0
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t busy_ms;           // Bus held, in total
+    uint32_t max_us;            // Longest transaction
+    uint32_t max_wait_us;       // Longest wait for another task's transaction
+} i2c_bus_stats_t;
+
+/**
+ * @brief Install the I2C driver on the configured pins (safe to call more than once)
+ */
+esp_err_t i2c_bus_init(void);
+
+/**
+ * @brief Run a command link while holding the bus lock
+ */
+esp_err_t i2c_bus_cmd_begin(i2c_cmd_handle_t cmd, TickType_t timeout);
+
+/**
+ * @brief Transaction count, errors and bus time since boot
+ */
+void i2c_bus_get_stats(i2c_bus_stats_t *stats);
+
+#endif // I2C_BUS_H
@@ -0,0 +1,44 @@
+#ifndef LOCAL_API_H
+#define LOCAL_API_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Read-only HTTP endpoint on the local network: GET / returns the indoor
+ * readings, the cached weather and health counters as one JSON document.
+ *
+ * The response (headers and body) is serialized into a static buffer when the
+ * data changes, or when the health figures are older than
+ * CONFIG_LOCAL_API_HEALTH_INTERVAL, and polls in between are answered by
+ * sending that buffer as is: no formatting and no heap allocation per request.
+ * Connections are served by the network loop and kept alive between polls.
+ */
+
+#define LOCAL_API_MAX_CLIENTS   2
+#define LOCAL_API_BUFFER_LEN    1280    // Headers and body of the JSON response
+
+typedef struct {
+    uint32_t requests;          // Responses sent, errors included
+    uint32_t builds;            // Times the JSON response was serialized
+    uint32_t connections;       // Accepted
+    uint32_t refused;           // Closed at once: every client slot busy, or no loop socket slot
+    uint16_t response_len;      // Current JSON response, headers included
+} local_api_stats_t;
+
+/**
+ * @brief Start listening on CONFIG_LOCAL_API_PORT (safe to call more than once)
+ */
+esp_err_t local_api_init(void);
+
+/**
+ * @brief Mark the readings or the weather as changed; the next poll serializes them again (any task)
+ */
+void local_api_invalidate(void);
+
+/**
+ * @brief Request and serialization counts since boot (any task)
+ */
+void local_api_get_stats(local_api_stats_t *stats);
+
+#endif // LOCAL_API_H
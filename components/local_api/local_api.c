@@ -0,0 +1,523 @@
+#include "local_api.h"
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <errno.h>
+#include "esp_system.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "net_loop.h"
+#include "sensors.h"
+#include "weather_api.h"
+#include "wifi_manager.h"
+#include "time_manager.h"
+
+static const char *TAG = "LOCAL_API";
+
+#define LOCAL_API_HEADER_RESERVE    160     // Status line and headers go right before the body
+#define LOCAL_API_LINE_LEN          64      // Longer request and header lines are truncated
+#define LOCAL_API_IDLE_MS           15000   // Connections without traffic for this long are closed
+#define LOCAL_API_SWEEP_MS          5000
+
+enum {
+    CLIENT_FREE = 0,
+    CLIENT_READ,        // Waiting for a request, or the rest of one
+    CLIENT_SEND,
+};
+
+typedef struct {
+    int fd;
+    uint8_t state;
+    bool request_line;      // The next line is the request line
+    bool get;
+    bool found;             // The path is served
+    bool keep_alive;
+    uint8_t line_len;
+    char line[LOCAL_API_LINE_LEN];
+    const char *out;        // Response being sent, never copied
+    uint16_t out_len;
+    uint16_t sent;
+    int64_t last_ms;        // Last traffic, for the idle timeout
+} api_client_t;
+
+typedef struct {
+    char *p;
+    size_t left;
+    bool overflow;
+} json_out_t;
+
+static bool s_started;
+static int s_listen_fd = -1;
+static api_client_t s_clients[LOCAL_API_MAX_CLIENTS];
+static int s_sweep_timer = NET_LOOP_TIMER_INVALID;
+static char s_rx_buffer[256];
+
+// The JSON response, built and sent on the loop task; never rebuilt while a
+// client is still sending it
+static char s_buffer[LOCAL_API_BUFFER_LEN];
+static const char *s_response;
+static uint16_t s_response_len;
+static int64_t s_built_ms;
+static volatile bool s_dirty = true;
+
+// Written on the loop task only; readers get a copy that may be one request behind
+static local_api_stats_t s_stats;
+
+static const char RESPONSE_404[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+static const char RESPONSE_405[] = "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\n\r\n";
+static const char RESPONSE_500[] = "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n";
+
+static const char *const CONDITION_NAMES[] = {
+    "clear", "clouds", "rain", "drizzle", "thunderstorm", "snow", "mist", "unknown",
+};
+
+static void client_io(int fd, uint8_t events, void *arg);
+
+static void out_printf(json_out_t *out, const char *fmt, ...)
+{
+    va_list args;
+
+    if (out->overflow) {
+        return;
+    }
+    va_start(args, fmt);
+    int n = vsnprintf(out->p, out->left, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= out->left) {
+        out->overflow = true;
+        return;
+    }
+    out->p += n;
+    out->left -= n;
+}
+
+// Tenths as a JSON number: -5 is -0.5
+static void out_deci(json_out_t *out, const char *key, int16_t deci)
+{
+    int value = abs(deci);
+    out_printf(out, "\"%s\":%s%d.%d", key, deci < 0 ? "-" : "", value / 10, value % 10);
+}
+
+// Names and descriptions come from the weather API and may need escaping
+static void out_string(json_out_t *out, const char *key, const char *str)
+{
+    out_printf(out, "\"%s\":\"", key);
+    for (; *str != '\0'; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\') {
+            out_printf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            out_printf(out, "\\u%04x", c);
+        } else {
+            out_printf(out, "%c", c);
+        }
+    }
+    out_printf(out, "\"");
+}
+
+static const char *condition_name(int condition)
+{
+    if (condition < 0 || condition > WEATHER_UNKNOWN) {
+        condition = WEATHER_UNKNOWN;
+    }
+    return CONDITION_NAMES[condition];
+}
+
+static void write_body(json_out_t *out, int64_t now_ms)
+{
+    int16_t value;
+    weather_forecast_t current;
+    weather_location_t location;
+    wifi_link_stats_t link;
+    const char *sep = "";
+
+    out_printf(out, "{\"uptime\":%u,\"time\":", (uint32_t)(now_ms / 1000));
+    if (time_is_synced()) {
+        out_printf(out, "%ld", (long)time(NULL));
+    } else {
+        out_printf(out, "null");
+    }
+
+    out_printf(out, ",\"indoor\":{");
+    if (sensors_get(SENSOR_TEMPERATURE, &value) == ESP_OK) {
+        out_deci(out, "temperature", value);
+        sep = ",";
+    }
+    if (sensors_get(SENSOR_HUMIDITY, &value) == ESP_OK) {
+        out_printf(out, "%s", sep);
+        out_deci(out, "humidity", value);
+    }
+
+    out_printf(out, "},\"weather\":");
+    if (weather_is_valid() && weather_get_current(&current) == ESP_OK) {
+        out_printf(out, "{");
+        out_deci(out, "temperature", current.temp);
+        out_printf(out, ",\"condition\":\"%s\",", condition_name(current.condition));
+        out_string(out, "description", current.description);
+        out_printf(out, ",\"time\":%d}", current.dt);
+    } else {
+        out_printf(out, "null");
+    }
+
+    out_printf(out, ",\"locations\":[");
+    sep = "";
+    for (int i = 0; i < weather_get_location_count(); i++) {
+        if (weather_get_location(i, &location) != ESP_OK) {
+            continue;
+        }
+        out_printf(out, "%s{\"id\":%u,", sep, location.city_id);
+        out_string(out, "name", location.name);
+        out_printf(out, ",");
+        out_deci(out, "temperature", location.temp);
+        out_printf(out, ",\"condition\":\"%s\",\"time\":%d}", condition_name(location.condition), location.dt);
+        sep = ",";
+    }
+
+    wifi_manager_get_link_stats(&link);
+    out_printf(out, "],\"health\":{\"heap_free\":%u,\"heap_min\":%u,\"wifi\":%s,\"rssi\":%d,"
+               "\"wifi_outages\":%u,\"time_synced\":%s}}",
+               esp_get_free_heap_size(), esp_get_minimum_free_heap_size(),
+               wifi_is_connected() ? "true" : "false", link.rssi, link.outages,
+               time_is_synced() ? "true" : "false");
+}
+
+// Serialize into the shared buffer: the body first, then the headers right
+// in front of it, so the response is one block sent as is to every client
+static void build_response(int64_t now_ms)
+{
+    char *body = s_buffer + LOCAL_API_HEADER_RESERVE;
+    json_out_t out = {
+        .p = body,
+        .left = sizeof(s_buffer) - LOCAL_API_HEADER_RESERVE,
+    };
+
+    s_dirty = false;        // Changes from now on mark it again
+    s_built_ms = now_ms;
+    s_stats.builds++;
+
+    write_body(&out, now_ms);
+    if (out.overflow) {
+        ESP_LOGE(TAG, "Response does not fit in %d bytes", LOCAL_API_BUFFER_LEN);
+        s_response = RESPONSE_500;
+        s_response_len = sizeof(RESPONSE_500) - 1;
+        return;
+    }
+
+    int body_len = out.p - body;
+    int header_len = snprintf(s_buffer, LOCAL_API_HEADER_RESERVE,
+                              "HTTP/1.1 200 OK\r\n"
+                              "Content-Type: application/json\r\n"
+                              "Content-Length: %d\r\n"
+                              "Cache-Control: no-cache\r\n"
+                              "Access-Control-Allow-Origin: *\r\n"
+                              "\r\n", body_len);
+    memmove(body - header_len, s_buffer, header_len);
+    s_response = body - header_len;
+    s_response_len = header_len + body_len;
+    s_stats.response_len = s_response_len;
+}
+
+static bool response_in_use(void)
+{
+    for (int i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+        if (s_clients[i].state == CLIENT_SEND && s_clients[i].out == s_response) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Health figures change all the time; they are refreshed at most once per
+// CONFIG_LOCAL_API_HEALTH_INTERVAL, readings and weather as soon as they change
+static void current_response(api_client_t *client)
+{
+    int64_t now = net_loop_now_ms();
+
+    if ((s_response == NULL || s_dirty || now - s_built_ms >= CONFIG_LOCAL_API_HEALTH_INTERVAL * 1000) &&
+        !response_in_use()) {
+        build_response(now);
+    }
+    client->out = s_response;
+    client->out_len = s_response_len;
+}
+
+static void client_close(api_client_t *client)
+{
+    net_loop_unwatch(client->fd);
+    close(client->fd);
+    client->fd = -1;
+    client->state = CLIENT_FREE;
+    client->out = NULL;
+}
+
+// Returns false if the connection had to be closed
+static bool client_expect_request(api_client_t *client)
+{
+    client->state = CLIENT_READ;
+    client->request_line = true;
+    client->get = false;
+    client->found = false;
+    client->keep_alive = false;
+    client->line_len = 0;
+    client->out = NULL;
+    // An idle connection is not network activity for net_loop_busy()
+    if (net_loop_watch(client->fd, NET_LOOP_READ | NET_LOOP_QUIET, client_io, client) != ESP_OK) {
+        client_close(client);
+        return false;
+    }
+    return true;
+}
+
+static void client_send(api_client_t *client)
+{
+    int n = send(client->fd, client->out + client->sent, client->out_len - client->sent, 0);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            client_close(client);
+        }
+        return;
+    }
+    client->sent += n;
+    client->last_ms = net_loop_now_ms();
+
+    if (client->sent < client->out_len) {
+        if (net_loop_watch(client->fd, NET_LOOP_WRITE, client_io, client) != ESP_OK) {
+            client_close(client);
+        }
+    } else if (client->keep_alive) {
+        client_expect_request(client);
+    } else {
+        client_close(client);
+    }
+}
+
+static void client_respond(api_client_t *client)
+{
+    s_stats.requests++;
+    if (!client->get) {
+        client->out = RESPONSE_405;
+        client->out_len = sizeof(RESPONSE_405) - 1;
+    } else if (!client->found) {
+        client->out = RESPONSE_404;
+        client->out_len = sizeof(RESPONSE_404) - 1;
+    } else {
+        current_response(client);
+    }
+    client->state = CLIENT_SEND;
+    client->sent = 0;
+    client_send(client);
+}
+
+static void handle_line(api_client_t *client)
+{
+    char *line = client->line;
+
+    if (client->request_line) {
+        // "GET /path HTTP/1.1"; HTTP/1.1 connections stay open unless asked otherwise
+        char *path = strchr(line, ' ');
+        client->request_line = false;
+        client->get = (strncmp(line, "GET ", 4) == 0);
+        client->keep_alive = (strstr(line, " HTTP/1.1") != NULL);
+        if (path != NULL) {
+            size_t len = strcspn(path + 1, " ?");
+            client->found = (len == 1 && path[1] == '/') ||
+                            (len == 4 && strncmp(path + 1, "/api", 4) == 0);
+        }
+        return;
+    }
+
+    // HTTP/1.0 keep-alive is not offered, those connections are closed after the response
+    if (strncasecmp(line, "Connection:", 11) == 0) {
+        const char *value = line + 11;
+        while (*value == ' ' || *value == '\t') {
+            value++;
+        }
+        if (strncasecmp(value, "close", 5) == 0) {
+            client->keep_alive = false;
+        }
+    }
+}
+
+// Requests are answered one at a time: bytes after the end of a request
+// (pipelining) are dropped
+static void client_read(api_client_t *client)
+{
+    int n = recv(client->fd, s_rx_buffer, sizeof(s_rx_buffer), 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (n <= 0) {
+        client_close(client);
+        return;
+    }
+    client->last_ms = net_loop_now_ms();
+
+    for (int i = 0; i < n; i++) {
+        char c = s_rx_buffer[i];
+        if (c != '\n') {
+            if (client->line_len < LOCAL_API_LINE_LEN - 1) {
+                client->line[client->line_len++] = c;
+            }
+            continue;
+        }
+        if (client->line_len > 0 && client->line[client->line_len - 1] == '\r') {
+            client->line_len--;
+        }
+        client->line[client->line_len] = '\0';
+        bool empty = (client->line_len == 0);
+        client->line_len = 0;
+
+        if (!empty) {
+            handle_line(client);
+        } else if (!client->request_line) {
+            client_respond(client);
+            return;
+        }
+    }
+}
+
+static void client_io(int fd, uint8_t events, void *arg)
+{
+    api_client_t *client = (api_client_t *)arg;
+
+    if (client->state == CLIENT_SEND && (events & NET_LOOP_WRITE)) {
+        client_send(client);
+    } else if (client->state == CLIENT_READ && (events & NET_LOOP_READ)) {
+        client_read(client);
+    }
+}
+
+static void sweep_idle(void *arg)
+{
+    int64_t now = net_loop_now_ms();
+    bool open = false;
+
+    s_sweep_timer = NET_LOOP_TIMER_INVALID;
+    for (int i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+        if (s_clients[i].state == CLIENT_FREE) {
+            continue;
+        }
+        if (now - s_clients[i].last_ms >= LOCAL_API_IDLE_MS) {
+            client_close(&s_clients[i]);
+        } else {
+            open = true;
+        }
+    }
+    if (open) {
+        s_sweep_timer = net_loop_schedule(sweep_idle, NULL, LOCAL_API_SWEEP_MS);
+    }
+}
+
+// A free slot, or the one of the connection idle the longest between requests
+static api_client_t *client_slot(void)
+{
+    api_client_t *idle = NULL;
+
+    for (int i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+        api_client_t *client = &s_clients[i];
+        if (client->state == CLIENT_FREE) {
+            return client;
+        }
+        if (client->state == CLIENT_READ && client->request_line && client->line_len == 0 &&
+            (idle == NULL || client->last_ms < idle->last_ms)) {
+            idle = client;
+        }
+    }
+    if (idle != NULL) {
+        client_close(idle);
+    }
+    return idle;
+}
+
+static void on_accept(int fd, uint8_t events, void *arg)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+
+    int client_fd = accept(s_listen_fd, (struct sockaddr *)&addr, &addr_len);
+    if (client_fd < 0) {
+        return;
+    }
+    api_client_t *client = client_slot();
+    if (client == NULL) {
+        close(client_fd);
+        s_stats.refused++;
+        return;
+    }
+    fcntl(client_fd, F_SETFL, O_NONBLOCK);
+    s_stats.connections++;
+
+    client->fd = client_fd;
+    client->last_ms = net_loop_now_ms();
+    if (!client_expect_request(client)) {
+        s_stats.refused++;
+        return;
+    }
+    if (s_sweep_timer == NET_LOOP_TIMER_INVALID) {
+        s_sweep_timer = net_loop_schedule(sweep_idle, NULL, LOCAL_API_SWEEP_MS);
+    }
+}
+
+static void start_listening(void *arg)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_LOCAL_API_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    int reuse = 1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Failed to create socket");
+        return;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, LOCAL_API_MAX_CLIENTS) != 0) {
+        ESP_LOGE(TAG, "Failed to listen on port %d (errno %d)", CONFIG_LOCAL_API_PORT, errno);
+        close(fd);
+        return;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    if (net_loop_watch(fd, NET_LOOP_READ | NET_LOOP_QUIET, on_accept, NULL) != ESP_OK) {
+        close(fd);
+        return;
+    }
+    s_listen_fd = fd;
+    ESP_LOGI(TAG, "Serving readings as JSON on port %d", CONFIG_LOCAL_API_PORT);
+}
+
+esp_err_t local_api_init(void)
+{
+    if (s_started) {
+        return ESP_OK;
+    }
+    esp_err_t err = net_loop_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (int i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+        s_clients[i].fd = -1;
+    }
+    // Sockets are only watched from the loop task
+    if (net_loop_schedule(start_listening, NULL, 0) == NET_LOOP_TIMER_INVALID) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_started = true;
+    return ESP_OK;
+}
+
+void local_api_invalidate(void)
+{
+    s_dirty = true;
+}
+
+void local_api_get_stats(local_api_stats_t *stats)
+{
+    *stats = s_stats;
+}
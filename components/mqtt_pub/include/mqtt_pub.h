@@ -0,0 +1,68 @@
+#ifndef MQTT_PUB_H
+#define MQTT_PUB_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Publishes sensor readings and weather snapshots to an MQTT broker.
+ *
+ * Records are queued as they come in a RAM ring of CONFIG_MQTT_QUEUE_RECORDS
+ * (12 bytes each). Every CONFIG_MQTT_PUBLISH_INTERVAL seconds a short session
+ * runs on the network loop: connect, publish the queue in messages of up to
+ * MQTT_PUB_BATCH_RECORDS records with QoS 1, disconnect. Records leave the
+ * ring only once the broker has acknowledged them, so a backlog built up
+ * while the broker was unreachable is sent on the next session, one message
+ * in flight at a time and at most one per CONFIG_MQTT_DRAIN_GAP_MS. When the
+ * ring is full the oldest records are dropped.
+ *
+ * Messages go to "<CONFIG_MQTT_TOPIC_PREFIX>/<client id>" as compact JSON:
+ *   {"t":1792346409,"s":[[-300,0,234,456],...],"w":[[-1200,0,213,2],...]}
+ * "t" is the Unix time of the message; each record starts with its offset
+ * from it in seconds and its source (sensor index, or weather location with
+ * 0 the configured city), then temperature in tenths of a degree and
+ * humidity in tenths of a percent ("s") or the weather_condition_t ("w").
+ * Values not measured are null.
+ */
+
+#define MQTT_PUB_BATCH_RECORDS  16
+#define MQTT_PUB_NO_VALUE       INT16_MIN
+
+typedef struct {
+    uint32_t queued;            // Records waiting now
+    uint32_t queued_max;        // Most records waiting at once
+    uint32_t dropped;           // Oldest records overwritten because the ring was full
+    uint32_t published;         // Records acknowledged by the broker
+    uint32_t messages;          // Messages acknowledged
+    uint32_t sessions;          // Connections accepted by the broker
+    uint32_t failures;          // Sessions ended by an error or a timeout
+    uint32_t last_latency_ms;   // PUBLISH sent to PUBACK, last message
+    uint32_t max_latency_ms;
+    uint32_t avg_latency_ms;
+    uint32_t last_age_s;        // Age of the oldest record of the last message when acknowledged
+} mqtt_pub_stats_t;
+
+/**
+ * @brief Start the publish cadence on the network loop (safe to call more than once)
+ */
+esp_err_t mqtt_pub_init(void);
+
+/**
+ * @brief Queue a sensor reading (any task)
+ * @param temperature Tenths of a degree Celsius, or MQTT_PUB_NO_VALUE
+ * @param humidity Tenths of a percent, or MQTT_PUB_NO_VALUE
+ */
+void mqtt_pub_add_sensor(int index, int16_t temperature, int16_t humidity);
+
+/**
+ * @brief Queue a weather snapshot (any task)
+ * @param source 0 for the configured city, 1.. for the additional locations
+ */
+void mqtt_pub_add_weather(int source, int16_t temperature, uint8_t condition);
+
+/**
+ * @brief Queue depth, drops and publish latency since boot (any task)
+ */
+void mqtt_pub_get_stats(mqtt_pub_stats_t *stats);
+
+#endif // MQTT_PUB_H
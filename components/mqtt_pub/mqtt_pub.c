@@ -0,0 +1,676 @@
+#include "mqtt_pub.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <time.h>
+#include <errno.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "net_loop.h"
+#include "net_dns.h"
+#include "power_manager.h"
+#include "wifi_manager.h"
+#include "time_manager.h"
+
+static const char *TAG = "MQTT";
+
+#define MQTT_PUB_TIMEOUT_MS     10000   // Per step: DNS, connect, CONNACK, PUBACK
+#define MQTT_PUB_RETRY_MS       5000    // Loop timers all taken: try again after this long
+#define MQTT_PUB_KEEPALIVE_S    60      // Sessions are much shorter, so no PINGREQ is ever due
+#define MQTT_PUB_TOPIC_LEN      64
+#define MQTT_PUB_CREDENTIALS_LEN 128    // Username and password together
+#define MQTT_PUB_HEADER_RESERVE 5       // Fixed header: type and up to 4 length bytes
+#define MQTT_PUB_TX_LEN         (MQTT_PUB_HEADER_RESERVE + 2 + MQTT_PUB_TOPIC_LEN + 2 + \
+                                 32 + MQTT_PUB_BATCH_RECORDS * 32)
+
+// Packet types (MQTT 3.1.1)
+#define MQTT_CONNECT        0x10
+#define MQTT_CONNACK        2
+#define MQTT_PUBLISH_QOS1   0x32
+#define MQTT_PUBACK         4
+#define MQTT_DISCONNECT     0xE0
+
+enum {
+    RECORD_SENSOR = 0,
+    RECORD_WEATHER,
+};
+
+typedef struct {
+    uint32_t uptime_s;
+    uint8_t type;
+    uint8_t source;
+    int16_t temperature;
+    int16_t value;          // Humidity, or weather condition
+} mqtt_record_t;
+
+enum {
+    SESSION_IDLE = 0,
+    SESSION_RESOLVE,
+    SESSION_CONNECT,
+    SESSION_CONNACK,
+    SESSION_READY,          // Connected, nothing in flight
+    SESSION_PUBACK,
+};
+
+typedef struct {
+    char *p;
+    size_t left;
+    bool overflow;
+} payload_out_t;
+
+// Queue, shared with the tasks adding records
+static SemaphoreHandle_t s_lock;
+static mqtt_record_t s_ring[CONFIG_MQTT_QUEUE_RECORDS];
+static uint32_t s_head;                 // Oldest record
+static uint32_t s_count;
+static uint32_t s_inflight;             // Records at the head covered by the message in flight
+static mqtt_pub_stats_t s_stats;
+static uint64_t s_latency_total_ms;
+
+// Session, on the loop task only
+static bool s_started;
+static uint8_t s_state;
+static int s_fd = -1;
+static int s_timer = NET_LOOP_TIMER_INVALID;
+static esp_timer_handle_t s_retry_timer;
+static char s_client_id[32];
+static char s_topic[MQTT_PUB_TOPIC_LEN];
+static uint8_t s_tx[MQTT_PUB_TX_LEN];
+static const uint8_t *s_tx_data;
+static uint16_t s_tx_len;
+static uint16_t s_tx_sent;
+static uint16_t s_packet_id;
+static int64_t s_publish_ms;            // When the message in flight was sent
+static uint32_t s_oldest_s;             // Uptime of its oldest record
+static uint32_t s_session_records;
+static uint32_t s_session_messages;
+
+// Incoming packet; only short ones (CONNACK, PUBACK) are kept
+static uint8_t s_rx_state;              // 0: type byte, 1: length bytes, 2: body
+static uint8_t s_rx_type;
+static uint32_t s_rx_left;
+static uint32_t s_rx_shift;
+static uint8_t s_rx[4];
+static uint8_t s_rx_len;
+
+static void session_io(int fd, uint8_t events, void *arg);
+static void publish_next(void);
+
+static uint32_t uptime_s(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+static void queue_record(uint8_t type, int source, int16_t temperature, int16_t value)
+{
+    mqtt_record_t record = {
+        .uptime_s = uptime_s(),
+        .type = type,
+        .source = (uint8_t)source,
+        .temperature = temperature,
+        .value = value,
+    };
+
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_count == CONFIG_MQTT_QUEUE_RECORDS) {
+        s_head = (s_head + 1) % CONFIG_MQTT_QUEUE_RECORDS;
+        s_count--;
+        s_stats.dropped++;
+        if (s_inflight > 0) {
+            s_inflight--;   // The acknowledgement no longer covers the dropped record
+        }
+    }
+    s_ring[(s_head + s_count) % CONFIG_MQTT_QUEUE_RECORDS] = record;
+    s_count++;
+    if (s_count > s_stats.queued_max) {
+        s_stats.queued_max = s_count;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static void out_printf(payload_out_t *out, const char *fmt, ...)
+{
+    va_list args;
+
+    if (out->overflow) {
+        return;
+    }
+    va_start(args, fmt);
+    int n = vsnprintf(out->p, out->left, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= out->left) {
+        out->overflow = true;
+        return;
+    }
+    out->p += n;
+    out->left -= n;
+}
+
+static void out_value(payload_out_t *out, int16_t value)
+{
+    if (value == MQTT_PUB_NO_VALUE) {
+        out_printf(out, ",null");
+    } else {
+        out_printf(out, ",%d", value);
+    }
+}
+
+// One array per record type; offsets are seconds before the message time
+static void out_records(payload_out_t *out, uint8_t type, uint32_t count, uint32_t now_s)
+{
+    const char *sep = "";
+
+    for (uint32_t i = 0; i < count; i++) {
+        const mqtt_record_t *record = &s_ring[(s_head + i) % CONFIG_MQTT_QUEUE_RECORDS];
+        if (record->type != type) {
+            continue;
+        }
+        out_printf(out, "%s[%d,%d", sep, (int)(record->uptime_s - now_s), record->source);
+        out_value(out, record->temperature);
+        out_value(out, record->value);
+        out_printf(out, "]");
+        sep = ",";
+    }
+}
+
+static uint8_t *put_string(uint8_t *p, const char *str)
+{
+    size_t len = strlen(str);
+    *p++ = (uint8_t)(len >> 8);
+    *p++ = (uint8_t)len;
+    memcpy(p, str, len);
+    return p + len;
+}
+
+// The variable header and payload start at MQTT_PUB_HEADER_RESERVE; the fixed
+// header is written right in front of them
+static uint16_t finish_packet(uint8_t type, const uint8_t *end)
+{
+    uint32_t remaining = end - (s_tx + MQTT_PUB_HEADER_RESERVE);
+    uint8_t header[MQTT_PUB_HEADER_RESERVE];
+    int len = 0;
+
+    header[len++] = type;
+    do {
+        uint8_t byte = remaining % 128;
+        remaining /= 128;
+        header[len++] = byte | (remaining > 0 ? 0x80 : 0);
+    } while (remaining > 0);
+
+    uint8_t *start = s_tx + MQTT_PUB_HEADER_RESERVE - len;
+    memcpy(start, header, len);
+    s_tx_data = start;
+    return (uint16_t)(end - start);
+}
+
+static uint16_t build_connect(void)
+{
+    static const uint8_t protocol[] = { 0, 4, 'M', 'Q', 'T', 'T', 4 };
+    uint8_t *p = s_tx + MQTT_PUB_HEADER_RESERVE;
+    uint8_t flags = 0x02;   // Clean session: nothing is subscribed, nothing to resume
+
+    if (CONFIG_MQTT_USERNAME[0] != '\0') {
+        flags |= 0x80;
+    }
+    if (CONFIG_MQTT_PASSWORD[0] != '\0') {
+        flags |= 0x40;
+    }
+    memcpy(p, protocol, sizeof(protocol));
+    p += sizeof(protocol);
+    *p++ = flags;
+    *p++ = MQTT_PUB_KEEPALIVE_S >> 8;
+    *p++ = MQTT_PUB_KEEPALIVE_S & 0xFF;
+    p = put_string(p, s_client_id);
+    if (flags & 0x80) {
+        p = put_string(p, CONFIG_MQTT_USERNAME);
+    }
+    if (flags & 0x40) {
+        p = put_string(p, CONFIG_MQTT_PASSWORD);
+    }
+    return finish_packet(MQTT_CONNECT, p);
+}
+
+// Serialize up to a batch from the head of the queue; 0 when there is
+// nothing to send
+static uint16_t build_publish(void)
+{
+    uint8_t *p = s_tx + MQTT_PUB_HEADER_RESERVE;
+    payload_out_t out = { 0 };
+    uint32_t count;
+
+    if (!time_is_synced()) {
+        return 0;       // Records wait for a clock to be stamped with
+    }
+    s_packet_id = (s_packet_id == UINT16_MAX) ? 1 : s_packet_id + 1;
+    p = put_string(p, s_topic);
+    *p++ = (uint8_t)(s_packet_id >> 8);
+    *p++ = (uint8_t)s_packet_id;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    count = (s_count < MQTT_PUB_BATCH_RECORDS) ? s_count : MQTT_PUB_BATCH_RECORDS;
+    // Sized for a full batch; halve it should the records not fit anyway
+    for (; count > 0; count /= 2) {
+        uint32_t now_s = uptime_s();
+        out.p = (char *)p;
+        out.left = s_tx + sizeof(s_tx) - p;
+        out.overflow = false;
+        out_printf(&out, "{\"t\":%ld,\"s\":[", (long)time(NULL));
+        out_records(&out, RECORD_SENSOR, count, now_s);
+        out_printf(&out, "],\"w\":[");
+        out_records(&out, RECORD_WEATHER, count, now_s);
+        out_printf(&out, "]}");
+        if (!out.overflow) {
+            break;
+        }
+    }
+    s_inflight = count;
+    s_oldest_s = s_ring[s_head].uptime_s;
+    xSemaphoreGive(s_lock);
+
+    return (count > 0) ? finish_packet(MQTT_PUBLISH_QOS1, (uint8_t *)out.p) : 0;
+}
+
+static void session_end(esp_err_t err)
+{
+    if (s_state == SESSION_IDLE) {
+        return;
+    }
+    if (s_fd >= 0) {
+        net_loop_unwatch(s_fd);
+        close(s_fd);
+        s_fd = -1;
+    }
+    if (s_timer != NET_LOOP_TIMER_INVALID) {
+        net_loop_cancel(s_timer);
+        s_timer = NET_LOOP_TIMER_INVALID;
+    }
+    s_state = SESSION_IDLE;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_inflight = 0;
+    if (err != ESP_OK) {
+        s_stats.failures++;
+    }
+    uint32_t left = s_count;
+    uint32_t dropped = s_stats.dropped;
+    xSemaphoreGive(s_lock);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Published %u records in %u messages, %u queued, %u dropped since boot",
+                 s_session_records, s_session_messages, left, dropped);
+    } else {
+        ESP_LOGW(TAG, "Session failed (%s) after %u messages, %u records kept for the next one",
+                 esp_err_to_name(err), s_session_messages, left);
+    }
+    power_radio_release();
+}
+
+static void session_timeout(void *arg)
+{
+    s_timer = NET_LOOP_TIMER_INVALID;
+    session_end(ESP_ERR_TIMEOUT);
+}
+
+// Returns false, with the session ended, if no loop timer is free: a step
+// without a deadline could wait forever
+static bool arm_timeout(void)
+{
+    if (s_timer != NET_LOOP_TIMER_INVALID) {
+        net_loop_cancel(s_timer);
+    }
+    s_timer = net_loop_schedule(session_timeout, NULL, MQTT_PUB_TIMEOUT_MS);
+    if (s_timer == NET_LOOP_TIMER_INVALID) {
+        session_end(ESP_ERR_NO_MEM);
+        return false;
+    }
+    return true;
+}
+
+static void send_pending(void)
+{
+    int n = send(s_fd, s_tx_data + s_tx_sent, s_tx_len - s_tx_sent, 0);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            ESP_LOGE(TAG, "send failed (errno %d)", errno);
+            session_end(ESP_FAIL);
+        }
+        return;
+    }
+    s_tx_sent += n;
+    if (net_loop_watch(s_fd, NET_LOOP_READ | (s_tx_sent < s_tx_len ? NET_LOOP_WRITE : 0),
+                       session_io, NULL) != ESP_OK) {
+        session_end(ESP_ERR_NO_MEM);
+    }
+}
+
+static void start_send(uint16_t len)
+{
+    s_tx_len = len;
+    s_tx_sent = 0;
+    send_pending();
+}
+
+static void drain_gap_done(void *arg)
+{
+    s_timer = NET_LOOP_TIMER_INVALID;
+    publish_next();
+}
+
+static void acknowledged(void)
+{
+    int64_t now = net_loop_now_ms();
+    uint32_t latency_ms = (uint32_t)(now - s_publish_ms);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t count = s_inflight;
+    s_head = (s_head + count) % CONFIG_MQTT_QUEUE_RECORDS;
+    s_count -= count;
+    s_inflight = 0;
+    s_stats.published += count;
+    s_stats.messages++;
+    s_stats.last_latency_ms = latency_ms;
+    if (latency_ms > s_stats.max_latency_ms) {
+        s_stats.max_latency_ms = latency_ms;
+    }
+    s_latency_total_ms += latency_ms;
+    s_stats.avg_latency_ms = (uint32_t)(s_latency_total_ms / s_stats.messages);
+    s_stats.last_age_s = uptime_s() - s_oldest_s;
+    xSemaphoreGive(s_lock);
+
+    s_session_records += count;
+    s_session_messages++;
+    s_state = SESSION_READY;
+
+    // A backlog is drained one message at a time, with a gap between messages
+    if (s_timer != NET_LOOP_TIMER_INVALID) {
+        net_loop_cancel(s_timer);
+    }
+    s_timer = net_loop_schedule(drain_gap_done, NULL, CONFIG_MQTT_DRAIN_GAP_MS);
+    if (s_timer == NET_LOOP_TIMER_INVALID) {
+        session_end(ESP_ERR_NO_MEM);
+    }
+}
+
+static void handle_packet(void)
+{
+    if (s_rx_type == MQTT_CONNACK && s_state == SESSION_CONNACK) {
+        if (s_rx_len < 2 || s_rx[1] != 0) {
+            ESP_LOGE(TAG, "Broker refused the connection (code %d)", s_rx_len < 2 ? -1 : s_rx[1]);
+            session_end(ESP_FAIL);
+            return;
+        }
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_stats.sessions++;
+        xSemaphoreGive(s_lock);
+        s_state = SESSION_READY;
+        publish_next();
+    } else if (s_rx_type == MQTT_PUBACK && s_state == SESSION_PUBACK &&
+               s_rx_len >= 2 && ((s_rx[0] << 8) | s_rx[1]) == s_packet_id) {
+        acknowledged();
+    }
+    // Anything else (a PINGRESP, a stale PUBACK) is ignored
+}
+
+static void receive(const uint8_t *data, int len)
+{
+    for (int i = 0; i < len && s_state != SESSION_IDLE; i++) {
+        uint8_t c = data[i];
+
+        if (s_rx_state == 0) {
+            s_rx_type = c >> 4;
+            s_rx_left = 0;
+            s_rx_shift = 0;
+            s_rx_len = 0;
+            s_rx_state = 1;
+        } else if (s_rx_state == 1) {
+            s_rx_left |= (uint32_t)(c & 0x7F) << s_rx_shift;
+            s_rx_shift += 7;
+            if (!(c & 0x80)) {
+                s_rx_state = 2;
+                if (s_rx_left == 0) {
+                    s_rx_state = 0;
+                    handle_packet();
+                }
+            } else if (s_rx_shift >= 28) {
+                ESP_LOGE(TAG, "Malformed packet from broker");
+                session_end(ESP_ERR_INVALID_RESPONSE);
+            }
+        } else {
+            if (s_rx_len < sizeof(s_rx)) {
+                s_rx[s_rx_len++] = c;
+            }
+            if (--s_rx_left == 0) {
+                s_rx_state = 0;
+                handle_packet();
+            }
+        }
+    }
+}
+
+static void session_io(int fd, uint8_t events, void *arg)
+{
+    uint8_t buffer[32];
+
+    if (s_state == SESSION_CONNECT) {
+        int sock_err = 0;
+        socklen_t optlen = sizeof(sock_err);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &sock_err, &optlen);
+        if (sock_err != 0) {
+            ESP_LOGE(TAG, "Connect to %s failed (errno %d)", CONFIG_MQTT_BROKER_HOST, sock_err);
+            session_end(ESP_FAIL);
+            return;
+        }
+        s_state = SESSION_CONNACK;
+        s_rx_state = 0;
+        if (arm_timeout()) {
+            start_send(build_connect());
+        }
+        return;
+    }
+
+    if ((events & NET_LOOP_WRITE) && s_tx_sent < s_tx_len) {
+        send_pending();
+    }
+    if ((events & NET_LOOP_READ) && s_state != SESSION_IDLE) {
+        int n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            ESP_LOGE(TAG, "Connection closed by the broker");
+            session_end(ESP_FAIL);
+            return;
+        }
+        receive(buffer, n);
+    }
+}
+
+static void publish_next(void)
+{
+    static const uint8_t disconnect[] = { MQTT_DISCONNECT, 0 };
+
+    if (s_state != SESSION_READY) {
+        return;
+    }
+    uint16_t len = build_publish();
+    if (len == 0) {
+        // Queue drained; the socket buffer has room for two bytes
+        send(s_fd, disconnect, sizeof(disconnect), 0);
+        session_end(ESP_OK);
+        return;
+    }
+    s_state = SESSION_PUBACK;
+    s_publish_ms = net_loop_now_ms();
+    if (arm_timeout()) {
+        start_send(len);
+    }
+}
+
+static void broker_resolved(esp_err_t err, uint32_t addr, uint32_t ttl, void *arg)
+{
+    if (s_state != SESSION_RESOLVE) {
+        return;     // Timed out meanwhile
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s: DNS lookup failed: %s", CONFIG_MQTT_BROKER_HOST, esp_err_to_name(err));
+        session_end(err);
+        return;
+    }
+
+    s_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (s_fd < 0) {
+        session_end(ESP_ERR_NO_MEM);
+        return;
+    }
+    fcntl(s_fd, F_SETFL, O_NONBLOCK);
+
+    struct sockaddr_in broker = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_MQTT_BROKER_PORT),
+        .sin_addr.s_addr = addr,
+    };
+    if (connect(s_fd, (struct sockaddr *)&broker, sizeof(broker)) != 0 && errno != EINPROGRESS) {
+        ESP_LOGE(TAG, "Connect to %s failed (errno %d)", CONFIG_MQTT_BROKER_HOST, errno);
+        session_end(ESP_FAIL);
+        return;
+    }
+    s_state = SESSION_CONNECT;
+    if (!arm_timeout()) {
+        return;
+    }
+    if (net_loop_watch(s_fd, NET_LOOP_WRITE, session_io, NULL) != ESP_OK) {
+        session_end(ESP_ERR_NO_MEM);
+    }
+}
+
+static void session_start(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t count = s_count;
+    xSemaphoreGive(s_lock);
+
+    if (s_state != SESSION_IDLE || count == 0 || !time_is_synced() || !wifi_is_connected()) {
+        return;
+    }
+
+    // Held until session_end()
+    power_radio_acquire();
+    s_state = SESSION_RESOLVE;
+    s_session_records = 0;
+    s_session_messages = 0;
+    if (!arm_timeout()) {
+        return;
+    }
+    esp_err_t err = net_dns_lookup(CONFIG_MQTT_BROKER_HOST, broker_resolved, NULL);
+    if (err != ESP_OK) {
+        session_end(err);
+    }
+}
+
+static void publish_tick(void *arg);
+
+// esp_timer task: hand the tick back to the loop, or wait again
+static void retry_cb(void *arg)
+{
+    if (net_loop_schedule(publish_tick, NULL, 0) == NET_LOOP_TIMER_INVALID) {
+        esp_timer_start_once(s_retry_timer, MQTT_PUB_RETRY_MS * 1000);
+    }
+}
+
+// Next tick one publish interval from now. Loop timers are shared with every
+// network module; if none is free the tick comes from an esp_timer instead,
+// so publishing never stops
+static void schedule_tick(void)
+{
+    power_radio_expect(CONFIG_MQTT_PUBLISH_INTERVAL * 1000);
+    if (net_loop_schedule(publish_tick, NULL, CONFIG_MQTT_PUBLISH_INTERVAL * 1000) != NET_LOOP_TIMER_INVALID) {
+        return;
+    }
+    ESP_LOGW(TAG, "No loop timer for the next publish tick, using an esp_timer");
+    esp_timer_stop(s_retry_timer);
+    esp_timer_start_once(s_retry_timer, CONFIG_MQTT_PUBLISH_INTERVAL * 1000000ULL);
+}
+
+static void publish_tick(void *arg)
+{
+    schedule_tick();
+    session_start();
+}
+
+esp_err_t mqtt_pub_init(void)
+{
+    if (s_started) {
+        return ESP_OK;
+    }
+    if (strlen(CONFIG_MQTT_USERNAME) + strlen(CONFIG_MQTT_PASSWORD) > MQTT_PUB_CREDENTIALS_LEN) {
+        ESP_LOGE(TAG, "Username and password longer than %d bytes", MQTT_PUB_CREDENTIALS_LEN);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Each station needs its own client id; the MAC address gives one
+    if (CONFIG_MQTT_CLIENT_ID[0] != '\0') {
+        strncpy(s_client_id, CONFIG_MQTT_CLIENT_ID, sizeof(s_client_id) - 1);
+    } else {
+        uint8_t mac[6];
+        esp_read_mac(mac, ESP_MAC_WIFI_STA);
+        snprintf(s_client_id, sizeof(s_client_id), "ws-%02x%02x%02x", mac[3], mac[4], mac[5]);
+    }
+    snprintf(s_topic, sizeof(s_topic), "%s/%s", CONFIG_MQTT_TOPIC_PREFIX, s_client_id);
+
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = net_loop_init();
+    if (err != ESP_OK) {
+        vSemaphoreDelete(lock);
+        return err;
+    }
+    const esp_timer_create_args_t retry_args = {
+        .callback = retry_cb,
+        .name = "mqtt_retry",
+    };
+    err = esp_timer_create(&retry_args, &s_retry_timer);
+    if (err != ESP_OK) {
+        vSemaphoreDelete(lock);
+        return err;
+    }
+    s_lock = lock;
+
+    schedule_tick();
+    s_started = true;
+    ESP_LOGI(TAG, "Publishing to %s:%d topic %s every %d s, queue of %d records",
+             CONFIG_MQTT_BROKER_HOST, CONFIG_MQTT_BROKER_PORT, s_topic,
+             CONFIG_MQTT_PUBLISH_INTERVAL, CONFIG_MQTT_QUEUE_RECORDS);
+    return ESP_OK;
+}
+
+void mqtt_pub_add_sensor(int index, int16_t temperature, int16_t humidity)
+{
+    queue_record(RECORD_SENSOR, index, temperature, humidity);
+}
+
+void mqtt_pub_add_weather(int source, int16_t temperature, uint8_t condition)
+{
+    queue_record(RECORD_WEATHER, source, temperature, condition);
+}
+
+void mqtt_pub_get_stats(mqtt_pub_stats_t *stats)
+{
+    if (s_lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    stats->queued = s_count;
+    xSemaphoreGive(s_lock);
+}
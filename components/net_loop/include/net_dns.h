@@ -0,0 +1,65 @@
+#ifndef NET_DNS_H
+#define NET_DNS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Non-blocking DNS A-record resolver running on the shared network loop.
+ * Queries go to the DNS servers configured in lwIP over a UDP socket.
+ *
+ * net_dns_lookup() adds a small cache in front of it: answers are reused
+ * until their TTL expires, the last good address of each host is kept in
+ * NVS across reboots, and that address is used when no server answers.
+ */
+
+#define NET_DNS_MAX_PENDING 2
+#define NET_DNS_HOST_LEN    64
+
+#define NET_DNS_CACHE_SIZE          6           // OWM and MQTT hosts, up to 4 NTP servers
+#define NET_DNS_CACHE_MIN_TTL       60          // Seconds, floor for very short TTLs
+#define NET_DNS_CACHE_MAX_TTL       86400       // Seconds, cap for very long TTLs
+#define NET_DNS_PREFETCH_MARGIN_MS  120000      // Refresh entries expiring this soon
+
+typedef struct {
+    uint32_t hits;          // Answered from a fresh cache entry
+    uint32_t queries;       // Sent to a DNS server
+    uint32_t fallbacks;     // Resolver failed, expired address used instead
+    uint32_t failures;      // Resolver failed with nothing cached
+} net_dns_cache_stats_t;
+
+/**
+ * @brief Resolution result, called from the loop task
+ * @param err ESP_OK, ESP_ERR_TIMEOUT or ESP_ERR_NOT_FOUND
+ * @param addr IPv4 address in network byte order
+ * @param ttl Time to live of the answer in seconds
+ */
+typedef void (*net_dns_cb_t)(esp_err_t err, uint32_t addr, uint32_t ttl, void *arg);
+
+/**
+ * @brief Start resolving a host name; must be called from loop context
+ * @param cb May be NULL to resolve without a result
+ */
+esp_err_t net_dns_resolve(const char *host, net_dns_cb_t cb, void *arg);
+
+/**
+ * @brief Resolve through the cache; must be called from loop context
+ *
+ * Fresh entries complete without a query (still asynchronously). If the
+ * resolver fails, the last known address is reported with a TTL of 0.
+ * @param cb May be NULL to only refresh the cache
+ */
+esp_err_t net_dns_lookup(const char *host, net_dns_cb_t cb, void *arg);
+
+/**
+ * @brief Refresh a host in the background if its entry is missing or about
+ *        to expire, so a later net_dns_lookup() is answered from the cache
+ */
+void net_dns_prefetch(const char *host);
+
+/**
+ * @brief Copy cache counters
+ */
+void net_dns_cache_get_stats(net_dns_cache_stats_t *stats);
+
+#endif // NET_DNS_H
@@ -0,0 +1,86 @@
+#ifndef NET_HTTP_H
+#define NET_HTTP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "net_dns.h"
+
+/*
+ * Non-blocking HTTP/1.1 GET client driven by the shared network loop.
+ *
+ * Each request is a small state machine (resolve, connect, send, receive)
+ * that advances on socket readiness. The response is parsed incrementally:
+ * headers and (de-chunked) body data are handed to the caller as they arrive,
+ * nothing is buffered beyond one header line and a shared receive buffer.
+ */
+
+#define NET_HTTP_REQUEST_LEN 448
+#define NET_HTTP_LINE_LEN    128
+
+typedef struct {
+    void (*on_header)(void *ctx, const char *key, const char *value);
+    void (*on_body)(void *ctx, const uint8_t *data, size_t len);
+    void (*on_done)(void *ctx, esp_err_t err, int status);
+    void *ctx;
+} net_http_handler_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t parse_state;
+    bool chunked;
+    int fd;
+    int timer;
+    int status;
+    uint16_t port;
+    uint16_t request_len;
+    uint16_t sent;
+    uint8_t line_len;
+    int32_t content_length;     // -1 when not announced
+    uint32_t remaining;         // Bytes left in body or current chunk
+    char host[NET_DNS_HOST_LEN];
+    char request[NET_HTTP_REQUEST_LEN];
+    char line[NET_HTTP_LINE_LEN];
+    net_http_handler_t handler;
+
+    // Phase timing (ms since boot), valid in on_done
+    int64_t t_start;
+    int64_t t_resolved;
+    int64_t t_connected;
+    int64_t t_first_byte;
+    int64_t t_done;
+} net_http_request_t;
+
+// Totals over every request since boot, updated as each one finishes
+typedef struct {
+    uint32_t requests;
+    uint32_t failures;          // Errors and timeouts
+    uint32_t rx_bytes;          // Headers and body, as received
+    uint32_t last_ms;           // Start to finish of the last request
+    uint32_t max_ms;
+    uint32_t total_ms;
+    uint32_t last_first_byte_ms;    // Connected to first response byte of the last request
+} net_http_stats_t;
+
+/**
+ * @brief Start a GET request; must be called from loop context
+ * @param req Caller-owned request state, must stay valid until on_done
+ * @param url "http://host[:port]/path"
+ * @param headers Extra header lines, each terminated by "\r\n" (may be NULL)
+ * @param timeout_ms Deadline for the whole request
+ */
+esp_err_t net_http_get(net_http_request_t *req, const char *url, const char *headers,
+                       const net_http_handler_t *handler, uint32_t timeout_ms);
+
+/**
+ * @brief Check whether a request is still in progress
+ */
+bool net_http_busy(const net_http_request_t *req);
+
+/**
+ * @brief Request count, failures and durations since boot (any task)
+ */
+void net_http_get_stats(net_http_stats_t *stats);
+
+#endif // NET_HTTP_H
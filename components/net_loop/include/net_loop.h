@@ -0,0 +1,81 @@
+#ifndef NET_LOOP_H
+#define NET_LOOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/*
+ * Shared single-task event loop for network work.
+ *
+ * Sockets are registered with the events they are waiting for and their
+ * callbacks run from the loop task when select() reports them ready. One-shot
+ * timers run on the same task, so all network state machines advance without
+ * blocking and without a task (and stack) of their own.
+ */
+
+#define NET_LOOP_READ  0x01
+#define NET_LOOP_WRITE 0x02
+#define NET_LOOP_QUIET 0x04     // Long-lived socket (listening, idle connection): not counted by net_loop_busy()
+
+#define NET_LOOP_MAX_SOCKETS 8      // Plus the wake socket, within CONFIG_LWIP_MAX_SOCKETS
+// Worst case in use at once: weather 2 (next step, HTTP timeout), MQTT 2 (session,
+// publish tick), NTP 1, local API 1, DNS 2 (one per pending lookup), the one-off
+// start of NTP, the local API and the first prefetch, plus work posted by other tasks
+#define NET_LOOP_MAX_TIMERS  16
+#define NET_LOOP_STACK_SIZE  2560
+
+#define NET_LOOP_TIMER_INVALID (-1)
+
+typedef void (*net_loop_cb_t)(void *arg);
+typedef void (*net_loop_io_cb_t)(int fd, uint8_t events, void *arg);
+
+/**
+ * @brief Start the loop task (safe to call more than once)
+ */
+esp_err_t net_loop_init(void);
+
+/**
+ * @brief Register or update a socket; must be called from loop context
+ * @param events NET_LOOP_READ and/or NET_LOOP_WRITE, optionally with NET_LOOP_QUIET
+ */
+esp_err_t net_loop_watch(int fd, uint8_t events, net_loop_io_cb_t cb, void *arg);
+
+/**
+ * @brief Stop watching a socket; must be called from loop context
+ */
+void net_loop_unwatch(int fd);
+
+/**
+ * @brief Run a callback on the loop task after a delay (any task)
+ * @return Timer id, or NET_LOOP_TIMER_INVALID if no slot is free or the loop
+ *         is not initialized; callers must then fail or retry what they scheduled
+ */
+int net_loop_schedule(net_loop_cb_t cb, void *arg, uint32_t delay_ms);
+
+/**
+ * @brief Cancel a pending timer (any task)
+ *
+ * Timer ids are recycled once a timer has fired, so owners must forget the id
+ * in their callback.
+ */
+void net_loop_cancel(int timer_id);
+
+/**
+ * @brief Milliseconds since boot, on the loop's time base
+ */
+int64_t net_loop_now_ms(void);
+
+/**
+ * @brief Whether a DNS query, HTTP request or other network burst is in flight (any task)
+ *
+ * Sockets watched with NET_LOOP_QUIET do not count.
+ */
+bool net_loop_busy(void);
+
+/**
+ * @brief Minimum free stack of the loop task in bytes (for diagnostics)
+ */
+uint32_t net_loop_stack_free(void);
+
+#endif // NET_LOOP_H
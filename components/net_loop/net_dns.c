@@ -0,0 +1,261 @@
+#include "net_dns.h"
+#include <string.h>
+#include "esp_system.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "lwip/dns.h"
+#include "net_loop.h"
+
+static const char *TAG = "NET_DNS";
+
+#define DNS_PORT        53
+#define DNS_TIMEOUT_MS  2000
+#define DNS_ATTEMPTS    3
+
+#define DNS_FLAG_QR     0x8000
+#define DNS_FLAG_RD     0x0100
+#define DNS_RCODE_MASK  0x000F
+#define DNS_TYPE_A      1
+#define DNS_CLASS_IN    1
+
+typedef struct {
+    bool active;
+    int fd;
+    uint16_t id;
+    uint8_t attempt;
+    int timer;
+    uint32_t literal_addr;
+    char host[NET_DNS_HOST_LEN];
+    net_dns_cb_t cb;
+    void *arg;
+} dns_query_t;
+
+static dns_query_t s_queries[NET_DNS_MAX_PENDING];
+
+// Datagrams are only handled on the loop task, one at a time
+static uint8_t s_rx_buffer[512];
+
+static void query_finish(dns_query_t *q, esp_err_t err, uint32_t addr, uint32_t ttl)
+{
+    net_dns_cb_t cb = q->cb;
+    void *arg = q->arg;
+
+    if (q->fd >= 0) {
+        net_loop_unwatch(q->fd);
+        close(q->fd);
+    }
+    if (q->timer != NET_LOOP_TIMER_INVALID) {
+        net_loop_cancel(q->timer);
+    }
+    memset(q, 0, sizeof(*q));
+    q->fd = -1;
+    q->timer = NET_LOOP_TIMER_INVALID;
+
+    // Slot is free before the callback so it may start another query
+    if (cb != NULL) {
+        cb(err, addr, ttl, arg);
+    }
+}
+
+static uint32_t dns_server_addr(int attempt)
+{
+    const ip_addr_t *server = dns_getserver(attempt % 2);
+    if (server == NULL || ip_addr_isany(server)) {
+        server = dns_getserver(0);
+    }
+    return (server != NULL) ? ip4_addr_get_u32(ip_2_ip4(server)) : 0;
+}
+
+static esp_err_t query_send(dns_query_t *q)
+{
+    uint8_t packet[12 + NET_DNS_HOST_LEN + 2 + 4];
+    size_t pos = 12;
+
+    memset(packet, 0, 12);
+    packet[0] = q->id >> 8;
+    packet[1] = q->id & 0xFF;
+    packet[2] = DNS_FLAG_RD >> 8;
+    packet[5] = 1;  // QDCOUNT
+
+    // Encode name as length-prefixed labels
+    const char *label = q->host;
+    while (*label) {
+        const char *dot = strchr(label, '.');
+        size_t len = dot ? (size_t)(dot - label) : strlen(label);
+        if (len == 0 || len > 63 || pos + len + 1 >= sizeof(packet) - 5) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        packet[pos++] = len;
+        memcpy(&packet[pos], label, len);
+        pos += len;
+        label += len + (dot ? 1 : 0);
+    }
+    packet[pos++] = 0;
+    packet[pos++] = 0;
+    packet[pos++] = DNS_TYPE_A;
+    packet[pos++] = 0;
+    packet[pos++] = DNS_CLASS_IN;
+
+    struct sockaddr_in server = {
+        .sin_family = AF_INET,
+        .sin_port = htons(DNS_PORT),
+        .sin_addr.s_addr = dns_server_addr(q->attempt),
+    };
+    if (sendto(q->fd, packet, pos, 0, (struct sockaddr *)&server, sizeof(server)) < 0) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// Returns offset after an encoded name, or -1 if malformed
+static int skip_name(const uint8_t *buf, int len, int pos)
+{
+    while (pos < len) {
+        uint8_t label = buf[pos];
+        if (label == 0) {
+            return pos + 1;
+        }
+        if ((label & 0xC0) == 0xC0) {
+            return pos + 2;
+        }
+        pos += label + 1;
+    }
+    return -1;
+}
+
+static void query_timeout(void *arg);
+
+static void query_rx(int fd, uint8_t events, void *arg)
+{
+    dns_query_t *q = (dns_query_t *)arg;
+    int len = recv(fd, s_rx_buffer, sizeof(s_rx_buffer), 0);
+    if (len < 12) {
+        return;
+    }
+
+    uint16_t id = (s_rx_buffer[0] << 8) | s_rx_buffer[1];
+    uint16_t flags = (s_rx_buffer[2] << 8) | s_rx_buffer[3];
+    uint16_t qdcount = (s_rx_buffer[4] << 8) | s_rx_buffer[5];
+    uint16_t ancount = (s_rx_buffer[6] << 8) | s_rx_buffer[7];
+    if (id != q->id || !(flags & DNS_FLAG_QR)) {
+        return;  // Stale or unrelated datagram
+    }
+    if ((flags & DNS_RCODE_MASK) != 0) {
+        ESP_LOGW(TAG, "%s: server returned rcode %d", q->host, flags & DNS_RCODE_MASK);
+        query_finish(q, ESP_ERR_NOT_FOUND, 0, 0);
+        return;
+    }
+
+    int pos = 12;
+    for (int i = 0; i < qdcount && pos >= 0; i++) {
+        pos = skip_name(s_rx_buffer, len, pos);
+        if (pos >= 0) {
+            pos += 4;
+        }
+    }
+    for (int i = 0; i < ancount && pos >= 0; i++) {
+        pos = skip_name(s_rx_buffer, len, pos);
+        if (pos < 0 || pos + 10 > len) {
+            break;
+        }
+        const uint8_t *rr = &s_rx_buffer[pos];
+        uint16_t type = (rr[0] << 8) | rr[1];
+        uint16_t rclass = (rr[2] << 8) | rr[3];
+        uint32_t ttl = ((uint32_t)rr[4] << 24) | ((uint32_t)rr[5] << 16) | (rr[6] << 8) | rr[7];
+        uint16_t rdlength = (rr[8] << 8) | rr[9];
+        pos += 10;
+        if (pos + rdlength > len) {
+            break;
+        }
+        if (type == DNS_TYPE_A && rclass == DNS_CLASS_IN && rdlength == 4) {
+            uint32_t addr;
+            memcpy(&addr, &s_rx_buffer[pos], 4);
+            query_finish(q, ESP_OK, addr, ttl);
+            return;
+        }
+        pos += rdlength;
+    }
+
+    ESP_LOGW(TAG, "%s: no A record in response", q->host);
+    query_finish(q, ESP_ERR_NOT_FOUND, 0, 0);
+}
+
+static void query_timeout(void *arg)
+{
+    dns_query_t *q = (dns_query_t *)arg;
+    q->timer = NET_LOOP_TIMER_INVALID;
+
+    if (++q->attempt >= DNS_ATTEMPTS) {
+        ESP_LOGW(TAG, "%s: no response after %d attempts", q->host, DNS_ATTEMPTS);
+        query_finish(q, ESP_ERR_TIMEOUT, 0, 0);
+        return;
+    }
+    query_send(q);
+    q->timer = net_loop_schedule(query_timeout, q, DNS_TIMEOUT_MS);
+    if (q->timer == NET_LOOP_TIMER_INVALID) {
+        query_finish(q, ESP_ERR_NO_MEM, 0, 0);
+    }
+}
+
+static void literal_done(void *arg)
+{
+    dns_query_t *q = (dns_query_t *)arg;
+    q->timer = NET_LOOP_TIMER_INVALID;
+    query_finish(q, ESP_OK, q->literal_addr, UINT32_MAX);
+}
+
+esp_err_t net_dns_resolve(const char *host, net_dns_cb_t cb, void *arg)
+{
+    dns_query_t *q = NULL;
+    for (int i = 0; i < NET_DNS_MAX_PENDING; i++) {
+        if (!s_queries[i].active) {
+            q = &s_queries[i];
+            break;
+        }
+    }
+    if (q == NULL || strlen(host) >= NET_DNS_HOST_LEN) {
+        return (q == NULL) ? ESP_ERR_NO_MEM : ESP_ERR_INVALID_ARG;
+    }
+
+    memset(q, 0, sizeof(*q));
+    q->active = true;
+    q->fd = -1;
+    q->timer = NET_LOOP_TIMER_INVALID;
+    q->cb = cb;
+    q->arg = arg;
+    strcpy(q->host, host);
+
+    // Dotted-quad literals need no query, but still complete asynchronously
+    struct in_addr literal;
+    if (inet_aton(host, &literal)) {
+        q->literal_addr = literal.s_addr;
+        q->timer = net_loop_schedule(literal_done, q, 0);
+        if (q->timer == NET_LOOP_TIMER_INVALID) {
+            q->active = false;
+            return ESP_ERR_NO_MEM;
+        }
+        return ESP_OK;
+    }
+
+    q->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (q->fd < 0) {
+        q->active = false;
+        return ESP_FAIL;
+    }
+    fcntl(q->fd, F_SETFL, O_NONBLOCK);
+    q->id = esp_random() & 0xFFFF;
+
+    if (query_send(q) != ESP_OK || net_loop_watch(q->fd, NET_LOOP_READ, query_rx, q) != ESP_OK) {
+        close(q->fd);
+        q->active = false;
+        return ESP_FAIL;
+    }
+    q->timer = net_loop_schedule(query_timeout, q, DNS_TIMEOUT_MS);
+    if (q->timer == NET_LOOP_TIMER_INVALID) {
+        net_loop_unwatch(q->fd);
+        close(q->fd);
+        q->active = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,248 @@
+#include "net_dns.h"
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "lwip/sockets.h"
+#include "net_loop.h"
+
+static const char *TAG = "NET_DNS";
+
+#define DNS_CACHE_NVS_NAMESPACE "net_dns"
+#define DNS_CACHE_NVS_KEY       "cache"
+
+typedef struct {
+    char host[NET_DNS_HOST_LEN];
+    uint32_t addr;              // Network byte order, 0 = unused
+    int64_t expires_ms;         // 0 until resolved in this boot
+    int64_t last_used_ms;
+} dns_cache_entry_t;
+
+// Persisted form: only the answer, TTLs do not survive a reboot
+typedef struct {
+    char host[NET_DNS_HOST_LEN];
+    uint32_t addr;
+} dns_cache_record_t;
+
+typedef struct {
+    bool active;
+    char host[NET_DNS_HOST_LEN];
+    uint32_t addr;
+    uint32_t ttl;
+    net_dns_cb_t cb;
+    void *arg;
+} dns_lookup_t;
+
+static dns_cache_entry_t s_cache[NET_DNS_CACHE_SIZE];
+// NVS image, only used on the loop task; kept off its stack
+static dns_cache_record_t s_records[NET_DNS_CACHE_SIZE];
+static dns_lookup_t s_lookups[NET_DNS_MAX_PENDING];
+static net_dns_cache_stats_t s_stats;
+static bool s_loaded = false;
+
+static void cache_load(void)
+{
+    size_t len = sizeof(s_records);
+    nvs_handle handle;
+
+    if (s_loaded) {
+        return;
+    }
+    s_loaded = true;
+
+    if (nvs_open(DNS_CACHE_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    // A smaller cache saved by an older build fills the first slots
+    if (nvs_get_blob(handle, DNS_CACHE_NVS_KEY, s_records, &len) == ESP_OK) {
+        for (int i = 0; i < (int)(len / sizeof(dns_cache_record_t)); i++) {
+            s_records[i].host[NET_DNS_HOST_LEN - 1] = '\0';
+            strcpy(s_cache[i].host, s_records[i].host);
+            s_cache[i].addr = s_records[i].addr;
+            if (s_records[i].addr != 0) {
+                struct in_addr addr = { .s_addr = s_records[i].addr };
+                ESP_LOGI(TAG, "Last known address of %s: %s", s_records[i].host, inet_ntoa(addr));
+            }
+        }
+    }
+    nvs_close(handle);
+}
+
+static void cache_save(void)
+{
+    nvs_handle handle;
+
+    memset(s_records, 0, sizeof(s_records));
+    for (int i = 0; i < NET_DNS_CACHE_SIZE; i++) {
+        strcpy(s_records[i].host, s_cache[i].host);
+        s_records[i].addr = s_cache[i].addr;
+    }
+
+    esp_err_t err = nvs_open(DNS_CACHE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, DNS_CACHE_NVS_KEY, s_records, sizeof(s_records));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to persist DNS cache: %s", esp_err_to_name(err));
+    }
+}
+
+static dns_cache_entry_t *cache_find(const char *host)
+{
+    for (int i = 0; i < NET_DNS_CACHE_SIZE; i++) {
+        if (s_cache[i].addr != 0 && strcmp(s_cache[i].host, host) == 0) {
+            return &s_cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void cache_store(const char *host, uint32_t addr, uint32_t ttl)
+{
+    dns_cache_entry_t *entry = cache_find(host);
+    int64_t now = net_loop_now_ms();
+
+    if (entry == NULL) {
+        // Reuse the least recently used slot
+        entry = &s_cache[0];
+        for (int i = 1; i < NET_DNS_CACHE_SIZE; i++) {
+            if (s_cache[i].addr == 0 || s_cache[i].last_used_ms < entry->last_used_ms) {
+                entry = &s_cache[i];
+                if (entry->addr == 0) {
+                    break;
+                }
+            }
+        }
+        strcpy(entry->host, host);
+        entry->addr = 0;
+    }
+
+    if (ttl < NET_DNS_CACHE_MIN_TTL) {
+        ttl = NET_DNS_CACHE_MIN_TTL;
+    } else if (ttl > NET_DNS_CACHE_MAX_TTL) {
+        ttl = NET_DNS_CACHE_MAX_TTL;
+    }
+    entry->expires_ms = now + (int64_t)ttl * 1000;
+    entry->last_used_ms = now;
+
+    // Flash is only written when the answer itself changes
+    if (entry->addr != addr) {
+        entry->addr = addr;
+        cache_save();
+    }
+}
+
+static void lookup_complete(dns_lookup_t *lookup, esp_err_t err, uint32_t addr, uint32_t ttl)
+{
+    net_dns_cb_t cb = lookup->cb;
+    void *arg = lookup->arg;
+
+    lookup->active = false;
+    if (cb != NULL) {
+        cb(err, addr, ttl, arg);
+    }
+}
+
+static void lookup_cached(void *arg)
+{
+    dns_lookup_t *lookup = (dns_lookup_t *)arg;
+    lookup_complete(lookup, ESP_OK, lookup->addr, lookup->ttl);
+}
+
+static void lookup_resolved(esp_err_t err, uint32_t addr, uint32_t ttl, void *arg)
+{
+    dns_lookup_t *lookup = (dns_lookup_t *)arg;
+
+    if (err == ESP_OK) {
+        cache_store(lookup->host, addr, ttl);
+    } else {
+        dns_cache_entry_t *entry = cache_find(lookup->host);
+        if (entry != NULL) {
+            ESP_LOGW(TAG, "%s: resolver failed (%s), using last known address",
+                     lookup->host, esp_err_to_name(err));
+            entry->last_used_ms = net_loop_now_ms();
+            s_stats.fallbacks++;
+            err = ESP_OK;
+            addr = entry->addr;
+            ttl = 0;
+        } else {
+            s_stats.failures++;
+        }
+    }
+    lookup_complete(lookup, err, addr, ttl);
+}
+
+esp_err_t net_dns_lookup(const char *host, net_dns_cb_t cb, void *arg)
+{
+    dns_lookup_t *lookup = NULL;
+
+    // Literals gain nothing from caching
+    struct in_addr literal;
+    if (inet_aton(host, &literal)) {
+        return net_dns_resolve(host, cb, arg);
+    }
+    if (strlen(host) >= NET_DNS_HOST_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < NET_DNS_MAX_PENDING; i++) {
+        if (!s_lookups[i].active) {
+            lookup = &s_lookups[i];
+            break;
+        }
+    }
+    if (lookup == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    cache_load();
+    lookup->active = true;
+    lookup->cb = cb;
+    lookup->arg = arg;
+    strcpy(lookup->host, host);
+
+    dns_cache_entry_t *entry = cache_find(host);
+    int64_t now = net_loop_now_ms();
+    if (entry != NULL && entry->expires_ms > now) {
+        entry->last_used_ms = now;
+        lookup->addr = entry->addr;
+        lookup->ttl = (entry->expires_ms - now) / 1000;
+        s_stats.hits++;
+        if (net_loop_schedule(lookup_cached, lookup, 0) == NET_LOOP_TIMER_INVALID) {
+            lookup->active = false;
+            return ESP_ERR_NO_MEM;
+        }
+        return ESP_OK;
+    }
+
+    s_stats.queries++;
+    esp_err_t err = net_dns_resolve(host, lookup_resolved, lookup);
+    if (err != ESP_OK) {
+        lookup->active = false;
+    }
+    return err;
+}
+
+void net_dns_prefetch(const char *host)
+{
+    cache_load();
+
+    dns_cache_entry_t *entry = cache_find(host);
+    if (entry != NULL && entry->expires_ms - net_loop_now_ms() > NET_DNS_PREFETCH_MARGIN_MS) {
+        return;
+    }
+    // Treat the entry as expired so the lookup goes to the server
+    if (entry != NULL) {
+        entry->expires_ms = 0;
+    }
+    if (net_dns_lookup(host, NULL, NULL) != ESP_OK) {
+        ESP_LOGW(TAG, "%s: prefetch could not be started", host);
+    }
+}
+
+void net_dns_cache_get_stats(net_dns_cache_stats_t *stats)
+{
+    *stats = s_stats;
+}
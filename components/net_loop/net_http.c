@@ -0,0 +1,388 @@
+#include "net_http.h"
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "net_loop.h"
+
+static const char *TAG = "NET_HTTP";
+
+enum {
+    REQ_IDLE = 0,
+    REQ_RESOLVE,
+    REQ_CONNECT,
+    REQ_SEND,
+    REQ_RECEIVE,
+};
+
+enum {
+    P_STATUS = 0,
+    P_HEADER,
+    P_BODY,
+    P_CHUNK_SIZE,
+    P_CHUNK_DATA,
+    P_CHUNK_END,
+    P_TRAILER,
+    P_DONE,
+    P_ERROR,
+};
+
+// Responses are parsed on the loop task one read at a time
+static uint8_t s_rx_buffer[536];
+
+// Written on the loop task only; readers get a copy that may be one request behind
+static net_http_stats_t s_stats;
+
+static void request_finish(net_http_request_t *req, esp_err_t err)
+{
+    if (req->fd >= 0) {
+        net_loop_unwatch(req->fd);
+        close(req->fd);
+        req->fd = -1;
+    }
+    if (req->timer != NET_LOOP_TIMER_INVALID) {
+        net_loop_cancel(req->timer);
+        req->timer = NET_LOOP_TIMER_INVALID;
+    }
+    req->state = REQ_IDLE;
+    req->t_done = net_loop_now_ms();
+
+    uint32_t duration_ms = (uint32_t)(req->t_done - req->t_start);
+    s_stats.requests++;
+    s_stats.failures += (err != ESP_OK);
+    s_stats.last_ms = duration_ms;
+    s_stats.total_ms += duration_ms;
+    if (duration_ms > s_stats.max_ms) {
+        s_stats.max_ms = duration_ms;
+    }
+    s_stats.last_first_byte_ms = (req->t_first_byte >= req->t_connected && req->t_connected > 0) ?
+                                 (uint32_t)(req->t_first_byte - req->t_connected) : 0;
+
+    if (req->handler.on_done != NULL) {
+        req->handler.on_done(req->handler.ctx, err, req->status);
+    }
+}
+
+static void handle_line(net_http_request_t *req)
+{
+    char *line = req->line;
+
+    switch (req->parse_state) {
+        case P_STATUS: {
+            // "HTTP/1.1 200 OK"
+            char *space = strchr(line, ' ');
+            if (strncmp(line, "HTTP/", 5) != 0 || space == NULL) {
+                req->parse_state = P_ERROR;
+                return;
+            }
+            req->status = atoi(space + 1);
+            req->parse_state = P_HEADER;
+            break;
+        }
+
+        case P_HEADER: {
+            if (line[0] == '\0') {
+                if (req->status >= 100 && req->status < 200) {
+                    req->parse_state = P_STATUS;  // Interim response, real one follows
+                } else if (req->chunked) {
+                    req->parse_state = P_CHUNK_SIZE;
+                } else if (req->content_length == 0) {
+                    req->parse_state = P_DONE;
+                } else {
+                    req->remaining = (req->content_length > 0) ? req->content_length : 0;
+                    req->parse_state = P_BODY;
+                }
+                return;
+            }
+
+            char *colon = strchr(line, ':');
+            if (colon == NULL) {
+                return;
+            }
+            *colon = '\0';
+            char *value = colon + 1;
+            while (*value == ' ' || *value == '\t') {
+                value++;
+            }
+
+            if (strcasecmp(line, "Content-Length") == 0) {
+                req->content_length = atoi(value);
+            } else if (strcasecmp(line, "Transfer-Encoding") == 0 && strstr(value, "chunked") != NULL) {
+                req->chunked = true;
+            }
+            if (req->handler.on_header != NULL) {
+                req->handler.on_header(req->handler.ctx, line, value);
+            }
+            break;
+        }
+
+        case P_CHUNK_SIZE: {
+            char *end;
+            req->remaining = strtoul(line, &end, 16);
+            if (end == line) {
+                req->parse_state = P_ERROR;
+            } else {
+                req->parse_state = (req->remaining == 0) ? P_TRAILER : P_CHUNK_DATA;
+            }
+            break;
+        }
+
+        case P_CHUNK_END:
+            req->parse_state = (line[0] == '\0') ? P_CHUNK_SIZE : P_ERROR;
+            break;
+
+        case P_TRAILER:
+            if (line[0] == '\0') {
+                req->parse_state = P_DONE;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void emit_body(net_http_request_t *req, const uint8_t *data, size_t len)
+{
+    if (req->handler.on_body != NULL && len > 0) {
+        req->handler.on_body(req->handler.ctx, data, len);
+    }
+}
+
+static void parse_response(net_http_request_t *req, const uint8_t *data, size_t len)
+{
+    while (len > 0 && req->parse_state != P_DONE && req->parse_state != P_ERROR) {
+        size_t n;
+
+        switch (req->parse_state) {
+            case P_BODY:
+                // Without Content-Length the body runs until the server closes
+                n = (req->content_length < 0 || len < req->remaining) ? len : req->remaining;
+                emit_body(req, data, n);
+                if (req->content_length >= 0) {
+                    req->remaining -= n;
+                    if (req->remaining == 0) {
+                        req->parse_state = P_DONE;
+                    }
+                }
+                break;
+
+            case P_CHUNK_DATA:
+                n = (len < req->remaining) ? len : req->remaining;
+                emit_body(req, data, n);
+                req->remaining -= n;
+                if (req->remaining == 0) {
+                    req->parse_state = P_CHUNK_END;
+                }
+                break;
+
+            default:
+                // Line oriented states; overlong lines are truncated
+                n = 1;
+                if (*data == '\n') {
+                    if (req->line_len > 0 && req->line[req->line_len - 1] == '\r') {
+                        req->line_len--;
+                    }
+                    req->line[req->line_len] = '\0';
+                    req->line_len = 0;
+                    handle_line(req);
+                } else if (req->line_len < NET_HTTP_LINE_LEN - 1) {
+                    req->line[req->line_len++] = *data;
+                }
+                break;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+static void request_io(int fd, uint8_t events, void *arg)
+{
+    net_http_request_t *req = (net_http_request_t *)arg;
+
+    if (req->state == REQ_CONNECT) {
+        int sock_err = 0;
+        socklen_t optlen = sizeof(sock_err);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &sock_err, &optlen);
+        if (sock_err != 0) {
+            ESP_LOGE(TAG, "%s: connect failed (errno %d)", req->host, sock_err);
+            request_finish(req, ESP_FAIL);
+            return;
+        }
+        req->t_connected = net_loop_now_ms();
+        req->state = REQ_SEND;
+    }
+
+    if (req->state == REQ_SEND) {
+        int n = send(fd, req->request + req->sent, req->request_len - req->sent, 0);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ESP_LOGE(TAG, "%s: send failed (errno %d)", req->host, errno);
+                request_finish(req, ESP_FAIL);
+            }
+            return;
+        }
+        req->sent += n;
+        if (req->sent == req->request_len) {
+            req->state = REQ_RECEIVE;
+            net_loop_watch(fd, NET_LOOP_READ, request_io, req);
+        }
+        return;
+    }
+
+    if (req->state == REQ_RECEIVE && (events & NET_LOOP_READ)) {
+        int n = recv(fd, s_rx_buffer, sizeof(s_rx_buffer), 0);
+        if (n > 0) {
+            s_stats.rx_bytes += n;
+        }
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ESP_LOGE(TAG, "%s: recv failed (errno %d)", req->host, errno);
+                request_finish(req, ESP_FAIL);
+            }
+            return;
+        }
+        if (n == 0) {
+            // Close delimits bodies without Content-Length or chunking
+            bool complete = (req->parse_state == P_DONE) ||
+                            (req->parse_state == P_BODY && req->content_length < 0);
+            if (!complete) {
+                ESP_LOGE(TAG, "%s: connection closed before end of response", req->host);
+            }
+            request_finish(req, complete ? ESP_OK : ESP_ERR_INVALID_SIZE);
+            return;
+        }
+
+        if (req->t_first_byte == 0) {
+            req->t_first_byte = net_loop_now_ms();
+        }
+        parse_response(req, s_rx_buffer, n);
+        if (req->parse_state == P_ERROR) {
+            ESP_LOGE(TAG, "%s: malformed response", req->host);
+            request_finish(req, ESP_ERR_INVALID_RESPONSE);
+        } else if (req->parse_state == P_DONE) {
+            request_finish(req, ESP_OK);
+        }
+    }
+}
+
+static void request_resolved(esp_err_t err, uint32_t addr, uint32_t ttl, void *arg)
+{
+    net_http_request_t *req = (net_http_request_t *)arg;
+
+    if (req->state != REQ_RESOLVE) {
+        return;  // Timed out meanwhile
+    }
+    req->t_resolved = net_loop_now_ms();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s: DNS lookup failed: %s", req->host, esp_err_to_name(err));
+        request_finish(req, err);
+        return;
+    }
+
+    req->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (req->fd < 0) {
+        request_finish(req, ESP_ERR_NO_MEM);
+        return;
+    }
+    fcntl(req->fd, F_SETFL, O_NONBLOCK);
+
+    struct sockaddr_in server = {
+        .sin_family = AF_INET,
+        .sin_port = htons(req->port),
+        .sin_addr.s_addr = addr,
+    };
+    if (connect(req->fd, (struct sockaddr *)&server, sizeof(server)) != 0 && errno != EINPROGRESS) {
+        ESP_LOGE(TAG, "%s: connect failed (errno %d)", req->host, errno);
+        request_finish(req, ESP_FAIL);
+        return;
+    }
+
+    req->state = REQ_CONNECT;
+    if (net_loop_watch(req->fd, NET_LOOP_WRITE, request_io, req) != ESP_OK) {
+        request_finish(req, ESP_ERR_NO_MEM);
+    }
+}
+
+static void request_timeout(void *arg)
+{
+    net_http_request_t *req = (net_http_request_t *)arg;
+    req->timer = NET_LOOP_TIMER_INVALID;
+    ESP_LOGE(TAG, "%s: request timed out", req->host);
+    request_finish(req, ESP_ERR_TIMEOUT);
+}
+
+esp_err_t net_http_get(net_http_request_t *req, const char *url, const char *headers,
+                       const net_http_handler_t *handler, uint32_t timeout_ms)
+{
+    if (strncmp(url, "http://", 7) != 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    memset(req, 0, sizeof(*req));
+    req->fd = -1;
+    req->timer = NET_LOOP_TIMER_INVALID;
+    req->content_length = -1;
+    req->port = 80;
+    req->handler = *handler;
+
+    // Split "host[:port]/path"
+    const char *host = url + 7;
+    const char *path = strchr(host, '/');
+    size_t host_len = (path != NULL) ? (size_t)(path - host) : strlen(host);
+    if (path == NULL) {
+        path = "/";
+    }
+    const char *colon = memchr(host, ':', host_len);
+    if (colon != NULL) {
+        req->port = atoi(colon + 1);
+        host_len = colon - host;
+    }
+    if (host_len == 0 || host_len >= sizeof(req->host)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(req->host, host, host_len);
+    req->host[host_len] = '\0';
+
+    int len = snprintf(req->request, sizeof(req->request),
+                       "GET %s HTTP/1.1\r\n"
+                       "Host: %s\r\n"
+                       "User-Agent: esp8266-weather\r\n"
+                       "Connection: close\r\n"
+                       "%s\r\n",
+                       path, req->host, headers ? headers : "");
+    if (len < 0 || len >= (int)sizeof(req->request)) {
+        ESP_LOGE(TAG, "Request too long for buffer (%d bytes)", len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    req->request_len = len;
+
+    // Deadline first: a lookup in progress cannot be taken back
+    req->timer = net_loop_schedule(request_timeout, req, timeout_ms);
+    if (req->timer == NET_LOOP_TIMER_INVALID) {
+        return ESP_ERR_NO_MEM;
+    }
+    req->t_start = net_loop_now_ms();
+    req->state = REQ_RESOLVE;
+    esp_err_t err = net_dns_lookup(req->host, request_resolved, req);
+    if (err != ESP_OK) {
+        net_loop_cancel(req->timer);
+        req->timer = NET_LOOP_TIMER_INVALID;
+        req->state = REQ_IDLE;
+        return err;
+    }
+    return ESP_OK;
+}
+
+bool net_http_busy(const net_http_request_t *req)
+{
+    return req->state != REQ_IDLE;
+}
+
+void net_http_get_stats(net_http_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,290 @@
+#include "net_loop.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+static const char *TAG = "NET_LOOP";
+
+// Upper bound on select() sleep when no timer is due
+#define NET_LOOP_IDLE_MS 60000
+
+typedef struct {
+    int fd;
+    uint8_t events;
+    net_loop_io_cb_t cb;
+    void *arg;
+} net_loop_socket_t;
+
+typedef struct {
+    net_loop_cb_t cb;
+    void *arg;
+    int64_t due_ms;
+} net_loop_timer_t;
+
+static net_loop_socket_t s_sockets[NET_LOOP_MAX_SOCKETS];
+static net_loop_timer_t s_timers[NET_LOOP_MAX_TIMERS];
+static SemaphoreHandle_t s_timer_lock;
+static TaskHandle_t s_task;
+
+// Loopback UDP socket used to interrupt select() when a timer is added
+static int s_wake_fd = -1;
+static struct sockaddr_in s_wake_addr;
+
+int64_t net_loop_now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static void net_loop_wakeup(void)
+{
+    if (s_wake_fd >= 0 && xTaskGetCurrentTaskHandle() != s_task) {
+        uint8_t byte = 0;
+        sendto(s_wake_fd, &byte, 1, 0, (struct sockaddr *)&s_wake_addr, sizeof(s_wake_addr));
+    }
+}
+
+static void create_wake_socket(void)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return;
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(fd, (struct sockaddr *)&s_wake_addr, &len) != 0) {
+        ESP_LOGW(TAG, "No loopback wake socket, timers added from other tasks may be delayed");
+        close(fd);
+        return;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    s_wake_fd = fd;
+}
+
+esp_err_t net_loop_watch(int fd, uint8_t events, net_loop_io_cb_t cb, void *arg)
+{
+    net_loop_socket_t *free_slot = NULL;
+
+    for (int i = 0; i < NET_LOOP_MAX_SOCKETS; i++) {
+        if (s_sockets[i].fd == fd) {
+            free_slot = &s_sockets[i];
+            break;
+        }
+        if (s_sockets[i].fd < 0 && free_slot == NULL) {
+            free_slot = &s_sockets[i];
+        }
+    }
+    if (free_slot == NULL) {
+        ESP_LOGE(TAG, "No free socket slot for fd %d", fd);
+        return ESP_ERR_NO_MEM;
+    }
+
+    free_slot->fd = fd;
+    free_slot->events = events;
+    free_slot->cb = cb;
+    free_slot->arg = arg;
+    return ESP_OK;
+}
+
+void net_loop_unwatch(int fd)
+{
+    for (int i = 0; i < NET_LOOP_MAX_SOCKETS; i++) {
+        if (s_sockets[i].fd == fd) {
+            s_sockets[i].fd = -1;
+            s_sockets[i].cb = NULL;
+        }
+    }
+}
+
+int net_loop_schedule(net_loop_cb_t cb, void *arg, uint32_t delay_ms)
+{
+    int id = NET_LOOP_TIMER_INVALID;
+
+    if (s_timer_lock == NULL) {
+        ESP_LOGE(TAG, "Timer scheduled before net_loop_init()");
+        return NET_LOOP_TIMER_INVALID;
+    }
+    xSemaphoreTake(s_timer_lock, portMAX_DELAY);
+    for (int i = 0; i < NET_LOOP_MAX_TIMERS; i++) {
+        if (s_timers[i].cb == NULL) {
+            s_timers[i].cb = cb;
+            s_timers[i].arg = arg;
+            s_timers[i].due_ms = net_loop_now_ms() + delay_ms;
+            id = i;
+            break;
+        }
+    }
+    xSemaphoreGive(s_timer_lock);
+
+    if (id == NET_LOOP_TIMER_INVALID) {
+        ESP_LOGE(TAG, "No free timer slot");
+    } else {
+        net_loop_wakeup();
+    }
+    return id;
+}
+
+void net_loop_cancel(int timer_id)
+{
+    if (timer_id < 0 || timer_id >= NET_LOOP_MAX_TIMERS || s_timer_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_timer_lock, portMAX_DELAY);
+    s_timers[timer_id].cb = NULL;
+    xSemaphoreGive(s_timer_lock);
+}
+
+// Run due timers; returns milliseconds until the next one
+static int64_t run_timers(void)
+{
+    int64_t next_ms = NET_LOOP_IDLE_MS;
+
+    for (int i = 0; i < NET_LOOP_MAX_TIMERS; i++) {
+        net_loop_cb_t cb = NULL;
+        void *arg = NULL;
+        int64_t now = net_loop_now_ms();
+
+        xSemaphoreTake(s_timer_lock, portMAX_DELAY);
+        if (s_timers[i].cb != NULL) {
+            if (s_timers[i].due_ms <= now) {
+                cb = s_timers[i].cb;
+                arg = s_timers[i].arg;
+                s_timers[i].cb = NULL;
+            } else if (s_timers[i].due_ms - now < next_ms) {
+                next_ms = s_timers[i].due_ms - now;
+            }
+        }
+        xSemaphoreGive(s_timer_lock);
+
+        if (cb != NULL) {
+            cb(arg);
+            next_ms = 0;  // Callback may have scheduled more work, rescan
+        }
+    }
+    return next_ms;
+}
+
+static void net_loop_task(void *pvParameters)
+{
+    while (1) {
+        int64_t timeout_ms = run_timers();
+        if (timeout_ms == 0) {
+            continue;
+        }
+
+        fd_set read_fds, write_fds;
+        FD_ZERO(&read_fds);
+        FD_ZERO(&write_fds);
+        int max_fd = -1;
+
+        if (s_wake_fd >= 0) {
+            FD_SET(s_wake_fd, &read_fds);
+            max_fd = s_wake_fd;
+        }
+        for (int i = 0; i < NET_LOOP_MAX_SOCKETS; i++) {
+            int fd = s_sockets[i].fd;
+            if (fd < 0) {
+                continue;
+            }
+            if (s_sockets[i].events & NET_LOOP_READ) {
+                FD_SET(fd, &read_fds);
+            }
+            if (s_sockets[i].events & NET_LOOP_WRITE) {
+                FD_SET(fd, &write_fds);
+            }
+            if (fd > max_fd) {
+                max_fd = fd;
+            }
+        }
+
+        struct timeval tv = {
+            .tv_sec = timeout_ms / 1000,
+            .tv_usec = (timeout_ms % 1000) * 1000,
+        };
+        if (max_fd < 0) {
+            vTaskDelay(pdMS_TO_TICKS(timeout_ms < 100 ? timeout_ms : 100));
+            continue;
+        }
+
+        int ready = select(max_fd + 1, &read_fds, &write_fds, NULL, &tv);
+        if (ready <= 0) {
+            continue;
+        }
+
+        if (s_wake_fd >= 0 && FD_ISSET(s_wake_fd, &read_fds)) {
+            uint8_t drain[8];
+            while (recv(s_wake_fd, drain, sizeof(drain), 0) > 0) {
+            }
+        }
+
+        for (int i = 0; i < NET_LOOP_MAX_SOCKETS; i++) {
+            // Callbacks may unwatch or reuse slots, so re-read each one
+            int fd = s_sockets[i].fd;
+            if (fd < 0) {
+                continue;
+            }
+            uint8_t events = 0;
+            if ((s_sockets[i].events & NET_LOOP_READ) && FD_ISSET(fd, &read_fds)) {
+                events |= NET_LOOP_READ;
+            }
+            if ((s_sockets[i].events & NET_LOOP_WRITE) && FD_ISSET(fd, &write_fds)) {
+                events |= NET_LOOP_WRITE;
+            }
+            if (events != 0 && s_sockets[i].cb != NULL) {
+                s_sockets[i].cb(fd, events, s_sockets[i].arg);
+            }
+        }
+    }
+}
+
+esp_err_t net_loop_init(void)
+{
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+
+    for (int i = 0; i < NET_LOOP_MAX_SOCKETS; i++) {
+        s_sockets[i].fd = -1;
+    }
+    s_timer_lock = xSemaphoreCreateMutex();
+    if (s_timer_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    create_wake_socket();
+
+    if (xTaskCreate(net_loop_task, "net_loop", NET_LOOP_STACK_SIZE, NULL, 5, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create loop task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Network event loop started");
+    return ESP_OK;
+}
+
+bool net_loop_busy(void)
+{
+    if (s_task == NULL) {
+        return false;
+    }
+    // Unlocked read from another task: a snapshot is all callers need
+    for (int i = 0; i < NET_LOOP_MAX_SOCKETS; i++) {
+        if (s_sockets[i].fd >= 0 && !(s_sockets[i].events & NET_LOOP_QUIET)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t net_loop_stack_free(void)
+{
+    return (s_task != NULL) ? uxTaskGetStackHighWaterMark(s_task) : 0;
+}
@@ -0,0 +1,56 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Radio duty cycling around network windows.
+ *
+ * Between windows the station stays associated in modem sleep, waking only
+ * every CONFIG_POWER_LISTEN_INTERVAL beacons. Clients announce their next
+ * request with power_radio_expect(), so the radio is at full power from
+ * CONFIG_POWER_RADIO_LEAD_MS before it until CONFIG_POWER_RADIO_HOLD_MS
+ * after, and hold it with acquire/release while a request runs longer.
+ * Windows that overlap are merged.
+ */
+
+#define POWER_MAX_EXPECTED 4    // Announced windows pending at once
+
+typedef struct {
+    bool enabled;               // CONFIG_POWER_RADIO_SLEEP
+    bool awake;                 // Radio at full power now
+    uint32_t on_ms_this_hour;   // Full-power time in the hour in progress
+    uint32_t on_ms_last_hour;   // Same for the last complete hour
+    uint32_t on_ms_total;       // Since power_manager_init()
+    uint32_t uptime_ms;         // Time since power_manager_init(), for the ratio
+    uint32_t windows;           // Times the radio was woken
+    uint32_t unannounced;       // Of those, by a request nobody announced
+} power_radio_stats_t;
+
+/**
+ * @brief Start duty cycling; call once WiFi is started
+ */
+void power_manager_init(void);
+
+/**
+ * @brief Announce a request due in delay_ms (any task)
+ */
+void power_radio_expect(uint32_t delay_ms);
+
+/**
+ * @brief Keep the radio at full power until the matching release (any task)
+ */
+void power_radio_acquire(void);
+
+/**
+ * @brief End a request started with power_radio_acquire()
+ */
+void power_radio_release(void);
+
+/**
+ * @brief Full-power time per hour and window counts
+ */
+void power_manager_get_radio_stats(power_radio_stats_t *stats);
+
+#endif // POWER_MANAGER_H
@@ -0,0 +1,223 @@
+#include "power_manager.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+static const char *TAG = "POWER";
+
+#define POWER_HOUR_US   (3600LL * 1000000)
+#define POWER_LEAD_US   ((int64_t)CONFIG_POWER_RADIO_LEAD_MS * 1000)
+#define POWER_HOLD_US   ((int64_t)CONFIG_POWER_RADIO_HOLD_MS * 1000)
+
+#ifdef CONFIG_POWER_RADIO_SLEEP
+#define POWER_SLEEP_ENABLED true
+#else
+#define POWER_SLEEP_ENABLED false
+#endif
+
+static SemaphoreHandle_t s_lock;
+static esp_timer_handle_t s_timer;                  // Next window edge or end of the hour
+static int64_t s_expected_us[POWER_MAX_EXPECTED];   // Uptime of announced requests, 0 = free
+static int s_users;                                 // Acquired and not yet released
+static int64_t s_hold_until_us;                     // Window stays open until then without users
+static bool s_window;                               // Some request needs the radio now
+static bool s_awake;                                // Radio at full power
+static int64_t s_awake_since_us;
+
+// Radio-on accounting, all in microseconds of uptime
+static int64_t s_init_us;
+static int64_t s_hour_start_us;
+static int64_t s_hour_on_us;
+static int64_t s_last_hour_on_us;
+static int64_t s_total_on_us;
+static uint32_t s_windows;
+static uint32_t s_unannounced;
+
+// Charge full-power time up to now and close the hour once it has ended
+static void account_locked(int64_t now)
+{
+    if (s_awake) {
+        s_hour_on_us += now - s_awake_since_us;
+        s_total_on_us += now - s_awake_since_us;
+        s_awake_since_us = now;
+    }
+    if (now - s_hour_start_us >= POWER_HOUR_US) {
+        uint32_t permille = (uint32_t)(s_hour_on_us * 1000 / POWER_HOUR_US);
+        ESP_LOGI(TAG, "Radio at full power %u ms in the last hour (%u.%u%%), %u windows since boot",
+                 (uint32_t)(s_hour_on_us / 1000), permille / 10, permille % 10, s_windows);
+        s_last_hour_on_us = s_hour_on_us;
+        s_hour_on_us = 0;
+        s_hour_start_us = now - (now - s_hour_start_us) % POWER_HOUR_US;
+    }
+}
+
+static void set_awake_locked(bool awake, int64_t now)
+{
+    if (awake == s_awake) {
+        return;
+    }
+    account_locked(now);
+    s_awake = awake;
+    s_awake_since_us = now;
+    esp_wifi_set_ps(awake ? WIFI_PS_NONE : WIFI_PS_MAX_MODEM);
+    ESP_LOGD(TAG, "Radio %s", awake ? "awake" : "asleep");
+}
+
+// Open or close the window for the current time, then arm the timer for the
+// next time that can change
+static void update_locked(int64_t now)
+{
+    int64_t next = s_hour_start_us + POWER_HOUR_US;
+
+    // An announced request keeps the window open from the lead time before
+    // it until the hold time after
+    for (int i = 0; i < POWER_MAX_EXPECTED; i++) {
+        if (s_expected_us[i] == 0) {
+            continue;
+        }
+        if (s_expected_us[i] - POWER_LEAD_US <= now) {
+            if (s_expected_us[i] + POWER_HOLD_US > s_hold_until_us) {
+                s_hold_until_us = s_expected_us[i] + POWER_HOLD_US;
+            }
+            s_expected_us[i] = 0;
+        } else if (s_expected_us[i] - POWER_LEAD_US < next) {
+            next = s_expected_us[i] - POWER_LEAD_US;
+        }
+    }
+
+    bool window = (s_users > 0 || now < s_hold_until_us);
+    if (window && !s_window) {
+        s_windows++;
+    }
+    s_window = window;
+    if (s_users == 0 && now < s_hold_until_us && s_hold_until_us < next) {
+        next = s_hold_until_us;
+    }
+
+    // Without duty cycling the radio is never put to sleep, windows are only counted
+    set_awake_locked(window || !POWER_SLEEP_ENABLED, now);
+    account_locked(now);
+
+    esp_timer_stop(s_timer);
+    esp_timer_start_once(s_timer, next > now ? next - now : 1);
+}
+
+static void power_timer_cb(void *arg)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    update_locked(esp_timer_get_time());
+    xSemaphoreGive(s_lock);
+}
+
+void power_manager_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = power_timer_cb,
+        .name = "radio_power",
+    };
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (lock == NULL || esp_timer_create(&timer_args, &s_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start, radio stays at full power");
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    s_init_us = now;
+    s_hour_start_us = now;
+    s_awake_since_us = now;
+    s_awake = true;
+    if (POWER_SLEEP_ENABLED) {
+        // The listen interval in the station config sets how deep modem sleep goes
+        esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+        s_awake = false;
+        ESP_LOGI(TAG, "Radio sleeps between network windows (%d ms lead, %d ms hold)",
+                 CONFIG_POWER_RADIO_LEAD_MS, CONFIG_POWER_RADIO_HOLD_MS);
+    }
+
+    // Clients start calling in once the lock is visible
+    xSemaphoreTake(lock, portMAX_DELAY);
+    s_lock = lock;
+    update_locked(now);
+    xSemaphoreGive(lock);
+}
+
+void power_radio_expect(uint32_t delay_ms)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    int64_t due = now + (int64_t)delay_ms * 1000;
+    int slot = -1;
+    for (int i = 0; i < POWER_MAX_EXPECTED; i++) {
+        if (s_expected_us[i] == 0) {
+            slot = (slot < 0) ? i : slot;
+        } else if (s_expected_us[i] >= due - POWER_HOLD_US && s_expected_us[i] <= due) {
+            slot = i;       // Falls in that window already; keep the later time
+            break;
+        }
+    }
+    if (slot >= 0) {
+        s_expected_us[slot] = due;
+        update_locked(now);
+    } else {
+        ESP_LOGW(TAG, "Too many announced requests, one in %u ms will wake the radio late", delay_ms);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void power_radio_acquire(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (!s_window) {
+        s_unannounced++;
+    }
+    s_users++;
+    update_locked(esp_timer_get_time());
+    xSemaphoreGive(s_lock);
+}
+
+void power_radio_release(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    if (s_users > 0) {
+        s_users--;
+    }
+    if (now + POWER_HOLD_US > s_hold_until_us) {
+        s_hold_until_us = now + POWER_HOLD_US;
+    }
+    update_locked(now);
+    xSemaphoreGive(s_lock);
+}
+
+void power_manager_get_radio_stats(power_radio_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->enabled = POWER_SLEEP_ENABLED;
+    if (s_lock == NULL) {
+        stats->awake = true;
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    account_locked(now);
+    stats->awake = s_awake;
+    stats->on_ms_this_hour = (uint32_t)(s_hour_on_us / 1000);
+    stats->on_ms_last_hour = (uint32_t)(s_last_hour_on_us / 1000);
+    stats->on_ms_total = (uint32_t)(s_total_on_us / 1000);
+    stats->uptime_ms = (uint32_t)((now - s_init_us) / 1000);
+    stats->windows = s_windows;
+    stats->unannounced = s_unannounced;
+    xSemaphoreGive(s_lock);
+}
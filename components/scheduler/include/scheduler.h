@@ -0,0 +1,82 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/*
+ * Shared worker for periodic and one-shot jobs that do not need a task of
+ * their own (sensor sampling, display pages).
+ *
+ * Jobs run one at a time on a single worker task, earliest deadline first.
+ * An esp_timer wakes the worker at the next deadline, so a job starts on time
+ * unless the one before it is still running. Periodic jobs keep their phase:
+ * the next run is due one period after the last deadline, not after the run
+ * finished. A job must not block for long; work that waits on I/O belongs on
+ * net_loop or its own task.
+ */
+
+#define SCHED_MAX_JOBS      8
+#define SCHED_STACK_SIZE    3072
+#define SCHED_JOB_INVALID   (-1)
+
+typedef void (*sched_job_cb_t)(void *arg);
+
+// Lateness is start time minus deadline
+typedef struct {
+    const char *name;
+    uint32_t runs;
+    uint32_t late_avg_us;
+    uint32_t late_max_us;
+    uint32_t run_avg_us;
+    uint32_t run_max_us;
+} sched_job_stats_t;
+
+/**
+ * @brief Start the worker (safe to call more than once)
+ */
+esp_err_t sched_init(void);
+
+/**
+ * @brief Register a job, not scheduled yet
+ * @return Job id, or SCHED_JOB_INVALID if no slot is free
+ */
+int sched_add(const char *name, sched_job_cb_t cb, void *arg);
+
+/**
+ * @brief Run the job once after delay_ms, replacing any pending deadline (any task)
+ */
+void sched_after(int job, uint32_t delay_ms);
+
+/**
+ * @brief Run the job every period_ms, the first time after one period (any task)
+ */
+void sched_every(int job, uint32_t period_ms);
+
+/**
+ * @brief Run the job as soon as the worker is free (any task); a periodic job counts its period from now
+ */
+void sched_now(int job);
+
+/**
+ * @brief Drop the pending deadline and the period (any task)
+ */
+void sched_cancel(int job);
+
+/**
+ * @brief Run count, lateness against the deadline and run time of a job
+ */
+esp_err_t sched_get_job_stats(int job, sched_job_stats_t *stats);
+
+/**
+ * @brief Number of registered jobs
+ */
+int sched_job_count(void);
+
+/**
+ * @brief Minimum free stack of the worker in bytes (for diagnostics)
+ */
+uint32_t sched_stack_free(void);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,248 @@
+#include "scheduler.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "SCHED";
+
+#define SCHED_REPORT_US (3600LL * 1000000)
+
+typedef struct {
+    const char *name;
+    sched_job_cb_t cb;
+    void *arg;
+    bool pending;
+    int64_t due_us;
+    int64_t period_us;          // 0 for one-shot
+    uint32_t runs;
+    uint64_t late_total_us;
+    uint64_t run_total_us;
+    uint32_t late_max_us;
+    uint32_t run_max_us;
+} sched_job_t;
+
+static sched_job_t s_jobs[SCHED_MAX_JOBS];
+static int s_job_count;
+static SemaphoreHandle_t s_lock;
+static TaskHandle_t s_task;
+static esp_timer_handle_t s_timer;      // Wakes the worker at the earliest deadline
+static int64_t s_report_us;
+
+static void sched_timer_cb(void *arg)
+{
+    xTaskNotifyGive(s_task);
+}
+
+static void set_due(int job, int64_t due_us, int64_t period_us)
+{
+    if (s_lock == NULL || job < 0 || job >= s_job_count) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_jobs[job].pending = true;
+    s_jobs[job].due_us = due_us;
+    s_jobs[job].period_us = period_us;
+    xSemaphoreGive(s_lock);
+
+    // The worker looks for the earliest deadline again after each job anyway
+    if (xTaskGetCurrentTaskHandle() != s_task) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static void fill_stats(const sched_job_t *job, sched_job_stats_t *stats)
+{
+    stats->name = job->name;
+    stats->runs = job->runs;
+    stats->late_avg_us = job->runs ? (uint32_t)(job->late_total_us / job->runs) : 0;
+    stats->late_max_us = job->late_max_us;
+    stats->run_avg_us = job->runs ? (uint32_t)(job->run_total_us / job->runs) : 0;
+    stats->run_max_us = job->run_max_us;
+}
+
+static void report(void)
+{
+    sched_job_stats_t stats;
+
+    for (int i = 0; i < s_job_count; i++) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        fill_stats(&s_jobs[i], &stats);
+        xSemaphoreGive(s_lock);
+        ESP_LOGI(TAG, "%s: %u runs, late %u.%u ms avg, %u.%u ms max; run %u.%u ms avg, %u.%u ms max",
+                 stats.name, stats.runs,
+                 stats.late_avg_us / 1000, stats.late_avg_us / 100 % 10,
+                 stats.late_max_us / 1000, stats.late_max_us / 100 % 10,
+                 stats.run_avg_us / 1000, stats.run_avg_us / 100 % 10,
+                 stats.run_max_us / 1000, stats.run_max_us / 100 % 10);
+    }
+    ESP_LOGI(TAG, "Worker stack: %u of %d bytes never used", sched_stack_free(), SCHED_STACK_SIZE);
+}
+
+static void run_job(sched_job_t *job, int64_t due_us, int64_t start_us)
+{
+    job->cb(job->arg);
+
+    int64_t end_us = esp_timer_get_time();
+    uint32_t late_us = (uint32_t)(start_us - due_us);
+    uint32_t run_us = (uint32_t)(end_us - start_us);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    job->runs++;
+    job->late_total_us += late_us;
+    job->run_total_us += run_us;
+    if (late_us > job->late_max_us) {
+        job->late_max_us = late_us;
+    }
+    if (run_us > job->run_max_us) {
+        job->run_max_us = run_us;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (end_us - s_report_us >= SCHED_REPORT_US) {
+        s_report_us = end_us;
+        report();
+    }
+}
+
+static void sched_task(void *pvParameters)
+{
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        sched_job_t *job = NULL;
+        int64_t due_us = 0;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        for (int i = 0; i < s_job_count; i++) {
+            if (s_jobs[i].pending && (job == NULL || s_jobs[i].due_us < job->due_us)) {
+                job = &s_jobs[i];
+            }
+        }
+        if (job != NULL) {
+            due_us = job->due_us;
+            if (due_us <= now) {
+                if (job->period_us > 0) {
+                    // Keep the phase; periods missed while the worker was busy are skipped
+                    job->due_us += job->period_us * (1 + (now - due_us) / job->period_us);
+                } else {
+                    job->pending = false;
+                }
+            }
+        }
+        xSemaphoreGive(s_lock);
+
+        if (job != NULL && due_us <= now) {
+            run_job(job, due_us, now);
+            continue;
+        }
+
+        esp_timer_stop(s_timer);
+        if (job != NULL) {
+            esp_timer_start_once(s_timer, due_us - now);
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+esp_err_t sched_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = sched_timer_cb,
+        .name = "sched",
+    };
+
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL || esp_timer_create(&timer_args, &s_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the scheduler");
+        return ESP_ERR_NO_MEM;
+    }
+    s_report_us = esp_timer_get_time();
+
+    if (xTaskCreate(sched_task, "sched", SCHED_STACK_SIZE, NULL, 5, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create worker task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Job scheduler started");
+    return ESP_OK;
+}
+
+int sched_add(const char *name, sched_job_cb_t cb, void *arg)
+{
+    int id = SCHED_JOB_INVALID;
+
+    if (s_lock == NULL) {
+        return SCHED_JOB_INVALID;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_job_count < SCHED_MAX_JOBS) {
+        id = s_job_count;
+        memset(&s_jobs[id], 0, sizeof(s_jobs[id]));
+        s_jobs[id].name = name;
+        s_jobs[id].cb = cb;
+        s_jobs[id].arg = arg;
+        s_job_count++;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (id == SCHED_JOB_INVALID) {
+        ESP_LOGE(TAG, "No free job slot for %s", name);
+    }
+    return id;
+}
+
+void sched_after(int job, uint32_t delay_ms)
+{
+    set_due(job, esp_timer_get_time() + (int64_t)delay_ms * 1000, 0);
+}
+
+void sched_every(int job, uint32_t period_ms)
+{
+    int64_t period_us = (int64_t)period_ms * 1000;
+    set_due(job, esp_timer_get_time() + period_us, period_us);
+}
+
+void sched_now(int job)
+{
+    if (job < 0 || job >= s_job_count) {
+        return;
+    }
+    set_due(job, esp_timer_get_time(), s_jobs[job].period_us);
+}
+
+void sched_cancel(int job)
+{
+    if (s_lock == NULL || job < 0 || job >= s_job_count) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_jobs[job].pending = false;
+    s_jobs[job].period_us = 0;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t sched_get_job_stats(int job, sched_job_stats_t *stats)
+{
+    if (s_lock == NULL || job < 0 || job >= s_job_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    fill_stats(&s_jobs[job], stats);
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+int sched_job_count(void)
+{
+    return s_job_count;
+}
+
+uint32_t sched_stack_free(void)
+{
+    return (s_task != NULL) ? uxTaskGetStackHighWaterMark(s_task) : 0;
+}
@@ -0,0 +1,65 @@
+#ifndef SENSOR_FILTER_H
+#define SENSOR_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Integer-only filter chain for one sensor channel:
+ *   range check -> rate-of-change gate -> median of N -> exponential smoother
+ *
+ * Constant memory and constant time per sample. Values are fixed-point
+ * integers in the sensor's own unit (e.g. tenths of a degree).
+ */
+
+#define SENSOR_FILTER_MAX_MEDIAN 7
+
+typedef struct {
+    int16_t min;                // Range check, inclusive
+    int16_t max;
+    int16_t max_step;           // Largest change from the last accepted sample, 0 = no gate
+    uint8_t max_rejects;        // Consecutive gate rejections before accepting the new level
+    uint8_t median_len;         // 1 (off), 3, 5 or 7
+    uint8_t ema_shift;          // Smoothing factor 1/2^shift, 0 = off
+} sensor_filter_config_t;
+
+typedef struct {
+    uint32_t accepted;
+    uint32_t range_rejects;
+    uint32_t rate_rejects;
+    uint32_t rate_reanchors;    // Gate gave way after max_rejects (a real step)
+} sensor_filter_stats_t;
+
+typedef struct {
+    sensor_filter_config_t config;
+    sensor_filter_stats_t stats;
+    bool primed;
+    uint8_t consecutive_rejects;
+    int16_t last_accepted;
+    int16_t window[SENSOR_FILTER_MAX_MEDIAN];
+    uint8_t window_pos;
+    uint8_t window_count;
+    int32_t ema;                // Smoothed value << 8
+} sensor_filter_t;
+
+/**
+ * @brief Reset a filter with the given configuration
+ */
+void sensor_filter_init(sensor_filter_t *f, const sensor_filter_config_t *config);
+
+/**
+ * @brief Run a sample through the chain
+ * @param out Filtered value, only written when the sample is accepted
+ * @return false if the sample was rejected
+ */
+bool sensor_filter_apply(sensor_filter_t *f, int16_t raw, int16_t *out);
+
+/**
+ * @brief Per-stage counters
+ */
+static inline const sensor_filter_stats_t *sensor_filter_stats(const sensor_filter_t *f)
+{
+    return &f->stats;
+}
+
+#endif // SENSOR_FILTER_H
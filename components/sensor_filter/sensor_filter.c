@@ -0,0 +1,85 @@
+#include "sensor_filter.h"
+#include <string.h>
+#include <stdlib.h>
+
+void sensor_filter_init(sensor_filter_t *f, const sensor_filter_config_t *config)
+{
+    memset(f, 0, sizeof(*f));
+    f->config = *config;
+    if (f->config.median_len < 1) {
+        f->config.median_len = 1;
+    } else if (f->config.median_len > SENSOR_FILTER_MAX_MEDIAN) {
+        f->config.median_len = SENSOR_FILTER_MAX_MEDIAN;
+    }
+}
+
+static bool in_range(const sensor_filter_t *f, int16_t raw)
+{
+    return raw >= f->config.min && raw <= f->config.max;
+}
+
+static bool within_step(const sensor_filter_t *f, int16_t raw)
+{
+    return !f->primed || f->config.max_step == 0 ||
+           abs((int32_t)raw - f->last_accepted) <= f->config.max_step;
+}
+
+// Median of the window by insertion sort of a copy; at most 7 elements
+static int16_t window_median(const sensor_filter_t *f)
+{
+    int16_t sorted[SENSOR_FILTER_MAX_MEDIAN];
+    int n = f->window_count;
+
+    for (int i = 0; i < n; i++) {
+        int16_t v = f->window[i];
+        int j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = v;
+    }
+    return sorted[n / 2];
+}
+
+bool sensor_filter_apply(sensor_filter_t *f, int16_t raw, int16_t *out)
+{
+    if (!in_range(f, raw)) {
+        f->stats.range_rejects++;
+        return false;
+    }
+
+    // A sustained jump is a real change, not a glitch: give way after max_rejects
+    if (!within_step(f, raw)) {
+        if (++f->consecutive_rejects <= f->config.max_rejects) {
+            f->stats.rate_rejects++;
+            return false;
+        }
+        f->stats.rate_reanchors++;
+        f->window_count = 0;
+        f->window_pos = 0;
+        f->ema = (int32_t)raw * 256;
+    }
+    f->consecutive_rejects = 0;
+    f->last_accepted = raw;
+
+    f->window[f->window_pos] = raw;
+    f->window_pos = (f->window_pos + 1) % f->config.median_len;
+    if (f->window_count < f->config.median_len) {
+        f->window_count++;
+    }
+    int32_t value = window_median(f);
+
+    if (f->config.ema_shift > 0) {
+        if (!f->primed) {
+            f->ema = value * 256;
+        } else {
+            f->ema += (value * 256 - f->ema) / (1 << f->config.ema_shift);
+        }
+        value = (f->ema < 0) ? (f->ema - 128) / 256 : (f->ema + 128) / 256;
+    }
+
+    f->primed = true;
+    f->stats.accepted++;
+    *out = (int16_t)value;
+    return true;
+}
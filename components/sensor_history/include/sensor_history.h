@@ -0,0 +1,93 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <stdint.h>
+
+/*
+ * Fixed-size history of one sensor channel at three resolutions.
+ *
+ * Values are fixed-point integers (e.g. tenths of a degree). Each tier is a
+ * ring of 8-bit deltas from the previous sample; steps larger than +/-127
+ * are slew-limited and the stored series catches up over the next samples.
+ * Rolling min/max (monotonic queues), mean (running sum) and least-squares
+ * trend (running moments) are updated in O(1) amortized time per sample.
+ * Raw samples are averaged into 5-minute buckets, those into hourly ones.
+ */
+
+#ifdef CONFIG_SENSOR_HISTORY_LENGTH
+#define SENSOR_HISTORY_LENGTH CONFIG_SENSOR_HISTORY_LENGTH
+#else
+#define SENSOR_HISTORY_LENGTH 48
+#endif
+
+typedef enum {
+    SENSOR_HISTORY_RAW = 0,     // Every sample as added
+    SENSOR_HISTORY_5MIN,        // 5-minute means
+    SENSOR_HISTORY_HOURLY,      // Hourly means
+    SENSOR_HISTORY_TIERS,
+} sensor_history_tier_t;
+
+typedef struct {
+    int16_t value[SENSOR_HISTORY_LENGTH];
+    uint8_t seq[SENSOR_HISTORY_LENGTH];
+    uint8_t head;
+    uint8_t count;
+} sensor_history_deque_t;
+
+typedef struct {
+    int8_t delta[SENSOR_HISTORY_LENGTH];    // delta[i] = value[i] - value[i - 1]
+    uint8_t head;                           // Index of the oldest sample
+    uint8_t count;
+    uint8_t seq;                            // Sequence number of the next sample
+    int16_t oldest;
+    int16_t newest;
+    uint16_t period_s;                      // Nominal spacing, for the trend
+    int32_t sum;                            // Sum of values, for the mean
+    int64_t sum_kx;                         // Sum of k * value (k = 0 for the oldest)
+    sensor_history_deque_t min;             // Ascending candidates for the minimum
+    sensor_history_deque_t max;             // Descending candidates for the maximum
+} sensor_history_ring_t;
+
+typedef struct {
+    sensor_history_ring_t tier[SENSOR_HISTORY_TIERS];
+    // Buckets being averaged into the 5-minute and hourly tiers
+    int32_t acc_sum[2];
+    uint16_t acc_count[2];
+    uint32_t acc_bucket[2];
+} sensor_history_t;
+
+typedef struct {
+    uint8_t count;              // Samples in the window
+    int16_t latest;
+    int16_t min;
+    int16_t max;
+    int16_t mean;
+    int32_t trend_per_hour;     // Least-squares slope in value units per hour
+} sensor_history_stats_t;
+
+/**
+ * @brief Reset a history
+ * @param raw_period_s Nominal seconds between raw samples, used for the raw tier trend
+ */
+void sensor_history_init(sensor_history_t *h, uint16_t raw_period_s);
+
+/**
+ * @brief Add a sample
+ * @param now_s Monotonic time in seconds, used to close 5-minute and hourly buckets
+ */
+void sensor_history_add(sensor_history_t *h, int16_t value, uint32_t now_s);
+
+/**
+ * @brief Rolling statistics over the whole window of a tier
+ */
+void sensor_history_get_stats(const sensor_history_t *h, sensor_history_tier_t tier,
+                              sensor_history_stats_t *stats);
+
+/**
+ * @brief Decode a tier oldest-first, averaged down to at most @p max_points
+ * @return Number of points written
+ */
+int sensor_history_query(const sensor_history_t *h, sensor_history_tier_t tier,
+                         int16_t *out, int max_points);
+
+#endif // SENSOR_HISTORY_H
@@ -0,0 +1,170 @@
+#include "sensor_history.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define BUCKET_5MIN_S   300
+#define BUCKET_HOUR_S   3600
+
+static const uint16_t tier_period_s[SENSOR_HISTORY_TIERS] = {0, BUCKET_5MIN_S, BUCKET_HOUR_S};
+
+// Integer division rounding half away from zero
+static int16_t div_round(int32_t sum, int32_t count)
+{
+    return (sum < 0) ? (sum - count / 2) / count : (sum + count / 2) / count;
+}
+
+static uint8_t ring_index(uint8_t head, int offset)
+{
+    return (head + offset) % SENSOR_HISTORY_LENGTH;
+}
+
+// Drop the front candidate once the sample it refers to leaves the window
+static void deque_expire(sensor_history_deque_t *q, uint8_t seq)
+{
+    if (q->count > 0 && q->seq[q->head] == seq) {
+        q->head = ring_index(q->head, 1);
+        q->count--;
+    }
+}
+
+// Candidates dominated by the new value can never be the extreme again
+static void deque_push(sensor_history_deque_t *q, int16_t value, uint8_t seq, bool is_min)
+{
+    while (q->count > 0) {
+        int16_t back = q->value[ring_index(q->head, q->count - 1)];
+        if (is_min ? (back < value) : (back > value)) {
+            break;
+        }
+        q->count--;
+    }
+    uint8_t tail = ring_index(q->head, q->count);
+    q->value[tail] = value;
+    q->seq[tail] = seq;
+    q->count++;
+}
+
+static void ring_push(sensor_history_ring_t *r, int16_t value)
+{
+    if (r->count == 0) {
+        r->oldest = value;
+    } else {
+        int32_t delta = (int32_t)value - r->newest;
+        if (delta > INT8_MAX) {
+            delta = INT8_MAX;
+        } else if (delta < -INT8_MAX) {
+            delta = -INT8_MAX;
+        }
+        value = r->newest + delta;  // Stats follow what can be decoded
+        if (r->count == SENSOR_HISTORY_LENGTH) {
+            // Evict the oldest sample; the remaining ones all move down one position
+            int16_t evicted = r->oldest;
+            uint8_t evicted_seq = (uint8_t)(r->seq - r->count);
+            r->head = ring_index(r->head, 1);
+            r->oldest += r->delta[r->head];
+            r->count--;
+            r->sum -= evicted;
+            r->sum_kx -= r->sum;
+            deque_expire(&r->min, evicted_seq);
+            deque_expire(&r->max, evicted_seq);
+        }
+        r->delta[ring_index(r->head, r->count)] = (int8_t)delta;
+    }
+
+    r->newest = value;
+    r->sum_kx += (int64_t)r->count * value;
+    r->sum += value;
+    r->count++;
+    deque_push(&r->min, value, r->seq, true);
+    deque_push(&r->max, value, r->seq, false);
+    r->seq++;
+}
+
+void sensor_history_init(sensor_history_t *h, uint16_t raw_period_s)
+{
+    memset(h, 0, sizeof(*h));
+    for (int i = 0; i < SENSOR_HISTORY_TIERS; i++) {
+        h->tier[i].period_s = tier_period_s[i];
+    }
+    h->tier[SENSOR_HISTORY_RAW].period_s = raw_period_s;
+}
+
+// Average samples into the bucket of tier (level + 1), closing it when time moves on
+static void bucket_add(sensor_history_t *h, int level, int16_t value, uint32_t bucket)
+{
+    if (h->acc_count[level] > 0 && bucket != h->acc_bucket[level]) {
+        int16_t mean = div_round(h->acc_sum[level], h->acc_count[level]);
+        ring_push(&h->tier[level + 1], mean);
+        if (level == 0) {
+            bucket_add(h, 1, mean, h->acc_bucket[0] * BUCKET_5MIN_S / BUCKET_HOUR_S);
+        }
+        h->acc_sum[level] = 0;
+        h->acc_count[level] = 0;
+    }
+    h->acc_bucket[level] = bucket;
+    h->acc_sum[level] += value;
+    h->acc_count[level]++;
+}
+
+void sensor_history_add(sensor_history_t *h, int16_t value, uint32_t now_s)
+{
+    ring_push(&h->tier[SENSOR_HISTORY_RAW], value);
+    bucket_add(h, 0, value, now_s / BUCKET_5MIN_S);
+}
+
+void sensor_history_get_stats(const sensor_history_t *h, sensor_history_tier_t tier,
+                              sensor_history_stats_t *stats)
+{
+    const sensor_history_ring_t *r = &h->tier[tier];
+
+    memset(stats, 0, sizeof(*stats));
+    stats->count = r->count;
+    if (r->count == 0) {
+        return;
+    }
+    stats->latest = r->newest;
+    stats->min = r->min.value[r->min.head];
+    stats->max = r->max.value[r->max.head];
+    stats->mean = div_round(r->sum, r->count);
+
+    // Least-squares slope over k = 0..n-1 from running sums
+    int64_t n = r->count;
+    if (n >= 2 && r->period_s > 0) {
+        int64_t sum_k = n * (n - 1) / 2;
+        int64_t sum_kk = (n - 1) * n * (2 * n - 1) / 6;
+        int64_t num = n * r->sum_kx - sum_k * r->sum;
+        int64_t den = (n * sum_kk - sum_k * sum_k) * r->period_s;
+        stats->trend_per_hour = (int32_t)(num * 3600 / den);
+    }
+}
+
+int sensor_history_query(const sensor_history_t *h, sensor_history_tier_t tier,
+                         int16_t *out, int max_points)
+{
+    const sensor_history_ring_t *r = &h->tier[tier];
+    int points = (r->count < max_points) ? r->count : max_points;
+    int16_t value = r->oldest;
+    int32_t group_sum = 0;
+    int group_count = 0;
+    int written = 0;
+
+    if (points <= 0) {
+        return 0;
+    }
+
+    // Samples map to output points in contiguous groups, averaged on the fly
+    for (int i = 0; i < r->count; i++) {
+        if (i > 0) {
+            value += r->delta[ring_index(r->head, i)];
+        }
+        group_sum += value;
+        group_count++;
+
+        int next_group = (i + 1 < r->count) ? (i + 1) * points / r->count : points;
+        if (next_group != written) {
+            out[written++] = div_round(group_sum, group_count);
+            group_sum = 0;
+            group_count = 0;
+        }
+    }
+    return written;
+}
@@ -0,0 +1,144 @@
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sensor_filter.h"
+#include "sensor_history.h"
+
+/*
+ * Sensor drivers and the scheduler that samples them.
+ *
+ * A driver describes what it measures and how long a conversion takes; one
+ * job on the shared scheduler triggers the sensors in turn and comes back to
+ * read the result once the conversion is done, so only one sensor is ever
+ * being sampled at a time and no task is needed. Accepted readings are filtered and recorded
+ * per measured quantity.
+ *
+ * With CONFIG_SENSOR_ADAPTIVE each sensor's interval follows its signal:
+ * it shrinks quickly toward the driver's minimum while readings change
+ * faster than a threshold and grows back while they are flat. All reads,
+ * adaptive or not, draw from one budget of CONFIG_SENSOR_MAX_READS_PER_HOUR.
+ */
+
+#define SENSORS_MAX 4
+#define SENSORS_RETAINED 24     // Readings kept in RTC memory by sensors_set_retained()
+
+typedef enum {
+    SENSOR_TEMPERATURE = 0,     // Tenths of a degree Celsius
+    SENSOR_HUMIDITY,            // Tenths of a percent relative humidity
+    SENSOR_QUANTITIES,
+} sensor_quantity_t;
+
+#define SENSOR_CAP(quantity) (1u << (quantity))
+
+typedef struct {
+    int16_t value[SENSOR_QUANTITIES];   // Only quantities in the driver's capabilities are set
+} sensor_reading_t;
+
+typedef struct {
+    const char *name;
+    uint8_t capabilities;               // SENSOR_CAP() of each quantity measured
+    uint16_t conversion_ms;             // Time between trigger() and read()
+    uint16_t min_interval_ms;           // Shortest period the sensor supports
+    uint8_t max_retries;                // Extra attempts after a failed read
+    const sensor_filter_config_t *filter;   // Indexed by quantity
+
+    esp_err_t (*init)(void);
+    esp_err_t (*trigger)(void);         // Start a conversion; must not block for long
+    esp_err_t (*read)(sensor_reading_t *reading);
+} sensor_driver_t;
+
+typedef struct {
+    const char *name;
+    uint32_t interval_ms;           // Current sampling interval
+    uint32_t reads;                 // Conversions started since boot, retries included
+    uint32_t reads_per_hour;        // Effective rate since sampling started
+    uint32_t nominal_per_hour;      // Rate at the interval given to sensors_add()
+    uint32_t tightened;             // Interval shortened because readings changed
+    uint32_t relaxed;               // Interval lengthened because readings were flat
+    uint32_t throttled;             // Reads postponed by the read budget
+} sensor_sampling_stats_t;
+
+/**
+ * @brief Called on the scheduler's worker after each reading
+ * @param index Sensor index, in the order sensors were added
+ * @param reading Filtered values
+ * @param updated SENSOR_CAP() of quantities accepted by this reading
+ */
+typedef void (*sensors_listener_t)(int index, const sensor_reading_t *reading, uint8_t updated);
+
+/**
+ * @brief Initialize a sensor and add it to the schedule
+ * @param interval_ms Sampling period (the starting one when adaptive), raised to
+ *                    the driver's minimum if shorter
+ * @return Driver init error if the sensor is not usable; it is then not scheduled
+ */
+esp_err_t sensors_add(const sensor_driver_t *driver, uint32_t interval_ms);
+
+/**
+ * @brief Postpone sampling while the callback returns true (e.g. during network bursts)
+ */
+void sensors_set_defer_hook(bool (*busy)(void));
+
+/**
+ * @brief Receive every filtered reading (e.g. for logging); set before sensors_start()
+ */
+void sensors_set_listener(sensors_listener_t listener);
+
+/**
+ * @brief Keep recent readings in RTC memory for deep-sleep cycles; set before sensors_start()
+ *
+ * Each accepted reading is also stored in RTC memory (CONFIG_DEEP_SLEEP_MODE
+ * only, SENSORS_RETAINED of them). At the next start they are put back into
+ * the histories and the latest values are available at once; after a wake
+ * from deep sleep the first read is not delayed, the sensors stayed powered.
+ * @param clock_ms Time base that keeps running through deep sleep, used
+ *                 instead of the uptime for scheduling and history
+ */
+void sensors_set_retained(int64_t (*clock_ms)(void));
+
+/**
+ * @brief Start sampling on the shared scheduler
+ */
+esp_err_t sensors_start(void);
+
+/**
+ * @brief Latest filtered value of a quantity from the first sensor that has one
+ * @return ESP_ERR_INVALID_STATE until a reading has been accepted
+ */
+esp_err_t sensors_get(sensor_quantity_t quantity, int16_t *value);
+
+/**
+ * @brief Rolling min/max/mean/trend of a quantity at one history resolution
+ * @return ESP_ERR_INVALID_STATE until the first sample has been recorded
+ */
+esp_err_t sensors_get_history_stats(sensor_quantity_t quantity, sensor_history_tier_t tier,
+                                    sensor_history_stats_t *stats);
+
+/**
+ * @brief Copy a quantity's history oldest-first, e.g. for a sparkline
+ * @param max_points Output size; longer histories are averaged down to fit
+ * @return Number of points written
+ */
+int sensors_get_history(sensor_quantity_t quantity, sensor_history_tier_t tier,
+                        int16_t *out, int max_points);
+
+/**
+ * @brief Accepted and rejected sample counts of a quantity's filter chain
+ */
+esp_err_t sensors_get_filter_stats(sensor_quantity_t quantity, sensor_filter_stats_t *stats);
+
+/**
+ * @brief Number of sensors being sampled
+ */
+int sensors_count(void);
+
+/**
+ * @brief Sampling rate and interval adjustments of one sensor
+ * @param index 0 .. sensors_count() - 1, in the order sensors were added
+ */
+esp_err_t sensors_get_sampling_stats(int index, sensor_sampling_stats_t *stats);
+
+#endif // SENSORS_H
@@ -0,0 +1,640 @@
+#include "sensors.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "scheduler.h"
+
+static const char *TAG = "SENSORS";
+
+#define SENSORS_FIRST_READ_MS   2000    // Let sensors settle after power-up
+#define SENSORS_STAGGER_MS      1000    // Offset between first reads of consecutive sensors
+#define SENSORS_RETRY_DELAY_MS  500
+#define SENSORS_DEFER_STEP_MS   250
+#define SENSORS_MAX_DEFER_MS    5000    // Sample anyway after this long
+#define SENSORS_REPORT_MS       3600000
+
+// Read budget shared by all sensors: one read per SENSORS_READ_COST_MS on average
+#define SENSORS_READ_COST_MS    (3600000 / CONFIG_SENSOR_MAX_READS_PER_HOUR)
+#define SENSORS_READ_BURST      10
+
+#ifdef CONFIG_SENSOR_ADAPTIVE
+#define SENSORS_MAX_INTERVAL_MS ((uint32_t)CONFIG_SENSOR_ADAPTIVE_MAX_INTERVAL * 1000)
+#define SENSORS_DEADBAND        2       // +/-1 count of noise is never "changing"
+
+// Rate of change (tenths per minute) above which a quantity counts as changing
+static const uint16_t change_threshold[SENSOR_QUANTITIES] = {
+    [SENSOR_TEMPERATURE] = CONFIG_SENSOR_ADAPTIVE_TEMP_RATE,
+    [SENSOR_HUMIDITY] = CONFIG_SENSOR_ADAPTIVE_HUMIDITY_RATE,
+};
+#endif
+
+typedef struct {
+    const sensor_driver_t *driver;
+    uint32_t interval_ms;
+    uint32_t nominal_ms;                // Interval given to sensors_add()
+    int64_t next_due_ms;
+    int64_t ref_ms;                     // Adaptive sampling: change is measured from ref_value
+    int16_t ref_value[SENSOR_QUANTITIES];   // at ref_ms
+    int64_t round_start_ms;             // When the current (possibly retried) sample was due
+    uint32_t deferred_ms;
+    uint8_t retries;
+    uint8_t valid;                      // SENSOR_CAP() of quantities with an accepted reading
+    int16_t value[SENSOR_QUANTITIES];
+    sensor_filter_t filter[SENSOR_QUANTITIES];
+    sensor_history_t *history[SENSOR_QUANTITIES];   // Only for measured quantities
+    sensor_sampling_stats_t sampling;
+} sensor_slot_t;
+
+static sensor_slot_t s_slots[SENSORS_MAX];
+static int s_slot_count;
+static bool (*s_defer_hook)(void);
+static sensors_listener_t s_listener;
+static int s_job = SCHED_JOB_INVALID;
+static sensor_slot_t *s_converting;     // Triggered, read() due once the conversion is done
+static int64_t s_start_ms;
+static int64_t s_report_ms;
+static int64_t s_read_credit_ms;
+static int64_t s_credit_updated_ms;
+
+// Values, filters and histories are written by the sampling job and read by the display
+static SemaphoreHandle_t s_lock;
+static int64_t (*s_clock_ms)(void);     // Set for deep-sleep cycles, else uptime
+
+#ifdef CONFIG_DEEP_SLEEP_MODE
+#define SENSORS_RETAINED_MAGIC  0x534E5331  // "SNS1"
+
+// Survives deep sleep; must not be reloaded by the bootloader
+#ifdef RTC_NOINIT_ATTR
+#define SENSORS_RTC_ATTR RTC_NOINIT_ATTR
+#else
+#define SENSORS_RTC_ATTR RTC_DATA_ATTR
+#endif
+
+typedef struct {
+    int16_t value[SENSOR_QUANTITIES];
+    uint16_t gap_s;             // Since the previous entry, saturated
+    uint8_t slot;
+    uint8_t caps;               // Quantities accepted by this reading
+} retained_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t last_s;            // Time of the newest entry on the retained clock
+    uint8_t head;               // Oldest entry
+    uint8_t count;
+    uint16_t reserved;
+    retained_entry_t entry[SENSORS_RETAINED];
+    uint32_t check;             // Over everything above
+} retained_t;
+
+static SENSORS_RTC_ATTR retained_t s_retained;
+#endif
+
+static int64_t now_ms(void)
+{
+    return (s_clock_ms != NULL) ? s_clock_ms() : esp_timer_get_time() / 1000;
+}
+
+static const char *quantity_name(sensor_quantity_t quantity)
+{
+    return (quantity == SENSOR_TEMPERATURE) ? "temperature" : "humidity";
+}
+
+esp_err_t sensors_add(const sensor_driver_t *driver, uint32_t interval_ms)
+{
+    if (s_slot_count >= SENSORS_MAX || s_job != SCHED_JOB_INVALID) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+        if (s_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    esp_err_t err = driver->init();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "%s not available: %s", driver->name, esp_err_to_name(err));
+        return err;
+    }
+
+    sensor_slot_t *slot = &s_slots[s_slot_count];
+    memset(slot, 0, sizeof(*slot));
+    slot->driver = driver;
+    slot->interval_ms = (interval_ms < driver->min_interval_ms) ? driver->min_interval_ms : interval_ms;
+    slot->nominal_ms = slot->interval_ms;
+    slot->sampling.name = driver->name;
+
+    size_t history_bytes = 0;
+    for (int q = 0; q < SENSOR_QUANTITIES; q++) {
+        if (!(driver->capabilities & SENSOR_CAP(q))) {
+            continue;
+        }
+        slot->history[q] = malloc(sizeof(sensor_history_t));
+        if (slot->history[q] == NULL) {
+            for (int i = 0; i < q; i++) {
+                free(slot->history[i]);
+            }
+            return ESP_ERR_NO_MEM;
+        }
+#ifdef CONFIG_SENSOR_ADAPTIVE
+        // Raw samples are no longer evenly spaced, so the raw tier has no trend
+        sensor_history_init(slot->history[q], 0);
+#else
+        sensor_history_init(slot->history[q], slot->interval_ms / 1000);
+#endif
+        sensor_filter_init(&slot->filter[q], &driver->filter[q]);
+        history_bytes += sizeof(sensor_history_t);
+    }
+    s_slot_count++;
+
+    ESP_LOGI(TAG, "%s every %u ms (history %u bytes)", driver->name, slot->interval_ms, history_bytes);
+    return ESP_OK;
+}
+
+void sensors_set_defer_hook(bool (*busy)(void))
+{
+    s_defer_hook = busy;
+}
+
+void sensors_set_listener(sensors_listener_t listener)
+{
+    s_listener = listener;
+}
+
+void sensors_set_retained(int64_t (*clock_ms)(void))
+{
+    s_clock_ms = clock_ms;
+}
+
+static void log_reading(const sensor_slot_t *slot)
+{
+    char text[32] = "";
+    int len = 0;
+
+    if (slot->valid & SENSOR_CAP(SENSOR_TEMPERATURE)) {
+        int16_t t = slot->value[SENSOR_TEMPERATURE];
+        len += snprintf(text + len, sizeof(text) - len, " %s%d.%dC",
+                        t < 0 ? "-" : "", abs(t) / 10, abs(t) % 10);
+    }
+    if (slot->valid & SENSOR_CAP(SENSOR_HUMIDITY)) {
+        int16_t h = slot->value[SENSOR_HUMIDITY];
+        snprintf(text + len, sizeof(text) - len, " %d.%d%%", h / 10, h % 10);
+    }
+    ESP_LOGI(TAG, "%s:%s", slot->driver->name, text);
+}
+
+#ifdef CONFIG_SENSOR_ADAPTIVE
+// Quarter the interval on change so fast events are caught within a few
+// reads; grow it by a quarter per flat reading so one quiet reading does
+// not throw away the fast rate
+static bool adapt_interval(sensor_slot_t *slot, bool changing, bool flat)
+{
+    uint32_t max_ms = (slot->nominal_ms > SENSORS_MAX_INTERVAL_MS) ? slot->nominal_ms
+                                                                   : SENSORS_MAX_INTERVAL_MS;
+    uint32_t old_ms = slot->interval_ms;
+
+    if (changing) {
+        slot->interval_ms = old_ms / 4;
+        if (slot->interval_ms < slot->driver->min_interval_ms) {
+            slot->interval_ms = slot->driver->min_interval_ms;
+        }
+    } else if (flat) {
+        slot->interval_ms = old_ms + old_ms / 4;
+        if (slot->interval_ms > max_ms) {
+            slot->interval_ms = max_ms;
+        }
+    }
+
+    if (slot->interval_ms < old_ms) {
+        slot->sampling.tightened++;
+        ESP_LOGI(TAG, "%s: readings changing, interval %u -> %u ms", slot->driver->name,
+                 old_ms, slot->interval_ms);
+    } else if (slot->interval_ms > old_ms) {
+        slot->sampling.relaxed++;
+        ESP_LOGD(TAG, "%s: readings flat, interval %u -> %u ms", slot->driver->name,
+                 old_ms, slot->interval_ms);
+    }
+    return slot->interval_ms != old_ms;
+}
+#endif
+
+#ifdef CONFIG_DEEP_SLEEP_MODE
+static uint32_t retained_check(void)
+{
+    const uint32_t *word = (const uint32_t *)&s_retained;
+    uint32_t sum = 0x5A5A5A5A;
+
+    for (size_t i = 0; i < offsetof(retained_t, check) / sizeof(uint32_t); i++) {
+        sum = (sum << 5 | sum >> 27) ^ word[i];
+    }
+    return sum;
+}
+
+static void retained_append(int index, const int16_t *value, uint8_t caps, uint32_t now_s)
+{
+    uint32_t gap_s = (s_retained.count > 0) ? now_s - s_retained.last_s : 0;
+    int pos = (s_retained.head + s_retained.count) % SENSORS_RETAINED;
+    retained_entry_t *entry = &s_retained.entry[pos];
+
+    if (s_retained.count == SENSORS_RETAINED) {
+        s_retained.head = (s_retained.head + 1) % SENSORS_RETAINED;
+    } else {
+        s_retained.count++;
+    }
+    memcpy(entry->value, value, sizeof(entry->value));
+    entry->gap_s = (gap_s > UINT16_MAX) ? UINT16_MAX : gap_s;
+    entry->slot = index;
+    entry->caps = caps;
+    s_retained.last_s = now_s;
+    s_retained.check = retained_check();
+}
+
+// Put the readings kept through deep sleep back into the histories, spaced
+// as they were taken. Filters start over: readings minutes apart are not
+// smoothed into each other.
+static void retained_restore(void)
+{
+    if (s_retained.magic != SENSORS_RETAINED_MAGIC || s_retained.check != retained_check() ||
+        s_retained.count > SENSORS_RETAINED) {
+        memset(&s_retained, 0, sizeof(s_retained));
+        s_retained.magic = SENSORS_RETAINED_MAGIC;
+        s_retained.check = retained_check();
+        return;
+    }
+
+    uint32_t t = s_retained.last_s;
+    for (int i = 1; i < s_retained.count; i++) {
+        t -= s_retained.entry[(s_retained.head + i) % SENSORS_RETAINED].gap_s;
+    }
+    for (int i = 0; i < s_retained.count; i++) {
+        const retained_entry_t *entry = &s_retained.entry[(s_retained.head + i) % SENSORS_RETAINED];
+        t += (i > 0) ? entry->gap_s : 0;
+        if (entry->slot >= s_slot_count) {
+            continue;
+        }
+        sensor_slot_t *slot = &s_slots[entry->slot];
+        for (int q = 0; q < SENSOR_QUANTITIES; q++) {
+            if ((entry->caps & SENSOR_CAP(q)) && slot->history[q] != NULL) {
+                sensor_history_add(slot->history[q], entry->value[q], t);
+                slot->value[q] = entry->value[q];
+                slot->valid |= SENSOR_CAP(q);
+            }
+        }
+    }
+    ESP_LOGI(TAG, "%d readings restored from RTC memory", s_retained.count);
+}
+#endif
+
+static void record_reading(sensor_slot_t *slot, const sensor_reading_t *reading)
+{
+    uint8_t rejected = 0;
+    sensor_reading_t filtered_reading;
+    int64_t now = now_ms();
+    uint32_t now_s = now / 1000;
+#ifdef CONFIG_SENSOR_ADAPTIVE
+    bool changing = false;
+    bool flat = true;
+#endif
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int q = 0; q < SENSOR_QUANTITIES; q++) {
+        int16_t filtered;
+        if (slot->history[q] == NULL) {
+            continue;
+        }
+        if (sensor_filter_apply(&slot->filter[q], reading->value[q], &filtered)) {
+#ifdef CONFIG_SENSOR_ADAPTIVE
+            // Change of the accepted (unsmoothed) value since the reference,
+            // against the threshold, without dividing. Measuring over several
+            // readings keeps single-count noise from looking like a fast rate.
+            if (slot->valid & SENSOR_CAP(q)) {
+                int change = abs(reading->value[q] - slot->ref_value[q]);
+                int64_t change_per_min = (int64_t)change * 60000;
+                int64_t limit = (int64_t)change_threshold[q] * (now - slot->ref_ms);
+                if (change > SENSORS_DEADBAND && change_per_min > limit) {
+                    changing = true;
+                }
+                if (change_per_min * 2 > limit) {
+                    flat = false;
+                }
+            } else {
+                flat = false;
+            }
+#endif
+            slot->value[q] = filtered;
+            slot->valid |= SENSOR_CAP(q);
+            sensor_history_add(slot->history[q], filtered, now_s);
+        } else {
+            rejected |= SENSOR_CAP(q);
+        }
+    }
+#ifdef CONFIG_DEEP_SLEEP_MODE
+    if (s_clock_ms != NULL && (slot->driver->capabilities & ~rejected) != 0) {
+        retained_append(slot - s_slots, slot->value, slot->driver->capabilities & ~rejected, now_s);
+    }
+#endif
+#ifdef CONFIG_SENSOR_ADAPTIVE
+    // A flat reading also restarts the measurement, so a long quiet spell
+    // does not dilute the rate of a sudden change
+    if (adapt_interval(slot, changing, flat) || flat || slot->ref_ms == 0) {
+        slot->ref_ms = now;
+        for (int q = 0; q < SENSOR_QUANTITIES; q++) {
+            if (!(rejected & SENSOR_CAP(q))) {
+                slot->ref_value[q] = reading->value[q];
+            }
+        }
+    }
+#endif
+    memcpy(filtered_reading.value, slot->value, sizeof(filtered_reading.value));
+    xSemaphoreGive(s_lock);
+
+    if (s_listener != NULL) {
+        s_listener(slot - s_slots, &filtered_reading, slot->driver->capabilities & ~rejected);
+    }
+
+    for (int q = 0; q < SENSOR_QUANTITIES; q++) {
+        if (rejected & SENSOR_CAP(q)) {
+            const sensor_filter_stats_t *fs = sensor_filter_stats(&slot->filter[q]);
+            ESP_LOGW(TAG, "%s: rejected %s %d (range %u, rate %u, accepted %u)",
+                     slot->driver->name, quantity_name(q), reading->value[q],
+                     fs->range_rejects, fs->rate_rejects, fs->accepted);
+        }
+    }
+    log_reading(slot);
+}
+
+static esp_err_t sample_start(sensor_slot_t *slot)
+{
+    if (slot->retries == 0) {
+        slot->round_start_ms = slot->next_due_ms;
+    }
+    slot->sampling.reads++;
+    return slot->driver->trigger();
+}
+
+static void sample_finish(sensor_slot_t *slot, esp_err_t err)
+{
+    const sensor_driver_t *driver = slot->driver;
+    sensor_reading_t reading;
+
+    if (err == ESP_OK) {
+        err = driver->read(&reading);
+    }
+
+    if (err != ESP_OK && slot->retries < driver->max_retries) {
+        slot->retries++;
+        ESP_LOGW(TAG, "%s: %s, retry %d/%d", driver->name, esp_err_to_name(err),
+                 slot->retries, driver->max_retries);
+        slot->next_due_ms = now_ms() + SENSORS_RETRY_DELAY_MS;
+        return;
+    }
+
+    if (err == ESP_OK) {
+        record_reading(slot, &reading);
+    } else {
+        // Keep the last valid reading
+        ESP_LOGW(TAG, "%s: no reading after %d retries", driver->name, driver->max_retries);
+    }
+    slot->retries = 0;
+
+    // Keep the cadence unless retries or deferral pushed past the next period
+    slot->next_due_ms = slot->round_start_ms + slot->interval_ms;
+    if (slot->next_due_ms < now_ms()) {
+        slot->next_due_ms = now_ms() + slot->interval_ms;
+    }
+}
+
+// Wait needed before the budget allows another read; takes the read if none
+static int64_t read_budget_wait(int64_t now)
+{
+    s_read_credit_ms += now - s_credit_updated_ms;
+    s_credit_updated_ms = now;
+    if (s_read_credit_ms > (int64_t)SENSORS_READ_BURST * SENSORS_READ_COST_MS) {
+        s_read_credit_ms = (int64_t)SENSORS_READ_BURST * SENSORS_READ_COST_MS;
+    }
+    if (s_read_credit_ms < SENSORS_READ_COST_MS) {
+        return SENSORS_READ_COST_MS - s_read_credit_ms;
+    }
+    s_read_credit_ms -= SENSORS_READ_COST_MS;
+    return 0;
+}
+
+static void report_sampling(void)
+{
+    sensor_sampling_stats_t stats;
+
+    for (int i = 0; i < s_slot_count; i++) {
+        sensors_get_sampling_stats(i, &stats);
+        ESP_LOGI(TAG, "%s: %u reads/h (fixed interval: %u/h), interval %u ms, "
+                 "%u tightened, %u relaxed, %u throttled",
+                 stats.name, stats.reads_per_hour, stats.nominal_per_hour, stats.interval_ms,
+                 stats.tightened, stats.relaxed, stats.throttled);
+    }
+}
+
+// Runs on the scheduler: samples whatever is due and schedules itself for the
+// next due sensor. A conversion in progress ends the run; the job comes back
+// for read() once it is done, so the worker never sleeps through it.
+static void sensors_job(void *arg)
+{
+    if (s_converting != NULL) {
+        sample_finish(s_converting, ESP_OK);
+        s_converting = NULL;
+    }
+
+    while (1) {
+        sensor_slot_t *slot = &s_slots[0];
+        for (int i = 1; i < s_slot_count; i++) {
+            if (s_slots[i].next_due_ms < slot->next_due_ms) {
+                slot = &s_slots[i];
+            }
+        }
+
+        int64_t now = now_ms();
+        if (slot->next_due_ms > now) {
+            sched_after(s_job, (uint32_t)(slot->next_due_ms - now));
+            break;
+        }
+
+        // Network bursts keep interrupts busy; let them finish unless it takes too long
+        if (s_defer_hook != NULL && slot->deferred_ms < SENSORS_MAX_DEFER_MS && s_defer_hook()) {
+            slot->next_due_ms = now + SENSORS_DEFER_STEP_MS;
+            slot->deferred_ms += SENSORS_DEFER_STEP_MS;
+            continue;
+        }
+        slot->deferred_ms = 0;
+
+        int64_t wait_ms = read_budget_wait(now);
+        if (wait_ms > 0) {
+            slot->next_due_ms = now + wait_ms;
+            slot->sampling.throttled++;
+            continue;
+        }
+
+        if (now - s_report_ms >= SENSORS_REPORT_MS) {
+            s_report_ms = now;
+            report_sampling();
+        }
+
+        esp_err_t err = sample_start(slot);
+        if (err == ESP_OK && slot->driver->conversion_ms > 0) {
+            s_converting = slot;
+            sched_after(s_job, slot->driver->conversion_ms);
+            break;
+        }
+        sample_finish(slot, err);
+    }
+}
+
+esp_err_t sensors_start(void)
+{
+    if (s_job != SCHED_JOB_INVALID) {
+        return ESP_OK;
+    }
+    if (s_slot_count == 0) {
+        ESP_LOGW(TAG, "No sensors available");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    int64_t now = now_ms();
+    int64_t first_ms = SENSORS_FIRST_READ_MS;
+#ifdef CONFIG_DEEP_SLEEP_MODE
+    if (s_clock_ms != NULL) {
+        retained_restore();
+        if (esp_reset_reason() == ESP_RST_DEEPSLEEP) {
+            first_ms = 0;
+        }
+    }
+#endif
+    s_start_ms = now;
+    s_report_ms = now;
+    s_credit_updated_ms = now;
+    s_read_credit_ms = (int64_t)SENSORS_READ_BURST * SENSORS_READ_COST_MS;
+    for (int i = 0; i < s_slot_count; i++) {
+        s_slots[i].next_due_ms = now + first_ms + i * SENSORS_STAGGER_MS;
+    }
+
+    esp_err_t err = sched_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_job = sched_add("sensors", sensors_job, NULL);
+    if (s_job == SCHED_JOB_INVALID) {
+        return ESP_ERR_NO_MEM;
+    }
+    sched_now(s_job);
+    return ESP_OK;
+}
+
+// First sensor with an accepted reading of the quantity, else the first that measures it
+static sensor_slot_t *find_source(sensor_quantity_t quantity)
+{
+    sensor_slot_t *fallback = NULL;
+
+    if (quantity >= SENSOR_QUANTITIES) {
+        return NULL;
+    }
+    for (int i = 0; i < s_slot_count; i++) {
+        if (s_slots[i].valid & SENSOR_CAP(quantity)) {
+            return &s_slots[i];
+        }
+        if (fallback == NULL && s_slots[i].history[quantity] != NULL) {
+            fallback = &s_slots[i];
+        }
+    }
+    return fallback;
+}
+
+esp_err_t sensors_get(sensor_quantity_t quantity, int16_t *value)
+{
+    sensor_slot_t *slot = find_source(quantity);
+
+    if (slot == NULL || !(slot->valid & SENSOR_CAP(quantity))) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (value != NULL) {
+        *value = slot->value[quantity];
+    }
+    return ESP_OK;
+}
+
+esp_err_t sensors_get_history_stats(sensor_quantity_t quantity, sensor_history_tier_t tier,
+                                    sensor_history_stats_t *stats)
+{
+    sensor_slot_t *slot = find_source(quantity);
+
+    if (tier >= SENSOR_HISTORY_TIERS || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (slot == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sensor_history_get_stats(slot->history[quantity], tier, stats);
+    xSemaphoreGive(s_lock);
+
+    return (stats->count > 0) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+int sensors_get_history(sensor_quantity_t quantity, sensor_history_tier_t tier,
+                        int16_t *out, int max_points)
+{
+    sensor_slot_t *slot = find_source(quantity);
+
+    if (slot == NULL || tier >= SENSOR_HISTORY_TIERS || out == NULL) {
+        return 0;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int points = sensor_history_query(slot->history[quantity], tier, out, max_points);
+    xSemaphoreGive(s_lock);
+    return points;
+}
+
+esp_err_t sensors_get_filter_stats(sensor_quantity_t quantity, sensor_filter_stats_t *stats)
+{
+    sensor_slot_t *slot = find_source(quantity);
+
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (slot == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = *sensor_filter_stats(&slot->filter[quantity]);
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+int sensors_count(void)
+{
+    return s_slot_count;
+}
+
+esp_err_t sensors_get_sampling_stats(int index, sensor_sampling_stats_t *stats)
+{
+    if (index < 0 || index >= s_slot_count || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const sensor_slot_t *slot = &s_slots[index];
+    int64_t elapsed_ms = now_ms() - s_start_ms;
+
+    *stats = slot->sampling;
+    stats->interval_ms = slot->interval_ms;
+    stats->nominal_per_hour = 3600000 / slot->nominal_ms;
+    stats->reads_per_hour = (elapsed_ms > 0) ? (uint32_t)((int64_t)slot->sampling.reads * 3600000 / elapsed_ms) : 0;
+    return ESP_OK;
+}
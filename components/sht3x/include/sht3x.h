@@ -0,0 +1,12 @@
+#ifndef SHT3X_H
+#define SHT3X_H
+
+#include "sensors.h"
+
+/**
+ * @brief Sensirion SHT30/31/35 temperature and humidity driver on the shared I2C bus,
+ *        for sensors_add()
+ */
+extern const sensor_driver_t sht3x_sensor;
+
+#endif // SHT3X_H
@@ -0,0 +1,126 @@
+#include "sht3x.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "i2c_bus.h"
+
+static const char *TAG = "SHT3X";
+
+#define SHT3X_ADDR CONFIG_SHT3X_I2C_ADDR
+
+// Single-shot measurement, high repeatability, no clock stretching
+#define SHT3X_CMD_MEASURE   0x2400
+#define SHT3X_CMD_SOFT_RESET 0x30A2
+#define SHT3X_MEASURE_MS    16      // 15 ms max at high repeatability
+#define SHT3X_RESET_MS      2
+#define SHT3X_MIN_INTERVAL_MS 1000
+#define SHT3X_MAX_RETRIES   1
+#define SHT3X_TIMEOUT_MS    100
+
+// Sensor range from the datasheet: -40..125 C, 0..100 %RH. Less noisy than the DHT22.
+static const sensor_filter_config_t sht3x_filter_config[SENSOR_QUANTITIES] = {
+    [SENSOR_TEMPERATURE] = {
+        .min = -400, .max = 1250,
+        .max_step = 30,
+        .max_rejects = 2,
+        .median_len = 1,
+        .ema_shift = 1,
+    },
+    [SENSOR_HUMIDITY] = {
+        .min = 0, .max = 1000,
+        .max_step = 150,
+        .max_rejects = 2,
+        .median_len = 1,
+        .ema_shift = 1,
+    },
+};
+
+static esp_err_t sht3x_command(uint16_t command)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (SHT3X_ADDR << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(cmd, command >> 8, true);
+    i2c_master_write_byte(cmd, command & 0xFF, true);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(SHT3X_TIMEOUT_MS));
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
+// CRC-8, polynomial 0x31, initial value 0xFF
+static uint8_t sht3x_crc(const uint8_t *data, int len)
+{
+    uint8_t crc = 0xFF;
+    for (int i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static esp_err_t sht3x_trigger(void)
+{
+    return sht3x_command(SHT3X_CMD_MEASURE);
+}
+
+static esp_err_t sht3x_read(sensor_reading_t *reading)
+{
+    uint8_t data[6];
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (SHT3X_ADDR << 1) | I2C_MASTER_READ, true);
+    i2c_master_read(cmd, data, sizeof(data) - 1, I2C_MASTER_ACK);
+    i2c_master_read_byte(cmd, &data[sizeof(data) - 1], I2C_MASTER_NACK);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(SHT3X_TIMEOUT_MS));
+    i2c_cmd_link_delete(cmd);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (sht3x_crc(&data[0], 2) != data[2] || sht3x_crc(&data[3], 2) != data[5]) {
+        ESP_LOGW(TAG, "CRC error");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    // T = -45 + 175 * raw / 65535, RH = 100 * raw / 65535, in tenths
+    uint32_t raw_t = ((uint32_t)data[0] << 8) | data[1];
+    uint32_t raw_h = ((uint32_t)data[3] << 8) | data[4];
+    reading->value[SENSOR_TEMPERATURE] = (int16_t)((int32_t)((raw_t * 1750 + 32767) / 65535) - 450);
+    reading->value[SENSOR_HUMIDITY] = (int16_t)((raw_h * 1000 + 32767) / 65535);
+    return ESP_OK;
+}
+
+static esp_err_t sht3x_init(void)
+{
+    esp_err_t err = i2c_bus_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Also tells us whether anything answers at the address
+    err = sht3x_command(SHT3X_CMD_SOFT_RESET);
+    if (err != ESP_OK) {
+        return err;
+    }
+    vTaskDelay(pdMS_TO_TICKS(SHT3X_RESET_MS) + 1);
+
+    ESP_LOGI(TAG, "SHT3x initialized at 0x%02X", SHT3X_ADDR);
+    return ESP_OK;
+}
+
+const sensor_driver_t sht3x_sensor = {
+    .name = "SHT3x",
+    .capabilities = SENSOR_CAP(SENSOR_TEMPERATURE) | SENSOR_CAP(SENSOR_HUMIDITY),
+    .conversion_ms = SHT3X_MEASURE_MS,
+    .min_interval_ms = SHT3X_MIN_INTERVAL_MS,
+    .max_retries = SHT3X_MAX_RETRIES,
+    .filter = sht3x_filter_config,
+    .init = sht3x_init,
+    .trigger = sht3x_trigger,
+    .read = sht3x_read,
+};
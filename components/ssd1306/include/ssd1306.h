@@ -8,11 +8,42 @@
 #define SSD1306_WIDTH  128
 #define SSD1306_HEIGHT 64
 
+typedef struct {
+    uint32_t flushes;           // Frames sent to the panel
+    uint32_t last_bytes;        // Bytes on the wire for the last frame
+    uint32_t total_bytes;
+    uint32_t last_us;           // Time to send the last frame
+    uint32_t max_us;
+} ssd1306_flush_stats_t;
+
 /**
  * @brief Initialize SSD1306 display
  */
 void ssd1306_init(void);
 
+/**
+ * @brief Initialize the panel without the page rotation, for deep-sleep cycles
+ *
+ * After a wake from deep sleep the panel is left as it was; it is only
+ * configured after a power-on.
+ */
+void ssd1306_init_oneshot(void);
+
+/**
+ * @brief Draw the main screen from the calling task (after ssd1306_init_oneshot())
+ */
+void ssd1306_draw_main(void);
+
+/**
+ * @brief Redraw the main screen now instead of at the next update interval (any task)
+ */
+void ssd1306_refresh(void);
+
+/**
+ * @brief Repaint the page on screen with the current clock, keeping the page rotation (any task)
+ */
+void ssd1306_redraw(void);
+
 /**
  * @brief Clear display buffer
  */
@@ -23,6 +54,11 @@ void ssd1306_clear(void);
  */
 void ssd1306_display(void);
 
+/**
+ * @brief Frame count, size and send time of ssd1306_display() since boot
+ */
+void ssd1306_get_flush_stats(ssd1306_flush_stats_t *stats);
+
 /**
  * @brief Set pixel at position
  */
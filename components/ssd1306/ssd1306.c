@@ -1,23 +1,32 @@
 #include "ssd1306.h"
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/i2c.h"
 #include "driver/gpio.h"
-#include "dht22.h"
+#include "i2c_bus.h"
+#include "sensors.h"
 #include "weather_api.h"
 #include "wifi_manager.h"
 #include "time_manager.h"
+#include "scheduler.h"
 
 static const char *TAG = "SSD1306";
 
-#define I2C_MASTER_NUM I2C_NUM_0
-#define I2C_MASTER_FREQ_HZ 100000
 #define SSD1306_ADDR CONFIG_SSD1306_I2C_ADDR
 
 static uint8_t display_buffer[SSD1306_WIDTH * SSD1306_HEIGHT / 8];
+static int s_page_job = SCHED_JOB_INVALID;
+static int s_refresh_job = SCHED_JOB_INVALID;
+static int s_redraw_job = SCHED_JOB_INVALID;
+static int s_page;                  // Page on screen: 0 is the main screen
+static ssd1306_flush_stats_t s_flush_stats;
+static uint32_t s_wire_bytes;       // Address, control and payload bytes sent
 
 // SSD1306 commands
 #define SSD1306_SETCONTRAST 0x81
@@ -52,7 +61,8 @@ static esp_err_t ssd1306_write_command(uint8_t command)
     i2c_master_write_byte(cmd, 0x00, true);  // Command mode
     i2c_master_write_byte(cmd, command, true);
     i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
+    s_wire_bytes += 3;
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(1000));
     i2c_cmd_link_delete(cmd);
     return ret;
 }
@@ -65,24 +75,15 @@ static esp_err_t ssd1306_write_data(uint8_t *data, size_t len)
     i2c_master_write_byte(cmd, 0x40, true);  // Data mode
     i2c_master_write(cmd, data, len, true);
     i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
+    s_wire_bytes += 2 + len;
+    esp_err_t ret = i2c_bus_cmd_begin(cmd, pdMS_TO_TICKS(1000));
     i2c_cmd_link_delete(cmd);
     return ret;
 }
 
 static void ssd1306_init_display(void)
 {
-    // Initialize I2C
-    i2c_config_t conf;
-    conf.mode = I2C_MODE_MASTER;
-    conf.sda_io_num = CONFIG_SSD1306_SDA_GPIO;
-    conf.scl_io_num = CONFIG_SSD1306_SCL_GPIO;
-    conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.clk_stretch_tick = 300; // Maximum wait time for clock stretch
-    
-    ESP_ERROR_CHECK(i2c_driver_install(I2C_MASTER_NUM, conf.mode));
-    ESP_ERROR_CHECK(i2c_param_config(I2C_MASTER_NUM, &conf));
+    ESP_ERROR_CHECK(i2c_bus_init());
 
     vTaskDelay(pdMS_TO_TICKS(100));
 
@@ -123,6 +124,9 @@ void ssd1306_clear(void)
 
 void ssd1306_display(void)
 {
+    int64_t start = esp_timer_get_time();
+    uint32_t bytes = s_wire_bytes;
+
     ssd1306_write_command(SSD1306_COLUMNADDR);
     ssd1306_write_command(0);
     ssd1306_write_command(SSD1306_WIDTH - 1);
@@ -133,6 +137,22 @@ void ssd1306_display(void)
     for (uint16_t i = 0; i < (SSD1306_WIDTH * SSD1306_HEIGHT / 8); i += 16) {
         ssd1306_write_data(&display_buffer[i], 16);
     }
+
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+    s_flush_stats.flushes++;
+    s_flush_stats.last_bytes = s_wire_bytes - bytes;
+    s_flush_stats.total_bytes += s_flush_stats.last_bytes;
+    s_flush_stats.last_us = us;
+    if (us > s_flush_stats.max_us) {
+        s_flush_stats.max_us = us;
+    }
+}
+
+void ssd1306_get_flush_stats(ssd1306_flush_stats_t *stats)
+{
+    // Frames are only sent from one task at a time; a copy taken mid-frame is
+    // at most one frame behind
+    *stats = s_flush_stats;
 }
 
 void ssd1306_draw_pixel(int16_t x, int16_t y, bool color)
@@ -148,6 +168,12 @@ void ssd1306_draw_pixel(int16_t x, int16_t y, bool color)
     }
 }
 
+// Round a value in tenths to the nearest whole unit (half away from zero)
+static int deci_to_whole(int16_t deci)
+{
+    return (deci < 0) ? (deci - 5) / 10 : (deci + 5) / 10;
+}
+
 static void draw_weather_screen(void)
 {
     ssd1306_clear();
@@ -163,25 +189,20 @@ static void draw_weather_screen(void)
         snprintf(time_str, sizeof(time_str), "--:--");
     }
     
-    // ===== FIRST LINE (y=2): TIME | DHT22 TEMP | WIFI =====
+    // ===== FIRST LINE (y=2): TIME | INDOOR TEMP | WIFI =====
     // Draw time on the left
     ssd1306_draw_string(2, 2, time_str, 1);
     
-    // Draw DHT22 temperature in the center
+    // Draw indoor temperature in the center
     char temp_str[16];
-    if (dht22_is_valid()) {
-        float dht_temp = dht22_get_temperature();
-        int temp_whole = (int)dht_temp;
-        int temp_decimal = (int)((dht_temp - temp_whole) * 10 + 0.5);
-        if (temp_decimal >= 10) {
-            temp_whole += 1;
-            temp_decimal = 0;
-        }
-        snprintf(temp_str, sizeof(temp_str), "%d.%dC", temp_whole, temp_decimal);
+    int16_t indoor_temp;
+    if (sensors_get(SENSOR_TEMPERATURE, &indoor_temp) == ESP_OK) {
+        snprintf(temp_str, sizeof(temp_str), "%s%d.%dC", indoor_temp < 0 ? "-" : "",
+                 abs(indoor_temp) / 10, abs(indoor_temp) % 10);
     } else {
         snprintf(temp_str, sizeof(temp_str), "--.-C");
     }
-    // Centralize DHT22 temp
+    // Centralize indoor temp
     int text_width = strlen(temp_str) * 6;
     int x_centered = (128 - text_width) / 2;
     ssd1306_draw_string(x_centered, 2, temp_str, 1);
@@ -209,15 +230,7 @@ static void draw_weather_screen(void)
 
         // Draw current temperature (large font, below icon) - subido 8 pixels
         char temp[16];
-        int temp_whole = (int)forecast[0].temp;
-        int temp_decimal = (int)((forecast[0].temp - temp_whole) * 10);
-        if (temp_decimal < 0) temp_decimal = -temp_decimal;
-
-        if (temp_whole != 0 || forecast[0].temp > 0.5) {
-            snprintf(temp, sizeof(temp), "%dC", temp_whole);
-        } else {
-            snprintf(temp, sizeof(temp), "0C");
-        }
+        snprintf(temp, sizeof(temp), "%dC", deci_to_whole(forecast[0].temp));
         ssd1306_draw_string(4, 38, temp, 2);  // Large font - moved up 8 pixels (46 - 4 - 3 - 1 = 38)
 
         // Draw day of week at bottom of screen (small font)
@@ -249,13 +262,7 @@ static void draw_weather_screen(void)
 
             // Draw temperature below icon (small font)
             char temp[16];
-            int temp_whole = (int)forecast[i].temp;
-
-            if (temp_whole != 0 || forecast[i].temp > 0.5) {
-                snprintf(temp, sizeof(temp), "%dC", temp_whole);
-            } else {
-                snprintf(temp, sizeof(temp), "0C");
-            }
+            snprintf(temp, sizeof(temp), "%dC", deci_to_whole(forecast[i].temp));
 
             // Centralize temperature under icon (icon is 16px wide)
             int temp_width = strlen(temp) * 6;  // Font size 1 is ~6 pixels per char
@@ -278,14 +285,87 @@ static void draw_weather_screen(void)
     ssd1306_display();
 }
 
-static void display_update_task(void *pvParameters)
+#define LOCATIONS_PER_PAGE 4
+
+// Additional sites, one text row each: name on the left, temperature on the right
+static void draw_locations_screen(int page)
 {
-    while (1) {
+    ssd1306_clear();
+
+    struct tm timeinfo;
+    char str[24];
+    if (time_manager_get_time(&timeinfo) == ESP_OK) {
+        snprintf(str, sizeof(str), "%02d:%02d", timeinfo.tm_hour, timeinfo.tm_min);
+    } else {
+        snprintf(str, sizeof(str), "--:--");
+    }
+    ssd1306_draw_string(2, 2, str, 1);
+    ssd1306_draw_wifi_icon(110, 2, wifi_is_connected());
+    ssd1306_draw_line(0, 11, 127, 11, true);
+
+    int count = weather_get_location_count();
+    int first = page * LOCATIONS_PER_PAGE;
+    for (int i = first; i < count && i < first + LOCATIONS_PER_PAGE; i++) {
+        int y = 15 + (i - first) * 12;
+        weather_location_t location;
+
+        if (weather_get_location(i, &location) == ESP_OK) {
+            snprintf(str, sizeof(str), "%.14s", location.name);
+            ssd1306_draw_string(2, y, str, 1);
+            snprintf(str, sizeof(str), "%dC", deci_to_whole(location.temp));
+        } else {
+            ssd1306_draw_string(2, y, "...", 1);
+            snprintf(str, sizeof(str), "--C");
+        }
+        ssd1306_draw_string(126 - strlen(str) * 6, y, str, 1);
+    }
+
+    ssd1306_display();
+}
+
+// Main screen first, then one page per group of additional locations
+static void draw_page(int page)
+{
+    if (page == 0) {
         draw_weather_screen();
-        vTaskDelay(pdMS_TO_TICKS(CONFIG_DISPLAY_UPDATE_INTERVAL * 1000));
+    } else {
+        draw_locations_screen(page - 1);
     }
 }
 
+// All three jobs run on the scheduler's worker, one at a time, so the page
+// needs no lock
+static void page_job(void *arg)
+{
+    int location_pages = (weather_get_location_count() + LOCATIONS_PER_PAGE - 1) / LOCATIONS_PER_PAGE;
+    s_page = (s_page < location_pages) ? s_page + 1 : 0;
+    draw_page(s_page);
+}
+
+// New data: back to the main screen, which then stays for a full interval
+static void refresh_job(void *arg)
+{
+    s_page = 0;
+    draw_page(s_page);
+    sched_every(s_page_job, CONFIG_DISPLAY_UPDATE_INTERVAL * 1000);
+}
+
+// Clock changed: repaint the page on screen, keeping its remaining time
+static void redraw_job(void *arg)
+{
+    draw_page(s_page);
+}
+
+void ssd1306_refresh(void)
+{
+    sched_now(s_refresh_job);
+}
+
+void ssd1306_redraw(void)
+{
+    sched_now(s_redraw_job);
+}
+
 void ssd1306_init(void)
 {
     ssd1306_init_display();
@@ -302,8 +382,28 @@ void ssd1306_init(void)
     
     ESP_LOGI(TAG, "Display cleared after reboot");
     
-    // Create task to update display periodically
-    xTaskCreate(display_update_task, "display_update", 4096, NULL, 5, NULL);
+    // Pages rotate on the shared scheduler
+    if (sched_init() == ESP_OK) {
+        s_page_job = sched_add("display_page", page_job, NULL);
+        s_refresh_job = sched_add("display_refresh", refresh_job, NULL);
+        s_redraw_job = sched_add("display_redraw", redraw_job, NULL);
+        sched_now(s_refresh_job);
+    }
     
-    ESP_LOGI(TAG, "SSD1306 task started");
+    ESP_LOGI(TAG, "SSD1306 pages scheduled");
+}
+
+void ssd1306_init_oneshot(void)
+{
+    // The panel stays powered and configured through deep sleep, showing the last frame
+    if (esp_reset_reason() == ESP_RST_DEEPSLEEP) {
+        ESP_ERROR_CHECK(i2c_bus_init());
+    } else {
+        ssd1306_init_display();
+    }
+}
+
+void ssd1306_draw_main(void)
+{
+    draw_weather_screen();
 }
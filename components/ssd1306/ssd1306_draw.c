@@ -141,24 +141,27 @@ void ssd1306_draw_string(int16_t x, int16_t y, const char *str, uint8_t size)
 
 void ssd1306_draw_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1, bool color)
 {
-    int16_t dx = x1 - x0;
-    int16_t dy = y1 - y0;
-    int16_t steps = (dx > dy) ? (dx > -dx ? dx : -dx) : (dy > -dy ? dy : -dy);
+    // Bresenham's algorithm - integer only (no FPU on ESP8266)
+    int16_t dx = (x1 > x0) ? x1 - x0 : x0 - x1;
+    int16_t dy = (y1 > y0) ? y0 - y1 : y1 - y0;
+    int16_t sx = (x0 < x1) ? 1 : -1;
+    int16_t sy = (y0 < y1) ? 1 : -1;
+    int16_t err = dx + dy;
     
-    if (steps == 0) {
+    while (1) {
         ssd1306_draw_pixel(x0, y0, color);
-        return;
-    }
-    
-    float x_inc = (float)dx / steps;
-    float y_inc = (float)dy / steps;
-    float x = x0;
-    float y = y0;
-    
-    for (int i = 0; i <= steps; i++) {
-        ssd1306_draw_pixel((int16_t)x, (int16_t)y, color);
-        x += x_inc;
-        y += y_inc;
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        int16_t e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
     }
 }
 
@@ -0,0 +1,59 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "i2c_bus.h"
+#include "ssd1306.h"
+#include "net_http.h"
+
+/*
+ * Runtime counters gathered in one place: per-task CPU share and stack
+ * high-water mark, heap floor, I2C bus time, display frame
+ * size and HTTP fetch durations.
+ *
+ * The hot paths only bump counters in their own modules; this one reads them
+ * when asked. CPU shares need CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS and are
+ * computed over a window (CONFIG_TELEMETRY_CPU_WINDOW) by a scheduler job.
+ */
+
+#define TELEMETRY_MAX_TASKS     16
+#define TELEMETRY_CPU_UNKNOWN   0xFFFF      // No run-time stats, or the task is newer than the window
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t stack_free;        // Bytes never used since the task started
+    uint16_t cpu_permille;      // Share of the last CPU window
+    uint8_t priority;
+} telemetry_task_t;
+
+// About 0.5 KB; keep it off small task stacks
+typedef struct {
+    uint32_t uptime_s;
+    uint32_t heap_free;
+    uint32_t heap_min_free;     // Lowest free heap since boot
+    uint8_t task_count;         // Entries used in tasks
+    uint32_t cpu_window_ms;     // Span of the CPU shares, 0 before the first window ends
+    telemetry_task_t tasks[TELEMETRY_MAX_TASKS];
+    i2c_bus_stats_t i2c;
+    ssd1306_flush_stats_t display;
+    net_http_stats_t http;
+} telemetry_snapshot_t;
+
+/**
+ * @brief Start the CPU window and the periodic dump (CONFIG_TELEMETRY_DUMP_INTERVAL)
+ */
+esp_err_t telemetry_init(void);
+
+/**
+ * @brief Fill a snapshot of every counter (any task)
+ */
+void telemetry_get_snapshot(telemetry_snapshot_t *snapshot);
+
+/**
+ * @brief Log a snapshot over serial, a few lines long (any task)
+ */
+void telemetry_dump(void);
+
+#endif // TELEMETRY_H
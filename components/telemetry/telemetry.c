@@ -0,0 +1,216 @@
+#include "telemetry.h"
+#include <string.h>
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "scheduler.h"
+
+static const char *TAG = "TELEMETRY";
+
+#define TELEMETRY_CPU_STATS (configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS)
+
+// Run-time counter of each task when the current window started, and its
+// share of the window before
+typedef struct {
+    TaskHandle_t handle;
+    uint32_t runtime;
+    uint16_t cpu_permille;
+} task_window_t;
+
+static SemaphoreHandle_t s_lock;
+static int s_job = SCHED_JOB_INVALID;
+#if configUSE_TRACE_FACILITY
+static TaskStatus_t s_status[TELEMETRY_MAX_TASKS];      // Too big for the worker stack
+#endif
+static task_window_t s_window[TELEMETRY_MAX_TASKS];
+static int s_window_count;
+static uint32_t s_window_runtime;       // Total run time when the current window started
+static int64_t s_window_start_us;
+static uint32_t s_window_ms;            // Length of the window the shares cover
+static int64_t s_dump_us;
+static telemetry_snapshot_t s_dump_snapshot;
+
+#if TELEMETRY_CPU_STATS
+// Close the CPU window: each task's share is its run-time delta over the total
+// delta. Unsigned differences stay right across one counter wrap.
+static void close_window_locked(int64_t now)
+{
+    task_window_t next[TELEMETRY_MAX_TASKS];
+    uint32_t runtime;
+    int count = uxTaskGetSystemState(s_status, TELEMETRY_MAX_TASKS, &runtime);
+
+    if (count == 0) {
+        ESP_LOGW(TAG, "More than %d tasks, CPU shares not updated", TELEMETRY_MAX_TASKS);
+        return;
+    }
+    uint32_t elapsed = runtime - s_window_runtime;
+
+    for (int i = 0; i < count; i++) {
+        next[i].handle = s_status[i].xHandle;
+        next[i].runtime = s_status[i].ulRunTimeCounter;
+        next[i].cpu_permille = TELEMETRY_CPU_UNKNOWN;
+        for (int j = 0; j < s_window_count && elapsed > 0; j++) {
+            if (s_window[j].handle == next[i].handle) {
+                uint32_t used = next[i].runtime - s_window[j].runtime;
+                next[i].cpu_permille = (uint16_t)((uint64_t)used * 1000 / elapsed);
+                break;
+            }
+        }
+    }
+
+    memcpy(s_window, next, sizeof(next[0]) * count);
+    s_window_count = count;
+    s_window_runtime = runtime;
+    s_window_ms = (uint32_t)((now - s_window_start_us) / 1000);
+    s_window_start_us = now;
+}
+#endif
+
+static uint16_t task_cpu_locked(TaskHandle_t handle)
+{
+    for (int i = 0; i < s_window_count; i++) {
+        if (s_window[i].handle == handle) {
+            return s_window[i].cpu_permille;
+        }
+    }
+    return TELEMETRY_CPU_UNKNOWN;
+}
+
+static void fill_tasks_locked(telemetry_snapshot_t *snapshot)
+{
+#if configUSE_TRACE_FACILITY
+    int count = uxTaskGetSystemState(s_status, TELEMETRY_MAX_TASKS, NULL);
+
+    for (int i = 0; i < count; i++) {
+        telemetry_task_t *task = &snapshot->tasks[i];
+        strncpy(task->name, s_status[i].pcTaskName, sizeof(task->name) - 1);
+        task->stack_free = s_status[i].usStackHighWaterMark;
+        task->priority = (uint8_t)s_status[i].uxCurrentPriority;
+        task->cpu_permille = task_cpu_locked(s_status[i].xHandle);
+    }
+    snapshot->task_count = (uint8_t)count;
+#endif
+    snapshot->cpu_window_ms = s_window_ms;
+}
+
+static void fill_snapshot(telemetry_snapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+    snapshot->heap_free = esp_get_free_heap_size();
+    snapshot->heap_min_free = esp_get_minimum_free_heap_size();
+    i2c_bus_get_stats(&snapshot->i2c);
+    ssd1306_get_flush_stats(&snapshot->display);
+    net_http_get_stats(&snapshot->http);
+}
+
+static void log_snapshot(const telemetry_snapshot_t *s)
+{
+    ESP_LOGI(TAG, "Up %u s; heap %u free, %u min", s->uptime_s, s->heap_free, s->heap_min_free);
+    for (int i = 0; i < s->task_count; i++) {
+        const telemetry_task_t *task = &s->tasks[i];
+        if (task->cpu_permille == TELEMETRY_CPU_UNKNOWN) {
+            ESP_LOGI(TAG, "  %-16s cpu    -   stack %5u free  prio %u",
+                     task->name, task->stack_free, task->priority);
+        } else {
+            ESP_LOGI(TAG, "  %-16s cpu %3u.%u%%  stack %5u free  prio %u",
+                     task->name, task->cpu_permille / 10, task->cpu_permille % 10,
+                     task->stack_free, task->priority);
+        }
+    }
+    if (s->cpu_window_ms > 0) {
+        ESP_LOGI(TAG, "  CPU shares over the last %u s", s->cpu_window_ms / 1000);
+    }
+    ESP_LOGI(TAG, "I2C: %u transactions, %u errors, %u ms busy, %u us max, %u us max wait",
+             s->i2c.transactions, s->i2c.errors, s->i2c.busy_ms, s->i2c.max_us, s->i2c.max_wait_us);
+    ESP_LOGI(TAG, "Display: %u frames, %u bytes last, %u us last, %u us max",
+             s->display.flushes, s->display.last_bytes, s->display.last_us, s->display.max_us);
+    ESP_LOGI(TAG, "HTTP: %u requests, %u failed, %u bytes in; %u ms last, %u ms avg, %u ms max, %u ms to first byte",
+             s->http.requests, s->http.failures, s->http.rx_bytes, s->http.last_ms,
+             s->http.requests ? s->http.total_ms / s->http.requests : 0, s->http.max_ms,
+             s->http.last_first_byte_ms);
+}
+
+static void telemetry_job(void *arg)
+{
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+#if TELEMETRY_CPU_STATS
+    close_window_locked(now);
+#endif
+    xSemaphoreGive(s_lock);
+
+#if CONFIG_TELEMETRY_DUMP_INTERVAL > 0
+    if (now - s_dump_us >= (int64_t)CONFIG_TELEMETRY_DUMP_INTERVAL * 60 * 1000000) {
+        s_dump_us = now;
+        telemetry_dump();
+    }
+#else
+    (void)now;
+#endif
+}
+
+esp_err_t telemetry_init(void)
+{
+    if (s_lock != NULL) {
+        return ESP_OK;
+    }
+    esp_err_t err = sched_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create lock");
+        return ESP_ERR_NO_MEM;
+    }
+
+    int64_t now = esp_timer_get_time();
+    s_window_start_us = now;
+    s_dump_us = now;
+#if TELEMETRY_CPU_STATS
+    close_window_locked(now);       // Opens the first window
+#endif
+    s_lock = lock;
+
+    s_job = sched_add("telemetry", telemetry_job, NULL);
+    if (s_job == SCHED_JOB_INVALID) {
+        return ESP_ERR_NO_MEM;
+    }
+    sched_every(s_job, CONFIG_TELEMETRY_CPU_WINDOW * 1000);
+
+#if TELEMETRY_CPU_STATS
+    ESP_LOGI(TAG, "Telemetry started, CPU shares over %d s", CONFIG_TELEMETRY_CPU_WINDOW);
+#else
+    ESP_LOGI(TAG, "Telemetry started without CPU shares (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS is off)");
+#endif
+    return ESP_OK;
+}
+
+void telemetry_get_snapshot(telemetry_snapshot_t *snapshot)
+{
+    fill_snapshot(snapshot);
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    fill_tasks_locked(snapshot);
+    xSemaphoreGive(s_lock);
+}
+
+void telemetry_dump(void)
+{
+    if (s_lock == NULL) {
+        ESP_LOGW(TAG, "Not started");
+        return;
+    }
+    // The snapshot buffer is shared, so dumps from two tasks take turns
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    fill_snapshot(&s_dump_snapshot);
+    fill_tasks_locked(&s_dump_snapshot);
+    log_snapshot(&s_dump_snapshot);
+    xSemaphoreGive(s_lock);
+}
@@ -3,15 +3,82 @@
 
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+/*
+ * The clock survives soft resets and deep sleep: it is saved to RTC memory
+ * every minute together with the RTC counter, whose rate is calibrated
+ * against the crystal. At boot it is restored from the counter ticks that
+ * elapsed since the save, and SNTP corrects it once the network is up.
+ */
+
+/*
+ * Local time is cached: a timer aligned to the start of each minute converts
+ * the clock once, with the year's DST transitions precomputed, and publishes
+ * rollover events. Readers get the cached copy.
+ */
+
+#define TIME_EVENT_MINUTE   (1 << 0)
+#define TIME_EVENT_HOUR     (1 << 1)
+#define TIME_EVENT_DAY      (1 << 2)     // All three are also published when the clock is first set
+
+typedef enum {
+    TIME_SOURCE_NONE = 0,       // Clock not set yet
+    TIME_SOURCE_RTC,            // Restored after a reset, not synced since
+    TIME_SOURCE_SNTP,
+} time_source_t;
+
+typedef struct {
+    time_source_t source;
+    uint32_t error_ms;              // Estimated current error, UINT32_MAX if not set
+    int32_t last_correction_ms;     // Correction made by the last SNTP sync (the error the clock really had)
+    bool corrected;                 // last_correction_ms is valid
+    uint32_t rtc_hz;                // Measured RTC counter rate
+    uint32_t rtc_drift_ppm;         // Variation of that rate between calibrations
+    uint32_t last_sync;             // Unix time of the last SNTP sync, 0 if none
+    uint32_t sync_age_s;            // Seconds since the last SNTP sync, UINT32_MAX if none
+    uint32_t syncs;                 // SNTP syncs since boot
+    int32_t ntp_offset_us;          // Server time minus the clock at the last sync
+    uint32_t ntp_delay_us;          // Round trip to the server chosen at the last sync
+    uint8_t ntp_servers_used;       // Servers that agreed at the last sync
+    uint32_t ntp_poll_s;            // Current interval between syncs
+    int32_t slew_remaining_us;      // Part of the last offset not yet slewed into the clock
+    int32_t freq_correction_ppb;    // Crystal rate error being compensated
+} time_clock_stats_t;
 
 /**
- * @brief Initialize time manager and sync with NTP
+ * @brief Set the timezone and restore the clock from RTC memory if it survived the reset
  */
 void time_manager_init(void);
 
 /**
- * @brief Get current local time
+ * @brief Start NTP sync once the network is up (does not wait for it)
+ *
+ * Every server in CONFIG_NTP_SERVERS is queried; the clock is stepped when it
+ * is off by more than 128 ms and slewed otherwise.
+ */
+void time_manager_start_sync(void);
+
+/**
+ * @brief Save the clock to RTC memory now, e.g. right before deep sleep or a restart
+ */
+void time_manager_save(void);
+
+/**
+ * @brief Clock source, estimated error and RTC calibration
+ */
+void time_manager_get_clock_stats(time_clock_stats_t *stats);
+
+/**
+ * @brief Called from the network loop each time the clock is synchronized; set before init
+ */
+void time_manager_set_sync_hook(void (*synced)(void));
+
+/**
+ * @brief Get current local time (cached at the start of the minute; tm_sec is not live)
  * @param timeinfo Pointer to struct tm to store time
  * @return ESP_OK on success
  */
@@ -23,4 +90,16 @@ esp_err_t time_manager_get_time(struct tm *timeinfo);
  */
 bool time_is_synced(void);
 
+/**
+ * @brief Block until one of the TIME_EVENT_* bits is published
+ * @return The events that occurred, 0 on timeout; events published while
+ *         the caller is not waiting are not queued
+ */
+EventBits_t time_manager_wait_event(EventBits_t events, TickType_t timeout);
+
+/**
+ * @brief Called from the timer task with the TIME_EVENT_* bits at each rollover; must not block
+ */
+void time_manager_set_tick_hook(void (*tick)(EventBits_t events));
+
 #endif // TIME_MANAGER_H
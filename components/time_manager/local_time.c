@@ -0,0 +1,249 @@
+#include "local_time.h"
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "time_manager.h"
+
+static const char *TAG = "LOCAL_TIME";
+
+#define MIN_VALID_YEAR      2020
+#define TICK_MARGIN_US      2000    // Fire just after the minute starts, never just before
+#define ZONE_MAX_SEGMENTS   5       // Offsets in force during one year (standard, DST, ...)
+
+// UTC offsets in force over one year, found once with localtime_r(); every
+// other conversion is plain arithmetic with no TZ string parsing
+typedef struct {
+    time_t from;                        // Range covered (UTC), one day beyond the year each side
+    time_t to;
+    int count;
+    time_t start[ZONE_MAX_SEGMENTS];    // Segment i is in force from start[i]
+    int32_t offset[ZONE_MAX_SEGMENTS];  // Seconds east of UTC
+    int8_t isdst[ZONE_MAX_SEGMENTS];
+} zone_table_t;
+
+static zone_table_t s_zone;
+
+// Broken-down local time at the last minute tick; written by the tick timer
+// and after clock steps, read by the display
+static SemaphoreHandle_t s_lock;
+static struct tm s_local;
+static bool s_valid;
+static esp_timer_handle_t s_tick_timer;
+static EventGroupHandle_t s_events;
+static void (*s_tick_hook)(EventBits_t events);
+
+// Days since 1970-01-01 of a proleptic Gregorian date (H. Hinnant's algorithm)
+static int32_t days_from_civil(int32_t y, int32_t m, int32_t d)
+{
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    int32_t yoe = y - era * 400;
+    int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civil_from_days(int32_t z, int32_t *y, int32_t *m, int32_t *d)
+{
+    z += 719468;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int32_t doe = z - era * 146097;
+    int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int32_t mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp + (mp < 10 ? 3 : -9);
+    *y = yoe + era * 400 + (*m <= 2);
+}
+
+static int32_t floor_div(int64_t a, int32_t b)
+{
+    return (int32_t)((a >= 0) ? a / b : (a - b + 1) / b);
+}
+
+static int32_t offset_slow(time_t t, int8_t *isdst)
+{
+    struct tm tm;
+    localtime_r(&t, &tm);
+    *isdst = tm.tm_isdst > 0;
+    int64_t local = (int64_t)days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) * 86400 +
+                    tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+    return (int32_t)(local - t);
+}
+
+// Find the offsets in force during the UTC year containing t: one
+// localtime_r() per day, then a binary search for the exact second of
+// each change (DST transitions never come closer than a day)
+static void zone_build(time_t t)
+{
+    int32_t y, m, d;
+    int8_t isdst;
+
+    civil_from_days(floor_div(t, 86400), &y, &m, &d);
+    s_zone.from = (time_t)days_from_civil(y, 1, 1) * 86400 - 86400;
+    s_zone.to = (time_t)days_from_civil(y + 1, 1, 1) * 86400 + 86400;
+    s_zone.count = 1;
+    s_zone.start[0] = s_zone.from;
+    s_zone.offset[0] = offset_slow(s_zone.from, &isdst);
+    s_zone.isdst[0] = isdst;
+
+    for (time_t day = s_zone.from + 86400; day < s_zone.to && s_zone.count < ZONE_MAX_SEGMENTS; day += 86400) {
+        int32_t offset = offset_slow(day, &isdst);
+        if (offset == s_zone.offset[s_zone.count - 1]) {
+            continue;
+        }
+        time_t lo = day - 86400;
+        time_t hi = day;
+        while (hi - lo > 1) {
+            time_t mid = lo + (hi - lo) / 2;
+            int8_t mid_dst;
+            if (offset_slow(mid, &mid_dst) == offset) {
+                hi = mid;
+            } else {
+                lo = mid;
+            }
+        }
+        s_zone.start[s_zone.count] = hi;
+        s_zone.offset[s_zone.count] = offset;
+        s_zone.isdst[s_zone.count] = isdst;
+        s_zone.count++;
+    }
+    ESP_LOGI(TAG, "Timezone for %d: UTC%+d min on 1 January, %d offset change(s)", y, s_zone.offset[0] / 60,
+             s_zone.count - 1);
+}
+
+static void local_from_utc(time_t t, struct tm *tm)
+{
+    int i;
+
+    if (t < s_zone.from || t >= s_zone.to) {
+        zone_build(t);
+    }
+    for (i = s_zone.count - 1; i > 0 && t < s_zone.start[i]; i--) {
+    }
+
+    int64_t local = (int64_t)t + s_zone.offset[i];
+    int32_t days = floor_div(local, 86400);
+    int32_t secs = (int32_t)(local - (int64_t)days * 86400);
+    int32_t y, m, d;
+    civil_from_days(days, &y, &m, &d);
+
+    memset(tm, 0, sizeof(*tm));
+    tm->tm_sec = secs % 60;
+    tm->tm_min = secs / 60 % 60;
+    tm->tm_hour = secs / 3600;
+    tm->tm_mday = d;
+    tm->tm_mon = m - 1;
+    tm->tm_year = y - 1900;
+    tm->tm_wday = ((days % 7) + 11) % 7;   // 1970-01-01 was a Thursday
+    tm->tm_yday = days - days_from_civil(y, 1, 1);
+    tm->tm_isdst = s_zone.isdst[i];
+}
+
+// Refresh the cache, publish rollovers and arm the timer for the next minute
+static void update(void)
+{
+    struct timeval tv;
+    struct tm tm;
+    EventBits_t events = 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    gettimeofday(&tv, NULL);
+    local_from_utc(tv.tv_sec, &tm);
+
+    bool valid = tm.tm_year >= MIN_VALID_YEAR - 1900;
+    if (valid) {
+        // A clock that was just set counts as a rollover of everything
+        if (!s_valid || tm.tm_year != s_local.tm_year || tm.tm_yday != s_local.tm_yday) {
+            events = TIME_EVENT_DAY | TIME_EVENT_HOUR | TIME_EVENT_MINUTE;
+        } else if (tm.tm_hour != s_local.tm_hour) {
+            events = TIME_EVENT_HOUR | TIME_EVENT_MINUTE;
+        } else if (tm.tm_min != s_local.tm_min) {
+            events = TIME_EVENT_MINUTE;
+        }
+    }
+    s_local = tm;
+    s_valid = valid;
+
+    esp_timer_stop(s_tick_timer);
+    esp_timer_start_once(s_tick_timer, (60 - tm.tm_sec) * 1000000LL - tv.tv_usec + TICK_MARGIN_US);
+    xSemaphoreGive(s_lock);
+
+    if (events != 0) {
+        // Wakes every task waiting at this moment, then resets for the next tick
+        xEventGroupSetBits(s_events, events);
+        xEventGroupClearBits(s_events, events);
+        if (s_tick_hook != NULL) {
+            s_tick_hook(events);
+        }
+    }
+}
+
+static void tick_timer_cb(void *arg)
+{
+    update();
+}
+
+void local_time_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = tick_timer_cb,
+        .name = "clock_tick",
+    };
+
+    s_lock = xSemaphoreCreateMutex();
+    s_events = xEventGroupCreate();
+    if (s_lock == NULL || s_events == NULL || esp_timer_create(&timer_args, &s_tick_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the minute tick");
+        return;
+    }
+    update();
+}
+
+void local_time_clock_changed(void)
+{
+    if (s_tick_timer != NULL) {
+        update();
+    }
+}
+
+esp_err_t time_manager_get_time(struct tm *timeinfo)
+{
+    if (timeinfo == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *timeinfo = s_local;
+    bool valid = s_valid;
+    xSemaphoreGive(s_lock);
+
+    return valid ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+bool time_is_synced(void)
+{
+    return s_valid;
+}
+
+EventBits_t time_manager_wait_event(EventBits_t events, TickType_t timeout)
+{
+    if (s_events == NULL) {
+        vTaskDelay(timeout);
+        return 0;
+    }
+    return xEventGroupWaitBits(s_events, events, pdFALSE, pdFALSE, timeout) & events;
+}
+
+void time_manager_set_tick_hook(void (*tick)(EventBits_t events))
+{
+    s_tick_hook = tick;
+}
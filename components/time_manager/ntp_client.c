@@ -0,0 +1,440 @@
+#include "ntp_client.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "net_loop.h"
+#include "net_dns.h"
+#include "power_manager.h"
+
+static const char *TAG = "NTP";
+
+#define NTP_PORT                    123
+#define NTP_PACKET_LEN              48
+#define NTP_UNIX_OFFSET             2208988800ULL   // Seconds from 1900 to 1970
+#define NTP_ROUND_TIMEOUT_MS        5000            // Every server of a round, DNS included
+#define NTP_RETRY_S                 30              // After a round with no usable answer, doubling
+#define NTP_MIN_POLL_S              (15 * 60)
+#define NTP_MAX_POLL_S              (CONFIG_TIME_UPDATE_INTERVAL * 3600)
+#define NTP_BACKOFF_OFFSET_US       25000           // Smaller offsets double the poll interval
+#define NTP_MAX_DISTANCE_US         1500000         // Error bound beyond which an answer is useless
+#define NTP_OUTLIER_MARGIN_US       10000
+#define NTP_TIMER_RETRY_MS          5000            // Loop timers all taken: try again after this long
+
+#define NTP_MODE_CLIENT             3
+#define NTP_MODE_SERVER             4
+#define NTP_LEAP_UNSYNCHRONIZED     3
+
+typedef enum {
+    SERVER_IDLE = 0,
+    SERVER_RESOLVING,
+    SERVER_SENT,
+    SERVER_DONE,
+} server_state_t;
+
+typedef struct {
+    char host[NET_DNS_HOST_LEN];
+    server_state_t state;
+    uint32_t addr;              // Network byte order
+    uint8_t nonce[8];           // Sent as our transmit time, must come back as the origin
+    int64_t sent_us;            // Uptime when the request left
+    bool valid;
+    int64_t offset_us;
+    uint32_t delay_us;
+    uint32_t distance_us;       // Half the round trip plus the server's own distance to its reference
+} ntp_server_t;
+
+static ntp_server_t s_servers[NTP_MAX_SERVERS];
+static int s_server_count;
+static int s_next;              // Next server to resolve in the current round
+static int s_fd = -1;           // Open only during a round
+static int s_timer = NET_LOOP_TIMER_INVALID;
+static esp_timer_handle_t s_retry_timer;
+static uint32_t s_poll_s = NTP_MIN_POLL_S;
+static uint32_t s_retry_s = NTP_RETRY_S;
+static ntp_result_cb_t s_result_cb;
+
+// Datagrams are only handled on the loop task, one at a time
+static uint8_t s_rx_buffer[NTP_PACKET_LEN + 20];
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int64_t timestamp_to_unix_us(const uint8_t *p)
+{
+    uint64_t seconds = get_u32(p);
+    uint32_t fraction = get_u32(p + 4);
+
+    // Era 1 starts in 2036; small values are past the wrap, not 1900
+    if (seconds < NTP_UNIX_OFFSET) {
+        seconds += 1ULL << 32;
+    }
+    return (int64_t)(seconds - NTP_UNIX_OFFSET) * 1000000 + (int64_t)(((uint64_t)fraction * 1000000) >> 32);
+}
+
+// Root delay and dispersion are 16.16 fixed-point seconds
+static uint32_t short_to_us(const uint8_t *p)
+{
+    return (uint32_t)(((uint64_t)get_u32(p) * 1000000) >> 16);
+}
+
+static void round_start(void *arg);
+
+// esp_timer task: hand the round back to the loop, or wait again
+static void retry_cb(void *arg)
+{
+    if (net_loop_schedule(round_start, NULL, 0) == NET_LOOP_TIMER_INVALID) {
+        esp_timer_start_once(s_retry_timer, NTP_TIMER_RETRY_MS * 1000);
+    }
+}
+
+// Start the next round after delay_s. Loop timers are shared with every
+// network module; if none is free the round is started from an esp_timer,
+// so polling never stops
+static void schedule(uint32_t delay_s)
+{
+    uint32_t delay_ms = delay_s * 1000;
+
+    power_radio_expect(delay_ms);
+    s_timer = net_loop_schedule(round_start, NULL, delay_ms);
+    if (s_timer != NET_LOOP_TIMER_INVALID) {
+        return;
+    }
+    if (delay_ms < NTP_TIMER_RETRY_MS) {
+        delay_ms = NTP_TIMER_RETRY_MS;
+    }
+    ESP_LOGW(TAG, "No loop timer for the next round, retrying in %u ms", delay_ms);
+    esp_timer_stop(s_retry_timer);
+    esp_timer_start_once(s_retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+static int compare_offset(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Drop answers whose error bound does not reach the median offset, then
+// take the shortest round trip among the rest
+static ntp_server_t *select_server(int answered, int *used)
+{
+    int64_t offsets[NTP_MAX_SERVERS];
+    int n = 0;
+    ntp_server_t *best = NULL;
+
+    for (int i = 0; i < s_server_count; i++) {
+        if (s_servers[i].valid) {
+            offsets[n++] = s_servers[i].offset_us;
+        }
+    }
+    qsort(offsets, n, sizeof(offsets[0]), compare_offset);
+    int64_t median = (n % 2) ? offsets[n / 2] : (offsets[n / 2 - 1] + offsets[n / 2]) / 2;
+
+    // Two servers that disagree cannot outvote each other
+    *used = 0;
+    for (int i = 0; i < s_server_count && answered >= 3; i++) {
+        ntp_server_t *server = &s_servers[i];
+        if (server->valid && llabs(server->offset_us - median) > server->distance_us + NTP_OUTLIER_MARGIN_US) {
+            ESP_LOGW(TAG, "%s rejected: offset %d ms, the others agree on %d ms", server->host,
+                     (int)(server->offset_us / 1000), (int)(median / 1000));
+            server->valid = false;
+        }
+    }
+    for (int i = 0; i < s_server_count; i++) {
+        ntp_server_t *server = &s_servers[i];
+        if (server->valid) {
+            (*used)++;
+            if (best == NULL || server->delay_us < best->delay_us) {
+                best = server;
+            }
+        }
+    }
+    return best;
+}
+
+static void round_finish(void)
+{
+    int answered = 0;
+    int used = 0;
+
+    if (s_timer != NET_LOOP_TIMER_INVALID) {
+        net_loop_cancel(s_timer);
+        s_timer = NET_LOOP_TIMER_INVALID;
+    }
+    net_loop_unwatch(s_fd);
+    close(s_fd);
+    s_fd = -1;
+    power_radio_release();
+
+    for (int i = 0; i < s_server_count; i++) {
+        answered += s_servers[i].valid;
+    }
+    ntp_server_t *best = (answered > 0) ? select_server(answered, &used) : NULL;
+    if (best == NULL) {
+        ESP_LOGW(TAG, "No usable answer from %d server(s), retrying in %u s", s_server_count, s_retry_s);
+        schedule(s_retry_s);
+        s_retry_s = (s_retry_s * 2 < s_poll_s) ? s_retry_s * 2 : s_poll_s;
+        return;
+    }
+    s_retry_s = NTP_RETRY_S;
+
+    // Back off while the clock keeps time on its own, poll fast again when it does not
+    if (llabs(best->offset_us) < NTP_BACKOFF_OFFSET_US) {
+        s_poll_s = (s_poll_s * 2 < NTP_MAX_POLL_S) ? s_poll_s * 2 : NTP_MAX_POLL_S;
+    } else if (llabs(best->offset_us) > 4 * NTP_BACKOFF_OFFSET_US) {
+        s_poll_s = NTP_MIN_POLL_S;
+    }
+    ESP_LOGI(TAG, "%s: offset %d ms, delay %u ms (%d of %d answers used), next sync in %u min", best->host,
+             (int)(best->offset_us / 1000), best->delay_us / 1000, used, answered, s_poll_s / 60);
+
+    const ntp_result_t result = {
+        .server = best->host,
+        .offset_us = best->offset_us,
+        .delay_us = best->delay_us,
+        .answered = answered,
+        .used = used,
+    };
+    s_result_cb(&result);
+    schedule(s_poll_s);
+}
+
+static void check_done(void)
+{
+    if (s_next < s_server_count) {
+        return;
+    }
+    for (int i = 0; i < s_server_count; i++) {
+        if (s_servers[i].state != SERVER_DONE) {
+            return;
+        }
+    }
+    round_finish();
+}
+
+static void round_timeout(void *arg)
+{
+    s_timer = NET_LOOP_TIMER_INVALID;
+    round_finish();
+}
+
+static void send_request(ntp_server_t *server)
+{
+    uint8_t packet[NTP_PACKET_LEN];
+    uint32_t nonce[2] = { esp_random(), esp_random() };
+    struct sockaddr_in to = {
+        .sin_family = AF_INET,
+        .sin_port = htons(NTP_PORT),
+        .sin_addr.s_addr = server->addr,
+    };
+
+    // The transmit time is random rather than our clock: it identifies the
+    // answer and reveals nothing; timing uses the local uptime instead
+    memset(packet, 0, sizeof(packet));
+    packet[0] = (4 << 3) | NTP_MODE_CLIENT;
+    memcpy(server->nonce, nonce, sizeof(server->nonce));
+    memcpy(&packet[40], server->nonce, sizeof(server->nonce));
+
+    server->sent_us = esp_timer_get_time();
+    if (sendto(s_fd, packet, sizeof(packet), 0, (struct sockaddr *)&to, sizeof(to)) < 0) {
+        ESP_LOGW(TAG, "%s: send failed", server->host);
+        server->state = SERVER_DONE;
+        return;
+    }
+    server->state = SERVER_SENT;
+}
+
+static void parse_response(ntp_server_t *server, int len, int64_t received_us)
+{
+    const uint8_t *p = s_rx_buffer;
+    uint8_t leap = p[0] >> 6;
+    uint8_t mode = p[0] & 0x07;
+    uint8_t stratum = p[1];
+    struct timeval tv;
+
+    if (len < NTP_PACKET_LEN || mode != NTP_MODE_SERVER || memcmp(&p[24], server->nonce, 8) != 0) {
+        return;  // Not an answer to our request, keep waiting
+    }
+    server->state = SERVER_DONE;
+    if (stratum == 0) {
+        ESP_LOGW(TAG, "%s: kiss-o'-death %.4s", server->host, (const char *)&p[12]);
+        return;
+    }
+    if (leap == NTP_LEAP_UNSYNCHRONIZED || stratum > 15) {
+        ESP_LOGW(TAG, "%s: server not synchronized", server->host);
+        return;
+    }
+
+    // T1 and T4 on the system clock, with the interval taken from the uptime
+    // so that a slew in progress does not distort the round trip
+    gettimeofday(&tv, NULL);
+    int64_t t4 = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - (esp_timer_get_time() - received_us);
+    int64_t t1 = t4 - (received_us - server->sent_us);
+    int64_t t2 = timestamp_to_unix_us(&p[32]);
+    int64_t t3 = timestamp_to_unix_us(&p[40]);
+    int64_t delay = (t4 - t1) - (t3 - t2);
+
+    server->offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+    server->delay_us = (delay > 0) ? (uint32_t)delay : 0;
+    server->distance_us = server->delay_us / 2 + short_to_us(&p[4]) / 2 + short_to_us(&p[8]);
+    if (server->distance_us > NTP_MAX_DISTANCE_US) {
+        ESP_LOGW(TAG, "%s: error bound %u ms is too large", server->host, server->distance_us / 1000);
+        return;
+    }
+    server->valid = true;
+}
+
+static void on_rx(int fd, uint8_t events, void *arg)
+{
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    int len;
+
+    while ((len = recvfrom(fd, s_rx_buffer, sizeof(s_rx_buffer), 0, (struct sockaddr *)&from, &from_len)) > 0) {
+        int64_t received_us = esp_timer_get_time();
+        for (int i = 0; i < s_server_count; i++) {
+            ntp_server_t *server = &s_servers[i];
+            if (server->state == SERVER_SENT && server->addr == from.sin_addr.s_addr) {
+                parse_response(server, len, received_us);
+                break;
+            }
+        }
+        from_len = sizeof(from);
+    }
+    check_done();
+}
+
+static void resolve_next(void);
+
+static void on_resolved(esp_err_t err, uint32_t addr, uint32_t ttl, void *arg)
+{
+    ntp_server_t *server = (ntp_server_t *)arg;
+
+    if (s_fd < 0 || server->state != SERVER_RESOLVING) {
+        return;  // Round already over
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "%s: %s", server->host, esp_err_to_name(err));
+        server->state = SERVER_DONE;
+    } else {
+        server->addr = addr;
+        send_request(server);
+    }
+    resolve_next();
+}
+
+// One lookup at a time, so a round never holds more than one resolver slot
+static void resolve_next(void)
+{
+    while (s_next < s_server_count) {
+        ntp_server_t *server = &s_servers[s_next++];
+        server->state = SERVER_RESOLVING;
+        if (net_dns_lookup(server->host, on_resolved, server) == ESP_OK) {
+            return;
+        }
+        ESP_LOGW(TAG, "%s: resolver busy, skipped this round", server->host);
+        server->state = SERVER_DONE;
+    }
+    check_done();
+}
+
+static void round_abort(const char *reason)
+{
+    ESP_LOGE(TAG, "%s, retrying in %u s", reason, s_retry_s);
+    if (s_timer != NET_LOOP_TIMER_INVALID) {
+        net_loop_cancel(s_timer);
+    }
+    if (s_fd >= 0) {
+        close(s_fd);
+        s_fd = -1;
+    }
+    schedule(s_retry_s);
+}
+
+static void round_start(void *arg)
+{
+    // The deadline comes first: a round without one could wait forever
+    s_timer = net_loop_schedule(round_timeout, NULL, NTP_ROUND_TIMEOUT_MS);
+    if (s_timer == NET_LOOP_TIMER_INVALID) {
+        round_abort("No loop timer for the round");
+        return;
+    }
+
+    s_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s_fd < 0) {
+        round_abort("No socket");
+        return;
+    }
+    fcntl(s_fd, F_SETFL, O_NONBLOCK);
+    if (net_loop_watch(s_fd, NET_LOOP_READ, on_rx, NULL) != ESP_OK) {
+        round_abort("Cannot watch the socket");
+        return;
+    }
+    power_radio_acquire();
+
+    for (int i = 0; i < s_server_count; i++) {
+        s_servers[i].state = SERVER_IDLE;
+        s_servers[i].valid = false;
+    }
+    s_next = 0;
+    resolve_next();
+}
+
+esp_err_t ntp_client_start(const char *servers, ntp_result_cb_t cb)
+{
+    const char *p = servers;
+
+    if (s_result_cb != NULL) {
+        return ESP_OK;
+    }
+
+    // "host,host,..." with optional spaces
+    while (*p != '\0' && s_server_count < NTP_MAX_SERVERS) {
+        size_t len = strcspn(p, ", ");
+        if (len > 0 && len < NET_DNS_HOST_LEN) {
+            memcpy(s_servers[s_server_count].host, p, len);
+            s_servers[s_server_count].host[len] = '\0';
+            s_server_count++;
+        }
+        p += len;
+        p += (*p != '\0');
+    }
+    if (*p != '\0') {
+        ESP_LOGW(TAG, "Only the first %d servers are used", NTP_MAX_SERVERS);
+    }
+    if (s_server_count == 0) {
+        ESP_LOGE(TAG, "No NTP server configured");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = net_loop_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    const esp_timer_create_args_t retry_args = {
+        .callback = retry_cb,
+        .name = "ntp_retry",
+    };
+    err = esp_timer_create(&retry_args, &s_retry_timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_result_cb = cb;
+    power_radio_expect(0);
+    // The first round runs on the loop task, which owns s_timer from then on
+    if (net_loop_schedule(round_start, NULL, 0) == NET_LOOP_TIMER_INVALID) {
+        ESP_LOGW(TAG, "No loop timer for the first round, retrying in %u ms", NTP_TIMER_RETRY_MS);
+        esp_timer_start_once(s_retry_timer, NTP_TIMER_RETRY_MS * 1000);
+    }
+    return ESP_OK;
+}
+
+uint32_t ntp_client_poll_interval(void)
+{
+    return s_poll_s;
+}
@@ -0,0 +1,14 @@
+#ifndef LOCAL_TIME_H
+#define LOCAL_TIME_H
+
+/**
+ * @brief Create the minute timer and fill the cache; TZ must be set
+ */
+void local_time_init(void);
+
+/**
+ * @brief Refresh the cache and re-align the minute timer after the clock was set
+ */
+void local_time_clock_changed(void);
+
+#endif // LOCAL_TIME_H
@@ -0,0 +1,41 @@
+#ifndef NTP_CLIENT_H
+#define NTP_CLIENT_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * SNTP client on the shared network loop. Each round queries every
+ * configured server once, drops answers that disagree with the majority and
+ * reports the one with the shortest round trip. Rounds repeat at a poll
+ * interval that doubles while the measured offsets stay small.
+ */
+
+#define NTP_MAX_SERVERS 4
+
+// Sample chosen from one round
+typedef struct {
+    const char *server;
+    int64_t offset_us;      // Server time minus the system clock
+    uint32_t delay_us;      // Round trip to that server
+    uint8_t answered;       // Servers with a usable answer this round
+    uint8_t used;           // Of those, not rejected as outliers
+} ntp_result_t;
+
+/**
+ * @brief Called on the network loop with the sample chosen in each round
+ */
+typedef void (*ntp_result_cb_t)(const ntp_result_t *result);
+
+/**
+ * @brief Start polling (any task); later calls do nothing
+ * @param servers Host names or addresses separated by commas
+ */
+esp_err_t ntp_client_start(const char *servers, ntp_result_cb_t cb);
+
+/**
+ * @brief Current interval between rounds in seconds
+ */
+uint32_t ntp_client_poll_interval(void);
+
+#endif // NTP_CLIENT_H
@@ -1,85 +1,443 @@
 #include "time_manager.h"
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_system.h"
+#include "esp_attr.h"
 #include "esp_log.h"
-#include "lwip/apps/sntp.h"
+#include "esp_timer.h"
+#include "local_time.h"
+#include "ntp_client.h"
 
 static const char *TAG = "TIME_MANAGER";
-static bool time_synced = false;
+static void (*s_sync_hook)(void);
 
-static void time_sync_notification_cb(struct timeval *tv)
+// RTC slow-clock counter (~150 kHz RC oscillator, 32 bits, wraps in about
+// 8 h). Only a power-on reset clears it; soft resets and deep sleep do not.
+// Deep sleep is itself timed by this counter, so no gap can span a wrap.
+#ifndef RTC_COUNTER_REG
+#define RTC_COUNTER_REG     0x6000071C
+#endif
+#define RTC_NOMINAL_HZ      150000
+
+#define CLOCK_SAVE_MS       60000       // Calibrate the RTC and save the clock this often
+#define CLOCK_CAL_MIN_MS    1000        // Shortest calibration interval (about 7 ppm per tick)
+#define CLOCK_MAX_GAP_US    (6LL * 3600 * 1000000)   // Longer gaps may have wrapped the counter
+#define CLOCK_MAGIC         0x434C4B31  // "CLK1"
+#define CRYSTAL_PPM         20          // System clock (crystal) tolerance
+#define RTC_DRIFT_FLOOR_PPM 100         // RC oscillator drift not seen by calibration
+
+// Clock discipline: small offsets are slewed in at a rate nothing notices,
+// and the crystal's rate error is estimated from successive offsets
+#define NTP_STEP_US         128000      // Larger offsets are stepped
+#define SLEW_MAX_PPM        500         // Fastest slew, 0.5 ms per second
+#define SLEW_PERIOD_MS      1000
+#define FREQ_MAX_PPB        500000
+#define FREQ_NOISE_PPB      5000        // Offset noise allowed in a frequency estimate
+
+// Kept in RTC memory, which survives soft resets and deep sleep; must not be
+// reloaded by the bootloader, so it is left uninitialized where possible
+#ifdef RTC_NOINIT_ATTR
+#define CLOCK_RTC_ATTR RTC_NOINIT_ATTR
+#else
+#define CLOCK_RTC_ATTR RTC_DATA_ATTR
+#endif
+
+typedef struct {
+    uint32_t magic;
+    uint32_t rtc_count;         // Counter value when epoch_us was taken
+    int64_t epoch_us;           // Wall clock (UTC) at rtc_count
+    uint32_t period_q24;        // RTC tick period, microseconds in Q8.24
+    uint32_t drift_ppm;         // Variation of the period between calibrations
+    uint32_t error_ms;          // Estimated clock error when saved
+    uint32_t last_sync;         // Unix time of the last SNTP sync, 0 if none
+    uint32_t check;             // Sum of the fields above, against stale RTC memory
+} clock_state_t;
+
+static CLOCK_RTC_ATTR clock_state_t s_saved;
+
+// The clock was last set at ref_uptime_us; its error grows from error_base_ms
+// at error_ppm. All of this is shared by the SNTP callback and the save timer.
+static SemaphoreHandle_t s_lock;
+static esp_timer_handle_t s_save_timer;
+static time_source_t s_source = TIME_SOURCE_NONE;
+static int64_t s_ref_epoch_us;
+static int64_t s_ref_uptime_us;
+static uint32_t s_error_base_ms;
+static uint32_t s_error_ppm;
+static int32_t s_last_correction_ms;
+static bool s_corrected;
+static uint32_t s_last_sync;
+static uint32_t s_syncs;
+static int64_t s_sync_uptime_us;
+static int32_t s_ntp_offset_us;
+static uint32_t s_ntp_delay_us;
+static uint8_t s_ntp_used;
+
+// Corrections still being applied to the system clock
+static esp_timer_handle_t s_slew_timer;
+static int64_t s_slew_us;
+static int32_t s_freq_ppb;
+static int64_t s_freq_rem;              // Sub-microsecond remainder, in ppb-microseconds
+static int64_t s_adjust_uptime_us;
+
+// Drift measured since s_drift_uptime_us, for the next frequency estimate
+static int64_t s_drift_uptime_us;
+static int64_t s_drift_us;
+
+// RTC calibration against the system clock, refreshed every CLOCK_SAVE_MS.
+// Until the first one the period is the nominal one, or the last one saved
+static uint32_t s_period_q24 = (uint32_t)((1000000ULL << 24) / RTC_NOMINAL_HZ);
+static uint32_t s_drift_ppm = RTC_DRIFT_FLOOR_PPM;
+static bool s_calibrated;
+static uint32_t s_cal_count;
+static int64_t s_cal_uptime_us;
+
+static uint32_t rtc_count(void)
+{
+    return *(volatile uint32_t *)RTC_COUNTER_REG;
+}
+
+static uint32_t state_check(const clock_state_t *state)
+{
+    const uint32_t *word = (const uint32_t *)state;
+    uint32_t sum = 0x5A5A5A5A;
+
+    for (size_t i = 0; i < offsetof(clock_state_t, check) / sizeof(uint32_t); i++) {
+        sum = (sum << 5 | sum >> 27) ^ word[i];
+    }
+    return sum;
+}
+
+static int64_t epoch_us_at(int64_t uptime_us)
+{
+    int64_t elapsed_us = uptime_us - s_ref_uptime_us;
+    return s_ref_epoch_us + elapsed_us + elapsed_us * s_freq_ppb / 1000000000;
+}
+
+static uint32_t error_ms_at(int64_t uptime_us)
+{
+    int64_t elapsed_ms = (uptime_us - s_ref_uptime_us) / 1000;
+    return s_error_base_ms + (uint32_t)(elapsed_ms * s_error_ppm / 1000000);
+}
+
+static void set_reference(time_source_t source, int64_t epoch_us, int64_t uptime_us,
+                          uint32_t error_ms, uint32_t ppm)
+{
+    s_source = source;
+    s_ref_epoch_us = epoch_us;
+    s_ref_uptime_us = uptime_us;
+    s_error_base_ms = error_ms;
+    s_error_ppm = ppm;
+}
+
+static void save_locked(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    // Saved even before a calibration: deep sleep cycles are over long
+    // before the first periodic one
+    if (s_source == TIME_SOURCE_NONE) {
+        return;
+    }
+    s_saved.magic = CLOCK_MAGIC;
+    s_saved.rtc_count = rtc_count();
+    s_saved.epoch_us = epoch_us_at(now);
+    s_saved.period_q24 = s_period_q24;
+    s_saved.drift_ppm = s_drift_ppm;
+    s_saved.error_ms = error_ms_at(now);
+    s_saved.last_sync = s_last_sync;
+    s_saved.check = state_check(&s_saved);
+}
+
+// Measure the RTC period over the last interval; the system clock runs from
+// the crystal, so this tracks the RC oscillator's temperature drift. Shorter
+// intervals are left to grow, so a save soon after boot still measures
+static void calibrate_locked(void)
+{
+    uint32_t count = rtc_count();
+    int64_t now = esp_timer_get_time();
+    uint32_t ticks = count - s_cal_count;
+    int64_t elapsed_us = now - s_cal_uptime_us;
+
+    if (ticks == 0 || elapsed_us < CLOCK_CAL_MIN_MS * 1000LL) {
+        return;
+    }
+    s_cal_count = count;
+    s_cal_uptime_us = now;
+
+    uint32_t period = (uint32_t)(((uint64_t)elapsed_us << 24) / ticks);
+    if (s_calibrated) {
+        uint32_t deviation = (period > s_period_q24) ? period - s_period_q24 : s_period_q24 - period;
+        uint32_t ppm = (uint32_t)((uint64_t)deviation * 1000000 / s_period_q24);
+        // Smoothed, never below what a single calibration cannot see
+        s_drift_ppm += ((int32_t)ppm - (int32_t)s_drift_ppm) / 4;
+        if (s_drift_ppm < RTC_DRIFT_FLOOR_PPM) {
+            s_drift_ppm = RTC_DRIFT_FLOOR_PPM;
+        }
+    }
+    s_period_q24 = period;
+    s_calibrated = true;
+}
+
+static void shift_clock(int64_t delta_us)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    int64_t epoch_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec + delta_us;
+    tv.tv_sec = epoch_us / 1000000;
+    tv.tv_usec = epoch_us % 1000000;
+    settimeofday(&tv, NULL);
+}
+
+// Apply the frequency correction and the next part of a slew for the time
+// since the last call; returns the change made to the clock
+static int64_t adjust_locked(void)
 {
-    ESP_LOGI(TAG, "Time synchronized with NTP server");
-    time_synced = true;
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed_us = now - s_adjust_uptime_us;
+    int64_t slew_max = elapsed_us * SLEW_MAX_PPM / 1000000;
+
+    s_adjust_uptime_us = now;
+    s_freq_rem += elapsed_us * s_freq_ppb;
+    int64_t step = s_freq_rem / 1000000000;
+    s_freq_rem -= step * 1000000000;
+
+    int64_t slew = (s_slew_us > slew_max) ? slew_max : (s_slew_us < -slew_max) ? -slew_max : s_slew_us;
+    s_slew_us -= slew;
+    step += slew;
+    if (step != 0) {
+        shift_clock(step);
+    }
+    return step;
 }
 
-static void initialize_sntp(void)
+static void slew_timer_cb(void *arg)
 {
-    ESP_LOGI(TAG, "Initializing SNTP");
-    sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    sntp_setservername(0, CONFIG_NTP_SERVER);
-    sntp_set_time_sync_notification_cb(time_sync_notification_cb);
-    sntp_init();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    adjust_locked();
+    if (s_slew_us == 0) {
+        esp_timer_stop(s_slew_timer);
+    }
+    xSemaphoreGive(s_lock);
 }
 
-static void wait_for_time_sync(void)
+static void save_timer_cb(void *arg)
 {
-    int retry = 0;
-    const int retry_count = 30;
-    
-    while (sntp_get_sync_status() == SNTP_SYNC_STATUS_RESET && ++retry < retry_count) {
-        ESP_LOGI(TAG, "Waiting for system time to be set... (%d/%d)", retry, retry_count);
-        vTaskDelay(2000 / portTICK_PERIOD_MS);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    adjust_locked();
+    calibrate_locked();
+    save_locked();
+    xSemaphoreGive(s_lock);
+}
+
+// Set the clock from RTC memory after a soft reset or deep sleep wake
+static void restore_clock(void)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    uint32_t count = rtc_count();
+    int64_t now = esp_timer_get_time();
+
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT ||
+        s_saved.magic != CLOCK_MAGIC || s_saved.check != state_check(&s_saved)) {
+        ESP_LOGI(TAG, "No saved clock, waiting for SNTP");
+        memset(&s_saved, 0, sizeof(s_saved));
+        return;
     }
-    
-    if (retry >= retry_count) {
-        ESP_LOGW(TAG, "Failed to sync time with NTP server");
+
+    // Counter ticks since the save cover the reset and boot up to now
+    int64_t gap_us = (int64_t)(((uint64_t)(count - s_saved.rtc_count) * s_saved.period_q24) >> 24);
+    if (gap_us > CLOCK_MAX_GAP_US) {
+        // The time is lost, but the oscillator is the same one
+        ESP_LOGW(TAG, "Saved clock is too old (%d s), waiting for SNTP", (int)(gap_us / 1000000));
+        s_period_q24 = s_saved.period_q24;
+        s_drift_ppm = s_saved.drift_ppm;
+        return;
+    }
+
+    uint32_t error_ms = s_saved.error_ms + (uint32_t)(gap_us / 1000 * s_saved.drift_ppm / 1000000);
+    int64_t epoch_us = s_saved.epoch_us + gap_us;
+    struct timeval tv = {
+        .tv_sec = epoch_us / 1000000,
+        .tv_usec = epoch_us % 1000000,
+    };
+    settimeofday(&tv, NULL);
+
+    set_reference(TIME_SOURCE_RTC, epoch_us, now, error_ms, CRYSTAL_PPM);
+    s_period_q24 = s_saved.period_q24;
+    s_drift_ppm = s_saved.drift_ppm;
+    s_calibrated = true;
+    s_last_sync = s_saved.last_sync;
+    ESP_LOGI(TAG, "Clock restored from RTC after %d ms, estimated error %u ms",
+             (int)(gap_us / 1000), error_ms);
+}
+
+// Each offset, net of the slew still pending, is the drift since the last
+// sync; their sum over a long enough interval, where the noise of a single
+// offset no longer matters, is the crystal's remaining rate error
+static void update_frequency_locked(int64_t drift_us, uint32_t delay_us, int64_t now)
+{
+    int64_t interval_us = now - s_drift_uptime_us;
+
+    s_drift_us += drift_us;
+    if (interval_us < (int64_t)delay_us / 2 * (1000000000 / FREQ_NOISE_PPB)) {
+        return;
+    }
+    s_freq_ppb += (int32_t)(s_drift_us * 1000000000 / interval_us / 2);
+    if (s_freq_ppb > FREQ_MAX_PPB) {
+        s_freq_ppb = FREQ_MAX_PPB;
+    } else if (s_freq_ppb < -FREQ_MAX_PPB) {
+        s_freq_ppb = -FREQ_MAX_PPB;
+    }
+    s_drift_uptime_us = now;
+    s_drift_us = 0;
+}
+
+// Called on the network loop with the sample chosen from all servers
+static void ntp_result_cb(const ntp_result_t *result)
+{
+    int64_t now = esp_timer_get_time();
+    struct timeval tv;
+    bool step;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // Bring the frequency correction up to date; the new offset replaces the
+    // rest of the previous slew, which it already includes
+    int64_t pending_slew_us = s_slew_us;
+    s_slew_us = 0;
+    int64_t offset_us = result->offset_us - adjust_locked();
+    gettimeofday(&tv, NULL);
+    int64_t epoch_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec + offset_us;
+
+    // The difference from the estimate is the error the clock actually had
+    if (s_source != TIME_SOURCE_NONE) {
+        uint32_t estimated_ms = error_ms_at(now);
+        s_last_correction_ms = (int32_t)((epoch_us - epoch_us_at(now)) / 1000);
+        s_corrected = true;
+        ESP_LOGI(TAG, "Time synchronized with NTP, corrected by %d ms (estimated error %u ms)",
+                 s_last_correction_ms, estimated_ms);
+    } else {
+        ESP_LOGI(TAG, "Time synchronized with NTP");
+    }
+#ifdef CONFIG_DEEP_SLEEP_MODE
+    // The unit is back in deep sleep within seconds, long before a slew could finish
+    step = true;
+#else
+    step = (s_source == TIME_SOURCE_NONE || llabs(offset_us) >= NTP_STEP_US);
+#endif
+    if (step) {
+        // Something other than the crystal went wrong: restart the drift measurement
+        shift_clock(offset_us);
+        s_drift_uptime_us = now;
+        s_drift_us = 0;
+    } else {
+        update_frequency_locked(offset_us - pending_slew_us, result->delay_us, now);
+        s_slew_us = offset_us;
+        esp_timer_stop(s_slew_timer);
+        esp_timer_start_periodic(s_slew_timer, SLEW_PERIOD_MS * 1000);
+    }
+
+    // Half the round trip bounds the error of the chosen sample
+    set_reference(TIME_SOURCE_SNTP, epoch_us, now, result->delay_us / 2000 + 1, CRYSTAL_PPM);
+    s_last_sync = epoch_us / 1000000;
+    s_sync_uptime_us = now;
+    s_syncs++;
+    s_ntp_offset_us = (int32_t)offset_us;
+    s_ntp_delay_us = result->delay_us;
+    s_ntp_used = result->used;
+    save_locked();
+    xSemaphoreGive(s_lock);
+
+    if (step) {
+        local_time_clock_changed();
+    }
+    if (s_sync_hook != NULL) {
+        s_sync_hook();
     }
 }
 
 void time_manager_init(void)
 {
-    initialize_sntp();
-    wait_for_time_sync();
-    
-    // Set timezone
+    // Set timezone first so local time is right as soon as the clock is set
     setenv("TZ", CONFIG_TIMEZONE, 1);
     tzset();
-    
-    // Create task to periodically resync time
-    // This is handled by SNTP automatically, but we log it
-    time_synced = (sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED);
+
+    s_lock = xSemaphoreCreateMutex();
+    s_cal_count = rtc_count();
+    s_cal_uptime_us = esp_timer_get_time();
+    s_adjust_uptime_us = s_cal_uptime_us;
+    restore_clock();
+    local_time_init();
+
+    const esp_timer_create_args_t save_args = {
+        .callback = save_timer_cb,
+        .name = "clock_save",
+    };
+    const esp_timer_create_args_t slew_args = {
+        .callback = slew_timer_cb,
+        .name = "clock_slew",
+    };
+    if (esp_timer_create(&save_args, &s_save_timer) == ESP_OK) {
+        esp_timer_start_periodic(s_save_timer, CLOCK_SAVE_MS * 1000);
+    }
+    esp_timer_create(&slew_args, &s_slew_timer);
+}
+
+void time_manager_start_sync(void)
+{
+    // Rounds keep running on the network loop; the result callback reports each sync
+    ESP_LOGI(TAG, "Starting NTP with %s", CONFIG_NTP_SERVERS);
+    if (ntp_client_start(CONFIG_NTP_SERVERS, ntp_result_cb) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start NTP");
+    }
 }
 
-esp_err_t time_manager_get_time(struct tm *timeinfo)
+void time_manager_save(void)
 {
-    if (timeinfo == NULL) {
-        return ESP_ERR_INVALID_ARG;
+    if (s_lock == NULL) {
+        return;
     }
-    
-    time_t now;
-    time(&now);
-    localtime_r(&now, timeinfo);
-    
-    // Check if time is valid (year > 2020)
-    if (timeinfo->tm_year < (2020 - 1900)) {
-        return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    adjust_locked();
+    calibrate_locked();
+    save_locked();
+    xSemaphoreGive(s_lock);
+}
+
+void time_manager_get_clock_stats(time_clock_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+
+    memset(stats, 0, sizeof(*stats));
+    if (s_lock == NULL) {
+        return;
     }
-    
-    return ESP_OK;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    stats->source = s_source;
+    stats->error_ms = (s_source == TIME_SOURCE_NONE) ? UINT32_MAX : error_ms_at(now);
+    stats->last_correction_ms = s_last_correction_ms;
+    stats->corrected = s_corrected;
+    stats->rtc_hz = (uint32_t)((1000000ULL << 24) / s_period_q24);
+    stats->rtc_drift_ppm = s_drift_ppm;
+    stats->last_sync = s_last_sync;
+    stats->sync_age_s = (s_syncs > 0) ? (uint32_t)((now - s_sync_uptime_us) / 1000000) : UINT32_MAX;
+    stats->syncs = s_syncs;
+    stats->ntp_offset_us = s_ntp_offset_us;
+    stats->ntp_delay_us = s_ntp_delay_us;
+    stats->ntp_servers_used = s_ntp_used;
+    stats->ntp_poll_s = ntp_client_poll_interval();
+    stats->slew_remaining_us = (int32_t)s_slew_us;
+    stats->freq_correction_ppb = s_freq_ppb;
+    xSemaphoreGive(s_lock);
 }
 
-bool time_is_synced(void)
+void time_manager_set_sync_hook(void (*synced)(void))
 {
-    struct tm timeinfo;
-    time_t now;
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    
-    // Simple check: if year is reasonable, time is synced
-    return (timeinfo.tm_year >= (2020 - 1900));
+    s_sync_hook = synced;
 }
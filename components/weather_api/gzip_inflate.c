@@ -0,0 +1,538 @@
+#include "gzip_inflate.h"
+#include <string.h>
+#include <stddef.h>
+
+/*
+ * Resumable inflate in the spirit of zlib's puff.c: every state only consumes
+ * bits once everything it needs is in the bit accumulator, so a chunk boundary
+ * anywhere in the stream simply returns and the same state is retried on the
+ * next gzip_inflate_feed() call.
+ */
+
+enum {
+    ST_GZ_HEADER = 0,
+    ST_GZ_EXTRA_LEN,
+    ST_GZ_EXTRA,
+    ST_GZ_NAME,
+    ST_GZ_COMMENT,
+    ST_GZ_HCRC,
+    ST_BLOCK,
+    ST_STORED_LEN,
+    ST_STORED_NLEN,
+    ST_STORED,
+    ST_DYN_COUNTS,
+    ST_DYN_CLEN,
+    ST_DYN_LENS,
+    ST_SYM,
+    ST_LEN_EXTRA,
+    ST_DIST_SYM,
+    ST_DIST_EXTRA,
+    ST_TRAILER,
+    ST_DONE,
+    ST_ERROR,
+};
+
+// gzip header flags
+#define GZ_FHCRC    0x02
+#define GZ_FEXTRA   0x04
+#define GZ_FNAME    0x08
+#define GZ_FCOMMENT 0x10
+
+#define WINDOW_MASK (GZIP_INFLATE_WINDOW_SIZE - 1)
+
+static const uint16_t len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t clen_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// CRC32 (reflected, poly 0xEDB88320), 4 bits at a time to keep the table tiny
+static const uint32_t crc_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+static void fill(gzip_inflate_t *z)
+{
+    while (z->bitcnt <= 24 && z->in_len > 0) {
+        z->bitbuf |= (uint32_t)*z->in++ << z->bitcnt;
+        z->bitcnt += 8;
+        z->in_len--;
+    }
+}
+
+static int need(gzip_inflate_t *z, int n)
+{
+    fill(z);
+    return z->bitcnt >= n;
+}
+
+static uint32_t take(gzip_inflate_t *z, int n)
+{
+    uint32_t val = z->bitbuf & ((1u << n) - 1);
+    z->bitbuf >>= n;
+    z->bitcnt -= n;
+    return val;
+}
+
+static void flush(gzip_inflate_t *z)
+{
+    if (z->pos > z->flushed && !z->aborted) {
+        if (z->output(z->ctx, &z->window[z->flushed], z->pos - z->flushed) != 0) {
+            z->aborted = 1;
+        }
+    }
+    z->flushed = z->pos;
+}
+
+static inline void put(gzip_inflate_t *z, uint8_t byte)
+{
+    uint32_t crc = z->crc ^ byte;
+    crc = (crc >> 4) ^ crc_table[crc & 0x0F];
+    z->crc = (crc >> 4) ^ crc_table[crc & 0x0F];
+
+    z->window[z->pos++] = byte;
+    z->total_out++;
+    if (z->pos == GZIP_INFLATE_WINDOW_SIZE) {
+        flush(z);
+        z->pos = 0;
+        z->flushed = 0;
+    }
+}
+
+// Build canonical Huffman decoding table. Returns -1 if over-subscribed.
+static int build_huffman(gzip_huffman_t *h, const int16_t *length, int n)
+{
+    int16_t offs[16];
+
+    memset(h->count, 0, sizeof(h->count));
+    for (int sym = 0; sym < n; sym++) {
+        h->count[length[sym]]++;
+    }
+    if (h->count[0] == n) {
+        return 0;
+    }
+
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left <<= 1;
+        left -= h->count[len];
+        if (left < 0) {
+            return -1;
+        }
+    }
+
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++) {
+        offs[len + 1] = offs[len] + h->count[len];
+    }
+    for (int sym = 0; sym < n; sym++) {
+        if (length[sym] != 0) {
+            h->symbol[offs[length[sym]]++] = sym;
+        }
+    }
+    return left;
+}
+
+// Decode one symbol from the accumulator without consuming it.
+// Returns the code length, 0 if more bits are needed, -1 on an invalid code.
+static int decode_peek(const gzip_huffman_t *h, uint32_t bitbuf, int bitcnt, int *symbol)
+{
+    int code = 0, first = 0, index = 0;
+
+    for (int len = 1; len < 16; len++) {
+        if (len > bitcnt) {
+            return 0;
+        }
+        code |= (bitbuf >> (len - 1)) & 1;
+        int count = h->count[len];
+        if (code - count < first) {
+            *symbol = h->symbol[index + (code - first)];
+            return len;
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static void build_fixed(gzip_inflate_t *z)
+{
+    int sym = 0;
+    for (; sym < 144; sym++) z->lengths[sym] = 8;
+    for (; sym < 256; sym++) z->lengths[sym] = 9;
+    for (; sym < 280; sym++) z->lengths[sym] = 7;
+    for (; sym < 288; sym++) z->lengths[sym] = 8;
+    build_huffman(&z->lencode, z->lengths, 288);
+
+    for (sym = 0; sym < 30; sym++) z->lengths[sym] = 5;
+    build_huffman(&z->distcode, z->lengths, 30);
+}
+
+static uint8_t next_header_state(gzip_inflate_t *z)
+{
+    if (z->header_flags & GZ_FEXTRA) {
+        z->header_flags &= ~GZ_FEXTRA;
+        return ST_GZ_EXTRA_LEN;
+    }
+    if (z->header_flags & GZ_FNAME) {
+        z->header_flags &= ~GZ_FNAME;
+        return ST_GZ_NAME;
+    }
+    if (z->header_flags & GZ_FCOMMENT) {
+        z->header_flags &= ~GZ_FCOMMENT;
+        return ST_GZ_COMMENT;
+    }
+    if (z->header_flags & GZ_FHCRC) {
+        z->header_flags &= ~GZ_FHCRC;
+        return ST_GZ_HCRC;
+    }
+    return ST_BLOCK;
+}
+
+// The gzip trailer (CRC32, ISIZE) follows the last block on a byte boundary
+static uint8_t enter_trailer(gzip_inflate_t *z)
+{
+    take(z, z->bitcnt & 7);
+    z->counter = 0;
+    z->trailer[0] = 0;
+    z->trailer[1] = 0;
+    return ST_TRAILER;
+}
+
+static gzip_inflate_status_t run(gzip_inflate_t *z)
+{
+    int len, sym;
+
+    while (!z->aborted) {
+        switch (z->state) {
+            case ST_GZ_HEADER:
+                while (z->counter < 10) {
+                    if (!need(z, 8)) {
+                        return GZIP_INFLATE_OK;
+                    }
+                    uint8_t byte = take(z, 8);
+                    if ((z->counter == 0 && byte != 0x1F) ||
+                        (z->counter == 1 && byte != 0x8B) ||
+                        (z->counter == 2 && byte != 8)) {
+                        return GZIP_INFLATE_ERR_FORMAT;
+                    }
+                    if (z->counter == 3) {
+                        z->header_flags = byte;
+                    }
+                    z->counter++;
+                }
+                z->state = next_header_state(z);
+                break;
+
+            case ST_GZ_EXTRA_LEN:
+                if (!need(z, 16)) {
+                    return GZIP_INFLATE_OK;
+                }
+                z->length = take(z, 16);
+                z->state = ST_GZ_EXTRA;
+                break;
+
+            case ST_GZ_EXTRA:
+                while (z->length > 0) {
+                    if (!need(z, 8)) {
+                        return GZIP_INFLATE_OK;
+                    }
+                    take(z, 8);
+                    z->length--;
+                }
+                z->state = next_header_state(z);
+                break;
+
+            case ST_GZ_NAME:
+            case ST_GZ_COMMENT:
+                do {
+                    if (!need(z, 8)) {
+                        return GZIP_INFLATE_OK;
+                    }
+                } while (take(z, 8) != 0);
+                z->state = next_header_state(z);
+                break;
+
+            case ST_GZ_HCRC:
+                if (!need(z, 16)) {
+                    return GZIP_INFLATE_OK;
+                }
+                take(z, 16);
+                z->state = ST_BLOCK;
+                break;
+
+            case ST_BLOCK:
+                if (!need(z, 3)) {
+                    return GZIP_INFLATE_OK;
+                }
+                z->last_block = take(z, 1);
+                switch (take(z, 2)) {
+                    case 0:
+                        take(z, z->bitcnt & 7);  // Stored blocks start byte aligned
+                        z->state = ST_STORED_LEN;
+                        break;
+                    case 1:
+                        build_fixed(z);
+                        z->state = ST_SYM;
+                        break;
+                    case 2:
+                        z->state = ST_DYN_COUNTS;
+                        break;
+                    default:
+                        return GZIP_INFLATE_ERR_FORMAT;
+                }
+                break;
+
+            case ST_STORED_LEN:
+                if (!need(z, 16)) {
+                    return GZIP_INFLATE_OK;
+                }
+                z->length = take(z, 16);
+                z->state = ST_STORED_NLEN;
+                break;
+
+            case ST_STORED_NLEN:
+                if (!need(z, 16)) {
+                    return GZIP_INFLATE_OK;
+                }
+                if ((uint16_t)~take(z, 16) != z->length) {
+                    return GZIP_INFLATE_ERR_FORMAT;
+                }
+                z->state = ST_STORED;
+                break;
+
+            case ST_STORED:
+                while (z->length > 0) {
+                    if (!need(z, 8)) {
+                        return GZIP_INFLATE_OK;
+                    }
+                    put(z, take(z, 8));
+                    z->length--;
+                }
+                z->state = z->last_block ? enter_trailer(z) : ST_BLOCK;
+                break;
+
+            case ST_DYN_COUNTS:
+                if (!need(z, 14)) {
+                    return GZIP_INFLATE_OK;
+                }
+                z->nlen = take(z, 5) + 257;
+                z->ndist = take(z, 5) + 1;
+                z->ncode = take(z, 4) + 4;
+                if (z->nlen > 286 || z->ndist > 30) {
+                    return GZIP_INFLATE_ERR_FORMAT;
+                }
+                z->counter = 0;
+                z->state = ST_DYN_CLEN;
+                break;
+
+            case ST_DYN_CLEN:
+                while (z->counter < z->ncode) {
+                    if (!need(z, 3)) {
+                        return GZIP_INFLATE_OK;
+                    }
+                    z->lengths[clen_order[z->counter++]] = take(z, 3);
+                }
+                for (; z->counter < 19; z->counter++) {
+                    z->lengths[clen_order[z->counter]] = 0;
+                }
+                if (build_huffman(&z->lencode, z->lengths, 19) != 0) {
+                    return GZIP_INFLATE_ERR_FORMAT;
+                }
+                z->counter = 0;
+                z->state = ST_DYN_LENS;
+                break;
+
+            case ST_DYN_LENS:
+                while (z->counter < z->nlen + z->ndist) {
+                    fill(z);
+                    len = decode_peek(&z->lencode, z->bitbuf, z->bitcnt, &sym);
+                    if (len == 0) {
+                        return GZIP_INFLATE_OK;
+                    }
+                    if (len < 0) {
+                        return GZIP_INFLATE_ERR_FORMAT;
+                    }
+                    if (sym < 16) {
+                        take(z, len);
+                        z->lengths[z->counter++] = sym;
+                        continue;
+                    }
+
+                    int extra = (sym == 16) ? 2 : (sym == 17) ? 3 : 7;
+                    if (z->bitcnt < len + extra) {
+                        return GZIP_INFLATE_OK;
+                    }
+                    take(z, len);
+                    int16_t value = 0;
+                    int repeat;
+                    if (sym == 16) {
+                        if (z->counter == 0) {
+                            return GZIP_INFLATE_ERR_FORMAT;
+                        }
+                        value = z->lengths[z->counter - 1];
+                        repeat = 3 + take(z, 2);
+                    } else if (sym == 17) {
+                        repeat = 3 + take(z, 3);
+                    } else {
+                        repeat = 11 + take(z, 7);
+                    }
+                    if (z->counter + repeat > z->nlen + z->ndist) {
+                        return GZIP_INFLATE_ERR_FORMAT;
+                    }
+                    while (repeat--) {
+                        z->lengths[z->counter++] = value;
+                    }
+                }
+                if (z->lengths[256] == 0 ||
+                    build_huffman(&z->lencode, z->lengths, z->nlen) < 0 ||
+                    build_huffman(&z->distcode, z->lengths + z->nlen, z->ndist) < 0) {
+                    return GZIP_INFLATE_ERR_FORMAT;
+                }
+                z->state = ST_SYM;
+                break;
+
+            case ST_SYM:
+                for (;;) {
+                    fill(z);
+                    len = decode_peek(&z->lencode, z->bitbuf, z->bitcnt, &sym);
+                    if (len == 0) {
+                        return GZIP_INFLATE_OK;
+                    }
+                    if (len < 0) {
+                        return GZIP_INFLATE_ERR_FORMAT;
+                    }
+                    take(z, len);
+                    if (sym >= 256) {
+                        break;
+                    }
+                    put(z, sym);
+                    if (z->aborted) {
+                        return GZIP_INFLATE_ERR_ABORTED;
+                    }
+                }
+                if (sym == 256) {
+                    z->state = z->last_block ? enter_trailer(z) : ST_BLOCK;
+                } else if (sym - 257 >= 29) {
+                    return GZIP_INFLATE_ERR_FORMAT;
+                } else {
+                    z->symbol = sym - 257;
+                    z->state = ST_LEN_EXTRA;
+                }
+                break;
+
+            case ST_LEN_EXTRA:
+                if (!need(z, len_extra[z->symbol])) {
+                    return GZIP_INFLATE_OK;
+                }
+                z->length = len_base[z->symbol] + take(z, len_extra[z->symbol]);
+                z->state = ST_DIST_SYM;
+                break;
+
+            case ST_DIST_SYM:
+                fill(z);
+                len = decode_peek(&z->distcode, z->bitbuf, z->bitcnt, &sym);
+                if (len == 0) {
+                    return GZIP_INFLATE_OK;
+                }
+                if (len < 0 || sym >= 30) {
+                    return GZIP_INFLATE_ERR_FORMAT;
+                }
+                take(z, len);
+                z->symbol = sym;
+                z->state = ST_DIST_EXTRA;
+                break;
+
+            case ST_DIST_EXTRA: {
+                if (!need(z, dist_extra[z->symbol])) {
+                    return GZIP_INFLATE_OK;
+                }
+                uint32_t dist = dist_base[z->symbol] + take(z, dist_extra[z->symbol]);
+                if (dist > z->total_out) {
+                    return GZIP_INFLATE_ERR_FORMAT;
+                }
+                if (dist > GZIP_INFLATE_WINDOW_SIZE) {
+                    return GZIP_INFLATE_ERR_WINDOW;
+                }
+                uint32_t from = (z->pos - dist) & WINDOW_MASK;
+                while (z->length > 0) {
+                    put(z, z->window[from]);
+                    from = (from + 1) & WINDOW_MASK;
+                    z->length--;
+                }
+                z->state = ST_SYM;
+                break;
+            }
+
+            case ST_TRAILER:
+                while (z->counter < 8) {
+                    if (!need(z, 8)) {
+                        return GZIP_INFLATE_OK;
+                    }
+                    z->trailer[z->counter / 4] |= take(z, 8) << (8 * (z->counter % 4));
+                    z->counter++;
+                }
+                if (z->trailer[0] != ~z->crc || z->trailer[1] != z->total_out) {
+                    return GZIP_INFLATE_ERR_CHECKSUM;
+                }
+                z->state = ST_DONE;
+                break;
+
+            case ST_DONE:
+                return GZIP_INFLATE_DONE;
+
+            default:
+                return GZIP_INFLATE_ERR_FORMAT;
+        }
+    }
+    return GZIP_INFLATE_ERR_ABORTED;
+}
+
+void gzip_inflate_init(gzip_inflate_t *z, gzip_inflate_output_cb_t output, void *ctx)
+{
+    memset(z, 0, offsetof(gzip_inflate_t, window));
+    z->state = ST_GZ_HEADER;
+    z->crc = 0xFFFFFFFF;
+    z->output = output;
+    z->ctx = ctx;
+}
+
+gzip_inflate_status_t gzip_inflate_feed(gzip_inflate_t *z, const uint8_t *data, size_t len)
+{
+    if (z->state == ST_ERROR) {
+        return GZIP_INFLATE_ERR_FORMAT;
+    }
+
+    z->in = data;
+    z->in_len = len;
+
+    gzip_inflate_status_t status = run(z);
+    flush(z);
+    if (z->aborted) {
+        status = GZIP_INFLATE_ERR_ABORTED;
+    }
+    if (status != GZIP_INFLATE_OK && status != GZIP_INFLATE_DONE) {
+        z->state = ST_ERROR;
+    }
+    return status;
+}
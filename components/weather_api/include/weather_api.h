@@ -2,6 +2,7 @@
 #define WEATHER_API_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 typedef enum {
@@ -16,17 +17,44 @@ typedef enum {
 } weather_condition_t;
 
 typedef struct {
-    float temp;
+    int16_t temp;  // Temperature in tenths of a degree Celsius
     weather_condition_t condition;
     char description[32];
     int dt;  // Unix timestamp
 } weather_forecast_t;
 
+#ifdef CONFIG_OWM_MAX_LOCATIONS
+#define WEATHER_MAX_LOCATIONS CONFIG_OWM_MAX_LOCATIONS
+#else
+#define WEATHER_MAX_LOCATIONS 4
+#endif
+
+// Current conditions for one additional site, 28 bytes each
+typedef struct {
+    uint32_t city_id;  // OpenWeatherMap city ID
+    char name[16];     // City name as returned by the API (truncated)
+    int32_t dt;        // Unix timestamp of the observation
+    int16_t temp;      // Temperature in tenths of a degree Celsius
+    uint8_t condition; // weather_condition_t
+    uint8_t valid;
+} weather_location_t;
+
 /**
  * @brief Initialize weather API manager
  */
 void weather_api_init(void);
 
+/**
+ * @brief Load the last successful update kept in RTC memory (CONFIG_DEEP_SLEEP_MODE); call before weather_api_init()
+ * @return true if data was restored; weather_is_valid() is then true before any fetch
+ */
+bool weather_api_restore(void);
+
+/**
+ * @brief Called on the network loop after each update round (successful or not)
+ */
+void weather_set_update_hook(void (*updated)(void));
+
 /**
  * @brief Get current weather
  * @param forecast Pointer to store weather data
@@ -42,6 +70,19 @@ esp_err_t weather_get_current(weather_forecast_t *forecast);
  */
 esp_err_t weather_get_forecast(int day, weather_forecast_t *forecast);
 
+/**
+ * @brief Number of additional locations configured in CONFIG_OWM_LOCATION_IDS
+ */
+int weather_get_location_count(void);
+
+/**
+ * @brief Get current conditions for an additional location
+ * @param index Location index (0 .. weather_get_location_count() - 1)
+ * @param location Pointer to store location data
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not fetched yet
+ */
+esp_err_t weather_get_location(int index, weather_location_t *location);
+
 /**
  * @brief Check if weather data is valid
  * @return true if valid, false otherwise
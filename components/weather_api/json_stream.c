@@ -0,0 +1,387 @@
+#include "json_stream.h"
+#include <string.h>
+
+enum {
+    S_VALUE = 0,        // Expecting any value
+    S_VALUE_OR_END,     // After '[': value or ']'
+    S_KEY_OR_END,       // After '{': key or '}'
+    S_KEY,              // After ',' in an object: key
+    S_COLON,            // After a key
+    S_STRING,
+    S_ESCAPE,
+    S_UNICODE,
+    S_NUMBER,
+    S_LITERAL,
+    S_AFTER_VALUE,      // Expecting ',' or closing bracket
+    S_DONE,
+};
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void append(json_stream_t *js, char c)
+{
+    size_t max = js->in_key ? JSON_STREAM_KEY_LEN : JSON_STREAM_VALUE_LEN;
+    if (js->value_len < max - 1) {
+        js->value[js->value_len++] = c;
+    }
+}
+
+static void emit(json_stream_t *js, json_stream_type_t type)
+{
+    js->value[js->value_len] = '\0';
+    if (js->cb != NULL) {
+        js->cb(js->ctx, js, type, js->value);
+    }
+    js->value_len = 0;
+}
+
+static void value_done(json_stream_t *js)
+{
+    js->state = (js->depth == 0) ? S_DONE : S_AFTER_VALUE;
+    if (js->depth == 0) {
+        js->done = 1;
+    }
+}
+
+static bool push(json_stream_t *js, char container)
+{
+    if (js->depth >= JSON_STREAM_MAX_DEPTH) {
+        return false;
+    }
+    js->container[js->depth] = container;
+    js->key[js->depth][0] = '\0';
+    js->index[js->depth] = (container == '[') ? 0 : -1;
+    js->depth++;
+    js->state = (container == '[') ? S_VALUE_OR_END : S_KEY_OR_END;
+    return true;
+}
+
+static bool pop(json_stream_t *js, char closing)
+{
+    char expected = (js->container[js->depth - 1] == '{') ? '}' : ']';
+    if (closing != expected) {
+        return false;
+    }
+    js->depth--;
+    value_done(js);
+    return true;
+}
+
+static bool finish_literal(json_stream_t *js)
+{
+    js->value[js->value_len] = '\0';
+    if (strcmp(js->value, "true") == 0) {
+        emit(js, JSON_STREAM_TRUE);
+    } else if (strcmp(js->value, "false") == 0) {
+        emit(js, JSON_STREAM_FALSE);
+    } else if (strcmp(js->value, "null") == 0) {
+        emit(js, JSON_STREAM_NULL);
+    } else {
+        return false;
+    }
+    value_done(js);
+    return true;
+}
+
+static bool start_value(json_stream_t *js, char c)
+{
+    js->value_len = 0;
+    js->in_key = 0;
+
+    if (c == '{' || c == '[') {
+        return push(js, c);
+    } else if (c == '"') {
+        js->state = S_STRING;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        append(js, c);
+        js->state = S_NUMBER;
+    } else if (c == 't' || c == 'f' || c == 'n') {
+        append(js, c);
+        js->state = S_LITERAL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Process one character; returns false on syntax error
+static bool step(json_stream_t *js, char c)
+{
+    switch (js->state) {
+        case S_VALUE:
+            return is_space(c) || start_value(js, c);
+
+        case S_VALUE_OR_END:
+            if (is_space(c)) {
+                return true;
+            }
+            if (c == ']') {
+                return pop(js, c);
+            }
+            return start_value(js, c);
+
+        case S_KEY_OR_END:
+        case S_KEY:
+            if (is_space(c)) {
+                return true;
+            }
+            if (c == '}' && js->state == S_KEY_OR_END) {
+                return pop(js, c);
+            }
+            if (c != '"') {
+                return false;
+            }
+            js->value_len = 0;
+            js->in_key = 1;
+            js->state = S_STRING;
+            return true;
+
+        case S_COLON:
+            if (is_space(c)) {
+                return true;
+            }
+            if (c != ':') {
+                return false;
+            }
+            js->state = S_VALUE;
+            return true;
+
+        case S_STRING:
+            if (c == '\\') {
+                js->state = S_ESCAPE;
+            } else if (c == '"') {
+                if (js->in_key) {
+                    js->value[js->value_len] = '\0';
+                    memcpy(js->key[js->depth - 1], js->value, js->value_len + 1);
+                    js->in_key = 0;
+                    js->value_len = 0;
+                    js->state = S_COLON;
+                } else {
+                    emit(js, JSON_STREAM_STRING);
+                    value_done(js);
+                }
+            } else if ((unsigned char)c < 0x20) {
+                return false;
+            } else {
+                append(js, c);
+            }
+            return true;
+
+        case S_ESCAPE:
+            js->state = S_STRING;
+            switch (c) {
+                case '"':
+                case '\\':
+                case '/':
+                    append(js, c);
+                    break;
+                case 'b': append(js, '\b'); break;
+                case 'f': append(js, '\f'); break;
+                case 'n': append(js, '\n'); break;
+                case 'r': append(js, '\r'); break;
+                case 't': append(js, '\t'); break;
+                case 'u':
+                    js->unicode_digits = 0;
+                    js->unicode_code = 0;
+                    js->state = S_UNICODE;
+                    break;
+                default:
+                    return false;
+            }
+            return true;
+
+        case S_UNICODE: {
+            int digit;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                digit = c - 'A' + 10;
+            } else {
+                return false;
+            }
+            js->unicode_code = (js->unicode_code << 4) | digit;
+            if (++js->unicode_digits == 4) {
+                // The display font is ASCII only
+                append(js, js->unicode_code < 0x80 ? (char)js->unicode_code : '?');
+                js->state = S_STRING;
+            }
+            return true;
+        }
+
+        case S_NUMBER:
+            if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' ||
+                c == '+' || c == '-') {
+                append(js, c);
+                return true;
+            }
+            emit(js, JSON_STREAM_NUMBER);
+            value_done(js);
+            return step(js, c);
+
+        case S_LITERAL:
+            if (c >= 'a' && c <= 'z') {
+                append(js, c);
+                return true;
+            }
+            return finish_literal(js) && step(js, c);
+
+        case S_AFTER_VALUE:
+            if (is_space(c)) {
+                return true;
+            }
+            if (c == ',') {
+                if (js->container[js->depth - 1] == '{') {
+                    js->state = S_KEY;
+                } else {
+                    js->index[js->depth - 1]++;
+                    js->state = S_VALUE;
+                }
+                return true;
+            }
+            if (c == '}' || c == ']') {
+                return pop(js, c);
+            }
+            return false;
+
+        case S_DONE:
+            return is_space(c) || c == '\0';
+
+        default:
+            return false;
+    }
+}
+
+void json_stream_init(json_stream_t *js, json_stream_value_cb_t cb, void *ctx)
+{
+    memset(js, 0, sizeof(*js));
+    js->state = S_VALUE;
+    js->cb = cb;
+    js->ctx = ctx;
+}
+
+bool json_stream_feed(json_stream_t *js, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && !js->error; i++) {
+        if (!step(js, data[i])) {
+            js->error = 1;
+        }
+    }
+    return !js->error;
+}
+
+json_stream_status_t json_stream_finish(json_stream_t *js)
+{
+    // A bare top-level number or literal only ends with the input
+    if (!js->error && js->depth == 0) {
+        if (js->state == S_NUMBER) {
+            emit(js, JSON_STREAM_NUMBER);
+            value_done(js);
+        } else if (js->state == S_LITERAL && !finish_literal(js)) {
+            js->error = 1;
+        }
+    }
+
+    if (js->error) {
+        return JSON_STREAM_SYNTAX_ERROR;
+    }
+    return js->done ? JSON_STREAM_COMPLETE : JSON_STREAM_INCOMPLETE;
+}
+
+bool json_stream_key_is(const json_stream_t *js, int level, const char *key)
+{
+    if (level < 0 || level >= js->depth || js->container[level] != '{') {
+        return false;
+    }
+    return strcmp(js->key[level], key) == 0;
+}
+
+int json_stream_index(const json_stream_t *js, int level)
+{
+    if (level < 0 || level >= js->depth) {
+        return -1;
+    }
+    return js->index[level];
+}
+
+bool json_stream_number_to_fixed(const char *text, int decimals, int32_t *out)
+{
+    const char *p = text;
+    bool negative = false;
+    int64_t mantissa = 0;
+    int exponent = 0;       // Power of ten applied to mantissa
+    int digits = 0;
+
+    if (*p == '-') {
+        negative = true;
+        p++;
+    }
+    for (; *p >= '0' && *p <= '9'; p++, digits++) {
+        if (mantissa < 100000000000000000LL) {
+            mantissa = mantissa * 10 + (*p - '0');
+        } else {
+            exponent++;
+        }
+    }
+    if (*p == '.') {
+        for (p++; *p >= '0' && *p <= '9'; p++, digits++) {
+            if (mantissa < 100000000000000000LL) {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if (digits == 0) {
+        return false;
+    }
+    if (*p == 'e' || *p == 'E') {
+        bool exp_negative = false;
+        int exp_value = 0;
+        p++;
+        if (*p == '+' || *p == '-') {
+            exp_negative = (*p == '-');
+            p++;
+        }
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        for (; *p >= '0' && *p <= '9'; p++) {
+            if (exp_value < 1000) {
+                exp_value = exp_value * 10 + (*p - '0');
+            }
+        }
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+    if (*p != '\0') {
+        return false;
+    }
+
+    // Scale mantissa * 10^exponent to the requested number of decimals
+    int shift = exponent + decimals;
+    if (shift >= 0) {
+        for (; shift > 0 && mantissa != 0; shift--) {
+            mantissa *= 10;
+            if (mantissa > INT32_MAX) {
+                return false;
+            }
+        }
+    } else if (shift < -18) {
+        mantissa = 0;
+    } else {
+        int64_t divisor = 1;
+        for (; shift < 0; shift++) {
+            divisor *= 10;
+        }
+        mantissa = (mantissa + divisor / 2) / divisor;
+    }
+    if (mantissa > INT32_MAX) {
+        return false;
+    }
+
+    *out = negative ? -(int32_t)mantissa : (int32_t)mantissa;
+    return true;
+}
@@ -0,0 +1,319 @@
+#include "owm_parser.h"
+#include <string.h>
+#include <stdlib.h>
+
+// Fields collected for one weather entry
+#define OWM_HAS_TEMP 0x01
+#define OWM_HAS_MAIN 0x02
+#define OWM_HAS_DESC 0x04
+#define OWM_HAS_ID   0x08
+#define OWM_HAS_ALL  (OWM_HAS_TEMP | OWM_HAS_MAIN | OWM_HAS_DESC)
+#define OWM_HAS_LOCATION (OWM_HAS_TEMP | OWM_HAS_MAIN | OWM_HAS_ID)
+
+// Forecast list entries captured while streaming. With cnt=8 (24 hours,
+// 3-hour intervals) we show entries 2 and 4 (~6h and ~12h ahead), falling
+// back to earlier entries when the list is shorter.
+static const int forecast_list_index[OWM_PARSER_MAX_ITEMS] = {0, 1, 2, 4};
+
+static weather_condition_t parse_weather_condition(const char *main)
+{
+    if (strcmp(main, "Clear") == 0) {
+        return WEATHER_CLEAR;
+    } else if (strcmp(main, "Clouds") == 0) {
+        return WEATHER_CLOUDS;
+    } else if (strcmp(main, "Rain") == 0) {
+        return WEATHER_RAIN;
+    } else if (strcmp(main, "Drizzle") == 0) {
+        return WEATHER_DRIZZLE;
+    } else if (strcmp(main, "Thunderstorm") == 0) {
+        return WEATHER_THUNDERSTORM;
+    } else if (strcmp(main, "Snow") == 0) {
+        return WEATHER_SNOW;
+    } else if (strstr(main, "Mist") != NULL || strstr(main, "Fog") != NULL) {
+        return WEATHER_MIST;
+    }
+    return WEATHER_UNKNOWN;
+}
+
+static int forecast_slot(int list_index)
+{
+    for (int i = 0; i < OWM_PARSER_MAX_ITEMS; i++) {
+        if (forecast_list_index[i] == list_index) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Group entries are full current-weather objects under "list"[i]
+static void owm_location_value(owm_parser_t *p, const json_stream_t *js, json_stream_type_t type,
+                               const char *value)
+{
+    if (js->depth < 3 || !json_stream_key_is(js, 0, "list")) {
+        return;
+    }
+    int index = json_stream_index(js, 1);
+    if (index + 1 > p->list_count) {
+        p->list_count = index + 1;
+    }
+    if (index < 0 || index >= p->location_max) {
+        return;
+    }
+
+    weather_location_t *location = &p->locations[index];
+    int level = js->depth - 2;
+    int32_t number;
+
+    if (level == 1 && type == JSON_STREAM_NUMBER && json_stream_key_is(js, 2, "id")) {
+        if (json_stream_number_to_fixed(value, 0, &number)) {
+            location->city_id = number;
+            p->location_fields[index] |= OWM_HAS_ID;
+        }
+    } else if (level == 1 && type == JSON_STREAM_STRING && json_stream_key_is(js, 2, "name")) {
+        strncpy(location->name, value, sizeof(location->name) - 1);
+        location->name[sizeof(location->name) - 1] = '\0';
+    } else if (level == 1 && type == JSON_STREAM_NUMBER && json_stream_key_is(js, 2, "dt")) {
+        if (json_stream_number_to_fixed(value, 0, &number)) {
+            location->dt = number;
+        }
+    } else if (level == 2 && type == JSON_STREAM_NUMBER &&
+               json_stream_key_is(js, 2, "main") && json_stream_key_is(js, 3, "temp")) {
+        if (json_stream_number_to_fixed(value, 1, &number) &&
+            number >= INT16_MIN && number <= INT16_MAX) {
+            location->temp = (int16_t)number;
+            p->location_fields[index] |= OWM_HAS_TEMP;
+        }
+    } else if (level == 3 && type == JSON_STREAM_STRING && json_stream_key_is(js, 2, "weather") &&
+               json_stream_index(js, 3) == 0 && json_stream_key_is(js, 4, "main")) {
+        location->condition = parse_weather_condition(value);
+        p->location_fields[index] |= OWM_HAS_MAIN;
+    }
+}
+
+static void owm_value_cb(void *ctx, const json_stream_t *js, json_stream_type_t type, const char *value)
+{
+    owm_parser_t *p = (owm_parser_t *)ctx;
+    int base = 0;
+    int slot = 0;
+
+    if (p->kind == OWM_RESPONSE_GROUP) {
+        owm_location_value(p, js, type, value);
+        return;
+    }
+
+    // Forecast entries live under "list"[i]
+    if (p->kind == OWM_RESPONSE_FORECAST) {
+        if (js->depth < 3 || !json_stream_key_is(js, 0, "list")) {
+            return;
+        }
+        int list_index = json_stream_index(js, 1);
+        if (list_index + 1 > p->list_count) {
+            p->list_count = list_index + 1;
+        }
+        slot = forecast_slot(list_index);
+        if (slot < 0) {
+            return;
+        }
+        base = 2;
+    }
+
+    weather_forecast_t *item = &p->items[slot];
+    int level = js->depth - base;
+    int32_t number;
+
+    if (level == 1 && type == JSON_STREAM_NUMBER && json_stream_key_is(js, base, "dt")) {
+        if (json_stream_number_to_fixed(value, 0, &number)) {
+            item->dt = number;
+        }
+    } else if (level == 2 && type == JSON_STREAM_NUMBER &&
+               json_stream_key_is(js, base, "main") && json_stream_key_is(js, base + 1, "temp")) {
+        if (json_stream_number_to_fixed(value, 1, &number) &&
+            number >= INT16_MIN && number <= INT16_MAX) {
+            item->temp = (int16_t)number;
+            p->fields[slot] |= OWM_HAS_TEMP;
+        }
+    } else if (level == 3 && type == JSON_STREAM_STRING &&
+               json_stream_key_is(js, base, "weather") && json_stream_index(js, base + 1) == 0) {
+        if (json_stream_key_is(js, base + 2, "main")) {
+            item->condition = parse_weather_condition(value);
+            p->fields[slot] |= OWM_HAS_MAIN;
+        } else if (json_stream_key_is(js, base + 2, "description")) {
+            strncpy(item->description, value, sizeof(item->description) - 1);
+            item->description[sizeof(item->description) - 1] = '\0';
+            p->fields[slot] |= OWM_HAS_DESC;
+        }
+    }
+}
+
+static bool owm_parser_consume(owm_parser_t *p, const void *data, size_t len)
+{
+    p->body_bytes += len;
+    return json_stream_feed(&p->json, (const char *)data, len);
+}
+
+static int inflate_output_cb(void *ctx, const uint8_t *data, size_t len)
+{
+    return owm_parser_consume((owm_parser_t *)ctx, data, len) ? 0 : -1;
+}
+
+void owm_parser_init(owm_parser_t *p, owm_response_kind_t kind)
+{
+    memset(p, 0, sizeof(*p));
+    p->kind = kind;
+    json_stream_init(&p->json, owm_value_cb, p);
+}
+
+void owm_parser_set_locations(owm_parser_t *p, weather_location_t *locations, int count)
+{
+    if (count > WEATHER_MAX_LOCATIONS) {
+        count = WEATHER_MAX_LOCATIONS;
+    }
+    memset(locations, 0, count * sizeof(weather_location_t));
+    p->locations = locations;
+    p->location_max = count;
+}
+
+bool owm_parser_enable_gzip(owm_parser_t *p)
+{
+    if (p->gzip != NULL) {
+        return true;
+    }
+    p->gzip = malloc(sizeof(gzip_inflate_t));
+    if (p->gzip == NULL) {
+        p->no_memory = true;
+        return false;
+    }
+    p->heap_bytes += sizeof(gzip_inflate_t);
+    gzip_inflate_init(p->gzip, inflate_output_cb, p);
+    return true;
+}
+
+void owm_parser_feed(owm_parser_t *p, const void *data, size_t len)
+{
+    p->wire_bytes += len;
+
+    if (p->no_memory) {
+        return;
+    }
+    if (p->gzip == NULL) {
+        owm_parser_consume(p, data, len);
+        return;
+    }
+    if (p->gzip_status == GZIP_INFLATE_OK) {
+        p->gzip_status = gzip_inflate_feed(p->gzip, data, len);
+    }
+}
+
+static owm_parse_status_t current_result(owm_parser_t *p, weather_forecast_t out[2])
+{
+    if (p->fields[0] != OWM_HAS_ALL) {
+        return OWM_PARSE_MISSING_FIELDS;
+    }
+    out[0] = p->items[0];
+    return OWM_PARSE_OK;
+}
+
+static owm_parse_status_t group_result(owm_parser_t *p)
+{
+    int complete = 0;
+
+    for (int i = 0; i < p->location_max; i++) {
+        p->locations[i].valid = (p->location_fields[i] == OWM_HAS_LOCATION);
+        complete += p->locations[i].valid;
+    }
+    return (complete > 0) ? OWM_PARSE_OK : OWM_PARSE_MISSING_FIELDS;
+}
+
+static owm_parse_status_t forecast_result(owm_parser_t *p, weather_forecast_t out[2])
+{
+    if (p->list_count < 2) {
+        return OWM_PARSE_MISSING_FIELDS;
+    }
+
+    // Prefer list entries 2 and 4; shorter lists use 1 and 2, or 0 and 1
+    int slots[2];
+    if (p->list_count > 4) {
+        slots[0] = forecast_slot(2);
+        slots[1] = forecast_slot(4);
+    } else if (p->list_count > 2) {
+        slots[0] = forecast_slot(1);
+        slots[1] = forecast_slot(2);
+    } else {
+        slots[0] = forecast_slot(0);
+        slots[1] = forecast_slot(1);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (p->fields[slots[i]] != OWM_HAS_ALL) {
+            return OWM_PARSE_MISSING_FIELDS;
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        out[i] = p->items[slots[i]];
+    }
+    return OWM_PARSE_OK;
+}
+
+owm_parse_status_t owm_parser_finish(owm_parser_t *p, weather_forecast_t out[2])
+{
+    bool gzip = (p->gzip != NULL);
+
+    free(p->gzip);
+    p->gzip = NULL;
+
+    if (p->no_memory) {
+        return OWM_PARSE_NO_MEMORY;
+    }
+    // A JSON error aborts the inflater, so report it as such rather than as a decode error
+    if (p->json.error) {
+        return OWM_PARSE_SYNTAX_ERROR;
+    }
+    if (gzip && p->gzip_status != GZIP_INFLATE_DONE) {
+        if (p->gzip_status == GZIP_INFLATE_OK) {
+            return OWM_PARSE_TRUNCATED;
+        }
+        return (p->gzip_status == GZIP_INFLATE_ERR_WINDOW) ? OWM_PARSE_WINDOW_ERROR
+                                                           : OWM_PARSE_DECODE_ERROR;
+    }
+
+    switch (json_stream_finish(&p->json)) {
+        case JSON_STREAM_COMPLETE:
+            break;
+        case JSON_STREAM_INCOMPLETE:
+            return OWM_PARSE_TRUNCATED;
+        default:
+            return OWM_PARSE_SYNTAX_ERROR;
+    }
+
+    if (p->kind == OWM_RESPONSE_GROUP) {
+        return group_result(p);
+    } else if (p->kind == OWM_RESPONSE_FORECAST) {
+        return forecast_result(p, out);
+    }
+    return current_result(p, out);
+}
+
+owm_parse_status_t owm_parse_buffer(owm_parser_t *p, owm_response_kind_t kind, bool gzip,
+                                    const void *data, size_t len, weather_forecast_t out[2])
+{
+    owm_parser_init(p, kind);
+    if (gzip) {
+        owm_parser_enable_gzip(p);
+    }
+    owm_parser_feed(p, data, len);
+    return owm_parser_finish(p, out);
+}
+
+const char *owm_parse_status_name(owm_parse_status_t status)
+{
+    switch (status) {
+        case OWM_PARSE_OK:             return "ok";
+        case OWM_PARSE_TRUNCATED:      return "truncated";
+        case OWM_PARSE_SYNTAX_ERROR:   return "JSON syntax error";
+        case OWM_PARSE_DECODE_ERROR:   return "gzip decode error";
+        case OWM_PARSE_WINDOW_ERROR:   return "gzip window too small";
+        case OWM_PARSE_NO_MEMORY:      return "no memory for inflate state";
+        case OWM_PARSE_MISSING_FIELDS: return "missing fields";
+        default:                       return "unknown";
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef GZIP_INFLATE_H
+#define GZIP_INFLATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Streaming gzip (RFC 1952 / RFC 1951) decoder with a small fixed window.
+ *
+ * Compressed input is pushed in arbitrary chunks as it arrives from the
+ * network; decoded bytes are handed to the output callback straight out of
+ * the window, so neither the compressed nor the decoded body is ever
+ * buffered as a whole. Back-references further than the window are rejected.
+ */
+
+#ifdef CONFIG_OWM_GZIP_WINDOW_BITS
+#define GZIP_INFLATE_WINDOW_BITS CONFIG_OWM_GZIP_WINDOW_BITS
+#else
+#define GZIP_INFLATE_WINDOW_BITS 13
+#endif
+#define GZIP_INFLATE_WINDOW_SIZE (1u << GZIP_INFLATE_WINDOW_BITS)
+
+typedef enum {
+    GZIP_INFLATE_OK = 0,        // Input consumed, more expected
+    GZIP_INFLATE_DONE,          // End of gzip member reached, trailer verified
+    GZIP_INFLATE_ERR_FORMAT,    // Bad header, block type or Huffman code
+    GZIP_INFLATE_ERR_WINDOW,    // Back-reference beyond our window
+    GZIP_INFLATE_ERR_CHECKSUM,  // CRC32 or ISIZE mismatch
+    GZIP_INFLATE_ERR_ABORTED,   // Output callback asked to stop
+} gzip_inflate_status_t;
+
+/**
+ * @brief Output callback, called with decoded data in order
+ * @return 0 to continue, non-zero to abort decoding
+ */
+typedef int (*gzip_inflate_output_cb_t)(void *ctx, const uint8_t *data, size_t len);
+
+typedef struct {
+    int16_t count[16];          // Number of codes of each length
+    int16_t symbol[288];        // Symbols ordered by code
+} gzip_huffman_t;
+
+typedef struct {
+    // Decoder state
+    uint8_t state;
+    uint8_t last_block;
+    uint16_t counter;           // Generic counter for the current state
+    uint16_t header_flags;
+    uint16_t nlen, ndist, ncode;
+    uint16_t length;            // Pending match or stored block length
+    uint16_t symbol;            // Pending length/distance symbol
+    uint32_t trailer[2];
+
+    // Bit accumulator
+    uint32_t bitbuf;
+    uint8_t bitcnt;
+    const uint8_t *in;
+    size_t in_len;
+
+    // Output window
+    uint32_t pos;
+    uint32_t flushed;
+    uint32_t total_out;
+    uint32_t crc;
+    gzip_inflate_output_cb_t output;
+    void *ctx;
+    int aborted;
+
+    // Huffman tables (dynamic blocks reuse the same storage as fixed ones)
+    int16_t lengths[320];
+    gzip_huffman_t lencode;
+    gzip_huffman_t distcode;
+
+    uint8_t window[GZIP_INFLATE_WINDOW_SIZE];
+} gzip_inflate_t;
+
+/**
+ * @brief Reset decoder for a new gzip stream
+ */
+void gzip_inflate_init(gzip_inflate_t *z, gzip_inflate_output_cb_t output, void *ctx);
+
+/**
+ * @brief Feed the next chunk of compressed data
+ * @return GZIP_INFLATE_OK while more input is expected, GZIP_INFLATE_DONE at
+ *         the end of the stream, or an error status
+ */
+gzip_inflate_status_t gzip_inflate_feed(gzip_inflate_t *z, const uint8_t *data, size_t len);
+
+/**
+ * @brief Total number of decoded bytes so far
+ */
+static inline uint32_t gzip_inflate_total_out(const gzip_inflate_t *z)
+{
+    return z->total_out;
+}
+
+#endif // GZIP_INFLATE_H
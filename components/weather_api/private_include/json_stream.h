@@ -0,0 +1,96 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Incremental (SAX-style) JSON tokenizer.
+ *
+ * Input is pushed in arbitrary chunks; every scalar value is reported to the
+ * callback together with its path (member key or array index per level), so
+ * callers pick the fields they need without building a document tree.
+ * Memory use is fixed: keys and values longer than the buffers are truncated.
+ */
+
+#define JSON_STREAM_MAX_DEPTH 8
+#define JSON_STREAM_KEY_LEN   16
+#define JSON_STREAM_VALUE_LEN 48
+
+typedef enum {
+    JSON_STREAM_STRING = 0,
+    JSON_STREAM_NUMBER,
+    JSON_STREAM_TRUE,
+    JSON_STREAM_FALSE,
+    JSON_STREAM_NULL,
+} json_stream_type_t;
+
+typedef enum {
+    JSON_STREAM_COMPLETE = 0,   // A full document was parsed
+    JSON_STREAM_INCOMPLETE,     // Input ended before the document was closed
+    JSON_STREAM_SYNTAX_ERROR,   // Malformed JSON or nesting too deep
+} json_stream_status_t;
+
+typedef struct json_stream json_stream_t;
+
+/**
+ * @brief Called for every scalar value
+ * @param value NUL-terminated text (string contents or number/literal text)
+ */
+typedef void (*json_stream_value_cb_t)(void *ctx, const json_stream_t *js,
+                                       json_stream_type_t type, const char *value);
+
+struct json_stream {
+    uint8_t state;
+    uint8_t depth;
+    uint8_t in_key;
+    uint8_t done;
+    uint8_t error;
+    uint8_t value_len;
+    uint8_t unicode_digits;
+    uint16_t unicode_code;
+    char container[JSON_STREAM_MAX_DEPTH];          // '{' or '[' per level
+    char key[JSON_STREAM_MAX_DEPTH][JSON_STREAM_KEY_LEN];
+    int16_t index[JSON_STREAM_MAX_DEPTH];
+    char value[JSON_STREAM_VALUE_LEN];
+    json_stream_value_cb_t cb;
+    void *ctx;
+};
+
+/**
+ * @brief Reset tokenizer for a new document
+ */
+void json_stream_init(json_stream_t *js, json_stream_value_cb_t cb, void *ctx);
+
+/**
+ * @brief Feed the next chunk of the document
+ * @return false once a syntax error has been detected
+ */
+bool json_stream_feed(json_stream_t *js, const char *data, size_t len);
+
+/**
+ * @brief Signal end of input and report whether the document was complete
+ */
+json_stream_status_t json_stream_finish(json_stream_t *js);
+
+/**
+ * @brief Check the member key of the value at nesting level @p level
+ */
+bool json_stream_key_is(const json_stream_t *js, int level, const char *key);
+
+/**
+ * @brief Array index of the value at nesting level @p level (-1 in objects)
+ */
+int json_stream_index(const json_stream_t *js, int level);
+
+/**
+ * @brief Convert JSON number text to a fixed-point integer without floating point
+ * @param text Number text as reported by the callback
+ * @param decimals Number of decimal places to keep (1 = tenths), rounded half away from zero
+ * @param out Result
+ * @return false if the text is not a number or does not fit in 32 bits
+ */
+bool json_stream_number_to_fixed(const char *text, int decimals, int32_t *out);
+
+#endif // JSON_STREAM_H
@@ -0,0 +1,98 @@
+#ifndef OWM_PARSER_H
+#define OWM_PARSER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "weather_api.h"
+#include "gzip_inflate.h"
+#include "json_stream.h"
+
+/*
+ * OpenWeatherMap response parser, independent of the transport.
+ *
+ * The HTTP layer pushes body bytes exactly as received (gzip or plain) in
+ * whatever chunks the network delivers; the parser decodes, tokenizes and
+ * extracts the fields we display. Whole responses already in memory (e.g.
+ * recorded payloads) go through owm_parse_buffer() instead.
+ * Nothing here touches sockets, tasks or timers.
+ */
+
+#define OWM_PARSER_MAX_ITEMS 4
+
+typedef enum {
+    OWM_RESPONSE_CURRENT = 0,       // /data/2.5/weather
+    OWM_RESPONSE_FORECAST,          // /data/2.5/forecast
+    OWM_RESPONSE_GROUP,             // /data/2.5/group, current weather for several cities
+} owm_response_kind_t;
+
+typedef enum {
+    OWM_PARSE_OK = 0,
+    OWM_PARSE_TRUNCATED,            // Body ended before the JSON document closed
+    OWM_PARSE_SYNTAX_ERROR,         // Malformed JSON
+    OWM_PARSE_DECODE_ERROR,         // gzip stream could not be decoded
+    OWM_PARSE_WINDOW_ERROR,         // gzip back-reference beyond our window
+    OWM_PARSE_NO_MEMORY,            // Inflate state could not be allocated
+    OWM_PARSE_MISSING_FIELDS,       // Valid JSON without the fields we need
+} owm_parse_status_t;
+
+typedef struct {
+    json_stream_t json;
+    gzip_inflate_t *gzip;           // Allocated only for gzip-encoded bodies
+    gzip_inflate_status_t gzip_status;
+    bool no_memory;
+    owm_response_kind_t kind;
+    int list_count;                 // Forecast entries seen
+    weather_forecast_t items[OWM_PARSER_MAX_ITEMS];
+    uint8_t fields[OWM_PARSER_MAX_ITEMS];
+    weather_location_t *locations;  // Group responses: list[i] goes to locations[i]
+    int location_max;
+    uint8_t location_fields[WEATHER_MAX_LOCATIONS];
+    size_t wire_bytes;              // Body bytes as received
+    size_t body_bytes;              // Body bytes after decoding
+    size_t heap_bytes;              // Heap held while parsing
+} owm_parser_t;
+
+/**
+ * @brief Reset parser for a new response body
+ */
+void owm_parser_init(owm_parser_t *p, owm_response_kind_t kind);
+
+/**
+ * @brief Mark the body as gzip-encoded; call before the first owm_parser_feed()
+ * @return false if the inflate state could not be allocated
+ */
+bool owm_parser_enable_gzip(owm_parser_t *p);
+
+/**
+ * @brief Set where group response entries are stored; call after owm_parser_init()
+ * @param locations Array cleared and filled in list order; entries with all
+ *                  fields present get valid = 1 in owm_parser_finish()
+ */
+void owm_parser_set_locations(owm_parser_t *p, weather_location_t *locations, int count);
+
+/**
+ * @brief Feed the next chunk of the body as received
+ */
+void owm_parser_feed(owm_parser_t *p, const void *data, size_t len);
+
+/**
+ * @brief End of body: release decoder memory and validate the result
+ * @param out Receives the current weather (1 entry) or the two displayed
+ *            forecast entries; only written on OWM_PARSE_OK. Unused for
+ *            group responses, which fill the location array instead.
+ */
+owm_parse_status_t owm_parser_finish(owm_parser_t *p, weather_forecast_t out[2]);
+
+/**
+ * @brief Parse a complete response held in memory
+ */
+owm_parse_status_t owm_parse_buffer(owm_parser_t *p, owm_response_kind_t kind, bool gzip,
+                                    const void *data, size_t len, weather_forecast_t out[2]);
+
+/**
+ * @brief Short name for a parse status, for logs
+ */
+const char *owm_parse_status_name(owm_parse_status_t status);
+
+#endif // OWM_PARSER_H
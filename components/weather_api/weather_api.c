@@ -1,23 +1,78 @@
 #include "weather_api.h"
+#include <stddef.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include <stdlib.h>
 #include "esp_system.h"
+#include "esp_attr.h"
 #include "esp_log.h"
-#include "esp_http_client.h"
-#include "cJSON.h"
+#include "esp_timer.h"
+#include "net_loop.h"
+#include "net_http.h"
+#include "power_manager.h"
+#include "owm_parser.h"
 
 static const char *TAG = "WEATHER_API";
 
-#define MAX_HTTP_RECV_BUFFER 12288  // 12KB - Increased to handle large forecast responses
+#define OWM_API_HOST "api.openweathermap.org"
+
+#define WEATHER_HTTP_TIMEOUT_MS 10000
+#define WEATHER_DNS_PREFETCH_MS 30000   // Resolve this long before a fetch is due
+#define WEATHER_FIRST_FETCH_MS  1000    // Started once there is an IP; leave the prefetch a head start
+#define WEATHER_RETRY_MS        5000    // Loop timers all taken: try the next step again after this long
+#define WEATHER_FORECAST_COUNT  8       // 3-hour forecast entries requested (24 hours)
+
+// Largest decoded bodies, from recorded responses: a forecast entry is at most
+// 424 bytes and a group entry 525, plus the envelope (cnt=8 forecast: 3418
+// bytes, current weather: 466). Deflate cannot reference further back than
+// the body is long, so a body that fits the inflate window always decodes
+#define OWM_CURRENT_MAX_BYTES       768
+#define OWM_FORECAST_MAX_BYTES      (256 + WEATHER_FORECAST_COUNT * 448)
+#define OWM_GROUP_ENTRY_MAX_BYTES   560
 
 static weather_forecast_t current_weather;
 static weather_forecast_t forecast_data[3];  // Today, tomorrow, day after
 static bool weather_data_valid = false;
 
-static char http_response_buffer[MAX_HTTP_RECV_BUFFER];
-static int http_response_len = 0;
+// Additional sites from CONFIG_OWM_LOCATION_IDS, refreshed by one group request
+static weather_location_t s_locations[WEATHER_MAX_LOCATIONS];
+static int s_location_count = 0;
+static bool s_restored;             // Data came from RTC memory, keep it at init
+
+// Next step of the update cycle, when no loop timer was free to schedule it
+static esp_timer_handle_t s_retry_timer;
+static net_loop_cb_t s_retry_step;
+
+#ifdef CONFIG_DEEP_SLEEP_MODE
+#define WEATHER_RETAINED_MAGIC      0x57544831  // "WTH1"
+#define WEATHER_RETAINED_LOCATIONS  4           // RTC memory is shared with the clock and sensors
+
+// Survives deep sleep; must not be reloaded by the bootloader
+#ifdef RTC_NOINIT_ATTR
+#define WEATHER_RTC_ATTR RTC_NOINIT_ATTR
+#else
+#define WEATHER_RTC_ATTR RTC_DATA_ATTR
+#endif
+
+// What the display needs from the last successful update; descriptions are not kept
+typedef struct {
+    int32_t dt;
+    int16_t temp;
+    uint8_t condition;
+    uint8_t reserved;
+} retained_forecast_t;
+
+typedef struct {
+    uint32_t magic;
+    retained_forecast_t forecast[3];    // Current, then the two forecast periods
+    weather_location_t location[WEATHER_RETAINED_LOCATIONS];
+    uint32_t check;                     // Over everything above
+} weather_retained_t;
+
+static WEATHER_RTC_ATTR weather_retained_t s_retained;
+#endif
+
 
 // Simple URL encoder for city names (handles spaces and basic special chars)
 static void url_encode(const char *src, char *dst, size_t dst_size)
@@ -51,301 +106,474 @@ static void url_encode(const char *src, char *dst, size_t dst_size)
     dst[j] = '\0';
 }
 
-static weather_condition_t parse_weather_condition(const char *main)
+typedef enum {
+    FETCH_IDLE = 0,
+    FETCH_CURRENT,
+    FETCH_FORECAST,
+    FETCH_LOCATIONS,
+} fetch_stage_t;
+
+// One request is in flight at a time; all of this is only touched on the network loop
+static net_http_request_t s_http;
+static owm_parser_t s_parser;
+static bool s_status_ok;
+static int64_t s_parse_us;         // Time spent decoding and parsing the body
+static fetch_stage_t s_stage = FETCH_IDLE;
+static esp_err_t s_current_err = ESP_FAIL;
+static esp_err_t s_forecast_err = ESP_FAIL;
+static weather_location_t *s_location_staging;  // Heap, only while a group request runs
+static uint8_t s_plain_kinds;       // Endpoints asked for uncompressed bodies (bit per response kind)
+static void (*s_update_hook)(void);
+
+static void weather_update_done(void);
+
+static void weather_on_header(void *ctx, const char *key, const char *value)
 {
-    if (strcmp(main, "Clear") == 0) {
-        return WEATHER_CLEAR;
-    } else if (strcmp(main, "Clouds") == 0) {
-        return WEATHER_CLOUDS;
-    } else if (strcmp(main, "Rain") == 0) {
-        return WEATHER_RAIN;
-    } else if (strcmp(main, "Drizzle") == 0) {
-        return WEATHER_DRIZZLE;
-    } else if (strcmp(main, "Thunderstorm") == 0) {
-        return WEATHER_THUNDERSTORM;
-    } else if (strcmp(main, "Snow") == 0) {
-        return WEATHER_SNOW;
-    } else if (strstr(main, "Mist") != NULL || strstr(main, "Fog") != NULL) {
-        return WEATHER_MIST;
-    }
-    return WEATHER_UNKNOWN;
+    owm_parser_t *parser = (owm_parser_t *)ctx;
+
+    ESP_LOGD(TAG, "Header: %s: %s", key, value);
+    if (strcasecmp(key, "Content-Encoding") == 0 && strcasecmp(value, "gzip") == 0) {
+        if (!owm_parser_enable_gzip(parser)) {
+            ESP_LOGE(TAG, "No memory for inflate window (%u bytes)", sizeof(gzip_inflate_t));
+        }
+    }
 }
 
-static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+static void weather_on_body(void *ctx, const uint8_t *data, size_t len)
 {
-    switch(evt->event_id) {
-        case HTTP_EVENT_ON_DATA:
-            // Accept both chunked and non-chunked responses
-            if (http_response_len + evt->data_len < MAX_HTTP_RECV_BUFFER) {
-                memcpy(http_response_buffer + http_response_len, evt->data, evt->data_len);
-                http_response_len += evt->data_len;
-                ESP_LOGD(TAG, "Received %d bytes, total: %d", evt->data_len, http_response_len);
-            } else {
-                ESP_LOGW(TAG, "HTTP response buffer overflow! Current: %d, incoming: %d", 
-                         http_response_len, evt->data_len);
-            }
-            break;
-        case HTTP_EVENT_ERROR:
-            ESP_LOGE(TAG, "HTTP_EVENT_ERROR");
-            break;
-        case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
-            break;
-        case HTTP_EVENT_HEADER_SENT:
-            ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
-            break;
-        case HTTP_EVENT_ON_HEADER:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER: %s: %s", evt->header_key, evt->header_value);
-            break;
-        case HTTP_EVENT_ON_FINISH:
-            ESP_LOGI(TAG, "HTTP_EVENT_ON_FINISH, total received: %d bytes", http_response_len);
-            break;
-        default:
-            break;
+    // Body is decoded and parsed as it arrives, nothing is buffered
+    if (s_http.status == 200) {
+        int64_t start = esp_timer_get_time();
+        s_status_ok = true;
+        owm_parser_feed((owm_parser_t *)ctx, data, len);
+        s_parse_us += esp_timer_get_time() - start;
     }
-    return ESP_OK;
 }
 
-static esp_err_t fetch_current_weather(void)
+static void weather_on_done(void *ctx, esp_err_t err, int status);
+
+// Request URL for each endpoint; false if it does not fit
+static bool weather_url(owm_response_kind_t kind, char *url, size_t size)
 {
-    char url[512];
     char encoded_city[128];
-    
+    int len;
+
     // URL encode the city name to handle spaces and special characters
     url_encode(CONFIG_OWM_CITY, encoded_city, sizeof(encoded_city));
-    
-    snprintf(url, sizeof(url),
-             "http://api.openweathermap.org/data/2.5/weather?q=%s,%s&appid=%s&units=metric",
-             encoded_city, CONFIG_OWM_COUNTRY_CODE, CONFIG_OWM_API_KEY);
 
-    ESP_LOGI(TAG, "Fetching weather from: %s", url);
+    if (kind == OWM_RESPONSE_CURRENT) {
+        len = snprintf(url, size,
+                       "http://" OWM_API_HOST "/data/2.5/weather?q=%s,%s&appid=%s&units=metric",
+                       encoded_city, CONFIG_OWM_COUNTRY_CODE, CONFIG_OWM_API_KEY);
+    } else if (kind == OWM_RESPONSE_FORECAST) {
+        // Request only 8 items (24 hours) to reduce JSON size and parsing complexity
+        len = snprintf(url, size,
+                       "http://" OWM_API_HOST "/data/2.5/forecast?q=%s,%s&appid=%s&units=metric&cnt=%d",
+                       encoded_city, CONFIG_OWM_COUNTRY_CODE, CONFIG_OWM_API_KEY, WEATHER_FORECAST_COUNT);
+    } else {
+        // All sites go into one request: "id=ID1,ID2,..."
+        len = snprintf(url, size, "http://" OWM_API_HOST "/data/2.5/group?id=");
+        for (int i = 0; i < s_location_count && len < (int)size; i++) {
+            len += snprintf(url + len, size - len, "%s%u", i ? "," : "", s_locations[i].city_id);
+        }
+        if (len < (int)size) {
+            len += snprintf(url + len, size - len, "&appid=%s&units=metric", CONFIG_OWM_API_KEY);
+        }
+    }
+    return len > 0 && len < (int)size;
+}
 
-    http_response_len = 0;
-    memset(http_response_buffer, 0, sizeof(http_response_buffer));
+static const char *weather_kind_name(owm_response_kind_t kind)
+{
+    return kind == OWM_RESPONSE_FORECAST ? "forecast" :
+           kind == OWM_RESPONSE_GROUP ? "group" : "weather";
+}
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_event_handler,
-        .timeout_ms = 10000,
+// Start a GET request whose body streams through the OWM parser
+static esp_err_t weather_request_start(owm_response_kind_t kind)
+{
+    static const net_http_handler_t handler = {
+        .on_header = weather_on_header,
+        .on_body = weather_on_body,
+        .on_done = weather_on_done,
+        .ctx = &s_parser,
     };
+    char url[384];
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == NULL) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return ESP_FAIL;
+    if (!weather_url(kind, url, sizeof(url))) {
+        ESP_LOGE(TAG, "Request URL for %s too long", weather_kind_name(kind));
+        return ESP_ERR_INVALID_SIZE;
     }
-    
-    esp_err_t err = esp_http_client_perform(client);
+    ESP_LOGI(TAG, "Fetching %s from: %s", weather_kind_name(kind), url);
+
+    owm_parser_init(&s_parser, kind);
+    if (kind == OWM_RESPONSE_GROUP) {
+        owm_parser_set_locations(&s_parser, s_location_staging, s_location_count);
+    }
+    s_status_ok = false;
+    s_parse_us = 0;
+
+#ifdef CONFIG_OWM_HTTP_GZIP
+    const char *headers = (s_plain_kinds & (1 << kind)) ? NULL : "Accept-Encoding: gzip\r\n";
+#else
+    const char *headers = NULL;
+#endif
+    esp_err_t err = net_http_get(&s_http, url, headers, &handler, WEATHER_HTTP_TIMEOUT_MS);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start HTTP request: %s", esp_err_to_name(err));
+    }
+    return err;
+}
 
+// Validate transport and parse result once a request ends
+static esp_err_t weather_response_finish(owm_parser_t *parser, esp_err_t err, int status,
+                                         weather_forecast_t out[2], owm_parse_status_t *parse_status)
+{
     if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "Current weather HTTP status: %d", status_code);
-        if (status_code == 200) {
-            http_response_buffer[http_response_len] = '\0';
-            
-            // Debug: log first 300 chars of JSON response
-            ESP_LOGI(TAG, "JSON (current): %.300s", http_response_buffer);
-            
-            cJSON *root = cJSON_Parse(http_response_buffer);
-            if (root != NULL) {
-                cJSON *main_obj = cJSON_GetObjectItem(root, "main");
-                cJSON *weather = cJSON_GetObjectItem(root, "weather");
-                cJSON *dt = cJSON_GetObjectItem(root, "dt");
-                
-                if (main_obj && weather && cJSON_IsArray(weather)) {
-                    cJSON *weather_item = cJSON_GetArrayItem(weather, 0);
-                    cJSON *temp = cJSON_GetObjectItem(main_obj, "temp");
-                    cJSON *weather_main = cJSON_GetObjectItem(weather_item, "main");
-                    cJSON *description = cJSON_GetObjectItem(weather_item, "description");
-                    
-                    if (temp && weather_main && description) {
-                        current_weather.temp = temp->valuedouble;
-                        current_weather.condition = parse_weather_condition(weather_main->valuestring);
-                        strncpy(current_weather.description, description->valuestring, 
-                                sizeof(current_weather.description) - 1);
-                        current_weather.dt = dt ? dt->valueint : 0;
-                        
-                        // Debug: log temperature as integer to avoid float printf issues
-                        int temp_int = (int)current_weather.temp;
-                        ESP_LOGI(TAG, "Current weather: %dC, %s", 
-                                 temp_int, current_weather.description);
-                        err = ESP_OK;
-                    } else {
-                        ESP_LOGE(TAG, "Failed to parse weather data - temp:%p, weather_main:%p, desc:%p", 
-                                 temp, weather_main, description);
-                    }
-                }
-                cJSON_Delete(root);
-            }
-        } else {
-            ESP_LOGE(TAG, "HTTP GET request failed with status code: %d", status_code);
+        ESP_LOGI(TAG, "HTTP status: %d", status);
+        if (status != 200 || !s_status_ok) {
+            ESP_LOGE(TAG, "HTTP GET request failed with status code: %d", status);
             err = ESP_FAIL;
         }
     } else {
         ESP_LOGE(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
     }
 
-    esp_http_client_cleanup(client);
+    // Always finish the parser so the inflate state is released
+    *parse_status = owm_parser_finish(parser, out);
+    if (err == ESP_OK && *parse_status != OWM_PARSE_OK) {
+        ESP_LOGE(TAG, "Failed to parse %s response: %s (%u bytes decoded, fields 0x%02X/0x%02X/0x%02X/0x%02X, %d list entries)",
+                 weather_kind_name(parser->kind),
+                 owm_parse_status_name(*parse_status), parser->body_bytes,
+                 parser->fields[0], parser->fields[1], parser->fields[2], parser->fields[3],
+                 parser->list_count);
+        err = ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Timing: DNS %d ms, connect %d ms, first byte %d ms, total %d ms",
+             (int)(s_http.t_resolved - s_http.t_start),
+             (int)(s_http.t_connected - s_http.t_resolved),
+             (int)(s_http.t_first_byte - s_http.t_connected),
+             (int)(s_http.t_done - s_http.t_start));
+    ESP_LOGI(TAG, "Body: %u bytes on wire, %u bytes decoded, parse %d us, parser heap %u bytes",
+             parser->wire_bytes, parser->body_bytes, (int)s_parse_us, parser->heap_bytes);
     return err;
 }
 
-static esp_err_t fetch_forecast(void)
+// esp_timer task: hand the step back to the loop, or wait again
+static void weather_retry_cb(void *arg)
 {
-    char url[512];
-    char encoded_city[128];
-    
-    // URL encode the city name to handle spaces and special characters
-    url_encode(CONFIG_OWM_CITY, encoded_city, sizeof(encoded_city));
-    
-    // Request only 8 items (24 hours) to reduce JSON size and parsing complexity
-    snprintf(url, sizeof(url),
-             "http://api.openweathermap.org/data/2.5/forecast?q=%s,%s&appid=%s&units=metric&cnt=8",
-             encoded_city, CONFIG_OWM_COUNTRY_CODE, CONFIG_OWM_API_KEY);
+    if (net_loop_schedule(s_retry_step, NULL, 0) == NET_LOOP_TIMER_INVALID) {
+        esp_timer_start_once(s_retry_timer, WEATHER_RETRY_MS * 1000);
+    }
+}
+
+// Run the next step of the update cycle on the loop after delay_ms. Loop timers
+// are shared with every network module; if none is free the step is retried
+// from an esp_timer, so the update cycle never stops
+static void weather_schedule(net_loop_cb_t step, uint32_t delay_ms)
+{
+    if (net_loop_schedule(step, NULL, delay_ms) != NET_LOOP_TIMER_INVALID) {
+        return;
+    }
+    uint32_t retry_ms = (delay_ms > WEATHER_RETRY_MS) ? delay_ms : WEATHER_RETRY_MS;
+    ESP_LOGW(TAG, "No loop timer for the next weather step, retrying in %u ms", retry_ms);
+    s_retry_step = step;
+    esp_timer_stop(s_retry_timer);
+    esp_timer_start_once(s_retry_timer, (uint64_t)retry_ms * 1000);
+}
 
-    ESP_LOGI(TAG, "Fetching forecast from: %s", url);
+static void fetch_current_weather(void *arg)
+{
+    ESP_LOGI(TAG, "Updating weather data...");
 
-    http_response_len = 0;
-    memset(http_response_buffer, 0, sizeof(http_response_buffer));
+    // Held until weather_update_done(), across all requests of the update
+    power_radio_acquire();
+    s_stage = FETCH_CURRENT;
+    s_current_err = ESP_FAIL;
+    s_forecast_err = ESP_FAIL;
+    if (weather_request_start(OWM_RESPONSE_CURRENT) != ESP_OK) {
+        weather_update_done();
+    }
+}
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_event_handler,
-        .timeout_ms = 10000,
-    };
+static void fetch_forecast(void *arg)
+{
+    s_stage = FETCH_FORECAST;
+    if (weather_request_start(OWM_RESPONSE_FORECAST) != ESP_OK) {
+        weather_update_done();
+    }
+}
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == NULL) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return ESP_FAIL;
+static void fetch_locations(void *arg)
+{
+    s_location_staging = calloc(s_location_count, sizeof(weather_location_t));
+    if (s_location_staging == NULL) {
+        ESP_LOGE(TAG, "No memory for %d locations", s_location_count);
+        weather_update_done();
+        return;
     }
-    
-    esp_err_t err = esp_http_client_perform(client);
 
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        int content_length = esp_http_client_get_content_length(client);
-        ESP_LOGI(TAG, "Forecast HTTP status: %d, Content-Length: %d, Received: %d", 
-                 status_code, content_length, http_response_len);
-        if (status_code == 200) {
-            http_response_buffer[http_response_len] = '\0';
-            
-            // Debug: log response length and first/last chars of JSON
-            ESP_LOGI(TAG, "JSON (forecast) - Length: %d bytes", http_response_len);
-            ESP_LOGI(TAG, "JSON (forecast) - First 200 chars: %.200s", http_response_buffer);
-            
-            // Show last 200 chars to see if JSON is complete
-            int start = (http_response_len > 200) ? http_response_len - 200 : 0;
-            ESP_LOGI(TAG, "JSON (forecast) - Last 200 chars: %s", &http_response_buffer[start]);
-            
-            cJSON *root = cJSON_Parse(http_response_buffer);
-            
-            if (root == NULL) {
-                const char *error_ptr = cJSON_GetErrorPtr();
-                if (error_ptr != NULL) {
-                    ESP_LOGE(TAG, "JSON parse error before: %.50s", error_ptr);
-                }
-            }
-            
-            if (root != NULL) {
-                cJSON *list = cJSON_GetObjectItem(root, "list");
-
-                if (list && cJSON_IsArray(list)) {
-                    int array_size = cJSON_GetArraySize(list);
-                    
-                    // With cnt=8 (24 hours, 3-hour intervals):
-                    // Index 2 = +6h, Index 4 = +12h, Index 6 = +18h
-                    // We'll use indices 2 and 4 for tomorrow's forecast (morning and afternoon)
-                    int indices[2] = {2, 4};  // ~6 hours and ~12 hours ahead
-
-                    for (int i = 0; i < 2 && i < array_size; i++) {
-                        int idx = (indices[i] < array_size) ? indices[i] : i + 1;
-
-                        cJSON *forecast_item = cJSON_GetArrayItem(list, idx);
-
-                        if (forecast_item) {
-                            cJSON *main_obj = cJSON_GetObjectItem(forecast_item, "main");
-                            cJSON *weather = cJSON_GetObjectItem(forecast_item, "weather");
-                            cJSON *dt = cJSON_GetObjectItem(forecast_item, "dt");
-
-                            if (main_obj && weather && cJSON_IsArray(weather)) {
-                                cJSON *weather_item = cJSON_GetArrayItem(weather, 0);
-                                cJSON *temp = cJSON_GetObjectItem(main_obj, "temp");
-                                cJSON *weather_main = cJSON_GetObjectItem(weather_item, "main");
-                                cJSON *description = cJSON_GetObjectItem(weather_item, "description");
-                                
-                                if (temp && weather_main && description) {
-                                    forecast_data[i].temp = temp->valuedouble;
-                                    forecast_data[i].condition = parse_weather_condition(weather_main->valuestring);
-                                    strncpy(forecast_data[i].description, description->valuestring,
-                                            sizeof(forecast_data[i].description) - 1);
-                                    forecast_data[i].dt = dt ? dt->valueint : 0;
-                                } else {
-                                    ESP_LOGE(TAG, "Failed parsing forecast day %d - missing fields", i);
-                                }
-                            } else {
-                                ESP_LOGE(TAG, "Failed parsing forecast day %d - main_obj or weather invalid", i);
-                            }
-                        } else {
-                            ESP_LOGE(TAG, "Failed to get forecast item at index %d", idx);
-                        }
-                    }
-                    err = ESP_OK;
-                } else {
-                    ESP_LOGE(TAG, "Forecast list not found or not an array");
-                    err = ESP_FAIL;
-                }
-                cJSON_Delete(root);
-            } else {
-                ESP_LOGE(TAG, "Failed to parse forecast JSON");
-                err = ESP_FAIL;
+    s_stage = FETCH_LOCATIONS;
+    if (weather_request_start(OWM_RESPONSE_GROUP) != ESP_OK) {
+        free(s_location_staging);
+        s_location_staging = NULL;
+        weather_update_done();
+    }
+}
+
+// Copy freshly parsed entries into the table, matched by city ID; sites
+// missing from the response keep their previous values
+static void locations_publish(const weather_location_t *staged)
+{
+    int updated = 0;
+
+    for (int i = 0; i < s_location_count; i++) {
+        for (int j = 0; j < s_location_count; j++) {
+            if (staged[j].valid && staged[j].city_id == s_locations[i].city_id) {
+                s_locations[i] = staged[j];
+                updated++;
+                break;
             }
-        } else {
-            ESP_LOGE(TAG, "HTTP GET forecast failed with status code: %d", status_code);
-            err = ESP_FAIL;
         }
+    }
+    ESP_LOGI(TAG, "Updated %d of %d locations", updated, s_location_count);
+}
+
+static void weather_dns_prefetch(void *arg)
+{
+    net_dns_prefetch(OWM_API_HOST);
+}
+
+#ifdef CONFIG_DEEP_SLEEP_MODE
+static uint32_t retained_check(void)
+{
+    const uint32_t *word = (const uint32_t *)&s_retained;
+    uint32_t sum = 0x5A5A5A5A;
+
+    for (size_t i = 0; i < offsetof(weather_retained_t, check) / sizeof(uint32_t); i++) {
+        sum = (sum << 5 | sum >> 27) ^ word[i];
+    }
+    return sum;
+}
+
+static void retained_save(void)
+{
+    for (int i = 0; i < 3; i++) {
+        const weather_forecast_t *f = (i == 0) ? &current_weather : &forecast_data[i - 1];
+        s_retained.forecast[i].dt = f->dt;
+        s_retained.forecast[i].temp = f->temp;
+        s_retained.forecast[i].condition = f->condition;
+        s_retained.forecast[i].reserved = 0;
+    }
+    memset(s_retained.location, 0, sizeof(s_retained.location));
+    for (int i = 0; i < s_location_count && i < WEATHER_RETAINED_LOCATIONS; i++) {
+        s_retained.location[i] = s_locations[i];
+    }
+    s_retained.magic = WEATHER_RETAINED_MAGIC;
+    s_retained.check = retained_check();
+}
+#endif
+
+static void weather_update_done(void)
+{
+    if (s_current_err == ESP_OK && s_forecast_err == ESP_OK) {
+        weather_data_valid = true;
+        ESP_LOGI(TAG, "Weather data updated successfully");
+#ifdef CONFIG_DEEP_SLEEP_MODE
+        retained_save();
+#endif
     } else {
-        ESP_LOGE(TAG, "HTTP GET forecast failed: %s", esp_err_to_name(err));
+        weather_data_valid = false;
+        ESP_LOGW(TAG, "Failed to update weather data");
     }
+    net_dns_cache_stats_t dns;
+    net_dns_cache_get_stats(&dns);
+    ESP_LOGI(TAG, "DNS cache: %u hits, %u queries, %u fallbacks, %u failures",
+             dns.hits, dns.queries, dns.fallbacks, dns.failures);
+    ESP_LOGI(TAG, "Network loop stack free: %u bytes, heap free: %u bytes",
+             net_loop_stack_free(), esp_get_free_heap_size());
 
-    esp_http_client_cleanup(client);
-    return err;
+    if (s_update_hook != NULL) {
+        s_update_hook();
+    }
+
+    // Wait for next update, refreshing the API address in the background first;
+    // the radio sleeps in between and is woken ahead of both
+    s_stage = FETCH_IDLE;
+    power_radio_release();
+    power_radio_expect(CONFIG_OWM_UPDATE_INTERVAL * 60 * 1000 - WEATHER_DNS_PREFETCH_MS);
+    power_radio_expect(CONFIG_OWM_UPDATE_INTERVAL * 60 * 1000);
+    // The prefetch is only a head start; the fetch resolves the name itself if it was dropped
+    net_loop_schedule(weather_dns_prefetch, NULL,
+                      CONFIG_OWM_UPDATE_INTERVAL * 60 * 1000 - WEATHER_DNS_PREFETCH_MS);
+    weather_schedule(fetch_current_weather, CONFIG_OWM_UPDATE_INTERVAL * 60 * 1000);
 }
 
-static void weather_update_task(void *pvParameters)
+// Called on the network loop when a request completes (or fails)
+static void weather_on_done(void *ctx, esp_err_t err, int status)
 {
-    while (1) {
-        vTaskDelay(pdMS_TO_TICKS(10000));  // Wait 10 seconds before first update
-        
-        ESP_LOGI(TAG, "Updating weather data...");
-        
-        esp_err_t err1 = fetch_current_weather();
-        vTaskDelay(pdMS_TO_TICKS(1000));  // Small delay between requests
-        esp_err_t err2 = fetch_forecast();
-        
-        if (err1 == ESP_OK && err2 == ESP_OK) {
-            weather_data_valid = true;
-            ESP_LOGI(TAG, "Weather data updated successfully");
+    owm_parser_t *parser = (owm_parser_t *)ctx;
+    owm_response_kind_t kind = parser->kind;
+    owm_parse_status_t parse_status;
+    weather_forecast_t result[2];
+
+    err = weather_response_finish(parser, err, status, result, &parse_status);
+
+    // A body larger than expected may be compressed with back-references
+    // beyond our window. Ask that endpoint for plain bodies from now on and
+    // repeat the request at once, so this update does not fail too
+    if (err != ESP_OK && parse_status == OWM_PARSE_WINDOW_ERROR && !(s_plain_kinds & (1 << kind))) {
+        s_plain_kinds |= 1 << kind;
+        ESP_LOGW(TAG, "%s response needs a gzip window over %d bytes, requesting it uncompressed",
+                 weather_kind_name(kind), 1 << GZIP_INFLATE_WINDOW_BITS);
+        if (weather_request_start(kind) == ESP_OK) {
+            return;
+        }
+    }
+
+    if (s_stage == FETCH_CURRENT) {
+        s_current_err = err;
+        if (err == ESP_OK) {
+            current_weather = result[0];
+            ESP_LOGI(TAG, "Current weather: %s%d.%dC, %s",
+                     current_weather.temp < 0 ? "-" : "",
+                     abs(current_weather.temp) / 10, abs(current_weather.temp) % 10,
+                     current_weather.description);
+        }
+        s_stage = FETCH_IDLE;
+        weather_schedule(fetch_forecast, 1000);  // Small delay between requests
+    } else if (s_stage == FETCH_FORECAST) {
+        s_forecast_err = err;
+        if (err == ESP_OK) {
+            memcpy(forecast_data, result, sizeof(result));
+        }
+        s_stage = FETCH_IDLE;
+        if (s_location_count > 0) {
+            weather_schedule(fetch_locations, 1000);
         } else {
-            weather_data_valid = false;
-            ESP_LOGW(TAG, "Failed to update weather data");
+            weather_update_done();
         }
-        
-        // Wait for next update
-        vTaskDelay(pdMS_TO_TICKS(CONFIG_OWM_UPDATE_INTERVAL * 60 * 1000));
+    } else if (s_stage == FETCH_LOCATIONS) {
+        if (err == ESP_OK) {
+            locations_publish(s_location_staging);
+        }
+        free(s_location_staging);
+        s_location_staging = NULL;
+        weather_update_done();
     }
 }
 
-void weather_api_init(void)
+// Parse CONFIG_OWM_LOCATION_IDS ("id,id,...") into the location table
+static void locations_init(void)
+{
+    const char *p = CONFIG_OWM_LOCATION_IDS;
+
+    memset(s_locations, 0, sizeof(s_locations));
+    s_location_count = 0;
+
+    while (*p != '\0') {
+        char *end;
+        unsigned long id = strtoul(p, &end, 10);
+        if (end == p) {
+            p++;  // Skip separators and stray characters
+            continue;
+        }
+        if (s_location_count == WEATHER_MAX_LOCATIONS) {
+            ESP_LOGW(TAG, "Only the first %d location IDs are used", WEATHER_MAX_LOCATIONS);
+            break;
+        }
+        s_locations[s_location_count++].city_id = id;
+        p = end;
+    }
+    if (s_location_count > 0) {
+        ESP_LOGI(TAG, "%d additional locations (%u bytes)", s_location_count,
+                 s_location_count * sizeof(weather_location_t));
+    }
+}
+
+bool weather_api_restore(void)
 {
+#ifdef CONFIG_DEEP_SLEEP_MODE
+    if (s_retained.magic != WEATHER_RETAINED_MAGIC || s_retained.check != retained_check()) {
+        return false;
+    }
     memset(&current_weather, 0, sizeof(current_weather));
     memset(forecast_data, 0, sizeof(forecast_data));
+    locations_init();
+    for (int i = 0; i < 3; i++) {
+        weather_forecast_t *f = (i == 0) ? &current_weather : &forecast_data[i - 1];
+        f->dt = s_retained.forecast[i].dt;
+        f->temp = s_retained.forecast[i].temp;
+        f->condition = s_retained.forecast[i].condition;
+    }
+    // Matched by city ID in case CONFIG_OWM_LOCATION_IDS changed since
+    for (int i = 0; i < s_location_count && i < WEATHER_RETAINED_LOCATIONS; i++) {
+        if (s_retained.location[i].city_id == s_locations[i].city_id) {
+            s_locations[i] = s_retained.location[i];
+        }
+    }
+    weather_data_valid = true;
+    s_restored = true;
+    ESP_LOGI(TAG, "Weather restored from RTC memory");
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Endpoints whose bodies can outgrow the inflate window are asked for plain
+// bodies from the start: a compressed one would cost the window on the heap
+// and then be fetched again. The others only fall back after a window error
+static void plain_kinds_init(void)
+{
+#ifdef CONFIG_OWM_HTTP_GZIP
+    const uint32_t max_bytes[] = {
+        [OWM_RESPONSE_CURRENT] = OWM_CURRENT_MAX_BYTES,
+        [OWM_RESPONSE_FORECAST] = OWM_FORECAST_MAX_BYTES,
+        [OWM_RESPONSE_GROUP] = 64 + s_location_count * OWM_GROUP_ENTRY_MAX_BYTES,
+    };
+
+    for (int kind = 0; kind < 3; kind++) {
+        if (max_bytes[kind] > GZIP_INFLATE_WINDOW_SIZE && !(s_plain_kinds & (1 << kind))) {
+            s_plain_kinds |= 1 << kind;
+            ESP_LOGI(TAG, "%s responses can reach %u bytes, over the %u-byte gzip window: requesting them uncompressed",
+                     weather_kind_name(kind), max_bytes[kind], GZIP_INFLATE_WINDOW_SIZE);
+        }
+    }
+#endif
+}
+
+void weather_api_init(void)
+{
+    if (!s_restored) {
+        memset(&current_weather, 0, sizeof(current_weather));
+        memset(forecast_data, 0, sizeof(forecast_data));
+        locations_init();
+    }
+    plain_kinds_init();
     
-    // Create task with larger stack (8KB) to handle JSON parsing
-    xTaskCreate(weather_update_task, "weather_update", 8192, NULL, 5, NULL);
+    // Fetches run as state machines on the shared network loop, no task of our own
+    ESP_ERROR_CHECK(net_loop_init());
+    if (s_retry_timer == NULL) {
+        const esp_timer_create_args_t retry_args = {
+            .callback = weather_retry_cb,
+            .name = "weather_retry",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&retry_args, &s_retry_timer));
+    }
+    power_radio_expect(WEATHER_FIRST_FETCH_MS);
+    net_loop_schedule(weather_dns_prefetch, NULL, 0);
+    weather_schedule(fetch_current_weather, WEATHER_FIRST_FETCH_MS);
     
     ESP_LOGI(TAG, "Weather API initialized");
 }
 
+void weather_set_update_hook(void (*updated)(void))
+{
+    s_update_hook = updated;
+}
+
 esp_err_t weather_get_current(weather_forecast_t *forecast)
 {
     if (!weather_data_valid || forecast == NULL) {
@@ -371,6 +599,24 @@ esp_err_t weather_get_forecast(int day, weather_forecast_t *forecast)
     return ESP_OK;
 }
 
+int weather_get_location_count(void)
+{
+    return s_location_count;
+}
+
+esp_err_t weather_get_location(int index, weather_location_t *location)
+{
+    if (location == NULL || index < 0 || index >= s_location_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_locations[index].valid) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memcpy(location, &s_locations[index], sizeof(weather_location_t));
+    return ESP_OK;
+}
+
 bool weather_is_valid(void)
 {
     return weather_data_valid;
@@ -2,13 +2,78 @@
 #define WIFI_MANAGER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 
+// Time spent in each phase of the first connection since boot
+typedef struct {
+    bool cached;            // Connected to the AP cached from the last boot, without a scan
+    bool static_ip;         // CONFIG_WIFI_STATIC_IP, no DHCP
+    uint32_t scan_ms;       // 0 when the cached AP was used
+    uint32_t assoc_ms;      // Authentication and association (one step as far as the SDK reports)
+    uint32_t dhcp_ms;       // Connected to IP; near 0 with a static IP
+    uint32_t total_ms;      // wifi_manager_init() to IP, 0 until connected
+    uint32_t attempts;      // Failed attempts before that
+    uint8_t channel;
+} wifi_connect_stats_t;
+
+/*
+ * The connection is supervised for as long as the firmware runs: a failed
+ * attempt or a lost connection is retried at once, then after a delay that
+ * doubles up to CONFIG_WIFI_BACKOFF_MAX_MS, each retry starting with a fresh
+ * scan. Once the AP is back, recovery takes at most that delay plus one
+ * connection. Association and DHCP are bounded by CONFIG_WIFI_IP_TIMEOUT,
+ * and while connected a weak signal triggers a scan for a stronger AP with
+ * the same SSID.
+ */
+
+typedef enum {
+    WIFI_STATE_STARTING = 0,
+    WIFI_STATE_SCANNING,
+    WIFI_STATE_CONNECTING,  // Associating, or associated and waiting for an IP address
+    WIFI_STATE_CONNECTED,
+    WIFI_STATE_BACKOFF,     // Waiting before the next attempt
+} wifi_state_t;
+
+// Link supervision since boot; outages are counted from the first connection on
+typedef struct {
+    wifi_state_t state;
+    uint32_t retries;           // Consecutive failed attempts, 0 while connected
+    uint32_t backoff_ms;        // Delay before the next attempt, while in WIFI_STATE_BACKOFF
+    uint32_t up_ms;             // Current connection, 0 while disconnected
+    uint32_t down_ms;           // Current outage, 0 while connected
+    uint32_t up_ms_total;       // Time connected since wifi_manager_init()
+    uint32_t since_init_ms;
+    uint32_t outages;           // Recovered outages (roams included)
+    uint32_t last_outage_ms;    // Reconnect latency of the last one
+    uint32_t max_outage_ms;
+    uint32_t outage_ms_total;
+    uint32_t roam_scans;        // Scans made because the signal was weak
+    uint32_t roams;             // Moves to a stronger AP
+    int8_t rssi;                // Current AP at the last check
+    uint8_t last_reason;        // Last disconnect reason from the SDK
+} wifi_link_stats_t;
+
 /**
- * @brief Initialize WiFi manager
+ * @brief Initialize WiFi manager and start connecting (does not wait for the connection)
  */
 void wifi_manager_init(void);
 
+/**
+ * @brief Called from the event loop each time an IP address is obtained; set before init
+ */
+void wifi_manager_set_connected_hook(void (*connected)(void));
+
+/**
+ * @brief Phase timings of the first connection (all 0 until it is up)
+ */
+void wifi_manager_get_connect_stats(wifi_connect_stats_t *stats);
+
+/**
+ * @brief Supervisor state, reconnect latency and connected time
+ */
+void wifi_manager_get_link_stats(wifi_link_stats_t *stats);
+
 /**
  * @brief Check if WiFi is connected
  * @return true if connected, false otherwise
@@ -2,15 +2,19 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
 #include "tcpip_adapter.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
 #include "lwip/dns.h"
+#include "lwip/ip4_addr.h"
 
 static const char *TAG = "WIFI_MANAGER";
 
@@ -19,40 +23,387 @@ static EventGroupHandle_t s_wifi_event_group;
 
 /* The event group allows multiple bits for each event, but we only care about two events:
  * - we are connected to the AP with an IP
- * - we failed to connect after the maximum amount of retries */
+ * - we failed to connect after the maximum amount of retries (reconnecting goes on) */
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
 
 static int s_retry_num = 0;
 static bool s_is_connected = false;
+static void (*s_connected_hook)(void);
 
-static void event_handler(void* arg, esp_event_base_t event_base,
-                                int32_t event_id, void* event_data)
+#define WIFI_NVS_NAMESPACE  "wifi"
+#define WIFI_NVS_LINK_KEY   "link"
+#define WIFI_SCAN_MAX_APS   8
+
+#define WIFI_IP_TIMEOUT_MS      (CONFIG_WIFI_IP_TIMEOUT * 1000)
+#define WIFI_ROAM_INTERVAL_MS   (CONFIG_WIFI_ROAM_INTERVAL * 1000)
+
+// AP of the last successful connection, tried first on the next boot so the
+// SDK skips the scan; the SSID detects a changed configuration
+typedef struct {
+    char ssid[32];
+    uint8_t bssid[6];
+    uint8_t channel;
+} wifi_link_t;
+
+static wifi_config_t s_wifi_config;
+static wifi_link_t s_link;
+static bool s_link_cached;          // Current attempt uses the cached AP
+static wifi_connect_stats_t s_stats;
+static int64_t s_init_us;
+static int64_t s_phase_us;          // Start of the phase in progress
+
+// Supervisor: the event handler and the timer both drive the state, under s_lock.
+// The timer is the backoff delay, the IP timeout or the next roaming check,
+// depending on the state.
+static SemaphoreHandle_t s_lock;
+static esp_timer_handle_t s_timer;
+static wifi_state_t s_state;
+static bool s_roam_scan;            // Scan in progress is a roaming check, not a reconnect
+static bool s_roaming;              // Disconnect in progress is ours, to join s_roam_to
+static wifi_link_t s_roam_to;
+static uint32_t s_backoff_ms;
+static wifi_link_stats_t s_link_stats;
+static int64_t s_up_since_us;       // 0 while disconnected
+static int64_t s_down_since_us;     // 0 while connected and before the first connection
+static int64_t s_up_total_us;       // Closed connected periods
+
+static uint32_t phase_ms(void)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t ms = (uint32_t)((now - s_phase_us) / 1000);
+    s_phase_us = now;
+    return ms;
+}
+
+static bool link_load(wifi_link_t *link)
+{
+    size_t len = sizeof(*link);
+    nvs_handle handle;
+    bool ok = false;
+
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    if (nvs_get_blob(handle, WIFI_NVS_LINK_KEY, link, &len) == ESP_OK && len == sizeof(*link)) {
+        ok = strncmp(link->ssid, CONFIG_WIFI_SSID, sizeof(link->ssid)) == 0 && link->channel != 0;
+    }
+    nvs_close(handle);
+    return ok;
+}
+
+// Only written when the AP changed, not on every boot
+static void link_save(const wifi_link_t *link)
+{
+    nvs_handle handle;
+    esp_err_t err = nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &handle);
+
+    if (err == ESP_OK) {
+        err = (link != NULL) ? nvs_set_blob(handle, WIFI_NVS_LINK_KEY, link, sizeof(*link))
+                             : nvs_erase_key(handle, WIFI_NVS_LINK_KEY);
+        if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to update the cached AP: %s", esp_err_to_name(err));
+    }
+}
+
+// Stop the timer, and start it again when ms is not 0
+static void arm_timer(uint32_t ms)
+{
+    esp_timer_stop(s_timer);
+    if (ms > 0) {
+        esp_timer_start_once(s_timer, (uint64_t)ms * 1000);
+    }
+}
+
+// Delay before the given consecutive retry: the first one is immediate, the
+// next ones double from the minimum up to the maximum, minus up to a quarter
+// of random jitter so that stations behind one AP do not retry in step
+static uint32_t backoff_ms(int retry)
+{
+    if (retry <= 1) {
+        return 0;
+    }
+    uint32_t ms = CONFIG_WIFI_BACKOFF_MIN_MS;
+    for (int i = 2; i < retry && ms < CONFIG_WIFI_BACKOFF_MAX_MS; i++) {
+        ms *= 2;
+    }
+    if (ms > CONFIG_WIFI_BACKOFF_MAX_MS) {
+        ms = CONFIG_WIFI_BACKOFF_MAX_MS;
+    }
+    return ms - esp_random() % (ms / 4 + 1);
+}
+
+static void connect_to(const uint8_t *bssid, uint8_t channel)
+{
+    s_state = WIFI_STATE_CONNECTING;
+    s_wifi_config.sta.bssid_set = (bssid != NULL);
+    if (bssid != NULL) {
+        memcpy(s_wifi_config.sta.bssid, bssid, sizeof(s_wifi_config.sta.bssid));
+    }
+    s_wifi_config.sta.channel = channel;
+    esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
+    esp_wifi_connect();
+    // Bounds association as well as DHCP; restarted once associated
+    arm_timer(WIFI_IP_TIMEOUT_MS);
+}
+
+// Our own scan, filtered by SSID, so that its duration can be measured and
+// the strongest AP chosen
+static void start_scan(void)
+{
+    wifi_scan_config_t scan_config = {
+        .ssid = (uint8_t *)CONFIG_WIFI_SSID,
+    };
+
+    s_link_cached = false;
+    s_state = WIFI_STATE_SCANNING;
+    phase_ms();
+    if (esp_wifi_scan_start(&scan_config, false) != ESP_OK) {
+        // Leave the scan to the SDK
+        connect_to(NULL, 0);
+    }
+}
+
+// Connected: look for a better AP only when the current one has become weak
+static void roam_check(void)
+{
+    wifi_ap_record_t ap;
+    wifi_scan_config_t scan_config = {
+        .ssid = (uint8_t *)CONFIG_WIFI_SSID,
+    };
+
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        arm_timer(WIFI_ROAM_INTERVAL_MS);
+        return;
+    }
+    s_link_stats.rssi = ap.rssi;
+    if (ap.rssi >= CONFIG_WIFI_ROAM_RSSI || esp_wifi_scan_start(&scan_config, false) != ESP_OK) {
+        arm_timer(WIFI_ROAM_INTERVAL_MS);
+        return;
+    }
+    ESP_LOGI(TAG, "Signal at %d dBm, looking for a stronger AP", ap.rssi);
+    s_roam_scan = true;
+}
+
+static void roam_scan_done(const wifi_ap_record_t *best)
+{
+    s_roam_scan = false;
+    s_link_stats.roam_scans++;
+    if (s_state != WIFI_STATE_CONNECTED) {
+        return;             // Lost meanwhile; reconnecting scans again
+    }
+    if (best == NULL || memcmp(best->bssid, s_link.bssid, sizeof(s_link.bssid)) == 0 ||
+        best->rssi < s_link_stats.rssi + CONFIG_WIFI_ROAM_HYSTERESIS) {
+        arm_timer(WIFI_ROAM_INTERVAL_MS);
+        return;
+    }
+    ESP_LOGI(TAG, "Roaming to the AP on channel %d (%d dBm, was %d dBm)",
+             best->primary, best->rssi, s_link_stats.rssi);
+    memset(&s_roam_to, 0, sizeof(s_roam_to));
+    memcpy(s_roam_to.bssid, best->bssid, sizeof(s_roam_to.bssid));
+    s_roam_to.channel = best->primary;
+    s_roaming = true;
+    s_link_stats.roams++;
+    s_state = WIFI_STATE_CONNECTING;
+    esp_wifi_disconnect();
+}
+
+static void scan_done(void)
+{
+    static wifi_ap_record_t records[WIFI_SCAN_MAX_APS];  // Too large for the event task's stack
+    uint16_t count = WIFI_SCAN_MAX_APS;
+    const wifi_ap_record_t *best = NULL;
+
+    if (!s_roam_scan && s_state != WIFI_STATE_SCANNING) {
+        return;
+    }
+    if (esp_wifi_scan_get_ap_records(&count, records) == ESP_OK) {
+        for (int i = 0; i < count; i++) {
+            if (strcmp((const char *)records[i].ssid, CONFIG_WIFI_SSID) == 0 &&
+                (best == NULL || records[i].rssi > best->rssi)) {
+                best = &records[i];
+            }
+        }
+    }
+    if (s_roam_scan) {
+        roam_scan_done(best);
+        return;
+    }
+
+    if (s_stats.total_ms == 0) {
+        s_stats.scan_ms += phase_ms();
+    }
+    if (best == NULL) {
+        ESP_LOGW(TAG, "SSID:%s not found by scan", CONFIG_WIFI_SSID);
+        connect_to(NULL, 0);
+        return;
+    }
+    ESP_LOGI(TAG, "Found SSID:%s on channel %d (%d dBm, %d AP(s) in range)", CONFIG_WIFI_SSID,
+             best->primary, best->rssi, count);
+    connect_to(best->bssid, best->primary);
+}
+
+// Close the connected period, if any, and start counting the outage
+static void link_down(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (s_up_since_us != 0) {
+        s_up_total_us += now - s_up_since_us;
+        s_up_since_us = 0;
+        s_down_since_us = now;
+    }
+    s_is_connected = false;
+    xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+}
+
+static void link_up(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (s_down_since_us != 0) {
+        uint32_t outage_ms = (uint32_t)((now - s_down_since_us) / 1000);
+        s_link_stats.outages++;
+        s_link_stats.last_outage_ms = outage_ms;
+        s_link_stats.outage_ms_total += outage_ms;
+        if (outage_ms > s_link_stats.max_outage_ms) {
+            s_link_stats.max_outage_ms = outage_ms;
+        }
+        ESP_LOGI(TAG, "Reconnected after %u ms (%d attempt(s), worst outage %u ms)",
+                 outage_ms, s_retry_num + 1, s_link_stats.max_outage_ms);
+        s_down_since_us = 0;
+    }
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        s_link_stats.rssi = ap.rssi;
+    }
+    s_up_since_us = now;
+    s_retry_num = 0;
+    s_backoff_ms = 0;
+    s_link_cached = false;
+    s_is_connected = true;
+    s_state = WIFI_STATE_CONNECTED;
+    xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT);
+    xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    arm_timer(WIFI_ROAM_INTERVAL_MS);
+}
+
+// Attempt failed or connection lost: retry right away the first time, then
+// with a growing delay, without ever giving up
+static void retry_later(void)
+{
+    s_retry_num++;
+    if (s_retry_num == CONFIG_WIFI_MAXIMUM_RETRY) {
+        xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        ESP_LOGE(TAG, "Failed to connect to SSID:%s after %d attempts, retrying at most every %d ms",
+                 CONFIG_WIFI_SSID, CONFIG_WIFI_MAXIMUM_RETRY, CONFIG_WIFI_BACKOFF_MAX_MS);
+    }
+    s_backoff_ms = backoff_ms(s_retry_num);
+    if (s_backoff_ms == 0) {
+        start_scan();
+        return;
+    }
+    ESP_LOGI(TAG, "Retry to connect to the AP in %u ms (attempt %d)", s_backoff_ms, s_retry_num + 1);
+    s_state = WIFI_STATE_BACKOFF;
+    arm_timer(s_backoff_ms);
+}
+
+static void supervisor_timer_cb(void *arg)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    switch (s_state) {
+        case WIFI_STATE_BACKOFF:
+            start_scan();
+            break;
+
+        case WIFI_STATE_CONNECTING:
+            // Not associated or no address in time: start over rather than wait forever
+            ESP_LOGW(TAG, "Not connected after %d s, reconnecting", CONFIG_WIFI_IP_TIMEOUT);
+            esp_wifi_disconnect();
+            break;
+
+        case WIFI_STATE_CONNECTED:
+            if (!s_roam_scan) {
+                roam_check();
+            }
+            break;
+
+        default:
+            break;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+// Returns true when the connected hook is due, to be called outside the lock
+static bool handle_event(esp_event_base_t event_base, int32_t event_id, void* event_data)
 {
     if (event_base == WIFI_EVENT) {
         switch (event_id) {
             case WIFI_EVENT_STA_START:
                 ESP_LOGI(TAG, "WiFi station started");
-                esp_wifi_connect();
+                if (s_link_cached) {
+                    ESP_LOGI(TAG, "Trying the last AP on channel %d", s_link.channel);
+                    phase_ms();
+                    connect_to(s_link.bssid, s_link.channel);
+                } else {
+                    start_scan();
+                }
+                break;
+
+            case WIFI_EVENT_SCAN_DONE:
+                scan_done();
                 break;
 
             case WIFI_EVENT_STA_DISCONNECTED:
-                s_is_connected = false;
-                if (s_retry_num < CONFIG_WIFI_MAXIMUM_RETRY) {
-                    esp_wifi_connect();
-                    s_retry_num++;
-                    ESP_LOGI(TAG, "Retry to connect to the AP (attempt %d/%d)",
-                             s_retry_num, CONFIG_WIFI_MAXIMUM_RETRY);
+            {
+                wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
+                bool was_up = (s_up_since_us != 0);
+                link_down();
+                arm_timer(0);
+                s_roam_scan = false;
+                s_link_stats.last_reason = event->reason;
+                if (s_stats.total_ms == 0) {
+                    s_stats.attempts++;
+                }
+                if (s_roaming) {
+                    s_roaming = false;
+                    connect_to(s_roam_to.bssid, s_roam_to.channel);
+                } else if (s_link_cached) {
+                    // AP moved or went away: forget it and fall back to a full scan, not counted as a retry
+                    ESP_LOGW(TAG, "Last AP not reachable (reason %d), scanning", event->reason);
+                    link_save(NULL);
+                    start_scan();
                 } else {
-                    xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-                    ESP_LOGE(TAG, "Failed to connect to the AP after %d attempts",
-                             CONFIG_WIFI_MAXIMUM_RETRY);
+                    ESP_LOGW(TAG, "%s (reason %d)", was_up ? "Connection lost" : "Disconnected", event->reason);
+                    retry_later();
                 }
                 break;
+            }
 
             case WIFI_EVENT_STA_CONNECTED:
-                ESP_LOGI(TAG, "Connected to AP, waiting for IP address");
+            {
+                wifi_event_sta_connected_t* event = (wifi_event_sta_connected_t*) event_data;
+                if (s_stats.total_ms == 0) {
+                    s_stats.assoc_ms += phase_ms();
+                    s_stats.channel = event->channel;
+                }
+                ESP_LOGI(TAG, "Connected to AP on channel %d, waiting for IP address", event->channel);
+                arm_timer(WIFI_IP_TIMEOUT_MS);
+
+                wifi_link_t link = { .channel = event->channel };
+                strncpy(link.ssid, CONFIG_WIFI_SSID, sizeof(link.ssid));
+                memcpy(link.bssid, event->bssid, sizeof(link.bssid));
+                if (memcmp(&link, &s_link, sizeof(link)) != 0) {
+                    s_link = link;
+                    link_save(&link);
+                }
                 break;
+            }
 
             default:
                 ESP_LOGW(TAG, "Unhandled WiFi event: %d", event_id);
@@ -66,6 +417,16 @@ static void event_handler(void* arg, esp_event_base_t event_base,
                 ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
                 ESP_LOGI(TAG, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
 
+                if (s_stats.total_ms == 0) {
+                    s_stats.dhcp_ms = phase_ms();
+                    s_stats.total_ms = (uint32_t)((esp_timer_get_time() - s_init_us) / 1000);
+                    s_stats.cached = s_link_cached;
+                    ESP_LOGI(TAG, "Connected in %u ms: scan %u, auth/assoc %u, %s %u (%s AP, %u attempt(s))",
+                             s_stats.total_ms, s_stats.scan_ms, s_stats.assoc_ms,
+                             s_stats.static_ip ? "static IP" : "DHCP", s_stats.dhcp_ms,
+                             s_stats.cached ? "cached" : "scanned", s_stats.attempts + 1);
+                }
+
                 // Configure Google DNS servers (8.8.8.8 and 8.8.4.4) for faster name resolution
                 ip_addr_t dns_primary;
                 ip_addr_t dns_secondary;
@@ -75,14 +436,17 @@ static void event_handler(void* arg, esp_event_base_t event_base,
                 dns_setserver(1, &dns_secondary);
                 ESP_LOGI(TAG, "DNS servers configured: 8.8.8.8 and 8.8.4.4");
 
-                s_retry_num = 0;
-                s_is_connected = true;
-                xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
-                break;
+                link_up();
+                return true;
             }
 
             case IP_EVENT_STA_LOST_IP:
+                // Still associated: DHCP keeps trying until the IP timeout
                 ESP_LOGW(TAG, "Lost IP address");
+                link_down();
+                s_roam_scan = false;
+                s_state = WIFI_STATE_CONNECTING;
+                arm_timer(WIFI_IP_TIMEOUT_MS);
                 break;
 
             default:
@@ -90,11 +454,32 @@ static void event_handler(void* arg, esp_event_base_t event_base,
                 break;
         }
     }
+    return false;
+}
+
+static void event_handler(void* arg, esp_event_base_t event_base,
+                                int32_t event_id, void* event_data)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool connected = handle_event(event_base, event_id, event_data);
+    xSemaphoreGive(s_lock);
+
+    if (connected && s_connected_hook != NULL) {
+        s_connected_hook();
+    }
 }
 
 void wifi_manager_init(void)
 {
+    const esp_timer_create_args_t timer_args = {
+        .callback = supervisor_timer_cb,
+        .name = "wifi_supervisor",
+    };
+
     s_wifi_event_group = xEventGroupCreate();
+    s_lock = xSemaphoreCreateMutex();
+    configASSERT(s_lock != NULL);
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_timer));
 
     tcpip_adapter_init();
 
@@ -105,37 +490,74 @@ void wifi_manager_init(void)
 
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_LOST_IP, &event_handler, NULL));
 
-    wifi_config_t wifi_config = {
+    const wifi_config_t wifi_config = {
         .sta = {
             .ssid = CONFIG_WIFI_SSID,
             .password = CONFIG_WIFI_PASSWORD,
             .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+#ifdef CONFIG_POWER_RADIO_SLEEP
+            .listen_interval = CONFIG_POWER_LISTEN_INTERVAL,
+#endif
         },
     };
+    s_wifi_config = wifi_config;
+    s_link_cached = link_load(&s_link);
+
+#ifdef CONFIG_WIFI_STATIC_IP
+    // With DHCP stopped the SDK reports GOT_IP as soon as the AP accepts us
+    tcpip_adapter_ip_info_t ip_info = { 0 };
+    if (ip4addr_aton(CONFIG_WIFI_STATIC_IP_ADDR, &ip_info.ip) &&
+        ip4addr_aton(CONFIG_WIFI_STATIC_NETMASK, &ip_info.netmask) &&
+        ip4addr_aton(CONFIG_WIFI_STATIC_GATEWAY, &ip_info.gw)) {
+        tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+        tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &ip_info);
+        s_stats.static_ip = true;
+    } else {
+        ESP_LOGE(TAG, "Invalid static IP configuration, using DHCP");
+    }
+#endif
+
+    s_init_us = esp_timer_get_time();
+    s_phase_us = s_init_us;
+    s_state = WIFI_STATE_STARTING;
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config) );
     ESP_ERROR_CHECK(esp_wifi_start() );
 
-    ESP_LOGI(TAG, "WiFi initialization finished.");
-
-    /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
-     * number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above) */
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-            pdFALSE,
-            pdFALSE,
-            portMAX_DELAY);
-
-    /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
-     * happened. */
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "Connected to AP SSID:%s", CONFIG_WIFI_SSID);
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(TAG, "Failed to connect to SSID:%s", CONFIG_WIFI_SSID);
-    } else {
-        ESP_LOGE(TAG, "UNEXPECTED EVENT");
+    // Connecting continues in the event handler; callers that need the network
+    // wait for WIFI_CONNECTED_BIT or the connected hook instead of blocking here
+    ESP_LOGI(TAG, "WiFi initialization finished, connecting to SSID:%s", CONFIG_WIFI_SSID);
+}
+
+void wifi_manager_set_connected_hook(void (*connected)(void))
+{
+    s_connected_hook = connected;
+}
+
+void wifi_manager_get_connect_stats(wifi_connect_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+void wifi_manager_get_link_stats(wifi_link_stats_t *stats)
+{
+    if (s_lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
     }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    *stats = s_link_stats;
+    stats->state = s_state;
+    stats->retries = (uint32_t)s_retry_num;
+    stats->backoff_ms = (s_state == WIFI_STATE_BACKOFF) ? s_backoff_ms : 0;
+    stats->up_ms = s_up_since_us != 0 ? (uint32_t)((now - s_up_since_us) / 1000) : 0;
+    stats->down_ms = s_down_since_us != 0 ? (uint32_t)((now - s_down_since_us) / 1000) : 0;
+    stats->up_ms_total = (uint32_t)((s_up_total_us + (s_up_since_us != 0 ? now - s_up_since_us : 0)) / 1000);
+    stats->since_init_ms = (uint32_t)((now - s_init_us) / 1000);
+    xSemaphoreGive(s_lock);
 }
 
 bool wifi_is_connected(void)
@@ -1,4 +1,5 @@
 #include <string.h>
+#include <time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -6,54 +7,415 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
 
+#include "sensors.h"
 #include "dht22.h"
+#include "sht3x.h"
+#include "net_loop.h"
 #include "ssd1306.h"
 #include "weather_api.h"
 #include "wifi_manager.h"
+#include "power_manager.h"
 #include "time_manager.h"
+#include "datalog.h"
+#include "boot.h"
+#include "duty_cycle.h"
+#include "telemetry.h"
+#include "local_api.h"
+#include "mqtt_pub.h"
 
 static const char *TAG = "WEATHER_STATION";
 
-void app_main(void)
+// Boot milestones; stages below start as soon as the ones they require are reached
+#define BOOT_NVS            BIT0
+#define BOOT_DISPLAY        BIT1
+#define BOOT_WIFI           BIT2    // Radio started, still connecting
+#define BOOT_DATALOG        BIT3
+#define BOOT_SENSORS        BIT4
+#define BOOT_IP             BIT5
+#define BOOT_FIRST_READING  BIT6
+#define BOOT_FIRST_FRAME    BIT7    // Main screen redrawn with local data
+#define BOOT_TIME           BIT8
+#define BOOT_WEATHER        BIT9
+#define BOOT_UPDATE         BIT10   // Weather update round ended, successful or not
+
+static bool s_datalog_ok;
+
+#ifdef CONFIG_DATALOG_ENABLE
+// Sensors are sampled far more often than is worth keeping on flash
+static void log_sensor_reading(int index, const sensor_reading_t *reading, uint8_t updated)
 {
-    ESP_LOGI(TAG, "Starting Weather Station...");
+    static int64_t last_logged_ms[SENSORS_MAX];
+    int64_t now_ms = esp_timer_get_time() / 1000;
+
+    if (!time_is_synced() ||
+        (last_logged_ms[index] != 0 && now_ms - last_logged_ms[index] < CONFIG_DATALOG_SENSOR_INTERVAL * 1000)) {
+        return;
+    }
+    last_logged_ms[index] = now_ms;
+    datalog_append(DATALOG_SENSOR, index,
+                   (updated & SENSOR_CAP(SENSOR_TEMPERATURE)) ? reading->value[SENSOR_TEMPERATURE] : DATALOG_NO_VALUE,
+                   (updated & SENSOR_CAP(SENSOR_HUMIDITY)) ? reading->value[SENSOR_HUMIDITY] : DATALOG_NO_VALUE);
+}
+
+// Source 0 is the configured city, 1.. the additional locations
+static void log_weather(void)
+{
+    weather_forecast_t current;
+    weather_location_t location;
+
+    if (!time_is_synced()) {
+        return;
+    }
+    if (weather_get_current(&current) == ESP_OK) {
+        datalog_append(DATALOG_WEATHER, 0, current.temp, current.condition);
+    }
+    for (int i = 0; i < weather_get_location_count(); i++) {
+        if (weather_get_location(i, &location) == ESP_OK) {
+            datalog_append(DATALOG_WEATHER, i + 1, location.temp, location.condition);
+        }
+    }
+}
+#endif
 
-    // Initialize NVS
+#ifdef CONFIG_MQTT_ENABLE
+static void publish_sensor_reading(int index, const sensor_reading_t *reading, uint8_t updated)
+{
+    static int64_t last_queued_ms[SENSORS_MAX];
+    int64_t now_ms = esp_timer_get_time() / 1000;
+
+    if (last_queued_ms[index] != 0 && now_ms - last_queued_ms[index] < CONFIG_MQTT_SAMPLE_INTERVAL * 1000) {
+        return;
+    }
+    last_queued_ms[index] = now_ms;
+    mqtt_pub_add_sensor(index,
+                        (updated & SENSOR_CAP(SENSOR_TEMPERATURE)) ? reading->value[SENSOR_TEMPERATURE] : MQTT_PUB_NO_VALUE,
+                        (updated & SENSOR_CAP(SENSOR_HUMIDITY)) ? reading->value[SENSOR_HUMIDITY] : MQTT_PUB_NO_VALUE);
+}
+
+// Same sources as the data log
+static void publish_weather(void)
+{
+    weather_forecast_t current;
+    weather_location_t location;
+
+    if (weather_get_current(&current) == ESP_OK) {
+        mqtt_pub_add_weather(0, current.temp, current.condition);
+    }
+    for (int i = 0; i < weather_get_location_count(); i++) {
+        if (weather_get_location(i, &location) == ESP_OK) {
+            mqtt_pub_add_weather(i + 1, location.temp, location.condition);
+        }
+    }
+}
+#endif
+
+static void on_sensor_reading(int index, const sensor_reading_t *reading, uint8_t updated)
+{
+    if (!boot_reached(BOOT_FIRST_READING)) {
+        boot_signal(BOOT_FIRST_READING);
+    }
+#ifdef CONFIG_LOCAL_API_ENABLE
+    local_api_invalidate();
+#endif
+#ifdef CONFIG_DATALOG_ENABLE
+    if (s_datalog_ok) {
+        log_sensor_reading(index, reading, updated);
+    }
+#endif
+#ifdef CONFIG_MQTT_ENABLE
+    publish_sensor_reading(index, reading, updated);
+#endif
+}
+
+static void on_weather_update(void)
+{
+    boot_signal(BOOT_UPDATE);
+    if (weather_is_valid()) {
+        boot_signal(BOOT_WEATHER);
+        ssd1306_refresh();
+#ifdef CONFIG_LOCAL_API_ENABLE
+        local_api_invalidate();
+#endif
+#ifdef CONFIG_MQTT_ENABLE
+        publish_weather();
+#endif
+    }
+#ifdef CONFIG_DATALOG_ENABLE
+    if (s_datalog_ok) {
+        log_weather();
+    }
+#endif
+}
+
+static void on_wifi_connected(void)
+{
+    boot_signal(BOOT_IP);
+}
+
+static void on_time_synced(void)
+{
+    boot_signal(BOOT_TIME);
+    ssd1306_refresh();
+}
+
+// The clock on screen changes once a minute, whatever the page interval
+static void on_clock_tick(EventBits_t events)
+{
+    ssd1306_redraw();
+}
+
+static esp_err_t start_nvs(void)
+{
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES) {
         ESP_ERROR_CHECK(nvs_flash_erase());
         ret = nvs_flash_init();
     }
-    ESP_ERROR_CHECK(ret);
+    return ret;
+}
 
-    // Initialize SSD1306 Display FIRST to clear screen immediately after reboot
-    ESP_LOGI(TAG, "Initializing Display...");
+// Clears whatever the panel showed before the reset
+static esp_err_t start_display(void)
+{
     ssd1306_init();
+    return ESP_OK;
+}
 
-    // Initialize WiFi
-    ESP_LOGI(TAG, "Initializing WiFi...");
+static esp_err_t start_wifi(void)
+{
+    wifi_manager_set_connected_hook(on_wifi_connected);
     wifi_manager_init();
+    // Before the first request: weather and NTP announce theirs from the start
+    power_manager_init();
+    return ESP_OK;
+}
+
+static esp_err_t start_datalog(void)
+{
+#ifdef CONFIG_DATALOG_ENABLE
+    esp_err_t err = datalog_init();
+    s_datalog_ok = (err == ESP_OK);
+    return err;
+#else
+    return ESP_OK;
+#endif
+}
 
-    // Initialize Time
-    ESP_LOGI(TAG, "Initializing Time...");
+// One task samples every sensor in turn; first reads need no network
+static esp_err_t start_sensors(void)
+{
+    sensors_add(&dht22_sensor, CONFIG_DHT22_READ_INTERVAL * 1000);
+#ifdef CONFIG_SHT3X_ENABLE
+    sensors_add(&sht3x_sensor, CONFIG_SHT3X_READ_INTERVAL * 1000);
+#endif
+    sensors_set_defer_hook(net_loop_busy);
+    sensors_set_listener(on_sensor_reading);
+#ifdef CONFIG_DEEP_SLEEP_MODE
+    // History and the latest values carry over from earlier cycles
+    sensors_set_retained(duty_cycle_now_ms);
+#endif
+    return sensors_start();
+}
+
+static esp_err_t show_first_frame(void)
+{
+    ssd1306_refresh();
+    return ESP_OK;
+}
+
+// A clock restored from RTC memory is on screen from the first frame
+static esp_err_t start_clock(void)
+{
+    time_manager_set_sync_hook(on_time_synced);
+    time_manager_set_tick_hook(on_clock_tick);
     time_manager_init();
+    return ESP_OK;
+}
+
+static esp_err_t start_sntp(void)
+{
+    time_manager_start_sync();
+    return ESP_OK;
+}
 
-    // Initialize DHT22 Sensor
-    ESP_LOGI(TAG, "Initializing DHT22...");
-    dht22_init();
+// Counters are kept by each module from boot; this adds CPU shares and the dump
+static esp_err_t start_telemetry(void)
+{
+    return telemetry_init();
+}
+
+#ifdef CONFIG_LOCAL_API_ENABLE
+// Listens on all interfaces, so it can start before there is an address
+static esp_err_t start_local_api(void)
+{
+    return local_api_init();
+}
+#endif
 
-    // Initialize Weather API
-    ESP_LOGI(TAG, "Initializing Weather API...");
+#ifdef CONFIG_MQTT_ENABLE
+// Readings queue from here on; sessions wait for an address and the time
+static esp_err_t start_mqtt(void)
+{
+    return mqtt_pub_init();
+}
+#endif
+
+static esp_err_t start_weather(void)
+{
+    weather_set_update_hook(on_weather_update);
     weather_api_init();
+    return ESP_OK;
+}
+
+// Table order breaks ties between stages that are ready at the same time.
+// Columns: name, requires, provides on return, run, signals later
+static const boot_stage_t boot_stages[] = {
+    { "clock",     0,                                 0,                start_clock,       0 },
+    { "display",   0,                                 BOOT_DISPLAY,     start_display,     0 },
+    { "nvs",       0,                                 BOOT_NVS,         start_nvs,         0 },
+    { "wifi",      BOOT_NVS,                          BOOT_WIFI,        start_wifi,        BOOT_IP },
+    { "datalog",   0,                                 BOOT_DATALOG,     start_datalog,     0 },
+    { "sensors",   0,                                 BOOT_SENSORS,     start_sensors,     BOOT_FIRST_READING },
+    { "frame",     BOOT_DISPLAY | BOOT_FIRST_READING, BOOT_FIRST_FRAME, show_first_frame,  0 },
+    { "telemetry", BOOT_SENSORS,                      0,                start_telemetry,   0 },
+    { "sntp",      BOOT_IP,                           0,                start_sntp,        BOOT_TIME },
+    { "weather",   BOOT_NVS | BOOT_IP,                0,                start_weather,     BOOT_UPDATE | BOOT_WEATHER },
+#ifdef CONFIG_LOCAL_API_ENABLE
+    { "api",       BOOT_WIFI,                         0,                start_local_api,   0 },
+#endif
+#ifdef CONFIG_MQTT_ENABLE
+    { "mqtt",      BOOT_WIFI,                         0,                start_mqtt,        0 },
+#endif
+};
+
+_Static_assert(sizeof(boot_stages) / sizeof(boot_stages[0]) <= BOOT_MAX_STAGES,
+               "boot_stages has more entries than boot_run() accepts");
+
+// Milestones reached outside the stages, shown in the boot timeline
+static const boot_milestone_t boot_milestones[] = {
+    { BOOT_IP,            "ip" },
+    { BOOT_FIRST_READING, "reading" },
+    { BOOT_TIME,          "time sync" },
+    { BOOT_WEATHER,       "weather" },
+};
+
+#ifdef CONFIG_DEEP_SLEEP_MODE
+#define CYCLE_JOB_WEATHER           0
+#define CYCLE_MAX_CLOCK_ERROR_MS    10000   // Sync before the interval if the RTC drifted this far
+
+static esp_err_t start_display_oneshot(void)
+{
+    ssd1306_init_oneshot();
+    return ESP_OK;
+}
+
+static esp_err_t start_cycle_wifi(void)
+{
+    duty_cycle_radio_started();
+    wifi_manager_set_connected_hook(on_wifi_connected);
+    wifi_manager_init();
+    return ESP_OK;
+}
+
+static bool weather_due(bool next_wake)
+{
+    return duty_cycle_job_due(CYCLE_JOB_WEATHER, CONFIG_OWM_UPDATE_INTERVAL * 60, next_wake);
+}
+
+static bool clock_sync_due(bool next_wake)
+{
+    time_clock_stats_t clock;
+    time_t now = time(NULL) + (next_wake ? CONFIG_DEEP_SLEEP_PERIOD : 0);
+
+    time_manager_get_clock_stats(&clock);
+    return clock.last_sync == 0 || clock.error_ms > CYCLE_MAX_CLOCK_ERROR_MS ||
+           now - (time_t)clock.last_sync >= CONFIG_TIME_UPDATE_INTERVAL * 3600;
+}
 
-    ESP_LOGI(TAG, "Weather Station initialized successfully!");
+// One wake from deep sleep: read the sensors, use the network only for what
+// is due, draw the main screen and sleep again. Stages are picked per cycle.
+static void run_cycle(void)
+{
+    boot_stage_t stages[BOOT_MAX_STAGES];
+    boot_milestone_t milestones[4];
+    int stage_count = 0;
+    int milestone_count = 0;
+
+    duty_cycle_begin();
+    start_clock();
+    bool cached = weather_api_restore();
+    bool fetch = weather_due(false) || !cached;
+    bool sync = clock_sync_due(false);
+    bool network = (fetch || sync) && duty_cycle_radio_enabled();
+
+    stages[stage_count++] = (boot_stage_t){ "display", 0, BOOT_DISPLAY, start_display_oneshot };
+    stages[stage_count++] = (boot_stage_t){ "datalog", 0, BOOT_DATALOG, start_datalog };
+    stages[stage_count++] = (boot_stage_t){ "sensors", 0, BOOT_SENSORS, start_sensors, BOOT_FIRST_READING };
+    milestones[milestone_count++] = (boot_milestone_t){ BOOT_FIRST_READING, "reading" };
+    if (network) {
+        stages[stage_count++] = (boot_stage_t){ "nvs", 0, BOOT_NVS, start_nvs };
+        stages[stage_count++] = (boot_stage_t){ "wifi", BOOT_NVS, BOOT_WIFI, start_cycle_wifi, BOOT_IP };
+        milestones[milestone_count++] = (boot_milestone_t){ BOOT_IP, "ip" };
+        if (sync) {
+            stages[stage_count++] = (boot_stage_t){ "sntp", BOOT_IP, 0, start_sntp, BOOT_TIME };
+            milestones[milestone_count++] = (boot_milestone_t){ BOOT_TIME, "time sync" };
+        }
+        if (fetch) {
+            stages[stage_count++] = (boot_stage_t){ "weather", BOOT_NVS | BOOT_IP, 0, start_weather,
+                                                  BOOT_UPDATE | BOOT_WEATHER };
+            milestones[milestone_count++] = (boot_milestone_t){ BOOT_UPDATE, "weather" };
+        }
+    }
 
-    // Main loop handled by individual task managers
-    while(1) {
-        vTaskDelay(pdMS_TO_TICKS(10000));
+    boot_set_deadline(CONFIG_DEEP_SLEEP_MAX_AWAKE * 1000);
+    esp_err_t err = boot_run(stages, stage_count, milestones, milestone_count);
+    if (err != ESP_OK && err != ESP_ERR_TIMEOUT) {
+        // The cycle still ends normally: whatever did start is saved below
+        ESP_LOGW(TAG, "Cycle started incompletely: %s", esp_err_to_name(err));
     }
+
+    if (boot_reached(BOOT_WEATHER)) {
+        duty_cycle_job_done(CYCLE_JOB_WEATHER);
+    } else if (!weather_is_valid()) {
+        weather_api_restore();      // A failed update leaves the cached data on screen
+    }
+    ssd1306_draw_main();
+#ifdef CONFIG_DATALOG_ENABLE
+    if (s_datalog_ok) {
+        datalog_flush();
+    }
+#endif
+    time_manager_save();
+    duty_cycle_sleep(weather_due(true) || clock_sync_due(true));
+}
+#endif
+
+void app_main(void)
+{
+    ESP_LOGI(TAG, "Starting Weather Station...");
+
+#ifdef CONFIG_DEEP_SLEEP_MODE
+    run_cycle();    // Ends in deep sleep
+#endif
+
+    esp_err_t err = boot_run(boot_stages, sizeof(boot_stages) / sizeof(boot_stages[0]),
+                             boot_milestones, sizeof(boot_milestones) / sizeof(boot_milestones[0]));
+    if (err != ESP_OK) {
+        // Stages that did start keep running; the timeline above shows what is missing
+        ESP_LOGE(TAG, "Weather Station started with failures (%s). Free heap: %u bytes",
+                 esp_err_to_name(err), esp_get_free_heap_size());
+        return;
+    }
+
+    ESP_LOGI(TAG, "Weather Station initialized successfully! Free heap: %u bytes",
+             esp_get_free_heap_size());
+
+    // Nothing left for this task: periodic work runs on the scheduler and the
+    // network loop, and returning lets the SDK delete the main task and free
+    // its stack (CONFIG_ESP_MAIN_TASK_STACK_SIZE)
 }
@@ -0,0 +1,280 @@
+// Fixed-point values and integer line drawing against the float code they
+// replaced: checks that both give the same results, then times each.
+//
+// The host has an FPU, so the float columns here are a lower bound; on the
+// ESP8266 every float operation is a soft-float library call.
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "ssd1306.h"
+#include "dht22_decode.h"
+#include "json_stream.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() host_now_ns()
+#endif
+
+#define LINE_MAX_PIXELS 256
+
+// ssd1306_draw_line() draws through this; record the pixels instead of a frame.
+// Not inlined, so the float version below pays for the call like the real one
+static int16_t s_px[LINE_MAX_PIXELS][2];
+static int s_px_count;
+
+__attribute__((noinline)) void ssd1306_draw_pixel(int16_t x, int16_t y, bool color)
+{
+    if (s_px_count < LINE_MAX_PIXELS) {
+        s_px[s_px_count][0] = x;
+        s_px[s_px_count][1] = y;
+    }
+    s_px_count++;
+}
+
+static volatile int32_t s_sink;
+
+// --- Code as it was before the fixed-point change ---
+
+static void float_draw_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1, bool color)
+{
+    int16_t dx = x1 - x0;
+    int16_t dy = y1 - y0;
+    int16_t steps = (dx > dy) ? (dx > -dx ? dx : -dx) : (dy > -dy ? dy : -dy);
+
+    if (steps == 0) {
+        ssd1306_draw_pixel(x0, y0, color);
+        return;
+    }
+
+    float x_inc = (float)dx / steps;
+    float y_inc = (float)dy / steps;
+    float x = x0;
+    float y = y0;
+
+    for (int i = 0; i <= steps; i++) {
+        ssd1306_draw_pixel((int16_t)x, (int16_t)y, color);
+        x += x_inc;
+        y += y_inc;
+    }
+}
+
+// DHT22 bytes to degrees, then the display's rounding to one decimal
+static void float_format_indoor(const uint8_t data[5], char *out, size_t len)
+{
+    uint16_t raw_temperature = ((data[2] & 0x7F) << 8) | data[3];
+    float temperature = (data[2] & 0x80) ? -(raw_temperature / 10.0) : raw_temperature / 10.0;
+    int whole = (int)temperature;
+    int decimal = (int)((temperature - whole) * 10 + 0.5);
+
+    if (decimal >= 10) {
+        whole += 1;
+        decimal = 0;
+    }
+    snprintf(out, len, "%d.%dC", whole, decimal);
+}
+
+// cJSON's valuedouble, scaled to tenths at the parser boundary
+static int32_t float_number_to_deci(const char *text)
+{
+    double scaled = strtod(text, NULL) * 10;
+    return (int32_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
+
+// --- Code as it is now ---
+
+static void fixed_format_indoor(const uint8_t data[5], char *out, size_t len)
+{
+    int16_t temperature;
+    uint16_t humidity;
+
+    dht22_decode_values(data, &temperature, &humidity);
+    snprintf(out, len, "%s%d.%dC", temperature < 0 ? "-" : "",
+             abs(temperature) / 10, abs(temperature) % 10);
+}
+
+static int32_t fixed_number_to_deci(const char *text)
+{
+    int32_t value = 0;
+    json_stream_number_to_fixed(text, 1, &value);
+    return value;
+}
+
+// --- Equivalence ---
+
+static void check_lines(void)
+{
+    int16_t got[LINE_MAX_PIXELS][2];
+
+    // Every line from the centre to each border pixel, both directions
+    for (int i = 0; i < 2 * (128 + 64); i++) {
+        int16_t x = (i < 128) ? i : (i < 256) ? i - 128 : (i < 320) ? 0 : 127;
+        int16_t y = (i < 128) ? 0 : (i < 256) ? 63 : (i < 320) ? i - 256 : i - 320;
+
+        for (int dir = 0; dir < 2; dir++) {
+            int16_t x0 = dir ? x : 64, y0 = dir ? y : 32;
+            int16_t x1 = dir ? 64 : x, y1 = dir ? 32 : y;
+            int steps = abs(x1 - x0) > abs(y1 - y0) ? abs(x1 - x0) : abs(y1 - y0);
+
+            s_px_count = 0;
+            ssd1306_draw_line(x0, y0, x1, y1, true);
+            int count = s_px_count;
+            memcpy(got, s_px, sizeof(got));
+            CHECK_EQ(count, steps + 1);
+            CHECK(got[0][0] == x0 && got[0][1] == y0);
+            CHECK(got[count - 1][0] == x1 && got[count - 1][1] == y1);
+            for (int p = 1; p < count; p++) {
+                CHECK(abs(got[p][0] - got[p - 1][0]) <= 1 && abs(got[p][1] - got[p - 1][1]) <= 1);
+            }
+
+            // Within half a pixel of the ideal line along the minor axis. The float
+            // version is not a reference here: for lines going left or up it
+            // chose the step count from the wrong axis and left gaps
+            for (int p = 0; p < count; p++) {
+                int major = abs(x1 - x0) >= abs(y1 - y0);
+                int t = major ? got[p][0] - x0 : got[p][1] - y0;
+                int span = major ? x1 - x0 : y1 - y0;
+                int minor_span = major ? y1 - y0 : x1 - x0;
+                int minor = major ? got[p][1] - y0 : got[p][0] - x0;
+                // |minor - t * minor_span / span| <= 1/2, kept in integers
+                CHECK(span == 0 || 2 * abs(minor * span - t * minor_span) <= abs(span));
+            }
+        }
+    }
+}
+
+static void check_indoor(void)
+{
+    char fixed[16], old[16];
+
+    // The float version printed "-5.-3C" below zero, so only compare from 0.0C up
+    for (int raw = 0; raw <= 800; raw++) {
+        uint8_t data[5] = { 0x02, 0x00, raw >> 8, raw & 0xFF, 0 };
+        fixed_format_indoor(data, fixed, sizeof(fixed));
+        float_format_indoor(data, old, sizeof(old));
+        CHECK(strcmp(fixed, old) == 0);
+    }
+    uint8_t below[5] = { 0x02, 0x00, 0x80, 53, 0 };
+    fixed_format_indoor(below, fixed, sizeof(fixed));
+    CHECK(strcmp(fixed, "-5.3C") == 0);
+}
+
+static void check_numbers(void)
+{
+    char text[16];
+
+    // Two decimals not ending in 5: both round the same way. Exact halves are
+    // where the double version went wrong (0.15 * 10 = 1.4999...)
+    for (int hundredths = -6000; hundredths <= 6000; hundredths++) {
+        if (abs(hundredths) % 10 == 5) {
+            continue;
+        }
+        snprintf(text, sizeof(text), "%s%d.%02d", hundredths < 0 ? "-" : "",
+                 abs(hundredths) / 100, abs(hundredths) % 100);
+        CHECK_EQ(fixed_number_to_deci(text), float_number_to_deci(text));
+    }
+    CHECK_EQ(fixed_number_to_deci("0.15"), 2);
+    CHECK_EQ(fixed_number_to_deci("-0.15"), -2);
+    CHECK_EQ(fixed_number_to_deci("21.3"), 213);
+}
+
+// --- Timing ---
+
+typedef struct {
+    const char *name;
+    uint64_t old_cycles;
+    uint64_t new_cycles;
+    int ops;
+} bench_t;
+
+// Lines down and to the right only, which the float version drew completely
+static void bench_lines(bench_t *b)
+{
+    uint64_t t0 = CYCLES();
+    for (int i = 0; i < b->ops; i++) {
+        s_px_count = 0;
+        float_draw_line(0, 0, i % 128, (i * 7) % 64, true);
+        s_sink += s_px_count;
+    }
+    uint64_t t1 = CYCLES();
+    for (int i = 0; i < b->ops; i++) {
+        s_px_count = 0;
+        ssd1306_draw_line(0, 0, i % 128, (i * 7) % 64, true);
+        s_sink += s_px_count;
+    }
+    uint64_t t2 = CYCLES();
+    b->old_cycles = t1 - t0;
+    b->new_cycles = t2 - t1;
+}
+
+static void bench_indoor(bench_t *b)
+{
+    char out[16];
+    uint8_t data[5] = { 0x02, 0x00, 0, 0, 0 };
+
+    uint64_t t0 = CYCLES();
+    for (int i = 0; i < b->ops; i++) {
+        data[3] = i & 0xFF;
+        float_format_indoor(data, out, sizeof(out));
+        s_sink += out[0];
+    }
+    uint64_t t1 = CYCLES();
+    for (int i = 0; i < b->ops; i++) {
+        data[3] = i & 0xFF;
+        fixed_format_indoor(data, out, sizeof(out));
+        s_sink += out[0];
+    }
+    uint64_t t2 = CYCLES();
+    b->old_cycles = t1 - t0;
+    b->new_cycles = t2 - t1;
+}
+
+static void bench_numbers(bench_t *b)
+{
+    static const char *texts[] = { "21.37", "-3.5", "1013", "0.82", "-12.04", "28.9" };
+
+    uint64_t t0 = CYCLES();
+    for (int i = 0; i < b->ops; i++) {
+        s_sink += float_number_to_deci(texts[i % 6]);
+    }
+    uint64_t t1 = CYCLES();
+    for (int i = 0; i < b->ops; i++) {
+        s_sink += fixed_number_to_deci(texts[i % 6]);
+    }
+    uint64_t t2 = CYCLES();
+    b->old_cycles = t1 - t0;
+    b->new_cycles = t2 - t1;
+}
+
+int main(int argc, char **argv)
+{
+    int scale = (argc > 1) ? atoi(argv[1]) : 1;
+    bench_t benches[] = {
+        { "line, 0-127 pixels", 0, 0, 20000 * scale },
+        { "indoor reading to text", 0, 0, 50000 * scale },
+        { "JSON number to tenths", 0, 0, 200000 * scale },
+    };
+
+    check_lines();
+    check_indoor();
+    check_numbers();
+
+    bench_lines(&benches[0]);
+    bench_indoor(&benches[1]);
+    bench_numbers(&benches[2]);
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("%-24s %12s %12s  (TSC cycles per call)\n", "", "float", "fixed");
+#else
+    printf("%-24s %12s %12s  (ns per call)\n", "", "float", "fixed");
+#endif
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        bench_t *b = &benches[i];
+        printf("%-24s %12.1f %12.1f\n", b->name,
+               (double)b->old_cycles / b->ops, (double)b->new_cycles / b->ops);
+    }
+
+    HOST_TEST_EXIT();
+}
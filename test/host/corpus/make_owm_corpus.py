@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Write the OpenWeatherMap payloads the host tests replay.
+
+The payloads have the layout and field order of real API responses, with
+seeded values so the files are reproducible. Run from this directory; the
+output goes to owm/. Gzip variants are made by the tests themselves, with
+zlib at the settings a web server uses.
+
+Forecasts are written with one list entry per line, so the tests can cut a
+cnt=N response out of the 40-entry file.
+"""
+
+import json
+import random
+
+rng = random.Random(20240601)
+
+CONDITIONS = [
+    (800, "Clear", "clear sky", "01d"),
+    (801, "Clouds", "few clouds", "02d"),
+    (803, "Clouds", "broken clouds", "04d"),
+    (500, "Rain", "light rain", "10d"),
+    (521, "Rain", "shower rain", "09d"),
+    (300, "Drizzle", "light intensity drizzle", "09d"),
+    (211, "Thunderstorm", "thunderstorm", "11d"),
+    (600, "Snow", "light snow", "13d"),
+    (701, "Mist", "mist", "50d"),
+]
+
+CITIES = [
+    (2643743, "London", "GB", -0.1257, 51.5085),
+    (2988507, "Paris", "FR", 2.3488, 48.8534),
+    (2950159, "Berlin", "DE", 13.4105, 52.5244),
+    (3117735, "Madrid", "ES", -3.7026, 40.4165),
+    (3169070, "Rome", "IT", 12.4839, 41.8947),
+    (2759794, "Amsterdam", "NL", 4.8897, 52.374),
+    (2761369, "Vienna", "AT", 16.3721, 48.2085),
+    (3067696, "Prague", "CZ", 14.4208, 50.088),
+    (756135, "Warsaw", "PL", 21.0118, 52.2298),
+    (2673730, "Stockholm", "SE", 18.0649, 59.3326),
+    (658225, "Helsinki", "FI", 24.9355, 60.1695),
+    (3143244, "Oslo", "NO", 10.7461, 59.9127),
+    (2618425, "Copenhagen", "DK", 12.5655, 55.6759),
+    (2800866, "Brussels", "BE", 4.3488, 50.8505),
+    (2657896, "Zurich", "CH", 8.55, 47.3667),
+    (2267057, "Lisbon", "PT", -9.1333, 38.7167),
+    (264371, "Athens", "GR", 23.7162, 37.9795),
+    (3054643, "Budapest", "HU", 19.0399, 47.498),
+    (2964574, "Dublin", "IE", -6.2489, 53.3331),
+    (3448439, "Sao Paulo", "BR", -46.6361, -23.5475),
+]
+
+DT0 = 1717236000
+
+
+def temp():
+    return round(rng.uniform(-12.0, 34.0), 2)
+
+
+def weather(cond):
+    return [{"id": cond[0], "main": cond[1], "description": cond[2], "icon": cond[3]}]
+
+
+def main_block(t):
+    return {
+        "temp": t,
+        "feels_like": round(t - rng.uniform(0, 3), 2),
+        "temp_min": round(t - rng.uniform(0, 2), 2),
+        "temp_max": round(t + rng.uniform(0, 2), 2),
+        "pressure": rng.randint(990, 1035),
+        "humidity": rng.randint(20, 99),
+    }
+
+
+def current_entry(city, dt):
+    city_id, name, country, lon, lat = city
+    cond = rng.choice(CONDITIONS)
+    return {
+        "coord": {"lon": lon, "lat": lat},
+        "weather": weather(cond),
+        "base": "stations",
+        "main": main_block(temp()),
+        "visibility": 10000,
+        "wind": {"speed": round(rng.uniform(0, 12), 2), "deg": rng.randint(0, 359)},
+        "clouds": {"all": rng.randint(0, 100)},
+        "dt": dt,
+        "sys": {"type": 2, "id": rng.randint(2000000, 2099999), "country": country,
+                "sunrise": dt - 20000, "sunset": dt + 38000},
+        "timezone": 3600,
+        "id": city_id,
+        "name": name,
+        "cod": 200,
+    }
+
+
+def group_entry(city, dt):
+    entry = current_entry(city, dt)
+    for key in ("base", "timezone", "cod"):
+        del entry[key]
+    main = entry["main"]
+    main.update({"sea_level": main["pressure"], "grnd_level": main["pressure"] - rng.randint(0, 40)})
+    entry["wind"]["gust"] = round(rng.uniform(0, 18), 2)
+    entry["sys"].update({"timezone": 3600, "sunrise": dt - rng.randint(18000, 22000),
+                         "sunset": dt + rng.randint(36000, 40000)})
+    if entry["weather"][0]["main"] in ("Rain", "Drizzle", "Thunderstorm"):
+        entry["rain"] = {"1h": round(rng.uniform(0.1, 4), 2)}
+    return entry
+
+
+def forecast_entry(i):
+    cond = rng.choice(CONDITIONS)
+    dt = DT0 + 10800 * i
+    main = main_block(temp())
+    main.update({"sea_level": main["pressure"], "grnd_level": main["pressure"] - 12,
+                 "temp_kf": 0})
+    entry = {
+        "dt": dt,
+        "main": main,
+        "weather": weather(cond),
+        "clouds": {"all": rng.randint(0, 100)},
+        "wind": {"speed": round(rng.uniform(0, 12), 2), "deg": rng.randint(0, 359),
+                 "gust": round(rng.uniform(0, 18), 2)},
+        "visibility": 10000,
+        "pop": round(rng.uniform(0, 1), 2),
+        "sys": {"pod": "d" if (i % 8) < 4 else "n"},
+        "dt_txt": "2024-06-%02d %02d:00:00" % (1 + (i * 3 + 10) // 24, (i * 3 + 10) % 24),
+    }
+    if cond[1] in ("Rain", "Drizzle", "Thunderstorm"):
+        entry["rain"] = {"3h": round(rng.uniform(0.1, 6), 2)}
+    return entry
+
+
+def compact(obj):
+    return json.dumps(obj, separators=(",", ":"))
+
+
+def write(name, text):
+    with open("owm/" + name, "w") as f:
+        f.write(text)
+
+
+def main():
+    write("current.json", compact(current_entry(CITIES[0], DT0)))
+
+    # cnt=40, the most the endpoint returns; one entry per line
+    entries = [compact(forecast_entry(i)) for i in range(40)]
+    city = {"id": 2643743, "name": "London", "coord": {"lat": 51.5085, "lon": -0.1257},
+            "country": "GB", "population": 1000000, "timezone": 3600,
+            "sunrise": DT0 - 20000, "sunset": DT0 + 38000}
+    write("forecast_cnt40.json",
+          '{"cod":"200","message":0,"cnt":40,"list":[\n' + ",\n".join(entries) +
+          '\n],"city":' + compact(city) + "}")
+
+    for count in (3, 20):
+        group = {"cnt": count, "list": [group_entry(c, DT0 + i)
+                                        for i, c in enumerate(CITIES[:count])]}
+        write("group_%d.json" % count, compact(group))
+
+    # Malformed and incomplete bodies
+    current = compact(current_entry(CITIES[0], DT0))
+    write("current_truncated.json", current[:len(current) * 2 // 3])
+    no_temp = current_entry(CITIES[0], DT0)
+    del no_temp["main"]["temp"]
+    write("current_no_temp.json", compact(no_temp))
+    no_weather = current_entry(CITIES[0], DT0)
+    del no_weather["weather"]
+    write("current_no_weather.json", compact(no_weather))
+    write("error_401.json",
+          '{"cod":401, "message": "Invalid API key. Please see '
+          'https://openweathermap.org/faq#error401 for more info."}')
+
+
+if __name__ == "__main__":
+    main()
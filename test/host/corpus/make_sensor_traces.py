@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Write the DHT22 reading traces the sensor filter test replays.
+
+One reading every 2 s, in tenths of a degree or of a percent, as the driver
+hands them to the filter. Each line is "raw,truth,tag": the reading, the value
+the sensor should have reported, and what was done to the reading:
+
+    n  sensor noise only
+    s  spike within the rate gate (the median has to remove it)
+    S  spike beyond the rate gate, alone or two in a row
+    r  outside the datasheet range (a garbled frame that passed the checksum)
+    j  first reading after a real step larger than the rate gate
+
+Events are kept at least 8 readings apart and from the start, so each one can
+be checked on its own. Run from this directory; the output goes to sensor/.
+"""
+
+import math
+import random
+
+rng = random.Random(20240615)
+
+SPACING = 8
+
+
+def noise(sd, limit):
+    return max(-limit, min(limit, round(rng.gauss(0, sd))))
+
+
+def trace(length, level, sd, limits, step_gate, small, out_of_range, steps):
+    """steps: {index: change} applied from that reading on"""
+    lines = ["# raw,truth,tag"]
+    last_event = 0              # Let the median window fill first
+    offset = 0
+    paired = False
+
+    for i in range(length):
+        if i in steps:
+            offset += steps[i]
+        truth = level(i) + offset
+        raw = truth + noise(sd, 2 * sd)
+        tag = "n"
+
+        if i in steps:
+            tag = "j"
+            last_event = i
+        elif paired:
+            # Second reading of a glitch pair, same error as the first
+            raw = truth + spike
+            tag = "S"
+            paired = False
+        elif i - last_event >= SPACING and all(abs(i - s) >= SPACING for s in steps):
+            r = rng.random()
+            if r < 0.04:
+                spike = rng.choice((-1, 1)) * rng.randint(step_gate + 20, 3 * step_gate)
+                # Within the sensor range, or it would be a range rejection
+                if not limits[0] <= truth + spike <= limits[1]:
+                    spike = -spike
+                raw = truth + spike
+                tag = "S"
+                paired = rng.random() < 0.4
+            elif r < 0.07:
+                raw = truth + rng.choice((-1, 1)) * rng.randint(small[0], small[1])
+                tag = "s"
+            elif r < 0.09:
+                raw = rng.choice(out_of_range)
+                tag = "r"
+            if tag != "n":
+                last_event = i
+        lines.append("%d,%d,%s" % (raw, truth, tag))
+    return lines
+
+
+def write(name, lines):
+    with open("sensor/" + name, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def main():
+    # Indoor temperature over ~40 minutes: a slow swing, a window opened at
+    # 300 and closed again at 900
+    write("temperature.csv", trace(
+        1200,
+        lambda i: 215 + round(15 * math.sin(i / 190.0)),
+        sd=1, limits=(-400, 800), step_gate=30, small=(10, 25),
+        out_of_range=(-3276, -1000, 801, 1638, 3276),
+        steps={300: -60, 900: 55}))
+
+    # Bathroom humidity: a shower at 200, the fan at 700
+    write("humidity.csv", trace(
+        1200,
+        lambda i: 550 + round(20 * math.sin(i / 260.0)),
+        sd=3, limits=(0, 1000), step_gate=150, small=(20, 60),
+        out_of_range=(-1, -200, 1001, 1638, 3276),
+        steps={200: 250, 700: -200}))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,58 @@
+#include "host_dns_server.h"
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "host_net.h"
+
+static int s_fd = -1;
+static uint32_t s_ttl;
+static uint32_t s_queries;
+
+static void *responder(void *unused)
+{
+    uint8_t buf[512];
+    struct sockaddr_in peer;
+    socklen_t peer_len;
+
+    while (1) {
+        peer_len = sizeof(peer);
+        ssize_t len = recvfrom(s_fd, buf, sizeof(buf) - 16, 0, (struct sockaddr *)&peer, &peer_len);
+        if (len < 12) {
+            continue;
+        }
+        // Question stays as it is; one answer pointing back at it
+        buf[2] = 0x81;          // QR, RD
+        buf[3] = 0x80;          // RA, rcode 0
+        buf[6] = 0;
+        buf[7] = 1;             // ANCOUNT
+        buf[8] = buf[9] = buf[10] = buf[11] = 0;
+        uint8_t answer[16] = { 0xC0, 12, 0, 1, 0, 1,
+                               s_ttl >> 24, s_ttl >> 16, s_ttl >> 8, s_ttl, 0, 4, 127, 0, 0, 1 };
+        memcpy(&buf[len], answer, sizeof(answer));
+        __atomic_add_fetch(&s_queries, 1, __ATOMIC_RELAXED);
+        sendto(s_fd, buf, len + sizeof(answer), 0, (struct sockaddr *)&peer, peer_len);
+    }
+    return NULL;
+}
+
+void host_dns_server_start(uint32_t ttl)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+    pthread_t thread;
+
+    s_ttl = ttl;
+    s_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    bind(s_fd, (struct sockaddr *)&addr, sizeof(addr));
+    getsockname(s_fd, (struct sockaddr *)&addr, &len);
+    host_net_redirect(53, ntohs(addr.sin_port));
+    pthread_create(&thread, NULL, responder, NULL);
+    pthread_detach(thread);
+}
+
+uint32_t host_dns_server_queries(void)
+{
+    return __atomic_load_n(&s_queries, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,22 @@
+#ifndef HOST_DNS_SERVER_H
+#define HOST_DNS_SERVER_H
+
+#include <stdint.h>
+
+/*
+ * DNS responder for tests: answers every A query with 127.0.0.1 from its own
+ * thread, and takes over port 53 through host_net_redirect().
+ */
+
+/**
+ * @brief Start the responder
+ * @param ttl TTL in seconds put in every answer
+ */
+void host_dns_server_start(uint32_t ttl);
+
+/**
+ * @brief Queries answered so far
+ */
+uint32_t host_dns_server_queries(void);
+
+#endif // HOST_DNS_SERVER_H
@@ -0,0 +1,51 @@
+#include "host_loop.h"
+#include <unistd.h>
+#include "host_clock.h"
+#include "host_sync.h"
+#include "net_loop.h"
+
+static void nothing(void *arg)
+{
+}
+
+bool host_loop_run_until(bool (*done)(void), int step_ms, int timeout_ms)
+{
+    int ms = 0;
+
+    while (!done()) {
+        if (ms >= timeout_ms) {
+            return false;
+        }
+        if (!net_loop_busy()) {
+            host_clock_advance_us(step_ms * 1000LL);
+            ms += step_ms;
+            net_loop_schedule(nothing, NULL, 0);
+        }
+        usleep(1000);
+    }
+    return true;
+}
+
+static void (*s_call_fn)(void);
+static bool s_call_done;
+
+static void call_on_loop(void *arg)
+{
+    s_call_fn();
+    host_sync_lock();
+    s_call_done = true;
+    host_sync_broadcast();
+    host_sync_unlock();
+}
+
+void host_loop_call(void (*fn)(void))
+{
+    s_call_fn = fn;
+    s_call_done = false;
+    net_loop_schedule(call_on_loop, NULL, 0);
+    host_sync_lock();
+    while (!s_call_done) {
+        host_sync_wait(-1);
+    }
+    host_sync_unlock();
+}
@@ -0,0 +1,25 @@
+#ifndef HOST_LOOP_H
+#define HOST_LOOP_H
+
+#include <stdbool.h>
+
+/*
+ * Driving the firmware's network loop in virtual time. The clock moves only
+ * while no socket of the loop is busy, so no request can time out because the
+ * host was slow; each step wakes the loop so it sees the new time.
+ */
+
+/**
+ * @brief Step virtual time until done() returns true
+ * @param step_ms Virtual time per step
+ * @param timeout_ms Virtual time to give up after
+ * @return Whether done() became true
+ */
+bool host_loop_run_until(bool (*done)(void), int step_ms, int timeout_ms);
+
+/**
+ * @brief Run fn on the loop task and wait for it to return (real time)
+ */
+void host_loop_call(void (*fn)(void));
+
+#endif // HOST_LOOP_H
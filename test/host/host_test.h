@@ -0,0 +1,48 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Checks shared by the host tests. A failed check prints its location and is
+ * counted; HOST_TEST_EXIT() turns the count into the process exit status so
+ * ctest reports it.
+ */
+
+static int host_test_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            host_test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+        long long a_ = (long long)(actual), e_ = (long long)(expected); \
+        if (a_ != e_) { \
+            printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+            host_test_failures++; \
+        } \
+    } while (0)
+
+#define HOST_TEST_EXIT() do { \
+        if (host_test_failures) { \
+            printf("%d check(s) failed\n", host_test_failures); \
+            return 1; \
+        } \
+        printf("All checks passed\n"); \
+        return 0; \
+    } while (0)
+
+// Monotonic host time for benchmarks
+static inline uint64_t host_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#endif // HOST_TEST_H
@@ -0,0 +1,63 @@
+#ifndef DRIVER_I2C_H
+#define DRIVER_I2C_H
+
+// Host stand-in for the I2C master driver: command links run against the
+// simulated devices (see host_devices.h)
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+typedef enum {
+    I2C_NUM_0 = 0,
+    I2C_NUM_MAX,
+} i2c_port_t;
+
+typedef enum {
+    I2C_MODE_MASTER,
+    I2C_MODE_MAX,
+} i2c_mode_t;
+
+typedef enum {
+    I2C_MASTER_ACK = 0,
+    I2C_MASTER_NACK,
+    I2C_MASTER_LAST_NACK,
+} i2c_ack_type_t;
+
+#define I2C_MASTER_WRITE 0
+#define I2C_MASTER_READ  1
+
+typedef struct {
+    i2c_mode_t mode;
+    gpio_num_t sda_io_num;
+    gpio_pullup_t sda_pullup_en;
+    gpio_num_t scl_io_num;
+    gpio_pullup_t scl_pullup_en;
+    uint32_t clk_stretch_tick;
+} i2c_config_t;
+
+typedef struct host_i2c_cmd *i2c_cmd_handle_t;
+
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode);
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *conf);
+
+i2c_cmd_handle_t i2c_cmd_link_create(void);
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en);
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, uint8_t *data, size_t len, bool ack_en);
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd, uint8_t *data, i2c_ack_type_t ack);
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t len, i2c_ack_type_t ack);
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd);
+
+/**
+ * @brief Run a command link; the calling task is held for the time the bytes
+ *        take on a 100 kHz bus
+ * @return ESP_FAIL when no device acknowledges the address
+ */
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks);
+
+#endif // DRIVER_I2C_H
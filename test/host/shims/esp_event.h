@@ -0,0 +1,25 @@
+#ifndef ESP_EVENT_H
+#define ESP_EVENT_H
+
+// Host stand-in for the default event loop: events are queued and handlers
+// run on an "esp_event" task, as on the device
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *arg, esp_event_base_t base, int32_t id, void *data);
+
+#define ESP_EVENT_ANY_ID -1
+
+extern const char *WIFI_EVENT;
+extern const char *IP_EVENT;
+
+esp_err_t esp_event_loop_create_default(void);
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id,
+                                     esp_event_handler_t handler, void *arg);
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void *data, size_t size,
+                         uint32_t ticks);
+
+#endif // ESP_EVENT_H
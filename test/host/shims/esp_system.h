@@ -0,0 +1,47 @@
+#ifndef ESP_SYSTEM_H
+#define ESP_SYSTEM_H
+
+// Host stand-in for the parts of esp_system.h the firmware uses
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_RST_UNKNOWN = 0,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+    ESP_RST_SDIO,
+    ESP_RST_FAST_SW,
+} esp_reset_reason_t;
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+} esp_mac_type_t;
+
+// Free heap is reported as HOST_HEAP_SIZE minus what malloc has handed out
+#define HOST_HEAP_SIZE (80 * 1024)
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+uint32_t esp_random(void);
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type);
+esp_reset_reason_t esp_reset_reason(void);
+void esp_restart(void);
+
+// Reset reason esp_reset_reason() reports (power-on until set)
+void host_set_reset_reason(esp_reset_reason_t reason);
+
+// Stands in for the RTC slow-clock counter register; tests that read it
+// define RTC_COUNTER_REG as &host_rtc_counter and move it themselves
+extern volatile uint32_t host_rtc_counter;
+
+#endif // ESP_SYSTEM_H
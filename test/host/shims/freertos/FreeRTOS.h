@@ -0,0 +1,59 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+// Host stand-in for FreeRTOS: tasks are threads, see host_freertos.c
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_attr.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+typedef struct host_task *TaskHandle_t;
+typedef struct host_sem *SemaphoreHandle_t;
+typedef struct host_event_group *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  1
+#define pdFAIL                  0
+#define portMAX_DELAY           0xFFFFFFFFu
+#define portTICK_PERIOD_MS      10      // CONFIG_FREERTOS_HZ=100, as on the device
+#define pdMS_TO_TICKS(ms)       ((TickType_t)((ms) / portTICK_PERIOD_MS))
+#define configMAX_TASK_NAME_LEN 16
+#define configMINIMAL_STACK_SIZE 768
+#define configASSERT(x)         ((void)(x))
+// As in sdkconfig.defaults; run time is counted in microseconds of host CPU
+#define configUSE_TRACE_FACILITY        1
+#define configGENERATE_RUN_TIME_STATS   1
+
+#define portYIELD_FROM_ISR()
+#define portENTER_CRITICAL()
+#define portEXIT_CRITICAL()
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+#ifndef BIT0
+#define BIT0    0x00000001
+#define BIT1    0x00000002
+#define BIT2    0x00000004
+#define BIT3    0x00000008
+#define BIT4    0x00000010
+#define BIT5    0x00000020
+#define BIT6    0x00000040
+#define BIT7    0x00000080
+#define BIT8    0x00000100
+#define BIT9    0x00000200
+#define BIT10   0x00000400
+#define BIT11   0x00000800
+#define BIT12   0x00001000
+#define BIT13   0x00002000
+#define BIT14   0x00004000
+#define BIT15   0x00008000
+#endif
+
+#endif // FREERTOS_H
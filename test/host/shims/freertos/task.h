@@ -0,0 +1,44 @@
+#ifndef FREERTOS_TASK_H
+#define FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef enum {
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+} eTaskState;
+
+typedef struct {
+    TaskHandle_t xHandle;
+    const char *pcTaskName;
+    UBaseType_t xTaskNumber;
+    eTaskState eCurrentState;
+    UBaseType_t uxCurrentPriority;
+    UBaseType_t uxBasePriority;
+    uint32_t ulRunTimeCounter;      // Host CPU time of the thread outside host_sync waits, in microseconds
+    uint16_t usStackHighWaterMark;  // Not measured on the host (0)
+} TaskStatus_t;
+
+BaseType_t xTaskCreate(void (*fn)(void *), const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken);
+// Total run time is the uptime in microseconds, as with the esp_timer run-time clock
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t size, uint32_t *total_run_time);
+
+// Host only: list the calling thread as a task of that name (it is not
+// counted as running, see host_sync.h), and the number of times a task
+// returned from a blocking call that had to wait
+TaskHandle_t host_task_adopt(const char *name);
+uint32_t host_task_wakeups(TaskHandle_t task);
+
+#endif // FREERTOS_TASK_H
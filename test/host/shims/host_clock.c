@@ -0,0 +1,483 @@
+#include "host_clock.h"
+#include "host_sync.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+// Real time a polling wait (a select() on sockets) sleeps between polls
+#define POLL_NS 1000000
+
+struct host_timer {
+    esp_timer_cb_t cb;
+    void *arg;
+    int64_t due_us;
+    int64_t period_us;          // 0 for one-shot
+    bool armed;
+    struct host_timer *next;
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond;
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+static int64_t s_start_ns;
+static bool s_virtual;
+static int64_t s_virtual_us;
+static struct host_timer *s_timers;
+static bool s_dispatcher;
+static void (*s_advance_hook)(int64_t now_us);
+
+// Firmware tasks that are not blocked in host_sync_wait(); virtual time only
+// moves in host_clock_run_idle() once this is 0. A broadcast counts every
+// sleeping task as running again until it has re-checked its condition.
+typedef struct waiter {
+    int64_t deadline_us;
+    struct waiter *next;
+} waiter_t;
+
+static pthread_cond_t s_idle_cond;
+static int s_running;
+static int s_sleeping;
+static uint64_t s_generation;
+static waiter_t *s_waiters;                 // Deadlines the sleeping tasks wait for
+static __thread bool t_task;
+static __thread host_wait_cpu_t *t_wait_cpu;
+static __thread int t_waiting;
+
+static int64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void clock_init(void)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s_cond, &attr);
+    pthread_cond_init(&s_idle_cond, &attr);
+    s_start_ns = monotonic_ns();
+}
+
+void host_sync_lock(void)
+{
+    pthread_once(&s_once, clock_init);
+    pthread_mutex_lock(&s_lock);
+}
+
+void host_sync_unlock(void)
+{
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_sync_broadcast(void)
+{
+    s_running += s_sleeping;
+    s_sleeping = 0;
+    s_generation++;
+    pthread_cond_broadcast(&s_cond);
+}
+
+void host_sync_task_created(void)
+{
+    host_sync_lock();
+    s_running++;
+    host_sync_unlock();
+}
+
+void host_sync_task_attach(void)
+{
+    t_task = true;
+}
+
+void host_sync_task_end(void)
+{
+    host_sync_lock();
+    t_task = false;
+    if (--s_running == 0) {
+        pthread_cond_signal(&s_idle_cond);
+    }
+    host_sync_unlock();
+}
+
+int64_t host_clock_now_us(void)
+{
+    pthread_once(&s_once, clock_init);
+    if (__atomic_load_n(&s_virtual, __ATOMIC_ACQUIRE)) {
+        return __atomic_load_n(&s_virtual_us, __ATOMIC_ACQUIRE);
+    }
+    return (monotonic_ns() - s_start_ns) / 1000;
+}
+
+static int64_t thread_cpu_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void host_sync_charge_waits(host_wait_cpu_t *account)
+{
+    t_wait_cpu = account;
+}
+
+// The total is added before the wait is closed, which host_sync_wait_cpu_us() relies on
+void host_sync_waiting(bool waiting)
+{
+    if (t_wait_cpu == NULL) {
+        return;
+    }
+    if (waiting) {
+        if (t_waiting++ == 0) {
+            __atomic_store_n(&t_wait_cpu->since_us, thread_cpu_us(), __ATOMIC_RELEASE);
+        }
+    } else if (--t_waiting == 0) {
+        int64_t since = __atomic_load_n(&t_wait_cpu->since_us, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&t_wait_cpu->total_us, thread_cpu_us() - since, __ATOMIC_RELEASE);
+        __atomic_store_n(&t_wait_cpu->since_us, -1, __ATOMIC_RELEASE);
+    }
+}
+
+int64_t host_sync_wait_cpu_us(const host_wait_cpu_t *account, int64_t cpu_now_us)
+{
+    int64_t since, total;
+
+    do {
+        since = __atomic_load_n(&account->since_us, __ATOMIC_ACQUIRE);
+        total = __atomic_load_n(&account->total_us, __ATOMIC_ACQUIRE);
+    } while (since != __atomic_load_n(&account->since_us, __ATOMIC_ACQUIRE));
+    return total + ((since >= 0 && cpu_now_us > since) ? cpu_now_us - since : 0);
+}
+
+static int timed_wait(pthread_cond_t *cond, int64_t ns)
+{
+    struct timespec ts = { .tv_sec = ns / 1000000000LL, .tv_nsec = ns % 1000000000LL };
+    return pthread_cond_timedwait(cond, &s_lock, &ts);
+}
+
+// Sleep until a broadcast; a polling wait also gives up after POLL_NS of real
+// time. Returns whether a broadcast came.
+static bool sleep_locked(int64_t deadline_us, bool poll)
+{
+    uint64_t generation = s_generation;
+    waiter_t self = { .deadline_us = deadline_us };
+
+    if (t_task) {
+        self.next = s_waiters;
+        s_waiters = &self;
+        s_sleeping++;
+        if (--s_running == 0) {
+            pthread_cond_signal(&s_idle_cond);
+        }
+    }
+
+    host_sync_waiting(true);
+    bool woken = true;
+    int64_t poll_ns = poll ? monotonic_ns() + POLL_NS : INT64_MAX;
+    while (generation == s_generation) {
+        int64_t until_ns = poll_ns;
+        if (deadline_us >= 0 && !s_virtual && s_start_ns + deadline_us * 1000 < until_ns) {
+            until_ns = s_start_ns + deadline_us * 1000;
+        }
+        // Virtual time only moves with a broadcast, so it needs no timeout
+        if (until_ns == INT64_MAX) {
+            pthread_cond_wait(&s_cond, &s_lock);
+        } else if (timed_wait(&s_cond, until_ns) == ETIMEDOUT && generation == s_generation) {
+            woken = false;
+            break;
+        }
+    }
+
+    if (t_task) {
+        for (waiter_t **p = &s_waiters; *p != NULL; p = &(*p)->next) {
+            if (*p == &self) {
+                *p = self.next;
+                break;
+            }
+        }
+        if (!woken) {
+            // Nobody counted us as running again
+            s_sleeping--;
+            s_running++;
+        }
+    }
+    host_sync_waiting(false);
+    return woken;
+}
+
+bool host_sync_wait(int64_t deadline_us)
+{
+    if (deadline_us >= 0 && host_clock_now_us() >= deadline_us) {
+        return false;
+    }
+    sleep_locked(deadline_us, false);
+    return deadline_us < 0 || host_clock_now_us() < deadline_us;
+}
+
+bool host_sync_poll(int64_t deadline_us)
+{
+    if (deadline_us >= 0 && host_clock_now_us() >= deadline_us) {
+        return false;
+    }
+    sleep_locked(deadline_us, true);
+    return deadline_us < 0 || host_clock_now_us() < deadline_us;
+}
+
+int64_t host_sync_deadline(uint32_t ticks)
+{
+    if (ticks == portMAX_DELAY) {
+        return -1;
+    }
+    return host_clock_now_us() + (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+void host_clock_set_virtual(bool enable)
+{
+    host_sync_lock();
+    if (enable && !s_virtual) {
+        s_virtual_us = (monotonic_ns() - s_start_ns) / 1000;
+    }
+    __atomic_store_n(&s_virtual, enable, __ATOMIC_RELEASE);
+    host_sync_broadcast();
+    host_sync_unlock();
+}
+
+bool host_clock_is_virtual(void)
+{
+    return s_virtual;
+}
+
+// Move virtual time forward; call with the lock held
+static void set_virtual_us(int64_t us)
+{
+    __atomic_store_n(&s_virtual_us, us, __ATOMIC_RELEASE);
+    if (s_advance_hook != NULL) {
+        s_advance_hook(us);
+    }
+}
+
+void host_clock_set_advance_hook(void (*hook)(int64_t now_us))
+{
+    host_sync_lock();
+    s_advance_hook = hook;
+    host_sync_unlock();
+}
+
+// Earliest armed timer due at or before limit_us; call with the lock held
+static struct host_timer *next_due(int64_t limit_us)
+{
+    struct host_timer *best = NULL;
+
+    for (struct host_timer *t = s_timers; t != NULL; t = t->next) {
+        if (t->armed && t->due_us <= limit_us && (best == NULL || t->due_us < best->due_us)) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+// Take a due timer off the schedule before its callback runs; call with the lock held
+static void fire_prepare(struct host_timer *t)
+{
+    if (t->period_us > 0) {
+        t->due_us += t->period_us;
+    } else {
+        t->armed = false;
+    }
+}
+
+bool host_clock_run_next(int64_t limit_us)
+{
+    host_sync_lock();
+    struct host_timer *t = next_due(limit_us);
+    int64_t target = (t != NULL) ? t->due_us : limit_us;
+    if (target > s_virtual_us) {
+        set_virtual_us(target);
+    }
+    esp_timer_cb_t cb = NULL;
+    void *arg = NULL;
+    if (t != NULL) {
+        cb = t->cb;
+        arg = t->arg;
+        fire_prepare(t);
+    }
+    host_sync_broadcast();
+    host_sync_unlock();
+
+    if (cb != NULL) {
+        cb(arg);
+    }
+    return cb != NULL;
+}
+
+bool host_clock_run_idle(int64_t limit_us, bool (*busy)(void))
+{
+    host_sync_waiting(true);
+    host_sync_lock();
+    while (1) {
+        while (s_running > 0) {
+            timed_wait(&s_idle_cond, monotonic_ns() + POLL_NS);
+        }
+        if (busy == NULL || !busy()) {
+            break;
+        }
+        host_sync_unlock();
+        struct timespec pause = { .tv_nsec = 100000 };
+        nanosleep(&pause, NULL);
+        host_sync_lock();
+    }
+    host_sync_waiting(false);
+
+    int64_t target = limit_us;
+    for (waiter_t *w = s_waiters; w != NULL; w = w->next) {
+        if (w->deadline_us >= 0 && w->deadline_us < target) {
+            target = w->deadline_us;
+        }
+    }
+    struct host_timer *t = next_due(target);
+    if (t != NULL) {
+        target = t->due_us;
+    }
+    if (target > s_virtual_us) {
+        set_virtual_us(target);
+    }
+    esp_timer_cb_t cb = NULL;
+    void *arg = NULL;
+    if (t != NULL) {
+        cb = t->cb;
+        arg = t->arg;
+        fire_prepare(t);
+    }
+    host_sync_broadcast();
+    host_sync_unlock();
+
+    if (cb != NULL) {
+        host_task_woken();
+        cb(arg);
+    }
+    return target < limit_us;
+}
+
+void host_clock_advance_us(int64_t us)
+{
+    int64_t target = host_clock_now_us() + us;
+
+    while (host_clock_run_next(target)) {
+    }
+}
+
+// Real time: esp_timer callbacks run on one dispatcher thread, like the SDK's timer task
+static void *dispatcher(void *unused)
+{
+    host_sync_lock();
+    while (1) {
+        if (s_virtual) {
+            host_sync_wait(-1);
+            continue;
+        }
+        struct host_timer *t = next_due(INT64_MAX);
+        if (t == NULL) {
+            host_sync_wait(-1);
+            continue;
+        }
+        if (t->due_us > host_clock_now_us()) {
+            host_sync_wait(t->due_us);
+            continue;
+        }
+        esp_timer_cb_t cb = t->cb;
+        void *arg = t->arg;
+        fire_prepare(t);
+        host_sync_unlock();
+        cb(arg);
+        host_sync_lock();
+    }
+    return NULL;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return host_clock_now_us();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle)
+{
+    struct host_timer *t = calloc(1, sizeof(*t));
+    if (t == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    t->cb = args->callback;
+    t->arg = args->arg;
+
+    host_sync_lock();
+    t->next = s_timers;
+    s_timers = t;
+    if (!s_dispatcher) {
+        pthread_t thread;
+        s_dispatcher = (pthread_create(&thread, NULL, dispatcher, NULL) == 0);
+        if (s_dispatcher) {
+            pthread_detach(thread);
+        }
+    }
+    host_sync_unlock();
+    *out_handle = t;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t t, uint64_t timeout_us, uint64_t period_us)
+{
+    esp_err_t err = ESP_OK;
+
+    host_sync_lock();
+    if (t->armed) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        t->armed = true;
+        t->due_us = host_clock_now_us() + (int64_t)timeout_us;
+        t->period_us = (int64_t)period_us;
+        host_sync_broadcast();
+    }
+    host_sync_unlock();
+    return err;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    return timer_start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    esp_err_t err = ESP_OK;
+
+    host_sync_lock();
+    if (!timer->armed) {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    host_sync_unlock();
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    host_sync_lock();
+    for (struct host_timer **p = &s_timers; *p != NULL; p = &(*p)->next) {
+        if (*p == timer) {
+            *p = timer->next;
+            break;
+        }
+    }
+    host_sync_unlock();
+    free(timer);
+    return ESP_OK;
+}
@@ -0,0 +1,49 @@
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Time base behind esp_timer_get_time(), esp_timer, vTaskDelay() and the
+ * FreeRTOS tick on the host.
+ *
+ * By default it follows the host's monotonic clock from process start. In
+ * virtual mode it only moves when host_clock_advance_us() is called, which
+ * also runs the esp_timer callbacks that fall due, in order, on the caller's
+ * thread; a day of timers then takes as long as their callbacks do.
+ */
+
+void host_clock_set_virtual(bool enable);
+bool host_clock_is_virtual(void);
+
+/**
+ * @brief Move virtual time forward, firing due esp_timers on the way
+ */
+void host_clock_advance_us(int64_t us);
+
+/**
+ * @brief Advance virtual time to the next esp_timer deadline (no later than limit_us)
+ * @return false if no timer is due by limit_us (time is then at limit_us)
+ */
+bool host_clock_run_next(int64_t limit_us);
+
+/**
+ * @brief Virtual time for a whole firmware: wait until every task is blocked
+ *        and busy() (may be NULL) is false, then move to the earliest deadline
+ *        a task or an esp_timer waits for, no later than limit_us, firing that
+ *        timer. Tasks then run until they block again.
+ * @return false once time is at limit_us
+ */
+bool host_clock_run_idle(int64_t limit_us, bool (*busy)(void));
+
+/**
+ * @brief Call hook each time virtual time moves, before anything runs at the
+ *        new time (with the host_sync lock held), e.g. to keep a simulated
+ *        hardware counter in step
+ */
+void host_clock_set_advance_hook(void (*hook)(int64_t now_us));
+
+int64_t host_clock_now_us(void);
+
+#endif // HOST_CLOCK_H
@@ -0,0 +1,86 @@
+#ifndef HOST_DEVICES_H
+#define HOST_DEVICES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Simulated hardware behind the driver shims, for running the whole firmware
+ * on the host: a DHT22 on a GPIO, an SSD1306 and an SHT3x on the I2C bus, an
+ * access point behind esp_wifi, and the data log partition in RAM. Device
+ * timing (the DHT22 frame, 100 kHz bus transfers, association and DHCP) is
+ * taken on the host clock, so it follows virtual time.
+ */
+
+/**
+ * @brief Put a DHT22 on a GPIO; it answers every start signal with a frame
+ *        timestamped on the CPU cycle counter (host_ccount())
+ */
+void host_dht22_attach(int gpio);
+
+/**
+ * @brief Values sent in the following frames, in tenths of a degree / percent
+ */
+void host_dht22_set(int16_t temperature, uint16_t humidity);
+
+/**
+ * @brief Frames sent so far
+ */
+uint32_t host_dht22_frames(void);
+
+/**
+ * @brief Add an SSD1306 at a 7-bit address; its display RAM follows the
+ *        commands and data written to it
+ */
+void host_i2c_add_ssd1306(uint8_t addr);
+
+/**
+ * @brief Pixel in display RAM (horizontal addressing, as the driver sets up)
+ */
+bool host_ssd1306_pixel(int x, int y);
+
+/**
+ * @brief Add an SHT3x at a 7-bit address
+ */
+void host_i2c_add_sht3x(uint8_t addr);
+
+/**
+ * @brief Values returned by the following measurements, in tenths
+ */
+void host_sht3x_set(int16_t temperature, uint16_t humidity);
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t nacks;             // Address not acknowledged
+    uint64_t bytes;             // Address and payload bytes on the wire
+} host_i2c_stats_t;
+
+void host_i2c_get_stats(host_i2c_stats_t *stats);
+
+/**
+ * @brief Bring the access point up or down; going down disconnects the
+ *        station (beacon timeout) and makes scans come back empty
+ * @param rssi Signal the station sees while the AP is up
+ */
+void host_wifi_set_ap(bool up, int8_t rssi);
+
+typedef struct {
+    uint32_t scans;
+    uint32_t connects;          // Association attempts
+    uint32_t disconnects;       // Association ended, by either side
+    uint32_t ps_changes;        // Power save mode switches (radio wakes and sleeps)
+    int64_t awake_us;           // Time spent with power save off while associated
+} host_wifi_stats_t;
+
+void host_wifi_get_stats(host_wifi_stats_t *stats);
+
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t erases;            // Sectors
+    uint64_t bytes_written;
+} host_flash_stats_t;
+
+void host_flash_get_stats(host_flash_stats_t *stats);
+
+#endif // HOST_DEVICES_H
@@ -0,0 +1,92 @@
+#include "host_devices.h"
+#include "host_sync.h"
+#include <string.h>
+#include "esp_partition.h"
+
+// The "datalog" entry of partitions.csv, as NOR flash: erasing sets a sector
+// to 0xFF and writes can only clear bits
+
+#define FLASH_SECTOR_SIZE       4096
+#define DATALOG_OFFSET          0x100000
+#define DATALOG_SIZE            0x40000
+
+static const esp_partition_t s_datalog = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = 0x40,
+    .address = DATALOG_OFFSET,
+    .size = DATALOG_SIZE,
+    .label = "datalog",
+};
+
+static uint8_t s_flash[DATALOG_SIZE];
+static bool s_formatted;
+static host_flash_stats_t s_stats;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype, const char *label)
+{
+    if (type != s_datalog.type || label == NULL || strcmp(label, s_datalog.label) != 0) {
+        return NULL;
+    }
+    host_sync_lock();
+    if (!s_formatted) {
+        // A new chip reads erased
+        memset(s_flash, 0xFF, sizeof(s_flash));
+        s_formatted = true;
+    }
+    host_sync_unlock();
+    return &s_datalog;
+}
+
+static bool in_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    return partition == &s_datalog && offset <= DATALOG_SIZE && size <= DATALOG_SIZE - offset;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size)
+{
+    if (!in_range(partition, offset, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_sync_lock();
+    memcpy(dst, s_flash + offset, size);
+    s_stats.reads++;
+    host_sync_unlock();
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size)
+{
+    const uint8_t *data = src;
+
+    if (!in_range(partition, offset, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_sync_lock();
+    for (size_t i = 0; i < size; i++) {
+        s_flash[offset + i] &= data[i];
+    }
+    s_stats.writes++;
+    s_stats.bytes_written += size;
+    host_sync_unlock();
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (!in_range(partition, offset, size) || offset % FLASH_SECTOR_SIZE != 0 || size % FLASH_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_sync_lock();
+    memset(s_flash + offset, 0xFF, size);
+    s_stats.erases += size / FLASH_SECTOR_SIZE;
+    host_sync_unlock();
+    return ESP_OK;
+}
+
+void host_flash_get_stats(host_flash_stats_t *stats)
+{
+    host_sync_lock();
+    *stats = s_stats;
+    host_sync_unlock();
+}
@@ -0,0 +1,423 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "host_sync.h"
+#include "host_clock.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+// Tasks are detached threads; every blocking call waits on the shared host_sync
+// condition, so it honours virtual time as well as real time
+
+struct host_task {
+    void (*fn)(void *);
+    void *arg;
+    uint32_t notify;
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t priority;
+    uint32_t number;
+    pthread_t thread;
+    void *stack;                // Charged to the heap, as the SDK allocates stacks there
+    uint32_t wakeups;
+    host_wait_cpu_t wait_cpu;   // Left out of the run time
+    struct host_task *next;
+};
+
+struct host_sem {
+    bool mutex;
+    bool taken;                 // Mutex held
+    uint32_t count;             // Binary semaphore given
+};
+
+struct host_event_group {
+    EventBits_t bits;
+};
+
+static __thread struct host_task *t_self;
+static struct host_task *s_tasks;           // Under the host_sync lock
+static uint32_t s_task_count;
+
+static void task_list_add(struct host_task *task)
+{
+    host_sync_lock();
+    task->number = ++s_task_count;
+    task->next = s_tasks;
+    s_tasks = task;
+    host_sync_unlock();
+}
+
+static void task_exit(struct host_task *task)
+{
+    host_sync_lock();
+    for (struct host_task **p = &s_tasks; *p != NULL; p = &(*p)->next) {
+        if (*p == task) {
+            *p = task->next;
+            break;
+        }
+    }
+    host_sync_unlock();
+    host_sync_task_end();
+    free(task->stack);
+    free(task);
+}
+
+static void *task_main(void *arg)
+{
+    struct host_task *task = arg;
+
+    t_self = task;
+    host_sync_task_attach();
+    host_sync_charge_waits(&task->wait_cpu);
+    task->fn(task->arg);
+    // Returning is how the SDK's main task ends; others call vTaskDelete(NULL)
+    host_sync_charge_waits(NULL);
+    t_self = NULL;
+    task_exit(task);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(void (*fn)(void *), const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    task->wait_cpu.since_us = -1;
+    task->priority = priority;
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    // Stack depth is in bytes on this SDK
+    task->stack = malloc(stack_depth);
+    if (task->stack == NULL) {
+        free(task);
+        return pdFAIL;
+    }
+    if (handle != NULL) {
+        *handle = task;
+    }
+    // Running from creation, so virtual time waits for it to block
+    host_sync_task_created();
+    task_list_add(task);
+    if (pthread_create(&task->thread, NULL, task_main, task) != 0) {
+        task_exit(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == t_self) {
+        struct host_task *self = t_self;
+        host_sync_charge_waits(NULL);
+        t_self = NULL;
+        task_exit(self);
+        pthread_exit(NULL);
+    }
+}
+
+// Wait with the lock held until done() or the deadline; counts a wakeup
+// when the caller had to block
+static bool block_until(bool (*done)(void *), void *ctx, int64_t deadline)
+{
+    bool blocked = false;
+    bool met;
+
+    while (!(met = done(ctx))) {
+        if (!blocked) {
+            blocked = true;
+            host_sync_waiting(true);
+        }
+        if (!host_sync_wait(deadline)) {
+            met = done(ctx);
+            break;
+        }
+    }
+    if (blocked) {
+        host_sync_waiting(false);
+        if (t_self != NULL) {
+            t_self->wakeups++;
+        }
+    }
+    return met;
+}
+
+static bool never_done(void *ctx)
+{
+    return false;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    int64_t deadline = host_sync_deadline(ticks);
+
+    host_sync_lock();
+    block_until(never_done, NULL, deadline);
+    host_sync_unlock();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(host_clock_now_us() / 1000 / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t host_task_adopt(const char *name)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->thread = pthread_self();
+    task->wait_cpu.since_us = -1;
+    t_self = task;
+    host_sync_charge_waits(&task->wait_cpu);
+    task_list_add(task);
+    return task;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    // Threads the firmware did not create (the test's main thread) get a handle on first use
+    if (t_self == NULL) {
+        t_self = calloc(1, sizeof(*t_self));
+        strcpy(t_self->name, "host");
+    }
+    return t_self;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return 0;
+}
+
+uint32_t host_task_wakeups(TaskHandle_t task)
+{
+    host_sync_lock();
+    uint32_t wakeups = task->wakeups;
+    host_sync_unlock();
+    return wakeups;
+}
+
+void host_task_woken(void)
+{
+    if (t_self != NULL) {
+        host_sync_lock();
+        t_self->wakeups++;
+        host_sync_unlock();
+    }
+}
+
+// Thread CPU time less the time spent waiting
+static uint32_t task_cpu_us(const struct host_task *task)
+{
+    clockid_t clock;
+    struct timespec ts;
+
+    if (pthread_getcpuclockid(task->thread, &clock) != 0 || clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    int64_t cpu_us = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    int64_t run_us = cpu_us - host_sync_wait_cpu_us(&task->wait_cpu, cpu_us);
+    return (uint32_t)(run_us > 0 ? run_us : 0);
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t size, uint32_t *total_run_time)
+{
+    UBaseType_t count = 0;
+
+    host_sync_lock();
+    for (struct host_task *t = s_tasks; t != NULL; t = t->next) {
+        count++;
+    }
+    if (count > size) {
+        host_sync_unlock();
+        return 0;
+    }
+    count = 0;
+    for (struct host_task *t = s_tasks; t != NULL; t = t->next) {
+        TaskStatus_t *s = &status[count++];
+        memset(s, 0, sizeof(*s));
+        s->xHandle = t;
+        s->pcTaskName = t->name;
+        s->xTaskNumber = t->number;
+        s->uxCurrentPriority = t->priority;
+        s->uxBasePriority = t->priority;
+        s->ulRunTimeCounter = task_cpu_us(t);
+    }
+    host_sync_unlock();
+    if (total_run_time != NULL) {
+        *total_run_time = (uint32_t)host_clock_now_us();
+    }
+    return count;
+}
+
+static bool notified(void *ctx)
+{
+    return ((struct host_task *)ctx)->notify > 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct host_task *self = xTaskGetCurrentTaskHandle();
+    int64_t deadline = host_sync_deadline(ticks);
+    uint32_t value;
+
+    host_sync_lock();
+    block_until(notified, self, deadline);
+    value = self->notify;
+    if (value > 0) {
+        self->notify = clear_on_exit ? 0 : value - 1;
+    }
+    host_sync_unlock();
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    host_sync_lock();
+    task->notify++;
+    host_sync_broadcast();
+    host_sync_unlock();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    xTaskNotifyGive(task);
+    if (woken != NULL) {
+        *woken = pdTRUE;
+    }
+}
+
+static SemaphoreHandle_t sem_create(bool mutex)
+{
+    struct host_sem *sem = calloc(1, sizeof(*sem));
+    if (sem != NULL) {
+        sem->mutex = mutex;
+    }
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return sem_create(true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return sem_create(false);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    free(sem);
+}
+
+static bool sem_available(void *ctx)
+{
+    struct host_sem *sem = ctx;
+    return sem->mutex ? !sem->taken : sem->count > 0;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    int64_t deadline = host_sync_deadline(ticks);
+    BaseType_t ok = pdFALSE;
+
+    host_sync_lock();
+    if (block_until(sem_available, sem, deadline)) {
+        if (sem->mutex) {
+            sem->taken = true;
+        } else {
+            sem->count = 0;
+        }
+        ok = pdTRUE;
+    }
+    host_sync_unlock();
+    return ok;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    host_sync_lock();
+    if (sem->mutex) {
+        sem->taken = false;
+    } else {
+        sem->count = 1;
+    }
+    host_sync_broadcast();
+    host_sync_unlock();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken)
+{
+    return xSemaphoreGive(sem);
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return calloc(1, sizeof(struct host_event_group));
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    host_sync_lock();
+    group->bits |= bits;
+    EventBits_t value = group->bits;
+    host_sync_broadcast();
+    host_sync_unlock();
+    return value;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    host_sync_lock();
+    EventBits_t value = group->bits;
+    group->bits &= ~bits;
+    host_sync_unlock();
+    return value;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    host_sync_lock();
+    EventBits_t value = group->bits;
+    host_sync_unlock();
+    return value;
+}
+
+typedef struct {
+    struct host_event_group *group;
+    EventBits_t bits;
+    bool all;
+} bits_wait_t;
+
+static bool bits_set(void *ctx)
+{
+    bits_wait_t *w = ctx;
+    EventBits_t value = w->group->bits;
+    return w->all ? (value & w->bits) == w->bits : (value & w->bits) != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks)
+{
+    int64_t deadline = host_sync_deadline(ticks);
+    bits_wait_t wait = { .group = group, .bits = bits, .all = wait_for_all };
+
+    host_sync_lock();
+    bool met = block_until(bits_set, &wait, deadline);
+    EventBits_t value = group->bits;
+    if (met && clear_on_exit) {
+        group->bits &= ~bits;
+    }
+    host_sync_unlock();
+    return value;
+}
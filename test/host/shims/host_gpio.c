@@ -0,0 +1,190 @@
+#include "host_devices.h"
+#include "host_clock.h"
+#include "host_sync.h"
+#include "driver/gpio.h"
+#include "rom/ets_sys.h"
+
+#define HOST_GPIO_COUNT     17
+#define HOST_CPU_MHZ        160
+
+// DHT22 timing (datasheet): the host must pull the line low for at least
+// 1 ms; the sensor answers 20-40 us after release with 80 us low, 80 us high,
+// then 40 bits of 50 us low followed by 26-28 us ('0') or 70 us ('1') high
+#define DHT_MIN_START_US    500
+#define DHT_RESPONSE_US     30
+#define DHT_PREAMBLE_US     160
+#define DHT_BIT_LOW_US      50
+#define DHT_BIT_ZERO_US     27
+#define DHT_BIT_ONE_US      70
+
+typedef struct {
+    gpio_mode_t mode;
+    uint32_t level;
+    gpio_int_type_t intr;
+    gpio_isr_t isr;
+    void *arg;
+    int64_t low_since_us;
+    int64_t low_us;             // Length of the last low pulse driven
+} host_gpio_t;
+
+static host_gpio_t s_gpio[HOST_GPIO_COUNT];
+static int s_dht_gpio = -1;
+static int16_t s_dht_temperature = 215;
+static uint16_t s_dht_humidity = 550;
+static uint32_t s_dht_frames;
+static uint32_t s_edge_ccount;      // Set while the ISR runs for a synthesized edge
+static bool s_in_edge;
+
+void host_dht22_attach(int gpio)
+{
+    s_dht_gpio = gpio;
+}
+
+void host_dht22_set(int16_t temperature, uint16_t humidity)
+{
+    host_sync_lock();
+    s_dht_temperature = temperature;
+    s_dht_humidity = humidity;
+    host_sync_unlock();
+}
+
+uint32_t host_dht22_frames(void)
+{
+    host_sync_lock();
+    uint32_t frames = s_dht_frames;
+    host_sync_unlock();
+    return frames;
+}
+
+uint32_t host_ccount(void)
+{
+    if (s_in_edge) {
+        return s_edge_ccount;
+    }
+    return (uint32_t)(host_clock_now_us() * HOST_CPU_MHZ);
+}
+
+uint32_t ets_get_cpu_frequency(void)
+{
+    return HOST_CPU_MHZ;
+}
+
+void ets_delay_us(uint32_t us)
+{
+    int64_t deadline = host_clock_now_us() + us;
+
+    host_sync_lock();
+    host_sync_waiting(true);
+    while (host_sync_wait(deadline)) {
+    }
+    host_sync_waiting(false);
+    host_sync_unlock();
+}
+
+static void edge(host_gpio_t *pin, int64_t at_us)
+{
+    s_edge_ccount = (uint32_t)(at_us * HOST_CPU_MHZ);
+    s_in_edge = true;
+    pin->isr(pin->arg);
+    s_in_edge = false;
+}
+
+// The whole frame is delivered at once: its edges carry the times they would
+// have had, and the driver only looks at them after its conversion delay
+static void dht22_frame(host_gpio_t *pin)
+{
+    host_sync_lock();
+    int16_t temperature = s_dht_temperature;
+    uint16_t humidity = s_dht_humidity;
+    s_dht_frames++;
+    host_sync_unlock();
+
+    uint8_t data[5];
+    uint16_t raw_t = temperature < 0 ? (uint16_t)(0x8000 | -temperature) : (uint16_t)temperature;
+    data[0] = humidity >> 8;
+    data[1] = humidity & 0xFF;
+    data[2] = raw_t >> 8;
+    data[3] = raw_t & 0xFF;
+    data[4] = (uint8_t)(data[0] + data[1] + data[2] + data[3]);
+
+    int64_t t = host_clock_now_us() + DHT_RESPONSE_US;
+    edge(pin, t);
+    t += DHT_PREAMBLE_US;
+    edge(pin, t);
+    for (int i = 0; i < 40; i++) {
+        bool one = data[i / 8] & (0x80 >> (i % 8));
+        t += DHT_BIT_LOW_US + (one ? DHT_BIT_ONE_US : DHT_BIT_ZERO_US);
+        edge(pin, t);
+    }
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode)
+{
+    if (gpio < 0 || gpio >= HOST_GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_gpio_t *pin = &s_gpio[gpio];
+    gpio_mode_t was = pin->mode;
+
+    pin->mode = mode;
+    // Released after a start signal: the sensor answers on falling edges
+    if (gpio == s_dht_gpio && was == GPIO_MODE_OUTPUT && mode == GPIO_MODE_INPUT &&
+        pin->low_us >= DHT_MIN_START_US && pin->isr != NULL &&
+        (pin->intr == GPIO_INTR_NEGEDGE || pin->intr == GPIO_INTR_ANYEDGE)) {
+        pin->low_us = 0;
+        dht22_frame(pin);
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+    if (gpio < 0 || gpio >= HOST_GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_gpio_t *pin = &s_gpio[gpio];
+    int64_t now = host_clock_now_us();
+
+    if (pin->level != 0 && level == 0) {
+        pin->low_since_us = now;
+    } else if (pin->level == 0 && level != 0) {
+        pin->low_us = now - pin->low_since_us;
+    }
+    pin->level = level;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio, gpio_pull_mode_t pull)
+{
+    if (gpio < 0 || gpio >= HOST_GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pull == GPIO_PULLUP_ONLY) {
+        s_gpio[gpio].level = 1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio, gpio_int_type_t type)
+{
+    if (gpio < 0 || gpio >= HOST_GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_gpio[gpio].intr = type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void *arg)
+{
+    if (gpio < 0 || gpio >= HOST_GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_gpio[gpio].isr = handler;
+    s_gpio[gpio].arg = arg;
+    return ESP_OK;
+}
@@ -0,0 +1,336 @@
+#include "host_devices.h"
+#include "host_clock.h"
+#include "host_sync.h"
+#include <stdlib.h>
+#include <string.h>
+#include "driver/i2c.h"
+
+// 100 kHz: nine clocks per byte, plus start and stop
+#define I2C_BYTE_US         90
+#define I2C_FRAME_US        20
+
+#define I2C_MAX_OPS         8
+#define I2C_MAX_DEVICES     4
+
+#define SSD1306_WIDTH       128
+#define SSD1306_PAGES       8
+
+typedef enum {
+    OP_START,
+    OP_WRITE,
+    OP_READ,
+    OP_STOP,
+} op_type_t;
+
+typedef struct {
+    op_type_t type;
+    uint8_t byte;               // Single-byte writes are copied
+    const uint8_t *data;
+    uint8_t *dst;
+    size_t len;
+} op_t;
+
+struct host_i2c_cmd {
+    op_t ops[I2C_MAX_OPS];
+    int count;
+};
+
+typedef struct {
+    uint8_t addr;
+    void (*write)(const uint8_t *data, size_t len);
+    void (*read)(uint8_t *data, size_t len);
+} device_t;
+
+static device_t s_devices[I2C_MAX_DEVICES];
+static int s_device_count;
+static host_i2c_stats_t s_stats;
+
+// SSD1306: display RAM and the command being received, whose arguments may
+// come in later transactions
+static uint8_t s_gddram[SSD1306_PAGES][SSD1306_WIDTH];
+static uint8_t s_ssd_cmd[3];
+static int s_ssd_cmd_len;
+static int s_ssd_cmd_args;
+static int s_col, s_col_start, s_col_end = SSD1306_WIDTH - 1;
+static int s_page, s_page_start, s_page_end = SSD1306_PAGES - 1;
+
+// SHT3x: the last measurement, read back once
+static int16_t s_sht_temperature = 215;
+static uint16_t s_sht_humidity = 550;
+static uint8_t s_sht_result[6];
+static size_t s_sht_pos = sizeof(s_sht_result);
+
+static void add_device(uint8_t addr, void (*write)(const uint8_t *, size_t), void (*read)(uint8_t *, size_t))
+{
+    if (s_device_count < I2C_MAX_DEVICES) {
+        s_devices[s_device_count++] = (device_t){ .addr = addr, .write = write, .read = read };
+    }
+}
+
+static int ssd1306_arg_count(uint8_t cmd)
+{
+    switch (cmd) {
+        case 0x21:                  // Column address
+        case 0x22:                  // Page address
+            return 2;
+        case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+        case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void ssd1306_command(const uint8_t *cmd)
+{
+    if (cmd[0] == 0x21) {
+        s_col_start = s_col = cmd[1] % SSD1306_WIDTH;
+        s_col_end = cmd[2] % SSD1306_WIDTH;
+    } else if (cmd[0] == 0x22) {
+        s_page_start = s_page = cmd[1] % SSD1306_PAGES;
+        s_page_end = cmd[2] % SSD1306_PAGES;
+    }
+}
+
+static void ssd1306_write(const uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    bool command = (data[0] & 0x40) == 0;
+    for (size_t i = 1; i < len; i++) {
+        if (!command) {
+            s_gddram[s_page][s_col] = data[i];
+            if (s_col++ == s_col_end) {
+                s_col = s_col_start;
+                s_page = (s_page == s_page_end) ? s_page_start : s_page + 1;
+            }
+            continue;
+        }
+        if (s_ssd_cmd_len == 0) {
+            s_ssd_cmd_args = ssd1306_arg_count(data[i]);
+        }
+        s_ssd_cmd[s_ssd_cmd_len++] = data[i];
+        if (s_ssd_cmd_len > s_ssd_cmd_args) {
+            ssd1306_command(s_ssd_cmd);
+            s_ssd_cmd_len = 0;
+        }
+    }
+}
+
+void host_i2c_add_ssd1306(uint8_t addr)
+{
+    add_device(addr, ssd1306_write, NULL);
+}
+
+bool host_ssd1306_pixel(int x, int y)
+{
+    if (x < 0 || x >= SSD1306_WIDTH || y < 0 || y >= SSD1306_PAGES * 8) {
+        return false;
+    }
+    host_sync_lock();
+    bool on = (s_gddram[y / 8][x] >> (y % 8)) & 1;
+    host_sync_unlock();
+    return on;
+}
+
+// CRC-8, polynomial 0x31, initial value 0xFF
+static uint8_t sht3x_crc(const uint8_t *data)
+{
+    uint8_t crc = 0xFF;
+    for (int i = 0; i < 2; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void sht3x_write(const uint8_t *data, size_t len)
+{
+    if (len < 2) {
+        return;
+    }
+    uint16_t command = (data[0] << 8) | data[1];
+    if (command == 0x30A2) {
+        s_sht_pos = sizeof(s_sht_result);
+    } else if (command == 0x2400) {
+        // Inverse of T = -45 + 175 * raw / 65535 and RH = 100 * raw / 65535, in tenths
+        uint16_t raw_t = (uint16_t)(((int32_t)s_sht_temperature + 450) * 65535 / 1750);
+        uint16_t raw_h = (uint16_t)((uint32_t)s_sht_humidity * 65535 / 1000);
+        s_sht_result[0] = raw_t >> 8;
+        s_sht_result[1] = raw_t & 0xFF;
+        s_sht_result[2] = sht3x_crc(&s_sht_result[0]);
+        s_sht_result[3] = raw_h >> 8;
+        s_sht_result[4] = raw_h & 0xFF;
+        s_sht_result[5] = sht3x_crc(&s_sht_result[3]);
+        s_sht_pos = 0;
+    }
+}
+
+static void sht3x_read(uint8_t *data, size_t len)
+{
+    // Without a measurement the sensor does not acknowledge; the bus reads 0xFF
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (s_sht_pos < sizeof(s_sht_result)) ? s_sht_result[s_sht_pos++] : 0xFF;
+    }
+}
+
+void host_i2c_add_sht3x(uint8_t addr)
+{
+    add_device(addr, sht3x_write, sht3x_read);
+}
+
+void host_sht3x_set(int16_t temperature, uint16_t humidity)
+{
+    host_sync_lock();
+    s_sht_temperature = temperature;
+    s_sht_humidity = humidity;
+    host_sync_unlock();
+}
+
+void host_i2c_get_stats(host_i2c_stats_t *stats)
+{
+    host_sync_lock();
+    *stats = s_stats;
+    host_sync_unlock();
+}
+
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *conf)
+{
+    return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    return calloc(1, sizeof(struct host_i2c_cmd));
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd)
+{
+    free(cmd);
+}
+
+static esp_err_t add_op(i2c_cmd_handle_t cmd, op_t op)
+{
+    if (cmd == NULL || cmd->count == I2C_MAX_OPS) {
+        return ESP_ERR_NO_MEM;
+    }
+    cmd->ops[cmd->count++] = op;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd)
+{
+    return add_op(cmd, (op_t){ .type = OP_START });
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en)
+{
+    return add_op(cmd, (op_t){ .type = OP_WRITE, .byte = data, .len = 1 });
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, uint8_t *data, size_t len, bool ack_en)
+{
+    return add_op(cmd, (op_t){ .type = OP_WRITE, .data = data, .len = len });
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd, uint8_t *data, i2c_ack_type_t ack)
+{
+    return add_op(cmd, (op_t){ .type = OP_READ, .dst = data, .len = 1 });
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t len, i2c_ack_type_t ack)
+{
+    return add_op(cmd, (op_t){ .type = OP_READ, .dst = data, .len = len });
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd)
+{
+    return add_op(cmd, (op_t){ .type = OP_STOP });
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks)
+{
+    uint8_t written[64];
+    size_t written_len = 0;
+    size_t bytes = 0;
+    device_t *device = NULL;
+    bool addressed = false;
+    bool read = false;
+    esp_err_t err = ESP_OK;
+
+    // Writes are gathered so a device sees one transaction; the driver's
+    // largest (display data) is 18 bytes
+    for (int i = 0; i < cmd->count && err == ESP_OK; i++) {
+        op_t *op = &cmd->ops[i];
+        const uint8_t *data = op->data != NULL ? op->data : &op->byte;
+        switch (op->type) {
+            case OP_START:
+                addressed = false;
+                break;
+            case OP_WRITE:
+            {
+                size_t len = op->len;
+                bytes += len;
+                if (!addressed) {
+                    addressed = true;
+                    read = data[0] & 1;
+                    device = NULL;
+                    for (int d = 0; d < s_device_count; d++) {
+                        if (s_devices[d].addr == data[0] >> 1) {
+                            device = &s_devices[d];
+                        }
+                    }
+                    if (device == NULL) {
+                        err = ESP_FAIL;
+                        break;
+                    }
+                    data++;
+                    len--;
+                }
+                if (!read && written_len + len <= sizeof(written)) {
+                    memcpy(written + written_len, data, len);
+                    written_len += len;
+                }
+                break;
+            }
+            case OP_READ:
+                bytes += op->len;
+                if (device != NULL && read && device->read != NULL) {
+                    host_sync_lock();
+                    device->read(op->dst, op->len);
+                    host_sync_unlock();
+                } else {
+                    memset(op->dst, 0xFF, op->len);
+                }
+                break;
+            case OP_STOP:
+                break;
+        }
+    }
+    if (err == ESP_OK && device != NULL && !read && device->write != NULL) {
+        host_sync_lock();
+        device->write(written, written_len);
+        host_sync_unlock();
+    }
+
+    host_sync_lock();
+    s_stats.transactions++;
+    s_stats.nacks += (err != ESP_OK);
+    s_stats.bytes += bytes;
+    // The task is held for the bus time, as the driver waits for its ISR
+    int64_t deadline = host_clock_now_us() + I2C_FRAME_US + (int64_t)bytes * I2C_BYTE_US;
+    host_sync_waiting(true);
+    while (host_sync_wait(deadline)) {
+    }
+    host_sync_waiting(false);
+    host_sync_unlock();
+    return err;
+}
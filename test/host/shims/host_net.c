@@ -0,0 +1,215 @@
+#include "host_net.h"
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/select.h>
+#include <errno.h>
+#include <string.h>
+#include "host_clock.h"
+#include "host_sync.h"
+
+// Not lwip/sockets.h: this file calls the host functions it stands in for
+
+#define HOST_NET_MAX_REDIRECTS 8
+
+static struct {
+    uint16_t port;
+    uint16_t local_port;
+} s_redirects[HOST_NET_MAX_REDIRECTS];
+static uint64_t s_tx_bytes;
+static uint64_t s_rx_bytes;
+static bool s_link_down;
+
+void host_net_redirect(uint16_t port, uint16_t local_port)
+{
+    for (int i = 0; i < HOST_NET_MAX_REDIRECTS; i++) {
+        if (s_redirects[i].port == 0 || s_redirects[i].port == port) {
+            s_redirects[i].port = port;
+            s_redirects[i].local_port = local_port;
+            return;
+        }
+    }
+}
+
+void host_net_set_link(bool up)
+{
+    __atomic_store_n(&s_link_down, !up, __ATOMIC_RELEASE);
+}
+
+void host_net_get_counters(uint64_t *tx_bytes, uint64_t *rx_bytes)
+{
+    *tx_bytes = __atomic_load_n(&s_tx_bytes, __ATOMIC_RELAXED);
+    *rx_bytes = __atomic_load_n(&s_rx_bytes, __ATOMIC_RELAXED);
+}
+
+// Rewrite an IPv4 destination that has a redirect; returns addr unchanged otherwise
+static const struct sockaddr *redirect(const struct sockaddr *addr, struct sockaddr_in *local)
+{
+    if (addr == NULL || addr->sa_family != AF_INET) {
+        return addr;
+    }
+    memcpy(local, addr, sizeof(*local));
+    for (int i = 0; i < HOST_NET_MAX_REDIRECTS && s_redirects[i].port != 0; i++) {
+        if (ntohs(local->sin_port) == s_redirects[i].port) {
+            local->sin_port = htons(s_redirects[i].local_port);
+            local->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            return (const struct sockaddr *)local;
+        }
+    }
+    return addr;
+}
+
+// Without an address only the host itself can be reached; redirected ports
+// stand for remote servers even when the firmware has them at 127.0.0.1
+static bool unreachable(const struct sockaddr *addr)
+{
+    if (addr == NULL || addr->sa_family != AF_INET || !__atomic_load_n(&s_link_down, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    struct sockaddr_in local;
+    const struct sockaddr_in *in = (const struct sockaddr_in *)addr;
+    if (in->sin_addr.s_addr == htonl(INADDR_LOOPBACK) && redirect(addr, &local) == addr) {
+        return false;
+    }
+    errno = ENETUNREACH;
+    return true;
+}
+
+static void count(uint64_t *counter, ssize_t n)
+{
+    if (n > 0) {
+        __atomic_add_fetch(counter, (uint64_t)n, __ATOMIC_RELAXED);
+    }
+}
+
+int host_net_connect(int fd, const struct sockaddr *addr, socklen_t len)
+{
+    struct sockaddr_in local;
+    if (unreachable(addr)) {
+        return -1;
+    }
+    return connect(fd, redirect(addr, &local), len);
+}
+
+// Also wakes tasks polling in select(), so a datagram one task sends another
+// (the network loop's wake socket) is seen before virtual time moves on
+ssize_t host_net_sendto(int fd, const void *data, size_t len, int flags,
+                        const struct sockaddr *addr, socklen_t addr_len)
+{
+    struct sockaddr_in local;
+    if (unreachable(addr)) {
+        return -1;
+    }
+    ssize_t n = sendto(fd, data, len, flags | MSG_NOSIGNAL, redirect(addr, &local), addr_len);
+    count(&s_tx_bytes, n);
+    host_sync_lock();
+    host_sync_broadcast();
+    host_sync_unlock();
+    return n;
+}
+
+ssize_t host_net_send(int fd, const void *data, size_t len, int flags)
+{
+    ssize_t n = send(fd, data, len, flags | MSG_NOSIGNAL);
+    count(&s_tx_bytes, n);
+    return n;
+}
+
+ssize_t host_net_recv(int fd, void *data, size_t len, int flags)
+{
+    ssize_t n = recv(fd, data, len, flags);
+    count(&s_rx_bytes, n);
+    return n;
+}
+
+ssize_t host_net_recvfrom(int fd, void *data, size_t len, int flags,
+                          struct sockaddr *addr, socklen_t *addr_len)
+{
+    ssize_t n = recvfrom(fd, data, len, flags, addr, addr_len);
+    count(&s_rx_bytes, n);
+    return n;
+}
+
+// In virtual time the timeout is virtual too: sockets are polled while the
+// task waits like any other, so a day of select() timeouts passes at once
+int host_net_select(int nfds, fd_set *read_fds, fd_set *write_fds, fd_set *except_fds,
+                    struct timeval *timeout)
+{
+    if (!host_clock_is_virtual()) {
+        return select(nfds, read_fds, write_fds, except_fds, timeout);
+    }
+
+    fd_set want[3];
+    fd_set *sets[3] = { read_fds, write_fds, except_fds };
+    int64_t deadline = -1;
+    if (timeout != NULL) {
+        deadline = host_clock_now_us() + (int64_t)timeout->tv_sec * 1000000 + timeout->tv_usec;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (sets[i] != NULL) {
+            want[i] = *sets[i];
+        }
+    }
+
+    // Polling again after each wait is part of the wait
+    bool blocked = false;
+    while (1) {
+        struct timeval now = { 0 };
+        int ready = select(nfds, read_fds, write_fds, except_fds, &now);
+        if (ready != 0) {
+            if (blocked) {
+                host_sync_waiting(false);
+                host_task_woken();
+            }
+            return ready;
+        }
+        if (!blocked) {
+            host_sync_waiting(true);
+        }
+        host_sync_lock();
+        bool waiting = host_sync_poll(deadline);
+        host_sync_unlock();
+        if (!waiting) {
+            host_sync_waiting(false);
+            for (int i = 0; i < 3; i++) {
+                if (sets[i] != NULL) {
+                    FD_ZERO(sets[i]);
+                }
+            }
+            return 0;
+        }
+        blocked = true;
+        for (int i = 0; i < 3; i++) {
+            if (sets[i] != NULL) {
+                *sets[i] = want[i];
+            }
+        }
+    }
+}
+
+// Last: lwip/dns.h pulls in the socket macros, which must not rename the functions above
+#include "lwip/dns.h"
+
+// Queries go to port 53 wherever the firmware points them, and a test
+// redirects that port; until then, to 127.0.0.1
+static ip_addr_t s_dns_servers[2];
+
+void dns_setserver(uint8_t index, const ip_addr_t *server)
+{
+    if (index < 2) {
+        s_dns_servers[index] = *server;
+    }
+}
+
+const ip_addr_t *dns_getserver(uint8_t index)
+{
+    static ip_addr_t loopback;
+
+    if (index < 2 && s_dns_servers[index].addr != 0) {
+        return &s_dns_servers[index];
+    }
+    loopback.addr = htonl(INADDR_LOOPBACK);
+    return &loopback;
+}
@@ -0,0 +1,29 @@
+#ifndef HOST_NET_H
+#define HOST_NET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The lwIP socket API maps onto host sockets (see lwip/sockets.h). Firmware
+ * connects to fixed ports on remote hosts; tests send those to local servers.
+ */
+
+/**
+ * @brief Send TCP and UDP traffic for port to 127.0.0.1:local_port instead
+ */
+void host_net_redirect(uint16_t port, uint16_t local_port);
+
+/**
+ * @brief Whether the station has an address; without one, connections and
+ *        datagrams to other hosts and to redirected ports fail with
+ *        ENETUNREACH. Up unless the WiFi stand-in (host_devices.h) is in use.
+ */
+void host_net_set_link(bool up);
+
+/**
+ * @brief Bytes sent and received through the firmware's sockets so far
+ */
+void host_net_get_counters(uint64_t *tx_bytes, uint64_t *rx_bytes);
+
+#endif // HOST_NET_H
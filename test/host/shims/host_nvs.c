@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+#include "nvs_flash.h"
+
+// NVS in memory: one list of (namespace, key) blobs shared by all handles
+
+#define HOST_NVS_NAME_LEN 16
+
+typedef struct host_nvs_entry {
+    char ns[HOST_NVS_NAME_LEN];
+    char key[HOST_NVS_NAME_LEN];
+    void *value;
+    size_t length;
+    struct host_nvs_entry *next;
+} host_nvs_entry_t;
+
+static char s_namespaces[8][HOST_NVS_NAME_LEN];
+static host_nvs_entry_t *s_entries;
+
+esp_err_t nvs_open(const char *name, nvs_open_mode mode, nvs_handle *out_handle)
+{
+    for (int i = 0; i < 8; i++) {
+        if (strcmp(s_namespaces[i], name) == 0 || s_namespaces[i][0] == '\0') {
+            strncpy(s_namespaces[i], name, HOST_NVS_NAME_LEN - 1);
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle handle)
+{
+}
+
+esp_err_t nvs_commit(nvs_handle handle)
+{
+    return ESP_OK;
+}
+
+static host_nvs_entry_t **find(nvs_handle handle, const char *key)
+{
+    host_nvs_entry_t **p = &s_entries;
+
+    for (; *p != NULL; p = &(*p)->next) {
+        if (strcmp((*p)->ns, s_namespaces[handle - 1]) == 0 && strcmp((*p)->key, key) == 0) {
+            break;
+        }
+    }
+    return p;
+}
+
+esp_err_t nvs_erase_key(nvs_handle handle, const char *key)
+{
+    host_nvs_entry_t **p = find(handle, key);
+    host_nvs_entry_t *entry = *p;
+
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *p = entry->next;
+    free(entry->value);
+    free(entry);
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle handle, const char *key, const void *value, size_t length)
+{
+    host_nvs_entry_t **p = find(handle, key);
+    void *copy = malloc(length ? length : 1);
+
+    if (copy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, value, length);
+    if (*p == NULL) {
+        *p = calloc(1, sizeof(host_nvs_entry_t));
+        if (*p == NULL) {
+            free(copy);
+            return ESP_ERR_NO_MEM;
+        }
+        strncpy((*p)->ns, s_namespaces[handle - 1], HOST_NVS_NAME_LEN - 1);
+        strncpy((*p)->key, key, HOST_NVS_NAME_LEN - 1);
+    }
+    free((*p)->value);
+    (*p)->value = copy;
+    (*p)->length = length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle handle, const char *key, void *out_value, size_t *length)
+{
+    host_nvs_entry_t *entry = *find(handle, key);
+
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out_value == NULL) {
+        *length = entry->length;
+        return ESP_OK;
+    }
+    if (*length < entry->length) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, entry->value, entry->length);
+    *length = entry->length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    while (s_entries != NULL) {
+        host_nvs_entry_t *entry = s_entries;
+        s_entries = entry->next;
+        free(entry->value);
+        free(entry);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+// Logging, heap figures and system calls of the SDK, for host builds
+
+static esp_log_level_t s_log_level = ESP_LOG_INFO;
+static uint32_t s_min_free = HOST_HEAP_SIZE;
+static uint32_t s_random = 0x12345678;
+static esp_reset_reason_t s_reset_reason = ESP_RST_POWERON;
+
+volatile uint32_t host_rtc_counter;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    if (strcmp(tag, "*") == 0) {
+        s_log_level = level;
+    }
+}
+
+void host_log(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+    va_list args;
+
+    if (level > s_log_level) {
+        return;
+    }
+    flockfile(stdout);
+    printf("%c (%lld) %s: ", letters[level], (long long)(esp_timer_get_time() / 1000), tag);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+    funlockfile(stdout);
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    struct mallinfo2 info = mallinfo2();
+    uint32_t used = (uint32_t)info.uordblks;
+    uint32_t free_bytes = (used < HOST_HEAP_SIZE) ? HOST_HEAP_SIZE - used : 0;
+
+    if (free_bytes < s_min_free) {
+        s_min_free = free_bytes;
+    }
+    return free_bytes;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    esp_get_free_heap_size();
+    return s_min_free;
+}
+
+uint32_t esp_random(void)
+{
+    // Deterministic, so runs can be repeated
+    s_random ^= s_random << 13;
+    s_random ^= s_random >> 17;
+    s_random ^= s_random << 5;
+    return s_random;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    static const uint8_t host_mac[6] = { 0x02, 0x00, 0x00, 0xAB, 0xCD, 0xEF };
+    memcpy(mac, host_mac, sizeof(host_mac));
+    return ESP_OK;
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return s_reset_reason;
+}
+
+void host_set_reset_reason(esp_reset_reason_t reason)
+{
+    s_reset_reason = reason;
+}
+
+void esp_restart(void)
+{
+    fprintf(stderr, "esp_restart() called\n");
+    abort();
+}
+
+// One malloc arena for all threads, so mallinfo2() sees every task's heap
+__attribute__((constructor)) static void host_platform_init(void)
+{
+    mallopt(M_ARENA_MAX, 1);
+}
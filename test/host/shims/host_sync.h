@@ -0,0 +1,78 @@
+#ifndef HOST_SYNC_H
+#define HOST_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * One lock and condition for every blocking object of the host shims
+ * (semaphores, notifications, event groups, delays). Moving virtual time or
+ * changing any object wakes all waiters, which re-check their own condition;
+ * that keeps timeouts right in both real and virtual time.
+ */
+
+void host_sync_lock(void);
+void host_sync_unlock(void);
+
+/**
+ * @brief Wait with the lock held until something changes
+ * @param deadline_us Host clock time to give up at, or -1 to wait forever
+ * @return false once the deadline has passed
+ */
+bool host_sync_wait(int64_t deadline_us);
+
+/**
+ * @brief Same, but also returns after a short real-time pause, for waits on
+ *        something outside the shims (a socket) that has to be polled
+ */
+bool host_sync_poll(int64_t deadline_us);
+
+/**
+ * @brief Wake all waiters; call with the lock held
+ */
+void host_sync_broadcast(void);
+
+/**
+ * @brief Deadline on the host clock for a FreeRTOS tick timeout (-1 for portMAX_DELAY)
+ */
+int64_t host_sync_deadline(uint32_t ticks);
+
+/**
+ * @brief Firmware tasks: virtual time waits while any of them is running (see
+ *        host_clock_run_idle()). A task counts as running from its creation;
+ *        its thread attaches itself and ends with host_sync_task_end().
+ */
+void host_sync_task_created(void);
+void host_sync_task_attach(void);
+void host_sync_task_end(void);
+
+/**
+ * @brief Count a return from a blocking call that had to wait, for the calling task
+ */
+void host_task_woken(void);
+
+/**
+ * @brief Host CPU time a thread spends waiting. With virtual time every
+ *        sleeper wakes at each step to re-check, which is the simulation's
+ *        cost, not the task's.
+ */
+typedef struct {
+    int64_t total_us;           // Waits that have ended
+    int64_t since_us;           // Thread CPU time the current wait began at, -1 if none
+} host_wait_cpu_t;
+
+/**
+ * @brief Charge the calling thread's waits to *account (NULL to stop).
+ *        host_sync waits count by themselves; host_sync_waiting() brackets
+ *        other waiting (true, then false), and brackets may nest.
+ */
+void host_sync_charge_waits(host_wait_cpu_t *account);
+void host_sync_waiting(bool waiting);
+
+/**
+ * @brief Wait time in *account as of cpu_now_us, the thread's CPU time now,
+ *        including a wait in progress; safe from another thread
+ */
+int64_t host_sync_wait_cpu_us(const host_wait_cpu_t *account, int64_t cpu_now_us);
+
+#endif // HOST_SYNC_H
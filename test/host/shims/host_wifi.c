@@ -0,0 +1,417 @@
+#include "host_devices.h"
+#include "host_clock.h"
+#include "host_net.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "tcpip_adapter.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Station side of the SDK against one simulated access point. Steps that take
+// air time run on an esp_timer and report through the default event loop.
+
+#define AP_CHANNEL          6
+#define AP_START_MS         50
+#define AP_SCAN_MS          1500      // Active scan of channels 1-13
+#define AP_ASSOC_MS         300       // Authentication and association
+#define AP_DHCP_MS          700
+#define AP_NOT_FOUND_MS     3000      // Probing for an AP that does not answer
+
+#define EVENT_TASK_STACK    2048
+#define EVENT_TASK_PRIORITY 20
+#define MAX_HANDLERS        8
+
+const char *WIFI_EVENT = "WIFI_EVENT";
+const char *IP_EVENT = "IP_EVENT";
+
+typedef struct event {
+    esp_event_base_t base;
+    int32_t id;
+    struct event *next;
+    size_t size;
+    uint8_t data[];
+} event_t;
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} handler_t;
+
+typedef enum {
+    STEP_NONE,
+    STEP_START,
+    STEP_SCAN,
+    STEP_ASSOC,
+    STEP_DHCP,
+    STEP_NOT_FOUND,
+} step_t;
+
+static const uint8_t s_ap_bssid[6] = { 0x24, 0x4B, 0xFE, 0x10, 0x20, 0x30 };
+
+// Not the host_sync lock: esp_timer calls are made with this one held
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Event loop
+static TaskHandle_t s_event_task;
+static event_t *s_events;
+static handler_t s_handlers[MAX_HANDLERS];
+static int s_handler_count;
+
+// Station and AP
+static esp_timer_handle_t s_timer;
+static step_t s_step;
+static int64_t s_step_due_us;
+static wifi_config_t s_config;
+static bool s_ap_up = true;
+static int8_t s_rssi = -60;
+static bool s_associated;
+static bool s_scanned;              // Scan results are for the AP being up
+static wifi_ps_type_t s_ps = WIFI_PS_NONE;
+static int64_t s_awake_since_us = -1;
+static host_wifi_stats_t s_stats;
+
+static void event_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (1) {
+            pthread_mutex_lock(&s_lock);
+            event_t *event = s_events;
+            if (event != NULL) {
+                s_events = event->next;
+            }
+            int count = s_handler_count;
+            pthread_mutex_unlock(&s_lock);
+            if (event == NULL) {
+                break;
+            }
+            for (int i = 0; i < count; i++) {
+                handler_t *h = &s_handlers[i];
+                if (h->base == event->base && (h->id == ESP_EVENT_ANY_ID || h->id == event->id)) {
+                    h->handler(h->arg, event->base, event->id, event->size > 0 ? event->data : NULL);
+                }
+            }
+            free(event);
+        }
+    }
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    if (s_event_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return xTaskCreate(event_task, "esp_event", EVENT_TASK_STACK, NULL, EVENT_TASK_PRIORITY,
+                       &s_event_task) == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id,
+                                     esp_event_handler_t handler, void *arg)
+{
+    esp_err_t err = ESP_ERR_NO_MEM;
+
+    pthread_mutex_lock(&s_lock);
+    if (s_handler_count < MAX_HANDLERS) {
+        s_handlers[s_handler_count++] = (handler_t){ base, id, handler, arg };
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void *data, size_t size,
+                         uint32_t ticks)
+{
+    event_t *event = malloc(sizeof(*event) + size);
+
+    if (event == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    event->base = base;
+    event->id = id;
+    event->size = size;
+    event->next = NULL;
+    if (size > 0) {
+        memcpy(event->data, data, size);
+    }
+    pthread_mutex_lock(&s_lock);
+    event_t **tail = &s_events;
+    while (*tail != NULL) {
+        tail = &(*tail)->next;
+    }
+    *tail = event;
+    pthread_mutex_unlock(&s_lock);
+    if (s_event_task != NULL) {
+        xTaskNotifyGive(s_event_task);
+    }
+    return ESP_OK;
+}
+
+// With the lock held
+static void schedule(step_t step, uint32_t ms)
+{
+    s_step = step;
+    s_step_due_us = host_clock_now_us() + (int64_t)ms * 1000;
+    esp_timer_stop(s_timer);
+    esp_timer_start_once(s_timer, (uint64_t)ms * 1000);
+}
+
+static void post_disconnected(uint8_t reason)
+{
+    wifi_event_sta_disconnected_t event = { .reason = reason };
+
+    memcpy(event.bssid, s_ap_bssid, sizeof(event.bssid));
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event, sizeof(event), 0);
+}
+
+// Radio time at full power: power save off while associated
+static void awake_update(void)
+{
+    int64_t now = host_clock_now_us();
+    bool awake = s_associated && s_ps == WIFI_PS_NONE;
+
+    if (s_awake_since_us >= 0) {
+        s_stats.awake_us += now - s_awake_since_us;
+    }
+    s_awake_since_us = awake ? now : -1;
+}
+
+// Association lost: with the lock held
+static void drop(void)
+{
+    s_associated = false;
+    awake_update();
+    s_stats.disconnects++;
+    host_net_set_link(false);
+}
+
+static void step_cb(void *arg)
+{
+    pthread_mutex_lock(&s_lock);
+    if (host_clock_now_us() < s_step_due_us) {
+        // Fired for a step that has been replaced since
+        pthread_mutex_unlock(&s_lock);
+        return;
+    }
+    step_t step = s_step;
+    bool ap_up = s_ap_up;
+    s_step = STEP_NONE;
+
+    switch (step) {
+        case STEP_START:
+            pthread_mutex_unlock(&s_lock);
+            esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, 0);
+            return;
+
+        case STEP_SCAN:
+            s_scanned = ap_up;
+            pthread_mutex_unlock(&s_lock);
+            esp_event_post(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, NULL, 0, 0);
+            return;
+
+        case STEP_ASSOC:
+        {
+            wifi_event_sta_connected_t event = { .channel = AP_CHANNEL, .authmode = WIFI_AUTH_WPA2_PSK };
+            size_t ssid_len = strnlen((const char *)s_config.sta.ssid, sizeof(event.ssid));
+            memcpy(event.ssid, s_config.sta.ssid, ssid_len);
+            event.ssid_len = (uint8_t)ssid_len;
+            memcpy(event.bssid, s_ap_bssid, sizeof(event.bssid));
+            s_associated = true;
+            awake_update();
+            schedule(STEP_DHCP, AP_DHCP_MS);
+            pthread_mutex_unlock(&s_lock);
+            esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &event, sizeof(event), 0);
+            return;
+        }
+
+        case STEP_DHCP:
+        {
+            ip_event_got_ip_t event = { .ip_changed = false };
+            IP4_ADDR(&event.ip_info.ip, 192, 168, 1, 50);
+            IP4_ADDR(&event.ip_info.netmask, 255, 255, 255, 0);
+            IP4_ADDR(&event.ip_info.gw, 192, 168, 1, 1);
+            host_net_set_link(true);
+            pthread_mutex_unlock(&s_lock);
+            esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event), 0);
+            return;
+        }
+
+        case STEP_NOT_FOUND:
+            pthread_mutex_unlock(&s_lock);
+            post_disconnected(WIFI_REASON_NO_AP_FOUND);
+            return;
+
+        default:
+            pthread_mutex_unlock(&s_lock);
+            return;
+    }
+}
+
+void host_wifi_set_ap(bool up, int8_t rssi)
+{
+    pthread_mutex_lock(&s_lock);
+    s_rssi = rssi;
+    s_ap_up = up;
+    if (!up && s_step == STEP_ASSOC) {
+        schedule(STEP_NOT_FOUND, AP_NOT_FOUND_MS);
+    } else if (!up && s_associated) {
+        // Beacons stop: the station notices after a few missed ones
+        esp_timer_stop(s_timer);
+        s_step = STEP_NONE;
+        drop();
+        pthread_mutex_unlock(&s_lock);
+        post_disconnected(WIFI_REASON_BEACON_TIMEOUT);
+        return;
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_wifi_get_stats(host_wifi_stats_t *stats)
+{
+    pthread_mutex_lock(&s_lock);
+    awake_update();
+    *stats = s_stats;
+    pthread_mutex_unlock(&s_lock);
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    const esp_timer_create_args_t args = {
+        .callback = step_cb,
+        .name = "host_ap",
+    };
+
+    // No address until DHCP has run
+    host_net_set_link(false);
+    return esp_timer_create(&args, &s_timer);
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    return mode == WIFI_MODE_STA ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    pthread_mutex_lock(&s_lock);
+    s_config = *conf;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    pthread_mutex_lock(&s_lock);
+    schedule(STEP_START, AP_START_MS);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    pthread_mutex_lock(&s_lock);
+    s_stats.connects++;
+    bool reachable = s_ap_up && (!s_config.sta.bssid_set ||
+                                 memcmp(s_config.sta.bssid, s_ap_bssid, sizeof(s_ap_bssid)) == 0);
+    schedule(reachable ? STEP_ASSOC : STEP_NOT_FOUND, reachable ? AP_ASSOC_MS : AP_NOT_FOUND_MS);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    pthread_mutex_lock(&s_lock);
+    bool active = s_associated || s_step == STEP_ASSOC || s_step == STEP_DHCP || s_step == STEP_NOT_FOUND;
+    if (!active) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_OK;
+    }
+    esp_timer_stop(s_timer);
+    s_step = STEP_NONE;
+    if (s_associated) {
+        drop();
+    }
+    pthread_mutex_unlock(&s_lock);
+    post_disconnected(WIFI_REASON_ASSOC_LEAVE);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block)
+{
+    pthread_mutex_lock(&s_lock);
+    if (s_step == STEP_SCAN) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_stats.scans++;
+    schedule(STEP_SCAN, AP_SCAN_MS);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t *number, wifi_ap_record_t *records)
+{
+    pthread_mutex_lock(&s_lock);
+    uint16_t count = 0;
+    if (s_scanned && *number > 0) {
+        wifi_ap_record_t *ap = &records[count++];
+        memset(ap, 0, sizeof(*ap));
+        memcpy(ap->bssid, s_ap_bssid, sizeof(ap->bssid));
+        memcpy(ap->ssid, s_config.sta.ssid, sizeof(s_config.sta.ssid));
+        ap->primary = AP_CHANNEL;
+        ap->rssi = s_rssi;
+        ap->authmode = WIFI_AUTH_WPA2_PSK;
+    }
+    *number = count;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *info)
+{
+    pthread_mutex_lock(&s_lock);
+    if (!s_associated) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_FAIL;
+    }
+    memset(info, 0, sizeof(*info));
+    memcpy(info->bssid, s_ap_bssid, sizeof(info->bssid));
+    memcpy(info->ssid, s_config.sta.ssid, sizeof(s_config.sta.ssid));
+    info->primary = AP_CHANNEL;
+    info->rssi = s_rssi;
+    info->authmode = WIFI_AUTH_WPA2_PSK;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    pthread_mutex_lock(&s_lock);
+    if (type != s_ps) {
+        s_ps = type;
+        s_stats.ps_changes++;
+        awake_update();
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+void tcpip_adapter_init(void)
+{
+}
+
+esp_err_t tcpip_adapter_dhcpc_stop(tcpip_adapter_if_t tcpip_if)
+{
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_set_ip_info(tcpip_adapter_if_t tcpip_if, const tcpip_adapter_ip_info_t *ip_info)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,14 @@
+#ifndef LWIP_DNS_H
+#define LWIP_DNS_H
+
+// Host stand-in: the resolver's server list is 127.0.0.1, where a test runs
+// its DNS responder (see host_dns_server.h)
+
+#include <stdint.h>
+#include "lwip/sockets.h"
+#include "lwip/ip4_addr.h"
+
+void dns_setserver(uint8_t index, const ip_addr_t *server);
+const ip_addr_t *dns_getserver(uint8_t index);
+
+#endif // LWIP_DNS_H
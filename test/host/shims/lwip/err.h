@@ -0,0 +1,6 @@
+#ifndef LWIP_ERR_H
+#define LWIP_ERR_H
+
+// Host stand-in: nothing the firmware uses
+
+#endif // LWIP_ERR_H
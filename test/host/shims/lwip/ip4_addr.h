@@ -0,0 +1,35 @@
+#ifndef LWIP_IP4_ADDR_H
+#define LWIP_IP4_ADDR_H
+
+// Host stand-in for lwIP's IPv4 address type and its helpers
+
+#include <stdint.h>
+#include <arpa/inet.h>
+
+typedef struct {
+    uint32_t addr;              // Network byte order
+} ip4_addr_t;
+
+typedef ip4_addr_t ip_addr_t;
+
+#define ip_2_ip4(ip)            (ip)
+#define ip4_addr_get_u32(ip)    ((ip)->addr)
+#define ip_addr_isany(ip)       ((ip) == NULL || (ip)->addr == 0)
+
+#define IP4_ADDR(ip, a, b, c, d) \
+    ((ip)->addr = htonl(((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d)))
+#define ip4_addr_byte(ip, n)    ((int)((const uint8_t *)&(ip)->addr)[n])
+#define IPSTR                   "%d.%d.%d.%d"
+#define IP2STR(ip)              ip4_addr_byte(ip, 0), ip4_addr_byte(ip, 1), ip4_addr_byte(ip, 2), ip4_addr_byte(ip, 3)
+
+static inline int ip4addr_aton(const char *text, ip4_addr_t *addr)
+{
+    struct in_addr in;
+    if (!inet_aton(text, &in)) {
+        return 0;
+    }
+    addr->addr = in.s_addr;
+    return 1;
+}
+
+#endif // LWIP_IP4_ADDR_H
@@ -0,0 +1,34 @@
+#ifndef LWIP_SOCKETS_H
+#define LWIP_SOCKETS_H
+
+// Host stand-in: the lwIP BSD socket API is the host's, with connect(),
+// sendto(), select() and the byte counters routed through host_net.c
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+int host_net_connect(int fd, const struct sockaddr *addr, socklen_t len);
+ssize_t host_net_sendto(int fd, const void *data, size_t len, int flags,
+                        const struct sockaddr *addr, socklen_t addr_len);
+ssize_t host_net_send(int fd, const void *data, size_t len, int flags);
+ssize_t host_net_recv(int fd, void *data, size_t len, int flags);
+ssize_t host_net_recvfrom(int fd, void *data, size_t len, int flags,
+                          struct sockaddr *addr, socklen_t *addr_len);
+int host_net_select(int nfds, fd_set *read_fds, fd_set *write_fds, fd_set *except_fds,
+                    struct timeval *timeout);
+
+#define connect  host_net_connect
+#define sendto   host_net_sendto
+#define send     host_net_send
+#define recv     host_net_recv
+#define recvfrom host_net_recvfrom
+#define select   host_net_select
+
+#endif // LWIP_SOCKETS_H
@@ -0,0 +1,6 @@
+#ifndef LWIP_SYS_H
+#define LWIP_SYS_H
+
+// Host stand-in: nothing the firmware uses
+
+#endif // LWIP_SYS_H
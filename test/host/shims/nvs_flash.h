@@ -0,0 +1,14 @@
+#ifndef NVS_FLASH_H
+#define NVS_FLASH_H
+
+// Host stand-in: NVS is kept in memory (host_nvs.c), so there is nothing to mount
+
+#include "esp_err.h"
+#include "nvs.h"
+
+#define ESP_ERR_NVS_NO_FREE_PAGES   (ESP_ERR_NVS_BASE + 0x0d)
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif // NVS_FLASH_H
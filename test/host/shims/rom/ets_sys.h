@@ -0,0 +1,21 @@
+#ifndef ROM_ETS_SYS_H
+#define ROM_ETS_SYS_H
+
+// Host stand-in for the ROM delay and CPU clock functions
+
+#include <stdint.h>
+
+/**
+ * @brief Busy-waits on the device; here the task blocks for that long on the host clock
+ */
+void ets_delay_us(uint32_t us);
+
+/**
+ * @brief CPU clock in MHz (160, as in sdkconfig.defaults)
+ */
+uint32_t ets_get_cpu_frequency(void);
+
+// Host only: the CCOUNT cycle counter, for code built with DHT_CCOUNT=host_ccount
+uint32_t host_ccount(void);
+
+#endif // ROM_ETS_SYS_H
@@ -0,0 +1,24 @@
+#ifndef TCPIP_ADAPTER_H
+#define TCPIP_ADAPTER_H
+
+// Host stand-in for tcpip_adapter: the address comes from the simulated AP
+
+#include "esp_err.h"
+#include "lwip/ip4_addr.h"
+
+typedef enum {
+    TCPIP_ADAPTER_IF_STA = 0,
+    TCPIP_ADAPTER_IF_AP,
+} tcpip_adapter_if_t;
+
+typedef struct {
+    ip4_addr_t ip;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+} tcpip_adapter_ip_info_t;
+
+void tcpip_adapter_init(void);
+esp_err_t tcpip_adapter_dhcpc_stop(tcpip_adapter_if_t tcpip_if);
+esp_err_t tcpip_adapter_set_ip_info(tcpip_adapter_if_t tcpip_if, const tcpip_adapter_ip_info_t *ip_info);
+
+#endif // TCPIP_ADAPTER_H
@@ -0,0 +1,606 @@
+// The whole firmware for a day of virtual time: app_main() runs on the main
+// task as on the device and boots every component against the simulated
+// hardware of host_devices.h (a DHT22, an SSD1306 and an SHT3x, the access
+// point, the data log partition). OpenWeatherMap, NTP and DNS are local
+// stand-ins on loopback, reachable only while the station holds an address.
+//
+// Virtual time moves only once every task is blocked and no network exchange
+// is waiting for an answer, so 24 hours take seconds. The temperature and
+// humidity follow a daily curve; the access point goes away from 13:00 to
+// 13:20 and the signal is weak from 18:00 to 19:00.
+//
+// Each hour prints the traces: CPU time and wakeups per task, radio on-time,
+// requests and bytes on the network, bus and flash traffic, and the free heap
+// (HOST_HEAP_SIZE less what the firmware holds), now and at its lowest in the
+// hour. CPU time is host thread time outside the waits (see
+// host_sync_charge_waits()); a wakeup is a blocking call that had to wait, or
+// for esp_timer, a timer fired. esp_timer is this thread, which also steps time.
+//
+//   sim_station [hours] [plain]
+//
+// "plain" makes the OpenWeatherMap stand-in ignore Accept-Encoding, so the
+// lowest free heap shows what the inflate window adds to an update.
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#ifdef SIM_GZIP
+#include <zlib.h>
+#endif
+#include "host_test.h"
+#include "host_clock.h"
+#include "host_devices.h"
+#include "host_dns_server.h"
+#include "host_net.h"
+#include "host_sync.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "datalog.h"
+#include "net_http.h"
+#include "net_loop.h"
+#include "power_manager.h"
+#include "ssd1306.h"
+#include "time_manager.h"
+#include "weather_api.h"
+#include "wifi_manager.h"
+
+#define SIM_HOURS           24
+#define HOUR_US             (3600LL * 1000000)
+#define TRUE_EPOCH_US       (1760000000LL * 1000000)    // Time the NTP stand-in keeps
+#define RTC_HZ              150000
+#define CLIMATE_STEP_US     (60LL * 1000000)
+#define OUTAGE_START_US     (13 * HOUR_US)
+#define OUTAGE_END_US       (OUTAGE_START_US + 20 * 60 * 1000000LL)
+#define WEAK_START_US       (18 * HOUR_US)
+#define WEAK_END_US         (19 * HOUR_US)
+#define RSSI_GOOD           -60
+#define RSSI_WEAK           -76
+#define BUSY_REAL_NS        500000000   // Longest a socket nobody answers holds virtual time
+#define MAX_TASKS           24
+
+#define DHT22_GPIO          CONFIG_DHT22_GPIO
+#define SSD1306_ADDR        CONFIG_SSD1306_I2C_ADDR
+#define SHT3X_ADDR          CONFIG_SHT3X_I2C_ADDR
+
+void app_main(void);
+
+// Wall clock: the firmware sets it from NTP, starting from 1970 as the SDK does
+static int64_t s_wall_offset_us;
+
+int __wrap_gettimeofday(struct timeval *tv, void *tz)
+{
+    int64_t us = host_clock_now_us() + __atomic_load_n(&s_wall_offset_us, __ATOMIC_RELAXED);
+    tv->tv_sec = us / 1000000;
+    tv->tv_usec = us % 1000000;
+    return 0;
+}
+
+int __wrap_settimeofday(const struct timeval *tv, const void *tz)
+{
+    __atomic_store_n(&s_wall_offset_us, (int64_t)tv->tv_sec * 1000000 + tv->tv_usec - host_clock_now_us(),
+                     __ATOMIC_RELAXED);
+    return 0;
+}
+
+time_t __wrap_time(time_t *t)
+{
+    struct timeval tv;
+    __wrap_gettimeofday(&tv, NULL);
+    if (t != NULL) {
+        *t = tv.tv_sec;
+    }
+    return tv.tv_sec;
+}
+
+// Heap the firmware holds: malloc and friends are wrapped at link time. The
+// stand-in servers and the set-up here are not the firmware's, so their
+// threads are not counted.
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+static int64_t s_heap_now;
+static int64_t s_heap_peak;
+static int64_t s_heap_hour_peak;            // Since the last report
+static __thread bool t_uncounted;
+
+static void peak_update(int64_t *peak, int64_t now)
+{
+    int64_t was = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (now > was && !__atomic_compare_exchange_n(peak, &was, now, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void heap_count(void *ptr, int sign)
+{
+    if (ptr == NULL || t_uncounted) {
+        return;
+    }
+    int64_t now = __atomic_add_fetch(&s_heap_now, sign * (int64_t)malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    peak_update(&s_heap_peak, now);
+    peak_update(&s_heap_hour_peak, now);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    heap_count(ptr, 1);
+    return ptr;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    void *ptr = __real_calloc(count, size);
+    heap_count(ptr, 1);
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    heap_count(ptr, -1);
+    void *moved = __real_realloc(ptr, size);
+    heap_count(moved != NULL || size == 0 ? moved : ptr, 1);
+    return moved;
+}
+
+void __wrap_free(void *ptr)
+{
+    heap_count(ptr, -1);
+    __real_free(ptr);
+}
+
+// OpenWeatherMap stand-in: the recorded responses, gzip-compressed like a web
+// server when the request allows it and zlib is there to do it
+static uint32_t s_owm_requests;
+static bool s_plain;                // Never compress, for the heap without the inflate window
+
+static char *load(const char *name, size_t *len)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "corpus/owm/%s", name);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("Cannot open %s\n", path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(*len + 1);
+    *len = fread(data, 1, *len, f);
+    data[*len] = '\0';
+    fclose(f);
+    return data;
+}
+
+// Forecast cut from the 40-entry recording, which has one entry per line
+static char *forecast_body(int cnt, size_t *len)
+{
+    size_t full_len;
+    char *full = load("forecast_cnt40.json", &full_len);
+    char *lines[42];
+    int count = 0;
+
+    for (char *line = strtok(full, "\n"); line != NULL && count < 42; line = strtok(NULL, "\n")) {
+        lines[count++] = line;
+    }
+    cnt = (cnt < 1 || cnt > 40) ? 40 : cnt;
+    char *body = malloc(full_len + 16);
+    if (body == NULL) {
+        printf("Out of memory\n");
+        exit(1);
+    }
+    size_t pos = sprintf(body, "{\"cod\":\"200\",\"message\":0,\"cnt\":%d,\"list\":[", cnt);
+    for (int i = 0; i < cnt; i++) {
+        size_t entry_len = strlen(lines[1 + i]);
+        if (lines[1 + i][entry_len - 1] == ',') {
+            entry_len--;
+        }
+        pos += sprintf(body + pos, "%s%.*s", i ? "," : "", (int)entry_len, lines[1 + i]);
+    }
+    pos += sprintf(body + pos, "%s", lines[41]);
+    free(full);
+    *len = pos;
+    return body;
+}
+
+static void owm_serve(int fd)
+{
+    char request[1024] = "";
+    size_t got = 0;
+
+    while (got < sizeof(request) - 1 && strstr(request, "\r\n\r\n") == NULL) {
+        ssize_t n = recv(fd, request + got, sizeof(request) - 1 - got, 0);
+        if (n <= 0) {
+            return;
+        }
+        got += n;
+        request[got] = '\0';
+    }
+    __atomic_add_fetch(&s_owm_requests, 1, __ATOMIC_RELAXED);
+
+    size_t body_len;
+    char *body;
+    if (strncmp(request, "GET /data/2.5/weather?", 22) == 0) {
+        body = load("current.json", &body_len);
+    } else if (strncmp(request, "GET /data/2.5/forecast?", 23) == 0) {
+        const char *cnt = strstr(request, "cnt=");
+        body = forecast_body(cnt != NULL ? atoi(cnt + 4) : 40, &body_len);
+    } else if (strncmp(request, "GET /data/2.5/group?", 20) == 0) {
+        body = load("group_3.json", &body_len);
+    } else {
+        const char *missing = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send(fd, missing, strlen(missing), MSG_NOSIGNAL);
+        return;
+    }
+
+    uint8_t *wire = (uint8_t *)body;
+    size_t wire_len = body_len;
+    bool gzip = false;
+#ifdef SIM_GZIP
+    if (!s_plain && strcasestr(request, "Accept-Encoding: gzip") != NULL) {
+        z_stream z = { 0 };
+        wire = malloc(body_len + 128);
+        deflateInit2(&z, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+        z.next_in = (Bytef *)body;
+        z.avail_in = body_len;
+        z.next_out = wire;
+        z.avail_out = body_len + 128;
+        deflate(&z, Z_FINISH);
+        wire_len = z.total_out;
+        deflateEnd(&z);
+        gzip = true;
+    }
+#endif
+
+    char header[256];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 200 OK\r\nContent-Type: application/json; charset=utf-8\r\n"
+                              "%sContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                              gzip ? "Content-Encoding: gzip\r\n" : "", wire_len);
+    send(fd, header, header_len, MSG_NOSIGNAL);
+    send(fd, wire, wire_len, MSG_NOSIGNAL);
+    if (wire != (uint8_t *)body) {
+        free(wire);
+    }
+    free(body);
+}
+
+static void *owm_server(void *arg)
+{
+    int listener = *(int *)arg;
+
+    t_uncounted = true;
+    while (1) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd >= 0) {
+            owm_serve(fd);
+            close(fd);
+        }
+    }
+    return NULL;
+}
+
+// NTP stand-in: a stratum 2 server whose clock is TRUE_EPOCH_US plus uptime
+static uint32_t s_ntp_answers;
+
+static void put_timestamp(uint8_t *p, int64_t us)
+{
+    uint32_t seconds = (uint32_t)(us / 1000000 + 2208988800LL);
+    uint32_t fraction = (uint32_t)(((uint64_t)(us % 1000000) << 32) / 1000000);
+    for (int i = 0; i < 4; i++) {
+        p[i] = seconds >> (24 - 8 * i);
+        p[4 + i] = fraction >> (24 - 8 * i);
+    }
+}
+
+static void *ntp_server(void *arg)
+{
+    int fd = *(int *)arg;
+    uint8_t packet[48];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+
+    t_uncounted = true;
+    while (1) {
+        if (recvfrom(fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_len) == 48) {
+            int64_t now = TRUE_EPOCH_US + host_clock_now_us();
+            memcpy(&packet[24], &packet[40], 8);    // Their transmit time is our origin
+            memset(packet, 0, 24);
+            packet[0] = (4 << 3) | 4;
+            packet[1] = 2;
+            put_timestamp(&packet[32], now);
+            put_timestamp(&packet[40], now);
+            sendto(fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, from_len);
+            __atomic_add_fetch(&s_ntp_answers, 1, __ATOMIC_RELAXED);
+        }
+        from_len = sizeof(from);
+    }
+    return NULL;
+}
+
+// Bind a loopback socket, take over the port the firmware uses and serve it from a thread
+static void server_start(int type, uint16_t port, void *(*serve)(void *))
+{
+    static int fds[2];
+    static int count;
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+    pthread_t thread;
+    int *fd = &fds[count++];
+
+    *fd = socket(AF_INET, type, 0);
+    bind(*fd, (struct sockaddr *)&addr, sizeof(addr));
+    if (type == SOCK_STREAM) {
+        listen(*fd, 4);
+    }
+    getsockname(*fd, (struct sockaddr *)&addr, &len);
+    host_net_redirect(port, ntohs(addr.sin_port));
+    pthread_create(&thread, NULL, serve, fd);
+    pthread_detach(thread);
+}
+
+static void rtc_follow(int64_t now_us)
+{
+    host_rtc_counter = (uint32_t)(now_us * RTC_HZ / 1000000);
+}
+
+// A socket the firmware waits on holds virtual time while the stand-ins
+// answer; one nobody answers only for BUSY_REAL_NS of real time
+static bool sim_busy(void)
+{
+    static uint64_t since_ns;
+
+    if (!net_loop_busy()) {
+        since_ns = 0;
+        return false;
+    }
+    uint64_t now = host_now_ns();
+    if (since_ns == 0) {
+        since_ns = now;
+    }
+    return now - since_ns < BUSY_REAL_NS;
+}
+
+// Warmest at 15:00, most humid before dawn; the SHT3x sits a little warmer
+static void climate(int64_t now_us)
+{
+    double phase = 2 * M_PI * ((double)now_us / HOUR_US - 9) / 24;
+    int16_t temperature = (int16_t)lround(215 + 55 * sin(phase));
+    uint16_t humidity = (uint16_t)lround(600 - 150 * sin(phase));
+
+    host_dht22_set(temperature, humidity);
+    host_sht3x_set(temperature + 3, humidity - 10);
+}
+
+static void main_task(void *arg)
+{
+    app_main();
+}
+
+// Figures that count up; each hour prints what changed
+typedef struct {
+    uint32_t task_number[MAX_TASKS];
+    uint32_t task_cpu_us[MAX_TASKS];
+    uint32_t task_wakeups[MAX_TASKS];
+    int tasks;
+    net_http_stats_t http;
+    power_radio_stats_t radio;
+    host_wifi_stats_t wifi;
+    host_i2c_stats_t i2c;
+    host_flash_stats_t flash;
+    uint32_t dht_frames;
+    uint32_t owm_requests;
+    uint32_t dns_queries;
+    uint32_t ntp_answers;
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+} counters_t;
+
+static void counters_read(counters_t *c)
+{
+    TaskStatus_t status[MAX_TASKS];
+    UBaseType_t count = uxTaskGetSystemState(status, MAX_TASKS, NULL);
+
+    c->tasks = 0;
+    for (UBaseType_t i = 0; i < count; i++) {
+        c->task_number[c->tasks] = status[i].xTaskNumber;
+        c->task_cpu_us[c->tasks] = status[i].ulRunTimeCounter;
+        c->task_wakeups[c->tasks] = host_task_wakeups(status[i].xHandle);
+        c->tasks++;
+    }
+    net_http_get_stats(&c->http);
+    power_manager_get_radio_stats(&c->radio);
+    host_wifi_get_stats(&c->wifi);
+    host_i2c_get_stats(&c->i2c);
+    host_flash_get_stats(&c->flash);
+    c->dht_frames = host_dht22_frames();
+    c->owm_requests = __atomic_load_n(&s_owm_requests, __ATOMIC_RELAXED);
+    c->dns_queries = host_dns_server_queries();
+    c->ntp_answers = __atomic_load_n(&s_ntp_answers, __ATOMIC_RELAXED);
+    host_net_get_counters(&c->tx_bytes, &c->rx_bytes);
+}
+
+static const char *task_name(uint32_t number)
+{
+    static TaskStatus_t status[MAX_TASKS];
+    UBaseType_t count = uxTaskGetSystemState(status, MAX_TASKS, NULL);
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        if (status[i].xTaskNumber == number) {
+            return status[i].pcTaskName;
+        }
+    }
+    return "?";
+}
+
+static void report_header(void)
+{
+    printf("hour  http fail  owm  dns  ntp   tx_B   rx_B  radio on_s  awake_s  disc   i2c_tx  dht  "
+           "fl_wr erase  free_B   min_B\n");
+}
+
+static void report(int hour, const counters_t *now, const counters_t *was)
+{
+    printf("%02d:00 %4u %4u %4u %4u %4u %6llu %6llu %6u %5.1f %7.1f %5u %8u %4u %5u %5u %7lld %7lld\n",
+           hour,
+           now->http.requests - was->http.requests, now->http.failures - was->http.failures,
+           now->owm_requests - was->owm_requests, now->dns_queries - was->dns_queries,
+           now->ntp_answers - was->ntp_answers,
+           (unsigned long long)(now->tx_bytes - was->tx_bytes),
+           (unsigned long long)(now->rx_bytes - was->rx_bytes),
+           now->radio.windows - was->radio.windows,
+           (now->radio.on_ms_total - was->radio.on_ms_total) / 1000.0,
+           (now->wifi.awake_us - was->wifi.awake_us) / 1e6,
+           now->wifi.disconnects - was->wifi.disconnects,
+           now->i2c.transactions - was->i2c.transactions,
+           now->dht_frames - was->dht_frames,
+           now->flash.writes - was->flash.writes, now->flash.erases - was->flash.erases,
+           HOST_HEAP_SIZE - (long long)__atomic_load_n(&s_heap_now, __ATOMIC_RELAXED),
+           HOST_HEAP_SIZE - (long long)__atomic_exchange_n(&s_heap_hour_peak,
+                                                           __atomic_load_n(&s_heap_now, __ATOMIC_RELAXED),
+                                                           __ATOMIC_RELAXED));
+
+    // Per task: CPU ms / wakeups in the hour
+    printf("      ");
+    for (int i = 0; i < now->tasks; i++) {
+        uint32_t cpu_us = now->task_cpu_us[i];
+        uint32_t wakeups = now->task_wakeups[i];
+        for (int j = 0; j < was->tasks; j++) {
+            if (was->task_number[j] == now->task_number[i]) {
+                cpu_us -= was->task_cpu_us[j];
+                wakeups -= was->task_wakeups[j];
+            }
+        }
+        printf(" %s %.1f/%u", task_name(now->task_number[i]), cpu_us / 1000.0, wakeups);
+    }
+    printf("\n");
+}
+
+// The panel at half resolution
+static int display_render(void)
+{
+    int lit = 0;
+
+    for (int y = 0; y < 64; y += 2) {
+        char row[65];
+        for (int x = 0; x < 128; x += 2) {
+            bool on = host_ssd1306_pixel(x, y) || host_ssd1306_pixel(x + 1, y) ||
+                      host_ssd1306_pixel(x, y + 1) || host_ssd1306_pixel(x + 1, y + 1);
+            row[x / 2] = on ? '#' : ' ';
+            lit += on;
+        }
+        row[64] = '\0';
+        printf("|%s|\n", row);
+    }
+    return lit;
+}
+
+int main(int argc, char **argv)
+{
+    int hours = (argc > 1) ? atoi(argv[1]) : SIM_HOURS;
+    s_plain = (argc > 2 && strcmp(argv[2], "plain") == 0);
+    int64_t end_us = hours * HOUR_US;
+    counters_t was = { 0 }, now;
+    uint64_t start_ns = host_now_ns();
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    t_uncounted = true;
+    host_clock_set_virtual(true);
+    host_clock_set_advance_hook(rtc_follow);
+    host_dht22_attach(DHT22_GPIO);
+    host_i2c_add_ssd1306(SSD1306_ADDR);
+    host_i2c_add_sht3x(SHT3X_ADDR);
+    host_wifi_set_ap(true, RSSI_GOOD);
+    climate(0);
+    host_dns_server_start(3600);
+    server_start(SOCK_STREAM, 80, owm_server);
+    server_start(SOCK_DGRAM, 123, ntp_server);
+
+    // This thread runs the esp_timer callbacks as time moves
+    host_task_adopt("esp_timer");
+    t_uncounted = false;
+    xTaskCreate(main_task, "uiT", CONFIG_ESP_MAIN_TASK_STACK_SIZE, NULL, 1, NULL);
+
+    report_header();
+    int64_t next_report = HOUR_US;
+    int64_t next_climate = CLIMATE_STEP_US;
+    while (host_clock_now_us() < end_us) {
+        int64_t limit = next_report < next_climate ? next_report : next_climate;
+        int64_t events[] = { OUTAGE_START_US, OUTAGE_END_US, WEAK_START_US, WEAK_END_US };
+        for (int i = 0; i < 4; i++) {
+            if (events[i] > host_clock_now_us() && events[i] < limit) {
+                limit = events[i];
+            }
+        }
+        while (host_clock_run_idle(limit, sim_busy)) {
+        }
+
+        int64_t t = host_clock_now_us();
+        if (t == OUTAGE_START_US) {
+            host_wifi_set_ap(false, RSSI_GOOD);
+        } else if (t == OUTAGE_END_US || t == WEAK_END_US) {
+            host_wifi_set_ap(true, RSSI_GOOD);
+        } else if (t == WEAK_START_US) {
+            host_wifi_set_ap(true, RSSI_WEAK);
+        }
+        if (t >= next_climate) {
+            climate(t);
+            next_climate += CLIMATE_STEP_US;
+        }
+        if (t >= next_report) {
+            counters_read(&now);
+            report((int)(t / HOUR_US), &now, &was);
+            was = now;
+            next_report += HOUR_US;
+        }
+    }
+
+    net_http_stats_t http;
+    time_clock_stats_t clock;
+    wifi_link_stats_t link;
+    datalog_stats_t log;
+    power_radio_stats_t radio;
+    ssd1306_flush_stats_t flush;
+    net_http_get_stats(&http);
+    time_manager_get_clock_stats(&clock);
+    wifi_manager_get_link_stats(&link);
+    datalog_get_stats(&log);
+    power_manager_get_radio_stats(&radio);
+    ssd1306_get_flush_stats(&flush);
+
+    int lit = display_render();
+    printf("%d virtual hours in %.1f s\n", hours, (host_now_ns() - start_ns) / 1e9);
+    printf("HTTP %u requests, %u failed; clock source %d, %u syncs, offset %d us\n",
+           http.requests, http.failures, clock.source, clock.syncs, clock.ntp_offset_us);
+    printf("WiFi %u outages (longest %u ms), %u roam scans; radio on %u s of %u s in %u windows\n",
+           link.outages, link.max_outage_ms, link.roam_scans, radio.on_ms_total / 1000, radio.uptime_ms / 1000,
+           radio.windows);
+    printf("Datalog %u records, %u flushes; display %u flushes\n", log.records, log.flushes, flush.flushes);
+    printf("Heap of %d B: %lld B free, %lld B at the lowest\n", HOST_HEAP_SIZE,
+           HOST_HEAP_SIZE - (long long)s_heap_now, HOST_HEAP_SIZE - (long long)s_heap_peak);
+
+    if (hours >= SIM_HOURS) {
+        CHECK(http.requests >= 80);
+        CHECK(s_ntp_answers >= 1);
+        CHECK_EQ(clock.source, TIME_SOURCE_SNTP);
+        CHECK(host_dht22_frames() >= (uint32_t)(hours * 3600 / CONFIG_SENSOR_ADAPTIVE_MAX_INTERVAL));
+        CHECK(link.outages >= 1);
+        CHECK(wifi_is_connected());
+        CHECK(weather_is_valid());
+        CHECK(log.records > 0);
+        CHECK(lit > 0);
+        CHECK(s_heap_peak < HOST_HEAP_SIZE);
+    }
+    HOST_TEST_EXIT();
+}
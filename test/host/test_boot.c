@@ -0,0 +1,93 @@
+// boot_run() with a stage that fails: everything that needs it, directly or
+// through a milestone it would have signalled later, is skipped, the other
+// stages run, and the call returns the failure instead of waiting for
+// milestones that cannot come.
+
+#include <pthread.h>
+#include <unistd.h>
+#include "host_test.h"
+#include "host_clock.h"
+#include "boot.h"
+
+#define M_DISPLAY   BIT0
+#define M_NVS       BIT1
+#define M_WIFI      BIT2
+#define M_IP        BIT3
+#define M_TIME      BIT4
+#define M_READING   BIT5
+#define M_FRAME     BIT6
+
+static int s_ran[8];
+
+enum { DISPLAY, NVS, WIFI, SNTP, SENSORS, FRAME, DATALOG };
+
+static void *first_reading(void *arg)
+{
+    usleep(50 * 1000);
+    boot_signal(M_READING);
+    return NULL;
+}
+
+static esp_err_t start_display(void) { s_ran[DISPLAY]++; return ESP_OK; }
+static esp_err_t start_nvs(void) { s_ran[NVS]++; return ESP_ERR_NO_MEM; }
+static esp_err_t start_wifi(void) { s_ran[WIFI]++; return ESP_OK; }
+static esp_err_t start_sntp(void) { s_ran[SNTP]++; return ESP_OK; }
+static esp_err_t start_frame(void) { s_ran[FRAME]++; return ESP_OK; }
+static esp_err_t start_datalog(void) { s_ran[DATALOG]++; return ESP_OK; }
+
+static esp_err_t start_sensors(void)
+{
+    pthread_t thread;
+
+    s_ran[SENSORS]++;
+    pthread_create(&thread, NULL, first_reading, NULL);
+    pthread_detach(thread);
+    return ESP_OK;
+}
+
+static const boot_stage_t k_stages[] = {
+    { "display", 0,                     M_DISPLAY, start_display, 0 },
+    { "nvs",     0,                     M_NVS,     start_nvs,     0 },
+    { "wifi",    M_NVS,                 M_WIFI,    start_wifi,    M_IP },
+    { "sntp",    M_IP,                  0,         start_sntp,    M_TIME },
+    { "sensors", 0,                     0,         start_sensors, M_READING },
+    { "frame",   M_DISPLAY | M_READING, M_FRAME,   start_frame,   0 },
+    { "datalog", 0,                     0,         start_datalog, 0 },
+};
+
+static const boot_milestone_t k_milestones[] = {
+    { M_IP,      "ip" },
+    { M_READING, "reading" },
+    { M_TIME,    "time sync" },
+};
+
+int main(void)
+{
+    static boot_stage_t too_many[BOOT_MAX_STAGES + 1];
+
+    CHECK_EQ(boot_run(too_many, BOOT_MAX_STAGES + 1, NULL, 0), ESP_ERR_INVALID_ARG);
+
+    // Returns once the reading is in, not after the 60 s report for the
+    // missing address and time, and not never for the skipped stages
+    int64_t start = host_clock_now_us();
+    CHECK_EQ(boot_run(k_stages, sizeof(k_stages) / sizeof(k_stages[0]),
+                      k_milestones, sizeof(k_milestones) / sizeof(k_milestones[0])), ESP_ERR_NO_MEM);
+    int64_t took_ms = (host_clock_now_us() - start) / 1000;
+    printf("boot_run() returned after %lld ms\n", (long long)took_ms);
+    CHECK(took_ms >= 50 && took_ms < 5000);
+
+    CHECK_EQ(s_ran[NVS], 1);
+    CHECK_EQ(s_ran[WIFI], 0);
+    CHECK_EQ(s_ran[SNTP], 0);
+    CHECK_EQ(s_ran[DISPLAY], 1);
+    CHECK_EQ(s_ran[SENSORS], 1);
+    CHECK_EQ(s_ran[FRAME], 1);
+    CHECK_EQ(s_ran[DATALOG], 1);
+    CHECK(boot_reached(M_DISPLAY | M_READING | M_FRAME));
+    CHECK(!boot_reached(M_NVS));
+
+    // Boot runs once
+    CHECK_EQ(boot_run(k_stages, 1, NULL, 0), ESP_ERR_INVALID_ARG);
+
+    HOST_TEST_EXIT();
+}
@@ -0,0 +1,259 @@
+// The datalog ring on a simulated NOR flash: wear over 50 laps, range queries,
+// remounting, and power cut at random points of writes and erases, after
+// which datalog_ring_mount() must find everything that was committed and the
+// log must carry on.
+//
+// The flash behaves like the real part: erase sets a sector to 0xFF, a write
+// can only clear bits, and a cut stops programming part way through a byte
+// or leaves an interrupted erase with random contents.
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "datalog_ring.h"
+
+#define SECTORS 8
+#define LAPS 50
+#define POWER_CUTS 3000
+
+static uint8_t s_flash[SECTORS * DATALOG_SECTOR_SIZE];
+static uint32_t s_erases[SECTORS];
+static long s_budget = -1;      // Bytes written before the cut, -1 = none
+static long s_erase_budget = -1;    // Sectors erased before the cut, -1 = none
+static bool s_cut;
+static int s_erase_cuts;
+
+static esp_err_t flash_read(void *ctx, uint32_t addr, void *buf, size_t len)
+{
+    memcpy(buf, s_flash + addr, len);
+    return ESP_OK;
+}
+
+static esp_err_t flash_write(void *ctx, uint32_t addr, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+
+    if (s_cut) {
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (s_budget == 0) {
+            // Power gone while programming this byte: some of its bits made it
+            s_flash[addr + i] &= p[i] | (uint8_t)rand();
+            s_cut = true;
+            return ESP_FAIL;
+        }
+        if (s_budget > 0) {
+            s_budget--;
+        }
+        s_flash[addr + i] &= p[i];
+    }
+    return ESP_OK;
+}
+
+static esp_err_t flash_erase(void *ctx, uint32_t addr)
+{
+    if (s_cut) {
+        return ESP_FAIL;
+    }
+    if (s_erase_budget == 0) {
+        // Interrupted erase: neither the old contents nor blank
+        for (int i = 0; i < 1000; i++) {
+            s_flash[addr + rand() % DATALOG_SECTOR_SIZE] = rand();
+        }
+        s_erase_cuts++;
+        s_cut = true;
+        return ESP_FAIL;
+    }
+    if (s_erase_budget > 0) {
+        s_erase_budget--;
+    }
+    memset(s_flash + addr, 0xFF, DATALOG_SECTOR_SIZE);
+    s_erases[addr / DATALOG_SECTOR_SIZE]++;
+    return ESP_OK;
+}
+
+static const datalog_flash_t k_flash = {
+    .read = flash_read,
+    .write = flash_write,
+    .erase = flash_erase,
+    .size = sizeof(s_flash),
+};
+
+// Records carry their own time in the values, so any mix-up shows
+static void append(datalog_ring_t *ring, uint32_t time, bool *flush_due)
+{
+    datalog_record_t record = {
+        .time = time, .kind = DATALOG_SENSOR, .value = { (int16_t)time, (int16_t)~time },
+    };
+    *flush_due = datalog_ring_append(ring, &record);
+}
+
+// Records in [from, to], checking order and contents on the way
+static int query(datalog_ring_t *ring, uint32_t from, uint32_t to, uint32_t *first, uint32_t *last)
+{
+    datalog_iter_t it;
+    datalog_record_t record;
+    uint32_t prev = 0;
+    int count = 0;
+
+    datalog_ring_iter_begin(ring, &it, from, to);
+    while (datalog_ring_iter_next(ring, &it, &record)) {
+        CHECK(record.time >= prev);
+        CHECK(record.time >= from && record.time <= to);
+        CHECK(record.value[0] == (int16_t)record.time && record.value[1] == (int16_t)~record.time);
+        if (count == 0 && first != NULL) {
+            *first = record.time;
+        }
+        prev = record.time;
+        count++;
+    }
+    if (last != NULL) {
+        *last = prev;
+    }
+    return count;
+}
+
+static void check_blank_and_garbage(void)
+{
+    datalog_ring_t ring;
+
+    memset(s_flash, 0xFF, sizeof(s_flash));
+    CHECK_EQ(datalog_ring_mount(&ring, &k_flash), ESP_OK);
+    CHECK_EQ(ring.used, 0);
+    CHECK_EQ(datalog_ring_records(&ring), 0);
+
+    // Random contents (a partition used for something else before) read as empty
+    srand(37);
+    for (size_t i = 0; i < sizeof(s_flash); i++) {
+        s_flash[i] = rand();
+    }
+    CHECK_EQ(datalog_ring_mount(&ring, &k_flash), ESP_OK);
+    CHECK_EQ(ring.used, 0);
+
+    // Too small for a ring
+    datalog_flash_t tiny = k_flash;
+    tiny.size = DATALOG_SECTOR_SIZE;
+    CHECK_EQ(datalog_ring_mount(&ring, &tiny), ESP_ERR_INVALID_SIZE);
+}
+
+static uint32_t check_laps(void)
+{
+    datalog_ring_t ring, again;
+    uint32_t time = 1000, first, last;
+    bool flush_due;
+
+    memset(s_flash, 0xFF, sizeof(s_flash));
+    memset(s_erases, 0, sizeof(s_erases));
+    CHECK_EQ(datalog_ring_mount(&ring, &k_flash), ESP_OK);
+
+    // Every sector erased once per lap, none more than once ahead of the others
+    for (long i = 0; i < (long)LAPS * SECTORS * (DATALOG_SLOTS - 1); i++) {
+        append(&ring, time++, &flush_due);
+        if (flush_due) {
+            CHECK_EQ(datalog_ring_flush(&ring), ESP_OK);
+        }
+    }
+    uint32_t least = UINT32_MAX, most = 0, total = 0;
+    for (int s = 0; s < SECTORS; s++) {
+        least = s_erases[s] < least ? s_erases[s] : least;
+        most = s_erases[s] > most ? s_erases[s] : most;
+        total += s_erases[s];
+    }
+    printf("%d laps: %u to %u erases per sector, %u flushes, %u records on flash\n",
+           LAPS, least, most, ring.flushes, datalog_ring_records(&ring));
+    CHECK(least >= LAPS - 1 && most <= LAPS + 1 && most - least <= 1);
+    CHECK_EQ(total, ring.erases);
+    CHECK_EQ(ring.used, SECTORS);
+
+    // Full range, then a window found through the sector index
+    int all = query(&ring, 0, UINT32_MAX, &first, &last);
+    CHECK_EQ(last, time - 1);
+    CHECK_EQ(all, last - first + 1);
+    CHECK_EQ(all, datalog_ring_records(&ring) + ring.buffered);
+    CHECK_EQ(query(&ring, last - 500, last - 100, &first, NULL), 401);
+    CHECK_EQ(first, last - 500);
+
+    // Mounting again finds the same ring; buffered records were never written
+    CHECK_EQ(datalog_ring_flush(&ring), ESP_OK);
+    CHECK_EQ(datalog_ring_mount(&again, &k_flash), ESP_OK);
+    CHECK_EQ(again.head, ring.head);
+    CHECK_EQ(again.tail, ring.tail);
+    CHECK_EQ(again.used, ring.used);
+    CHECK_EQ(again.head_slot, ring.head_slot);
+    CHECK_EQ(again.last_time, ring.last_time);
+    CHECK_EQ(datalog_ring_records(&again), datalog_ring_records(&ring));
+    CHECK_EQ(again.corrupt, 0);
+    return time;
+}
+
+// Power cut at a random byte of the next few sectors' worth of writes or, one
+// time in three, during one of the next erases. What a completed flush put on
+// flash must survive; what was in flight may be lost
+static void check_power_cuts(uint32_t time)
+{
+    datalog_ring_t ring;
+    uint32_t most_torn = 0;
+    bool flush_due;
+
+    srand(1);
+    for (int trial = 0; trial < POWER_CUTS; trial++) {
+        uint32_t newest = 0;
+        CHECK_EQ(datalog_ring_mount(&ring, &k_flash), ESP_OK);
+        int before = query(&ring, 0, UINT32_MAX, NULL, &newest);
+        uint32_t start = time;
+        uint32_t committed = newest;
+
+        if (trial % 3 == 0) {
+            s_erase_budget = rand() % 3;
+        } else {
+            s_budget = rand() % (3 * DATALOG_SECTOR_SIZE);
+        }
+        s_cut = false;
+        for (int i = 0; i < 2000 && !s_cut; i++) {
+            append(&ring, time, &flush_due);
+            if (flush_due && datalog_ring_flush(&ring) == ESP_OK) {
+                committed = time;
+            }
+            time++;
+        }
+        s_budget = -1;
+        s_erase_budget = -1;
+        s_cut = false;
+
+        // Everything committed in this trial is there, in one piece, and the
+        // newest record from before still is: less than a ring was written
+        uint32_t last = 0;
+        CHECK_EQ(datalog_ring_mount(&ring, &k_flash), ESP_OK);
+        query(&ring, 0, UINT32_MAX, NULL, &last);
+        CHECK(last >= committed);
+        if (committed >= start) {
+            CHECK_EQ(query(&ring, start, committed, NULL, NULL), committed - start + 1);
+        }
+        if (before > 0) {
+            CHECK_EQ(query(&ring, newest, newest, NULL, NULL), 1);
+        }
+        if (ring.corrupt > most_torn) {
+            most_torn = ring.corrupt;
+        }
+
+        // And the log carries on from there
+        for (int i = 0; i < 5; i++) {
+            append(&ring, time++, &flush_due);
+        }
+        CHECK_EQ(datalog_ring_flush(&ring), ESP_OK);
+        CHECK_EQ(datalog_ring_mount(&ring, &k_flash), ESP_OK);
+        CHECK(query(&ring, 0, UINT32_MAX, NULL, &last) > 0);
+        CHECK_EQ(last, time - 1);
+    }
+    printf("%d power cuts (%d during an erase): recovered every time, at most %u damaged records skipped\n",
+           POWER_CUTS, s_erase_cuts, most_torn);
+}
+
+int main(void)
+{
+    check_blank_and_garbage();
+    check_power_cuts(check_laps());
+
+    HOST_TEST_EXIT();
+}
@@ -0,0 +1,181 @@
+// DHT22 frame decoding from falling-edge timestamps, as the capture ISR
+// records them: a recorded frame, the same frame with an edge lost or a
+// corrupted checksum, and the limits of the response and bit windows.
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "dht22_decode.h"
+
+#define CPU_MHZ 80
+#define BIT_ZERO_US 77          // 50 us low + 27 us high
+#define BIT_ONE_US  120         // 50 us low + 70 us high
+
+// 65.2 %, 35.1 C at 80 MHz: response period 160 us, then 40 bits
+static const uint8_t k_frame[5] = { 0x02, 0x8C, 0x01, 0x5F, 0xEE };
+static const uint32_t k_edges[DHT22_FRAME_EDGES] = {
+    80000, 92800, 98960, 105120, 111280, 117440, 123600, 129760, 139360, 145520,
+    155120, 161280, 167440, 173600, 183200, 192800, 198960, 205120, 211280, 217440,
+    223600, 229760, 235920, 242080, 248240, 257840, 264000, 273600, 279760, 289360,
+    298960, 308560, 318160, 327760, 337360, 346960, 356560, 362720, 372320, 381920,
+    391520, 397680,
+};
+
+// Edges for a frame: the response period, then one period per bit taken
+// from bit_us[0] ('0') or bit_us[1] ('1'). Returns the number of edges
+static int synth(uint32_t *edges, uint32_t start, uint32_t cycles_per_us,
+                 uint32_t response_us, const uint32_t bit_us[2], const uint8_t data[5])
+{
+    uint32_t t = start;
+    int n = 0;
+
+    edges[n++] = t;
+    t += response_us * cycles_per_us;
+    edges[n++] = t;
+    for (int bit = 0; bit < 40; bit++) {
+        int one = (data[bit / 8] >> (7 - (bit % 8))) & 1;
+        t += bit_us[one] * cycles_per_us;
+        edges[n++] = t;
+    }
+    return n;
+}
+
+static dht22_decode_status_t decode_synth(uint32_t response_us, const uint32_t bit_us[2],
+                                          const uint8_t frame[5], uint8_t data[5])
+{
+    uint32_t edges[DHT22_FRAME_EDGES];
+    int count = synth(edges, 1000 * CPU_MHZ, CPU_MHZ, response_us, bit_us, frame);
+    return dht22_decode(edges, count, CPU_MHZ, data);
+}
+
+static void check_recorded(void)
+{
+    uint8_t data[5];
+    int16_t temperature;
+    uint16_t humidity;
+
+    CHECK_EQ(dht22_decode(k_edges, DHT22_FRAME_EDGES, CPU_MHZ, data), DHT22_DECODE_OK);
+    CHECK(memcmp(data, k_frame, 5) == 0);
+    dht22_decode_values(data, &temperature, &humidity);
+    CHECK_EQ(humidity, 652);
+    CHECK_EQ(temperature, 351);
+
+    // Temperature is sign-magnitude: 50.0 %, -10.1 C
+    static const uint8_t below[5] = { 0x01, 0xF4, 0x80, 0x65, 0xDA };
+    dht22_decode_values(below, &temperature, &humidity);
+    CHECK_EQ(humidity, 500);
+    CHECK_EQ(temperature, -101);
+
+    // A leading edge from the end of the start signal is skipped
+    uint32_t edges[DHT22_FRAME_EDGES + 1];
+    edges[0] = k_edges[0] - 30 * CPU_MHZ;
+    memcpy(edges + 1, k_edges, sizeof(k_edges));
+    CHECK_EQ(dht22_decode(edges, DHT22_FRAME_EDGES + 1, CPU_MHZ, data), DHT22_DECODE_OK);
+    CHECK(memcmp(data, k_frame, 5) == 0);
+
+    // Captured across the cycle counter wrap
+    for (int i = 0; i < DHT22_FRAME_EDGES; i++) {
+        edges[i] = k_edges[i] - k_edges[0] + 0xFFFFF000u;
+    }
+    CHECK_EQ(dht22_decode(edges, DHT22_FRAME_EDGES, CPU_MHZ, data), DHT22_DECODE_OK);
+    CHECK(memcmp(data, k_frame, 5) == 0);
+
+    // The same frame at 160 MHz
+    static const uint32_t bit_us[2] = { BIT_ZERO_US, BIT_ONE_US };
+    int count = synth(edges, 12345, 160, 160, bit_us, k_frame);
+    CHECK_EQ(dht22_decode(edges, count, 160, data), DHT22_DECODE_OK);
+    CHECK(memcmp(data, k_frame, 5) == 0);
+}
+
+static void check_damaged(void)
+{
+    uint32_t edges[DHT22_FRAME_EDGES];
+    uint8_t data[5];
+
+    CHECK_EQ(dht22_decode(k_edges, 0, CPU_MHZ, data), DHT22_DECODE_NO_RESPONSE);
+
+    // A lost edge anywhere after the response leaves too few periods for 40 bits
+    for (int lost = 2; lost < DHT22_FRAME_EDGES - 1; lost++) {
+        memcpy(edges, k_edges, lost * sizeof(uint32_t));
+        memcpy(edges + lost, k_edges + lost + 1, (DHT22_FRAME_EDGES - lost - 1) * sizeof(uint32_t));
+        CHECK_EQ(dht22_decode(edges, DHT22_FRAME_EDGES - 1, CPU_MHZ, data), DHT22_DECODE_INCOMPLETE);
+    }
+
+    // With a stray edge at the end making up the count, the two bits merged
+    // by the lost edge give a period too long for either
+    memcpy(edges, k_edges, sizeof(k_edges));
+    memmove(edges + 10, edges + 11, (DHT22_FRAME_EDGES - 11) * sizeof(uint32_t));
+    edges[DHT22_FRAME_EDGES - 1] = edges[DHT22_FRAME_EDGES - 2] + BIT_ZERO_US * CPU_MHZ;
+    CHECK_EQ(dht22_decode(edges, DHT22_FRAME_EDGES, CPU_MHZ, data), DHT22_DECODE_TIMING);
+
+    // The last edge never came
+    CHECK_EQ(dht22_decode(k_edges, DHT22_FRAME_EDGES - 1, CPU_MHZ, data), DHT22_DECODE_INCOMPLETE);
+
+    // One bit flipped in the checksum, then in the payload
+    static const uint32_t bit_us[2] = { BIT_ZERO_US, BIT_ONE_US };
+    uint8_t frame[5];
+    memcpy(frame, k_frame, 5);
+    frame[4] ^= 0x01;
+    CHECK_EQ(decode_synth(160, bit_us, frame, data), DHT22_DECODE_CHECKSUM);
+    CHECK(memcmp(data, frame, 5) == 0);
+    memcpy(frame, k_frame, 5);
+    frame[1] ^= 0x10;
+    CHECK_EQ(decode_synth(160, bit_us, frame, data), DHT22_DECODE_CHECKSUM);
+}
+
+static void check_windows(void)
+{
+    static const uint32_t bit_us[2] = { BIT_ZERO_US, BIT_ONE_US };
+    uint8_t data[5];
+
+    // Response period: 135 to 220 us inclusive
+    CHECK_EQ(decode_synth(134, bit_us, k_frame, data), DHT22_DECODE_INCOMPLETE);
+    CHECK_EQ(decode_synth(135, bit_us, k_frame, data), DHT22_DECODE_OK);
+    CHECK_EQ(decode_synth(220, bit_us, k_frame, data), DHT22_DECODE_OK);
+    CHECK_EQ(decode_synth(221, bit_us, k_frame, data), DHT22_DECODE_INCOMPLETE);
+
+    // Bit periods: 55 to 160 us, a '1' above 98 us
+    static const uint32_t shortest[2] = { 55, 99 };
+    static const uint32_t longest[2] = { 98, 160 };
+    static const uint32_t too_short[2] = { 54, BIT_ONE_US };
+    static const uint32_t too_long[2] = { BIT_ZERO_US, 161 };
+    CHECK_EQ(decode_synth(160, shortest, k_frame, data), DHT22_DECODE_OK);
+    CHECK(memcmp(data, k_frame, 5) == 0);
+    CHECK_EQ(decode_synth(160, longest, k_frame, data), DHT22_DECODE_OK);
+    CHECK(memcmp(data, k_frame, 5) == 0);
+    CHECK_EQ(decode_synth(160, too_short, k_frame, data), DHT22_DECODE_TIMING);
+    CHECK_EQ(decode_synth(160, too_long, k_frame, data), DHT22_DECODE_TIMING);
+}
+
+// Random frames with interrupt latency: each edge late by up to 15 us, which
+// lengthens one period and shortens the next, as on the device
+static void check_jitter(void)
+{
+    static const uint32_t bit_us[2] = { BIT_ZERO_US, BIT_ONE_US };
+    uint32_t edges[DHT22_FRAME_EDGES];
+    uint8_t frame[5], data[5];
+
+    srand(32);
+    for (int i = 0; i < 10000; i++) {
+        for (int b = 0; b < 4; b++) {
+            frame[b] = rand() & 0xFF;
+        }
+        frame[4] = frame[0] + frame[1] + frame[2] + frame[3];
+        int count = synth(edges, (uint32_t)rand() * 2, CPU_MHZ, 160, bit_us, frame);
+        for (int e = 0; e < count; e++) {
+            edges[e] += (rand() % (15 * CPU_MHZ));
+        }
+        CHECK_EQ(dht22_decode(edges, count, CPU_MHZ, data), DHT22_DECODE_OK);
+        CHECK(memcmp(data, frame, 5) == 0);
+    }
+}
+
+int main(void)
+{
+    check_recorded();
+    check_damaged();
+    check_windows();
+    check_jitter();
+
+    HOST_TEST_EXIT();
+}
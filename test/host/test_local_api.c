@@ -0,0 +1,249 @@
+// The local JSON API under load, on the network loop with host sockets: polls
+// over kept-alive connections and a new connection per request, reported as
+// requests per second, with the heap checked to stay where it was. The data
+// it serves comes from stubs. A connection the loop has no socket slot for is
+// closed at once and does not take a client slot.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "host_test.h"
+#include "host_loop.h"
+#include "lwip/sockets.h"
+#include "esp_system.h"
+#include "net_loop.h"
+#include "local_api.h"
+#include "sensors.h"
+#include "weather_api.h"
+#include "wifi_manager.h"
+#include "time_manager.h"
+
+#define KEEP_ALIVE_REQUESTS 20000
+#define NEW_CONNECTIONS     2000
+#define INVALIDATE_EVERY    500         // Readings change this often, in requests
+
+static const char KEEP_ALIVE[] = "GET / HTTP/1.1\r\nHost: station\r\n\r\n";
+static const char ONE_SHOT[] = "GET /api HTTP/1.0\r\n\r\n";
+
+esp_err_t sensors_get(sensor_quantity_t quantity, int16_t *value)
+{
+    *value = (quantity == SENSOR_TEMPERATURE) ? 215 : 473;
+    return ESP_OK;
+}
+
+bool weather_is_valid(void)
+{
+    return true;
+}
+
+esp_err_t weather_get_current(weather_forecast_t *forecast)
+{
+    memset(forecast, 0, sizeof(*forecast));
+    forecast->temp = 124;
+    forecast->condition = WEATHER_CLOUDS;
+    strcpy(forecast->description, "broken clouds");
+    forecast->dt = 1760000000;
+    return ESP_OK;
+}
+
+int weather_get_location_count(void)
+{
+    return 3;
+}
+
+esp_err_t weather_get_location(int index, weather_location_t *location)
+{
+    static const char *const names[] = { "London", "Paris", "Madrid" };
+
+    memset(location, 0, sizeof(*location));
+    location->city_id = 2643743 + index;
+    strcpy(location->name, names[index]);
+    location->temp = 100 + index * 30;
+    location->condition = WEATHER_CLEAR;
+    location->dt = 1760000000;
+    location->valid = 1;
+    return ESP_OK;
+}
+
+void wifi_manager_get_link_stats(wifi_link_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->rssi = -61;
+}
+
+bool wifi_is_connected(void)
+{
+    return true;
+}
+
+bool time_is_synced(void)
+{
+    return false;
+}
+
+static int connect_api(void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_LOCAL_API_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    for (int attempt = 0; attempt < 200; attempt++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            return fd;
+        }
+        close(fd);
+        usleep(10 * 1000);      // Not listening yet
+    }
+    return -1;
+}
+
+// Send one request and read the whole response; returns the status, 0 if the
+// server closed the connection first
+static int request(int fd, const char *req, char *body, size_t body_size)
+{
+    char buf[LOCAL_API_BUFFER_LEN + 1];
+    size_t len = 0;
+    char *end = NULL;
+
+    if (send(fd, req, strlen(req), 0) != (ssize_t)strlen(req)) {
+        return 0;
+    }
+    while (end == NULL || len < (size_t)(end + 4 - buf) + strtoul(strstr(buf, "Content-Length:") + 15, NULL, 10)) {
+        ssize_t n = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (n <= 0) {
+            return 0;
+        }
+        len += n;
+        buf[len] = '\0';
+        end = strstr(buf, "\r\n\r\n");
+    }
+    if (body != NULL) {
+        snprintf(body, body_size, "%s", end + 4);
+    }
+    return atoi(buf + 9);
+}
+
+static bool closed_by_server(int fd)
+{
+    char c;
+    return recv(fd, &c, 1, 0) == 0;
+}
+
+// Every loop socket slot but the listening socket's taken by pipes
+static int s_pipes[NET_LOOP_MAX_SOCKETS][2];
+static int s_pipe_count;
+
+static void nothing_io(int fd, uint8_t events, void *arg)
+{
+}
+
+static void fill_sockets(void)
+{
+    while (pipe(s_pipes[s_pipe_count]) == 0 &&
+           net_loop_watch(s_pipes[s_pipe_count][0], NET_LOOP_READ | NET_LOOP_QUIET, nothing_io, NULL) == ESP_OK) {
+        s_pipe_count++;
+    }
+    close(s_pipes[s_pipe_count][0]);
+    close(s_pipes[s_pipe_count][1]);
+}
+
+static void free_sockets(void)
+{
+    for (int i = 0; i < s_pipe_count; i++) {
+        net_loop_unwatch(s_pipes[i][0]);
+        close(s_pipes[i][0]);
+        close(s_pipes[i][1]);
+    }
+    s_pipe_count = 0;
+}
+
+static void check_no_socket_slot(void)
+{
+    local_api_stats_t before, after;
+
+    local_api_get_stats(&before);
+    host_loop_call(fill_sockets);
+    int fd = connect_api();
+    CHECK(fd >= 0);
+    CHECK(closed_by_server(fd));
+    close(fd);
+    host_loop_call(free_sockets);
+    local_api_get_stats(&after);
+    CHECK_EQ(after.refused - before.refused, 1);
+
+    // Both client slots are still free
+    int a = connect_api(), b = connect_api();
+    CHECK_EQ(request(a, KEEP_ALIVE, NULL, 0), 200);
+    CHECK_EQ(request(b, KEEP_ALIVE, NULL, 0), 200);
+    close(a);
+    close(b);
+}
+
+int main(void)
+{
+    local_api_stats_t stats;
+    char body[LOCAL_API_BUFFER_LEN];
+
+    CHECK_EQ(local_api_init(), ESP_OK);
+    check_no_socket_slot();
+
+    int fds[LOCAL_API_MAX_CLIENTS];
+    for (int i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+        fds[i] = connect_api();
+        CHECK(fds[i] >= 0);
+    }
+    CHECK_EQ(request(fds[0], KEEP_ALIVE, body, sizeof(body)), 200);
+    printf("%s\n", body);
+    CHECK(strstr(body, "\"indoor\":{\"temperature\":21.5,\"humidity\":47.3}") != NULL);
+    CHECK_EQ(request(fds[1], "GET /nothing HTTP/1.1\r\n\r\n", NULL, 0), 404);
+    CHECK_EQ(request(fds[1], "POST / HTTP/1.1\r\n\r\n", NULL, 0), 405);
+
+    // Polls over the kept-alive connections, taking turns; the response is
+    // serialized again each time the readings change
+    uint32_t heap_before = esp_get_free_heap_size();
+    local_api_get_stats(&stats);
+    uint32_t builds_before = stats.builds;
+    uint64_t start = host_now_ns();
+    int ok = 0;
+    for (int i = 0; i < KEEP_ALIVE_REQUESTS; i++) {
+        if (i % INVALIDATE_EVERY == 0) {
+            local_api_invalidate();
+        }
+        ok += request(fds[i % LOCAL_API_MAX_CLIENTS], KEEP_ALIVE, NULL, 0) == 200;
+    }
+    double seconds = (host_now_ns() - start) / 1e9;
+    local_api_get_stats(&stats);
+    printf("Kept alive:      %d requests in %.2f s, %.0f requests/s, %u builds, heap %u -> %u\n",
+           KEEP_ALIVE_REQUESTS, seconds, KEEP_ALIVE_REQUESTS / seconds, stats.builds - builds_before,
+           heap_before, esp_get_free_heap_size());
+    CHECK_EQ(ok, KEEP_ALIVE_REQUESTS);
+    CHECK(stats.builds - builds_before >= KEEP_ALIVE_REQUESTS / INVALIDATE_EVERY);
+    CHECK(stats.builds - builds_before <= KEEP_ALIVE_REQUESTS / INVALIDATE_EVERY + 1 + (uint32_t)seconds);
+    CHECK_EQ(esp_get_free_heap_size(), heap_before);
+    for (int i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+        close(fds[i]);
+    }
+
+    // A new connection per request, closed by the server after the response
+    uint32_t connections_before = stats.connections;
+    start = host_now_ns();
+    ok = 0;
+    for (int i = 0; i < NEW_CONNECTIONS; i++) {
+        int fd = connect_api();
+        ok += request(fd, ONE_SHOT, NULL, 0) == 200 && closed_by_server(fd);
+        close(fd);
+    }
+    seconds = (host_now_ns() - start) / 1e9;
+    local_api_get_stats(&stats);
+    printf("New connections: %d requests in %.2f s, %.0f requests/s, heap %u -> %u, lowest %u\n",
+           NEW_CONNECTIONS, seconds, NEW_CONNECTIONS / seconds, heap_before, esp_get_free_heap_size(),
+           esp_get_minimum_free_heap_size());
+    CHECK_EQ(ok, NEW_CONNECTIONS);
+    CHECK_EQ(stats.connections - connections_before, NEW_CONNECTIONS);
+    CHECK_EQ(esp_get_free_heap_size(), heap_before);
+
+    HOST_TEST_EXIT();
+}
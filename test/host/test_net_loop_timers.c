@@ -0,0 +1,319 @@
+// Loop timers in virtual time: order of expiry, behaviour before net_loop_init(),
+// literal DNS lookups without a callback, and what HTTP, DNS, the weather update cycle, NTP polling and the MQTT
+// publish tick do when every timer slot is taken. None of them may lose a request silently or stop for good.
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "host_test.h"
+#include "host_clock.h"
+#include "host_dns_server.h"
+#include "host_loop.h"
+#include "host_net.h"
+#include "lwip/sockets.h"
+#include "net_dns.h"
+#include "net_http.h"
+#include "net_loop.h"
+#include "nvs.h"
+#include "ntp_client.h"
+#include "mqtt_pub.h"
+#include "power_manager.h"
+#include "time_manager.h"
+#include "weather_api.h"
+#include "wifi_manager.h"
+
+#define HOUR_MS (60 * 60 * 1000)
+
+static int s_fired[8];
+static int s_fired_count;
+static int s_fillers[NET_LOOP_MAX_TIMERS];
+static int s_filler_count;
+static int s_http_done;
+static int s_dns_done;
+static esp_err_t s_dns_err;
+static int s_updates;
+static int s_ntp_fd;
+static int s_ntp_requests;
+static int s_ntp_results;
+static int s_mqtt_ticks;
+
+void power_radio_expect(uint32_t delay_ms) {}
+void power_radio_acquire(void) {}
+void power_radio_release(void) {}
+
+// Asked by each MQTT tick that finds records queued; no session is started
+bool time_is_synced(void)
+{
+    __atomic_add_fetch(&s_mqtt_ticks, 1, __ATOMIC_RELEASE);
+    return false;
+}
+
+bool wifi_is_connected(void)
+{
+    return true;
+}
+
+static void record(void *arg)
+{
+    if (s_fired_count < 8) {
+        s_fired[s_fired_count] = (int)(intptr_t)arg;
+    }
+    s_fired_count++;
+}
+
+static void never(void *arg)
+{
+    printf("Filler timer fired\n");
+    abort();
+}
+
+// Take every free timer slot
+static void fill_table(void)
+{
+    int id;
+
+    s_filler_count = 0;
+    while ((id = net_loop_schedule(never, NULL, HOUR_MS)) != NET_LOOP_TIMER_INVALID) {
+        s_fillers[s_filler_count++] = id;
+    }
+}
+
+static void free_table(void)
+{
+    for (int i = 0; i < s_filler_count; i++) {
+        net_loop_cancel(s_fillers[i]);
+    }
+    s_filler_count = 0;
+}
+
+static void http_done(void *ctx, esp_err_t err, int status)
+{
+    s_http_done++;
+}
+
+static void dns_done(esp_err_t err, uint32_t addr, uint32_t ttl, void *arg)
+{
+    s_dns_err = err;
+    s_dns_done++;
+}
+
+// Whether the DNS cache has put the host's address in NVS
+static bool dns_cache_saved(const char *host)
+{
+    static char blob[NET_DNS_CACHE_SIZE * (NET_DNS_HOST_LEN + 4)];
+    size_t len = sizeof(blob);
+    nvs_handle handle;
+
+    if (nvs_open("net_dns", NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    esp_err_t err = nvs_get_blob(handle, "cache", blob, &len);
+    nvs_close(handle);
+    for (size_t pos = 0; err == ESP_OK && pos + NET_DNS_HOST_LEN <= len; pos += NET_DNS_HOST_LEN + 4) {
+        if (strcmp(blob + pos, host) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool fired_three(void)
+{
+    return s_fired_count >= 3;
+}
+
+static bool fired_four(void)
+{
+    return s_fired_count >= 4;
+}
+
+// Literal hosts complete without a query, with nobody to tell
+static void literal_lookups(void)
+{
+    CHECK_EQ(net_dns_lookup("10.0.0.1", NULL, NULL), ESP_OK);
+    CHECK_EQ(net_dns_resolve("10.0.0.2", NULL, NULL), ESP_OK);
+    net_dns_prefetch("192.168.1.10");
+    net_loop_schedule(record, (void *)40, 10);
+}
+
+static bool dns_answered(void)
+{
+    return s_dns_done > 0;
+}
+
+static bool updated(void)
+{
+    return __atomic_load_n(&s_updates, __ATOMIC_ACQUIRE) > 0;
+}
+
+static void on_update(void)
+{
+    __atomic_add_fetch(&s_updates, 1, __ATOMIC_RELEASE);
+}
+
+// Stand-in NTP server on a loopback port, answered from the test thread
+static void ntp_server_start(void)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+
+    s_ntp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    bind(s_ntp_fd, (struct sockaddr *)&addr, sizeof(addr));
+    getsockname(s_ntp_fd, (struct sockaddr *)&addr, &len);
+    fcntl(s_ntp_fd, F_SETFL, O_NONBLOCK);
+    host_net_redirect(123, ntohs(addr.sin_port));
+}
+
+static void put_timestamp(uint8_t *p)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    uint32_t seconds = (uint32_t)(tv.tv_sec + 2208988800ULL);
+    uint32_t fraction = (uint32_t)(((uint64_t)tv.tv_usec << 32) / 1000000);
+    for (int i = 0; i < 4; i++) {
+        p[i] = seconds >> (24 - 8 * i);
+        p[4 + i] = fraction >> (24 - 8 * i);
+    }
+}
+
+// Answer every request waiting on the server socket as a stratum 2 server
+// whose clock is the host's
+static void ntp_serve(void)
+{
+    uint8_t packet[48];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+
+    while (recvfrom(s_ntp_fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_len) == 48) {
+        s_ntp_requests++;
+        memcpy(&packet[24], &packet[40], 8);    // Their transmit time is our origin
+        memset(packet, 0, 24);
+        packet[0] = (4 << 3) | 4;
+        packet[1] = 2;
+        put_timestamp(&packet[32]);
+        put_timestamp(&packet[40]);
+        sendto(s_ntp_fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, from_len);
+        from_len = sizeof(from);
+    }
+}
+
+static bool ntp_first_round(void)
+{
+    ntp_serve();
+    return __atomic_load_n(&s_ntp_results, __ATOMIC_ACQUIRE) >= 1;
+}
+
+static bool ntp_second_round(void)
+{
+    ntp_serve();
+    return __atomic_load_n(&s_ntp_results, __ATOMIC_ACQUIRE) >= 2;
+}
+
+static void ntp_result(const ntp_result_t *result)
+{
+    __atomic_add_fetch(&s_ntp_results, 1, __ATOMIC_RELEASE);
+}
+
+static bool mqtt_two_ticks(void)
+{
+    return __atomic_load_n(&s_mqtt_ticks, __ATOMIC_ACQUIRE) >= 2;
+}
+
+// On the loop task, with every slot taken
+static void full_table_requests(void)
+{
+    static const net_http_handler_t handler = { .on_done = http_done };
+    static net_http_request_t req;
+
+    fill_table();
+    CHECK_EQ(s_filler_count, NET_LOOP_MAX_TIMERS);
+
+    // Refused up front, and nothing left behind that could call back later
+    CHECK_EQ(net_http_get(&req, "http://example.com/", NULL, &handler, 1000), ESP_ERR_NO_MEM);
+    CHECK(!net_http_busy(&req));
+    CHECK_EQ(net_dns_resolve("10.0.0.1", dns_done, NULL), ESP_ERR_NO_MEM);
+    CHECK_EQ(net_dns_resolve("example.com", dns_done, NULL), ESP_ERR_NO_MEM);
+
+    // One slot: the HTTP deadline takes it, the cached answer cannot be
+    // delivered, and the deadline is given back
+    net_loop_cancel(s_fillers[--s_filler_count]);
+    CHECK_EQ(net_http_get(&req, "http://10.0.0.1/", NULL, &handler, 1000), ESP_ERR_NO_MEM);
+    CHECK(!net_http_busy(&req));
+    int id = net_loop_schedule(never, NULL, HOUR_MS);
+    CHECK(id != NET_LOOP_TIMER_INVALID);
+    s_fillers[s_filler_count++] = id;
+
+    // Slots queried by DNS are all free again once the table has room
+    free_table();
+    CHECK_EQ(net_dns_resolve("example.com", dns_done, NULL), ESP_OK);
+}
+
+int main(void)
+{
+    host_clock_set_virtual(true);
+
+    // Before init: refused, not a crash on the missing lock
+    CHECK_EQ(net_loop_schedule(record, NULL, 0), NET_LOOP_TIMER_INVALID);
+    net_loop_cancel(0);
+
+    CHECK_EQ(net_loop_init(), ESP_OK);
+    host_dns_server_start(60);
+    host_net_redirect(80, 9);       // Nothing listens on the discard port
+
+    // Expiry in due order, whatever the order of scheduling
+    net_loop_schedule(record, (void *)30, 30);
+    net_loop_schedule(record, (void *)10, 10);
+    net_loop_schedule(record, (void *)20, 20);
+    CHECK(host_loop_run_until(fired_three, 5, 1000));
+    CHECK_EQ(s_fired[0], 10);
+    CHECK_EQ(s_fired[1], 20);
+    CHECK_EQ(s_fired[2], 30);
+
+    // Literals with no callback: completed on the loop, nothing called
+    host_loop_call(literal_lookups);
+    CHECK(host_loop_run_until(fired_four, 5, 1000));
+    CHECK_EQ(s_fired[3], 40);
+
+    host_loop_call(full_table_requests);
+    CHECK(host_loop_run_until(dns_answered, 100, 10000));
+    CHECK_EQ(s_dns_err, ESP_OK);
+    CHECK_EQ(s_http_done, 0);
+
+    // Weather started with the table full: the first fetch waits on its retry
+    // timer, which keeps trying until a slot is free
+    host_loop_call(fill_table);
+    weather_set_update_hook(on_update);
+    weather_api_init();
+    host_clock_advance_us(30 * 1000 * 1000);
+    CHECK_EQ(s_updates, 0);
+    free_table();
+    CHECK(host_loop_run_until(updated, 1000, 60 * 1000));
+    CHECK(!weather_is_valid());     // Port 80 refuses; what matters is that the cycle ran
+
+    // NTP started with the table full: no error, and the first round goes out
+    // once a slot is free; polling then carries on at its interval. Servers
+    // are resolved through the DNS cache
+    ntp_server_start();
+    host_loop_call(fill_table);
+    CHECK_EQ(ntp_client_start("ntp.example", ntp_result), ESP_OK);
+    host_clock_advance_us(30 * 1000 * 1000);
+    ntp_serve();
+    CHECK_EQ(s_ntp_requests, 0);
+    free_table();
+    CHECK(host_loop_run_until(ntp_first_round, 1000, 60 * 1000));
+    CHECK(host_loop_run_until(ntp_second_round, 10 * 1000, (ntp_client_poll_interval() + 60) * 1000));
+    CHECK_EQ(s_ntp_requests, 2);
+    CHECK(dns_cache_saved("ntp.example"));
+
+    // MQTT started with the table full: no error, and the publish tick comes
+    // from its esp_timer until it is back on a loop timer
+    host_loop_call(fill_table);
+    CHECK_EQ(mqtt_pub_init(), ESP_OK);
+    mqtt_pub_add_sensor(0, 215, 473);
+    host_clock_advance_us(CONFIG_MQTT_PUBLISH_INTERVAL * 1000000LL / 2);
+    CHECK_EQ(s_mqtt_ticks, 0);
+    free_table();
+    CHECK(host_loop_run_until(mqtt_two_ticks, 1000, (CONFIG_MQTT_PUBLISH_INTERVAL * 2 + 60) * 1000));
+
+    HOST_TEST_EXIT();
+}
@@ -0,0 +1,333 @@
+// OpenWeatherMap parser against the recorded corpus: every payload plain and
+// gzip-encoded, fed in network-sized chunks, checked for the expected result,
+// timed and measured for peak heap. Then a fuzz loop feeds mutated and cut
+// copies of each payload, which must end in a defined status without leaks.
+//
+//   test_owm_replay [fuzz iterations per payload]
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <zlib.h>
+#include "host_test.h"
+#include "owm_parser.h"
+
+#define MAX_PAYLOADS 64
+#define TIMING_RUNS  20
+
+typedef struct {
+    char name[32];
+    owm_response_kind_t kind;
+    char *body;
+    size_t len;
+    owm_parse_status_t expect;
+    int forecast_cnt;               // Forecast payloads: entries in the list
+} payload_t;
+
+typedef struct {
+    owm_parse_status_t status;
+    size_t wire;
+    size_t decoded;
+    size_t peak_heap;
+    double parse_us;
+} result_t;
+
+static payload_t s_payloads[MAX_PAYLOADS];
+static int s_payload_count;
+static weather_location_t s_locations[WEATHER_MAX_LOCATIONS];
+
+// Heap use of the code under test: malloc and free are wrapped at link time
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+static size_t s_heap_now;
+static size_t s_heap_peak;
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    if (ptr != NULL) {
+        s_heap_now += malloc_usable_size(ptr);
+        if (s_heap_now > s_heap_peak) {
+            s_heap_peak = s_heap_now;
+        }
+    }
+    return ptr;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr != NULL) {
+        s_heap_now -= malloc_usable_size(ptr);
+    }
+    __real_free(ptr);
+}
+
+static char *load(const char *name, size_t *len)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "corpus/owm/%s", name);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("Cannot open %s\n", path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(*len + 1);
+    *len = fread(data, 1, *len, f);
+    data[*len] = '\0';
+    fclose(f);
+    return data;
+}
+
+static void add(const char *name, owm_response_kind_t kind, char *body, size_t len,
+                owm_parse_status_t expect, int forecast_cnt)
+{
+    payload_t *p = &s_payloads[s_payload_count++];
+
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    p->kind = kind;
+    p->body = body;
+    p->len = len;
+    p->expect = expect;
+    p->forecast_cnt = forecast_cnt;
+}
+
+static void add_file(const char *file, owm_response_kind_t kind, owm_parse_status_t expect)
+{
+    size_t len;
+    char *body = load(file, &len);
+    add(file, kind, body, len, expect, 0);
+}
+
+// cnt=N response cut from the 40-entry recording, which has one entry per line
+static void add_forecasts(void)
+{
+    size_t len;
+    char *full = load("forecast_cnt40.json", &len);
+    char *lines[42];
+    int count = 0;
+
+    for (char *line = strtok(full, "\n"); line != NULL && count < 42; line = strtok(NULL, "\n")) {
+        lines[count++] = line;
+    }
+    for (int cnt = 1; cnt <= 40; cnt++) {
+        char *body = malloc(len + 16);
+        char name[32];
+        if (body == NULL) {
+            exit(1);
+        }
+        size_t pos = sprintf(body, "{\"cod\":\"200\",\"message\":0,\"cnt\":%d,\"list\":[", cnt);
+        for (int i = 0; i < cnt; i++) {
+            size_t entry_len = strlen(lines[1 + i]);
+            if (lines[1 + i][entry_len - 1] == ',') {
+                entry_len--;
+            }
+            pos += sprintf(body + pos, "%s%.*s", i ? "," : "", (int)entry_len, lines[1 + i]);
+        }
+        pos += sprintf(body + pos, "%s", lines[41]);
+        snprintf(name, sizeof(name), "forecast cnt=%d", cnt);
+        add(name, OWM_RESPONSE_FORECAST, body, pos,
+            cnt < 2 ? OWM_PARSE_MISSING_FIELDS : OWM_PARSE_OK, cnt);
+    }
+    free(full);
+}
+
+static uint8_t *gzip_body(const char *data, size_t len, int window_bits, size_t *out_len)
+{
+    z_stream z = { 0 };
+    uint8_t *out = malloc(len + 128);
+
+    deflateInit2(&z, 6, Z_DEFLATED, window_bits + 16, 8, Z_DEFAULT_STRATEGY);
+    z.next_in = (Bytef *)data;
+    z.avail_in = len;
+    z.next_out = out;
+    z.avail_out = len + 128;
+    deflate(&z, Z_FINISH);
+    *out_len = z.total_out;
+    deflateEnd(&z);
+    return out;
+}
+
+static uint32_t s_rand = 2463534242u;
+
+static uint32_t next_rand(void)
+{
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+// Feed as the network would: chunks of 1..chunk_max bytes
+static owm_parse_status_t parse_chunked(owm_parser_t *parser, owm_response_kind_t kind, bool gzip,
+                                        const uint8_t *data, size_t len, size_t chunk_max,
+                                        weather_forecast_t out[2])
+{
+    owm_parser_init(parser, kind);
+    if (kind == OWM_RESPONSE_GROUP) {
+        owm_parser_set_locations(parser, s_locations, WEATHER_MAX_LOCATIONS);
+    }
+    if (gzip) {
+        owm_parser_enable_gzip(parser);
+    }
+    for (size_t pos = 0; pos < len;) {
+        size_t chunk = 1 + next_rand() % chunk_max;
+        if (chunk > len - pos) {
+            chunk = len - pos;
+        }
+        owm_parser_feed(parser, data + pos, chunk);
+        pos += chunk;
+    }
+    return owm_parser_finish(parser, out);
+}
+
+static void run(const payload_t *p, bool gzip, const uint8_t *wire, size_t wire_len, result_t *r)
+{
+    static owm_parser_t parser;
+    weather_forecast_t out[2];
+
+    size_t heap_before = s_heap_now;
+    s_heap_peak = s_heap_now;
+    r->status = parse_chunked(&parser, p->kind, gzip, wire, wire_len, 1460, out);
+    r->peak_heap = s_heap_peak - heap_before;
+    r->wire = parser.wire_bytes;
+    r->decoded = parser.body_bytes;
+    CHECK_EQ(s_heap_now, heap_before);
+
+    uint64_t start = host_now_ns();
+    for (int i = 0; i < TIMING_RUNS; i++) {
+        parse_chunked(&parser, p->kind, gzip, wire, wire_len, 1460, out);
+    }
+    r->parse_us = (host_now_ns() - start) / 1000.0 / TIMING_RUNS;
+}
+
+// Forecast results must be the entries the display uses, by position in the list
+static void check_forecast(const payload_t *p)
+{
+    static owm_parser_t parser;
+    weather_forecast_t out[2];
+
+    if (p->kind != OWM_RESPONSE_FORECAST || p->expect != OWM_PARSE_OK) {
+        return;
+    }
+    int first = (p->forecast_cnt > 4) ? 2 : (p->forecast_cnt > 2) ? 1 : 0;
+    int second = (p->forecast_cnt > 4) ? 4 : first + 1;
+    CHECK_EQ(owm_parse_buffer(&parser, OWM_RESPONSE_FORECAST, false, p->body, p->len, out), OWM_PARSE_OK);
+    CHECK_EQ(out[0].dt, 1717236000 + 10800 * first);
+    CHECK_EQ(out[1].dt, 1717236000 + 10800 * second);
+}
+
+static void replay(void)
+{
+    printf("%-24s %-7s %7s %7s %-22s %8s %9s\n",
+           "payload", "coding", "wire", "body", "result", "parse us", "peak heap");
+    for (int i = 0; i < s_payload_count; i++) {
+        const payload_t *p = &s_payloads[i];
+        result_t plain, gz32, gz8;
+        size_t len32, len8;
+        uint8_t *wire32 = gzip_body(p->body, p->len, 15, &len32);
+        uint8_t *wire8 = gzip_body(p->body, p->len, GZIP_INFLATE_WINDOW_BITS, &len8);
+
+        run(p, false, (const uint8_t *)p->body, p->len, &plain);
+        run(p, true, wire8, len8, &gz8);
+        run(p, true, wire32, len32, &gz32);
+
+        // Plain and gzip within our window give the same result; with a 32 KB
+        // window the encoder may reach further back once the body is larger
+        CHECK_EQ(plain.status, p->expect);
+        CHECK_EQ(gz8.status, p->expect);
+        if (p->len <= GZIP_INFLATE_WINDOW_SIZE) {
+            CHECK_EQ(gz32.status, p->expect);
+        } else {
+            CHECK(gz32.status == p->expect || gz32.status == OWM_PARSE_WINDOW_ERROR);
+        }
+        CHECK_EQ(plain.peak_heap, 0);
+        CHECK_EQ(plain.decoded, p->len);
+        check_forecast(p);
+
+        // A gzip stream cut short is truncated, not a decode error
+        result_t cut;
+        run(p, true, wire8, len8 / 2, &cut);
+        CHECK_EQ(cut.status, OWM_PARSE_TRUNCATED);
+
+        const struct { const char *coding; const result_t *r; } rows[] = {
+            { "plain", &plain }, { "gzip8k", &gz8 }, { "gzip32k", &gz32 },
+        };
+        for (int k = 0; k < 3; k++) {
+            printf("%-24s %-7s %7zu %7zu %-22s %8.1f %9zu\n", k ? "" : p->name, rows[k].coding,
+                   rows[k].r->wire, rows[k].r->decoded, owm_parse_status_name(rows[k].r->status),
+                   rows[k].r->parse_us, rows[k].r->peak_heap);
+        }
+        free(wire32);
+        free(wire8);
+    }
+}
+
+static void fuzz(int iterations)
+{
+    static owm_parser_t parser;
+    weather_forecast_t out[2];
+    int statuses[OWM_PARSE_MISSING_FIELDS + 1] = { 0 };
+    size_t peak = 0;
+
+    for (int i = 0; i < s_payload_count; i++) {
+        const payload_t *p = &s_payloads[i];
+        size_t gz_len;
+        uint8_t *gz = gzip_body(p->body, p->len, GZIP_INFLATE_WINDOW_BITS, &gz_len);
+        size_t max_len = (gz_len > p->len) ? gz_len : p->len;
+        uint8_t *mutated = malloc(max_len);
+
+        for (int it = 0; it < iterations; it++) {
+            bool gzip = it & 1;
+            const uint8_t *src = gzip ? gz : (const uint8_t *)p->body;
+            size_t len = gzip ? gz_len : p->len;
+
+            memcpy(mutated, src, len);
+            for (int flips = 1 + next_rand() % 8; flips > 0; flips--) {
+                mutated[next_rand() % len] = next_rand();
+            }
+            if (next_rand() % 4 == 0) {
+                len = next_rand() % len;
+            }
+
+            size_t heap_before = s_heap_now;
+            s_heap_peak = s_heap_now;
+            owm_parse_status_t status = parse_chunked(&parser, p->kind, gzip, mutated, len, 600, out);
+            CHECK(status <= OWM_PARSE_MISSING_FIELDS);
+            CHECK_EQ(s_heap_now, heap_before);
+            if (s_heap_peak - heap_before > peak) {
+                peak = s_heap_peak - heap_before;
+            }
+            statuses[status]++;
+        }
+        free(mutated);
+        free(gz);
+    }
+
+    printf("\nFuzz: %d mutated bodies, peak heap %zu bytes\n", s_payload_count * iterations, peak);
+    for (int s = 0; s <= OWM_PARSE_MISSING_FIELDS; s++) {
+        printf("  %-28s %6d\n", owm_parse_status_name(s), statuses[s]);
+    }
+    CHECK(peak <= sizeof(gzip_inflate_t) + 64);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : 400;
+
+    add_file("current.json", OWM_RESPONSE_CURRENT, OWM_PARSE_OK);
+    add_file("current_truncated.json", OWM_RESPONSE_CURRENT, OWM_PARSE_TRUNCATED);
+    add_file("current_no_temp.json", OWM_RESPONSE_CURRENT, OWM_PARSE_MISSING_FIELDS);
+    add_file("current_no_weather.json", OWM_RESPONSE_CURRENT, OWM_PARSE_MISSING_FIELDS);
+    add_file("error_401.json", OWM_RESPONSE_CURRENT, OWM_PARSE_MISSING_FIELDS);
+    add_file("group_3.json", OWM_RESPONSE_GROUP, OWM_PARSE_OK);
+    add_file("group_20.json", OWM_RESPONSE_GROUP, OWM_PARSE_OK);
+    add_forecasts();
+
+    replay();
+    fuzz(iterations);
+
+    HOST_TEST_EXIT();
+}
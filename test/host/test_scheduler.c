@@ -0,0 +1,164 @@
+// The job scheduler on its worker task in virtual time: periodic jobs keep
+// their phase, one-shots run once, earlier deadlines go first, a job that
+// overruns delays the others without shifting their phase, sched_now() and
+// sched_cancel() take effect, and the job table has a limit.
+//
+// Time moves 1 ms at a time. After each step a probe job, registered last so
+// that it loses every tie, is run with sched_now(); once it has run, every
+// job due by then has too.
+
+#include <stdlib.h>
+#include "host_test.h"
+#include "host_clock.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "scheduler.h"
+
+#define MS 1000LL
+#define MAX_RUNS 256
+
+typedef struct {
+    int runs;
+    int64_t at_us[MAX_RUNS];
+} runs_t;
+
+static runs_t s_fast, s_slow_period, s_once, s_late;
+static int s_order[4];
+static int s_order_count;
+static int s_fast_job, s_period_job, s_once_job, s_hog_job, s_order_a, s_order_b, s_probe;
+static SemaphoreHandle_t s_probe_done;
+
+static void record(void *arg)
+{
+    runs_t *runs = arg;
+    if (runs->runs < MAX_RUNS) {
+        runs->at_us[runs->runs] = esp_timer_get_time();
+    }
+    runs->runs++;
+}
+
+static void order(void *arg)
+{
+    if (s_order_count < 4) {
+        s_order[s_order_count++] = (int)(intptr_t)arg;
+    }
+}
+
+// Runs for 25 ms of virtual time
+static void hog(void *arg)
+{
+    host_clock_advance_us(25 * MS);
+}
+
+static void probe(void *arg)
+{
+    xSemaphoreGive(s_probe_done);
+}
+
+// Wait for the worker to run everything due by now
+static void settle(void)
+{
+    sched_now(s_probe);
+    xSemaphoreTake(s_probe_done, portMAX_DELAY);
+}
+
+static void step_ms(int ms)
+{
+    for (int i = 0; i < ms; i++) {
+        host_clock_advance_us(MS);
+        settle();
+    }
+}
+
+static void check_phase(const runs_t *runs, int from, int64_t phase_us, int64_t period_us)
+{
+    for (int i = from; i < runs->runs && i < MAX_RUNS; i++) {
+        CHECK_EQ((runs->at_us[i] - phase_us) % period_us, 0);
+    }
+}
+
+int main(void)
+{
+    sched_job_stats_t stats;
+
+    host_clock_set_virtual(true);
+    CHECK_EQ(sched_add("early", record, &s_fast), SCHED_JOB_INVALID);
+
+    CHECK_EQ(sched_init(), ESP_OK);
+    CHECK_EQ(sched_init(), ESP_OK);
+    s_probe_done = xSemaphoreCreateBinary();
+    s_fast_job = sched_add("fast", record, &s_fast);
+    s_period_job = sched_add("period", record, &s_slow_period);
+    s_once_job = sched_add("once", record, &s_once);
+    s_hog_job = sched_add("hog", hog, NULL);
+    s_order_a = sched_add("order_a", order, (void *)1);
+    s_order_b = sched_add("order_b", order, (void *)2);
+    int late_job = sched_add("late", record, &s_late);
+    s_probe = sched_add("probe", probe, NULL);
+    CHECK_EQ(sched_job_count(), SCHED_MAX_JOBS);
+    CHECK_EQ(sched_add("one_too_many", record, NULL), SCHED_JOB_INVALID);
+
+    // Periodic and one-shot jobs, on time to the millisecond step
+    int64_t start = esp_timer_get_time();
+    sched_every(s_fast_job, 10);
+    sched_every(s_period_job, 25);
+    sched_after(s_once_job, 15);
+    step_ms(1000);
+    CHECK_EQ(s_fast.runs, 100);
+    CHECK_EQ(s_slow_period.runs, 40);
+    CHECK_EQ(s_once.runs, 1);
+    CHECK_EQ(s_once.at_us[0] - start, 15 * MS);
+    check_phase(&s_fast, 0, start, 10 * MS);
+    check_phase(&s_slow_period, 0, start, 25 * MS);
+    CHECK_EQ(sched_get_job_stats(s_fast_job, &stats), ESP_OK);
+    CHECK_EQ(stats.runs, 100);
+    CHECK_EQ(stats.late_max_us, 0);
+
+    // The earlier deadline first, whatever the order of scheduling
+    sched_after(s_order_b, 3);
+    sched_after(s_order_a, 5);
+    step_ms(10);
+    CHECK_EQ(s_order_count, 2);
+    CHECK_EQ(s_order[0], 2);
+    CHECK_EQ(s_order[1], 1);
+
+    // A 25 ms job from 1012 ms delays the 10 ms one due at 1020, which runs
+    // when it ends at 1037, skips 1030 and goes on in its old phase
+    int before = s_fast.runs;
+    sched_after(s_hog_job, 2);
+    step_ms(100);
+    CHECK_EQ(s_fast.runs, before + 11);
+    CHECK_EQ(s_fast.at_us[before] - start, 1037 * MS);
+    CHECK_EQ(s_fast.at_us[before + 1] - start, 1040 * MS);
+    check_phase(&s_fast, before + 1, start, 10 * MS);
+    CHECK_EQ(sched_get_job_stats(s_fast_job, &stats), ESP_OK);
+    CHECK_EQ(stats.late_max_us, 17 * MS);
+    CHECK_EQ(sched_get_job_stats(s_hog_job, &stats), ESP_OK);
+    CHECK_EQ(stats.run_max_us, 25 * MS);
+
+    // sched_now(): at once, and the period counts from there
+    sched_every(late_job, 20);
+    step_ms(7);
+    int64_t now_at = esp_timer_get_time();
+    sched_now(late_job);
+    settle();
+    step_ms(45);
+    CHECK_EQ(s_late.runs, 3);
+    CHECK_EQ(s_late.at_us[0], now_at);
+    CHECK_EQ(s_late.at_us[1] - now_at, 20 * MS);
+    CHECK_EQ(s_late.at_us[2] - now_at, 40 * MS);
+
+    // Cancelled jobs stop, one-shots do not come back
+    sched_cancel(s_fast_job);
+    sched_cancel(s_period_job);
+    before = s_fast.runs;
+    int period_before = s_slow_period.runs;
+    step_ms(100);
+    CHECK_EQ(s_fast.runs, before);
+    CHECK_EQ(s_slow_period.runs, period_before);
+    CHECK_EQ(s_once.runs, 1);
+    CHECK_EQ(sched_get_job_stats(SCHED_MAX_JOBS, &stats), ESP_ERR_INVALID_ARG);
+
+    HOST_TEST_EXIT();
+}
@@ -0,0 +1,279 @@
+// The sensor filter chain stage by stage (range check, rate gate and its
+// re-anchor, median, smoother), then recorded-style DHT22 traces run through
+// the chain as the driver configures it. The traces come from
+// test/host/corpus/sensor, written by make_sensor_traces.py.
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "sensor_filter.h"
+
+#define TRACE_MAX 2000
+
+typedef struct {
+    int16_t raw;
+    int16_t truth;
+    char tag;
+} reading_t;
+
+static reading_t s_trace[TRACE_MAX];
+
+static int load_trace(const char *name)
+{
+    char path[128], line[64];
+    int count = 0;
+
+    snprintf(path, sizeof(path), "corpus/sensor/%s", name);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        printf("Cannot open %s\n", path);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f) != NULL && count < TRACE_MAX) {
+        int raw, truth;
+        char tag;
+        if (line[0] != '#' && sscanf(line, "%d,%d,%c", &raw, &truth, &tag) == 3) {
+            s_trace[count++] = (reading_t){ raw, truth, tag };
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+static void check_range(void)
+{
+    const sensor_filter_config_t config = { .min = -400, .max = 800, .max_step = 30,
+                                            .max_rejects = 2, .median_len = 1 };
+    sensor_filter_t f;
+    int16_t out = 1234;
+
+    // Rejected readings leave the output alone and do not prime the gate
+    sensor_filter_init(&f, &config);
+    CHECK(!sensor_filter_apply(&f, -401, &out));
+    CHECK(!sensor_filter_apply(&f, 801, &out));
+    CHECK(!sensor_filter_apply(&f, INT16_MIN, &out));
+    CHECK_EQ(out, 1234);
+    CHECK(sensor_filter_apply(&f, 800, &out));
+    CHECK_EQ(out, 800);
+
+    // Limits are inclusive
+    sensor_filter_init(&f, &config);
+    CHECK(sensor_filter_apply(&f, -400, &out));
+    CHECK_EQ(out, -400);
+
+    // Out of range in the middle of a gate run does not count towards it
+    sensor_filter_init(&f, &config);
+    CHECK(sensor_filter_apply(&f, 200, &out));
+    CHECK(!sensor_filter_apply(&f, 300, &out));
+    CHECK(!sensor_filter_apply(&f, 3276, &out));
+    CHECK(!sensor_filter_apply(&f, 300, &out));
+    CHECK(sensor_filter_apply(&f, 300, &out));
+    CHECK_EQ(out, 300);
+
+    const sensor_filter_stats_t *stats = sensor_filter_stats(&f);
+    CHECK_EQ(stats->accepted, 2);
+    CHECK_EQ(stats->range_rejects, 1);
+    CHECK_EQ(stats->rate_rejects, 2);
+    CHECK_EQ(stats->rate_reanchors, 1);
+}
+
+static void check_reanchor(void)
+{
+    sensor_filter_config_t config = { .min = -1000, .max = 1000, .max_step = 10,
+                                      .max_rejects = 3, .median_len = 5, .ema_shift = 2 };
+    sensor_filter_t f;
+    int16_t out;
+
+    // max_rejects readings at the new level are dropped, the next one is taken
+    // and restarts the median and smoother there
+    sensor_filter_init(&f, &config);
+    for (int i = 0; i < 5; i++) {
+        CHECK(sensor_filter_apply(&f, 100, &out));
+    }
+    for (int i = 0; i < 3; i++) {
+        CHECK(!sensor_filter_apply(&f, 200, &out));
+    }
+    CHECK(sensor_filter_apply(&f, 200, &out));
+    CHECK_EQ(out, 200);
+    CHECK(sensor_filter_apply(&f, 205, &out));
+    CHECK_EQ(out, 201);         // Median 205 of 200/205, smoothed by a quarter
+    CHECK_EQ(sensor_filter_stats(&f)->rate_rejects, 3);
+    CHECK_EQ(sensor_filter_stats(&f)->rate_reanchors, 1);
+
+    // An accepted reading in between starts the count again
+    sensor_filter_init(&f, &config);
+    CHECK(sensor_filter_apply(&f, 100, &out));
+    for (int i = 0; i < 3; i++) {
+        CHECK(!sensor_filter_apply(&f, 200, &out));
+        CHECK(!sensor_filter_apply(&f, -200, &out));
+        CHECK(!sensor_filter_apply(&f, 200, &out));
+        CHECK(sensor_filter_apply(&f, 100, &out));
+    }
+    CHECK_EQ(sensor_filter_stats(&f)->rate_reanchors, 0);
+
+    // The gate measures from the last accepted reading, not the output, so a
+    // slow drift passes however far it goes
+    sensor_filter_init(&f, &config);
+    for (int i = 0; i <= 100; i++) {
+        CHECK(sensor_filter_apply(&f, i * 10, &out));
+    }
+    CHECK(out > 900);
+
+    // No patience: every step is taken at once
+    config.max_rejects = 0;
+    sensor_filter_init(&f, &config);
+    CHECK(sensor_filter_apply(&f, 100, &out));
+    CHECK(sensor_filter_apply(&f, -100, &out));
+    CHECK_EQ(out, -100);
+    CHECK_EQ(sensor_filter_stats(&f)->rate_reanchors, 1);
+
+    // No gate
+    config.max_step = 0;
+    config.ema_shift = 0;
+    config.median_len = 1;
+    sensor_filter_init(&f, &config);
+    CHECK(sensor_filter_apply(&f, 1000, &out));
+    CHECK(sensor_filter_apply(&f, -1000, &out));
+    CHECK_EQ(out, -1000);
+    CHECK_EQ(sensor_filter_stats(&f)->rate_reanchors, 0);
+}
+
+static void check_median(void)
+{
+    const sensor_filter_config_t config = { .min = -1000, .max = 1000, .median_len = 5 };
+    static const int16_t in[] = { 10, 50, 20, 40, 30, 0, 0, 900, 0 };
+    // Middle of what has arrived so far (the upper one of an even count), then
+    // of the last five
+    static const int16_t expected[] = { 10, 50, 20, 40, 30, 30, 20, 30, 0 };
+    sensor_filter_t f;
+    int16_t out;
+
+    sensor_filter_init(&f, &config);
+    for (size_t i = 0; i < sizeof(in) / sizeof(in[0]); i++) {
+        CHECK(sensor_filter_apply(&f, in[i], &out));
+        CHECK_EQ(out, expected[i]);
+    }
+
+    // Lengths outside 1..7 are clamped
+    sensor_filter_config_t odd = config;
+    odd.median_len = 0;
+    sensor_filter_init(&f, &odd);
+    CHECK_EQ(f.config.median_len, 1);
+    odd.median_len = 9;
+    sensor_filter_init(&f, &odd);
+    CHECK_EQ(f.config.median_len, SENSOR_FILTER_MAX_MEDIAN);
+}
+
+static void check_ema(void)
+{
+    const sensor_filter_config_t config = { .min = -1000, .max = 1000, .median_len = 1,
+                                            .ema_shift = 2 };
+    static const int16_t rising[] = { 0, 25, 44, 58, 68 };
+    sensor_filter_t f;
+    int16_t out;
+
+    // A quarter of the way to each new reading, rounded to the nearest unit
+    sensor_filter_init(&f, &config);
+    CHECK(sensor_filter_apply(&f, 0, &out));
+    CHECK_EQ(out, 0);
+    for (int i = 1; i < 5; i++) {
+        CHECK(sensor_filter_apply(&f, 100, &out));
+        CHECK_EQ(out, rising[i]);
+    }
+
+    // Rounding is symmetric about zero
+    sensor_filter_init(&f, &config);
+    CHECK(sensor_filter_apply(&f, 0, &out));
+    for (int i = 1; i < 5; i++) {
+        CHECK(sensor_filter_apply(&f, -100, &out));
+        CHECK_EQ(out, -rising[i]);
+    }
+
+    // Settles on a constant input
+    for (int i = 0; i < 100; i++) {
+        sensor_filter_apply(&f, -100, &out);
+    }
+    CHECK(out >= -100 && out <= -98);
+}
+
+// Kconfig defaults, as in the driver
+static const sensor_filter_config_t k_temperature = {
+    .min = -400, .max = 800, .max_step = 30, .max_rejects = 2, .median_len = 3, .ema_shift = 1,
+};
+static const sensor_filter_config_t k_humidity = {
+    .min = 0, .max = 1000, .max_step = 150, .max_rejects = 2, .median_len = 3, .ema_shift = 1,
+};
+
+static void replay(const char *name, const sensor_filter_config_t *config, int tolerance)
+{
+    int count = load_trace(name);
+    int tags[128] = { 0 };
+    int64_t raw_error = 0, out_error = 0;
+    int worst = 0, outputs = 0, valid = 0;
+    sensor_filter_t f;
+    int16_t out;
+
+    CHECK(count > 0);
+    sensor_filter_init(&f, config);
+    for (int i = 0; i < count; i++) {
+        const reading_t *r = &s_trace[i];
+        tags[(int)r->tag]++;
+        bool in_range = r->raw >= config->min && r->raw <= config->max;
+        if (in_range) {
+            raw_error += abs(r->raw - r->truth);
+            valid++;
+        }
+
+        bool accepted = sensor_filter_apply(&f, r->raw, &out);
+        if (r->tag == 'r' || r->tag == 'S') {
+            CHECK(!accepted);
+        }
+        if (r->tag == 'j') {
+            // The first readings at a new level are held back, the one after is
+            // taken as it comes
+            CHECK(!accepted);
+            for (int k = 1; k < config->max_rejects; k++) {
+                CHECK(!sensor_filter_apply(&f, s_trace[i + k].raw, &out));
+            }
+            i += config->max_rejects;
+            CHECK(sensor_filter_apply(&f, s_trace[i].raw, &out));
+            CHECK(abs(out - s_trace[i].truth) <= tolerance);
+            continue;
+        }
+        if (accepted) {
+            int error = abs(out - r->truth);
+            out_error += error;
+            outputs++;
+            if (error > worst) {
+                worst = error;
+            }
+        }
+    }
+
+    const sensor_filter_stats_t *stats = sensor_filter_stats(&f);
+    printf("%-16s %5d %5d %4d %4d %4d %8.2f %8.2f %5d\n", name, count, stats->accepted,
+           stats->range_rejects, stats->rate_rejects, stats->rate_reanchors,
+           (double)raw_error / valid, (double)out_error / outputs, worst);
+
+    CHECK_EQ(stats->range_rejects, tags['r']);
+    CHECK_EQ(stats->rate_rejects, tags['S'] + tags['j'] * config->max_rejects);
+    CHECK_EQ(stats->rate_reanchors, tags['j']);
+    CHECK_EQ(stats->accepted, count - stats->range_rejects - stats->rate_rejects);
+    CHECK(worst <= tolerance);
+    CHECK(out_error * valid < raw_error * outputs);
+}
+
+int main(void)
+{
+    check_range();
+    check_reanchor();
+    check_median();
+    check_ema();
+
+    printf("%-16s %5s %5s %4s %4s %4s %8s %8s %5s\n", "trace", "read", "taken",
+           "rng", "rate", "step", "raw err", "out err", "worst");
+    replay("temperature.csv", &k_temperature, 3);
+    replay("humidity.csv", &k_humidity, 8);
+
+    HOST_TEST_EXIT();
+}
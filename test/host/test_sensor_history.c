@@ -0,0 +1,169 @@
+// sensor_history against a plain reference: three days of one-minute samples
+// (a daily cycle, noise and a few steps too large for one delta) go into the
+// history and into full arrays, and after every sample each tier's window,
+// rolling statistics and downsampled query must match what the arrays give
+// when recomputed from scratch.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "sensor_history.h"
+
+#define RAW_PERIOD_S    60
+#define DAYS            3
+#define SAMPLES         (DAYS * 24 * 60)
+
+// Every value a tier has stored, oldest first
+typedef struct {
+    int16_t value[SAMPLES];
+    int count;
+    uint16_t period_s;
+} reference_t;
+
+static reference_t s_ref[SENSOR_HISTORY_TIERS];
+
+static int16_t div_round(int32_t sum, int32_t count)
+{
+    return (sum < 0) ? (sum - count / 2) / count : (sum + count / 2) / count;
+}
+
+// Steps beyond one delta are cut to it, and the series catches up later
+static void ref_push(reference_t *r, int16_t value)
+{
+    if (r->count > 0) {
+        int16_t last = r->value[r->count - 1];
+        if (value > last + INT8_MAX) {
+            value = last + INT8_MAX;
+        } else if (value < last - INT8_MAX) {
+            value = last - INT8_MAX;
+        }
+    }
+    r->value[r->count++] = value;
+}
+
+static int window(const reference_t *r, const int16_t **values)
+{
+    int n = r->count < SENSOR_HISTORY_LENGTH ? r->count : SENSOR_HISTORY_LENGTH;
+    *values = r->value + r->count - n;
+    return n;
+}
+
+static void check_tier(const sensor_history_t *h, sensor_history_tier_t tier)
+{
+    const reference_t *r = &s_ref[tier];
+    const int16_t *v;
+    int n = window(r, &v);
+    sensor_history_stats_t stats;
+    int16_t points[SENSOR_HISTORY_LENGTH];
+
+    sensor_history_get_stats(h, tier, &stats);
+    CHECK_EQ(stats.count, n);
+    if (n == 0) {
+        CHECK_EQ(sensor_history_query(h, tier, points, SENSOR_HISTORY_LENGTH), 0);
+        return;
+    }
+
+    int16_t min = v[0], max = v[0];
+    int32_t sum = 0;
+    double k_mean = (n - 1) / 2.0, v_mean = 0, sxy = 0, sxx = 0;
+    for (int i = 0; i < n; i++) {
+        min = v[i] < min ? v[i] : min;
+        max = v[i] > max ? v[i] : max;
+        sum += v[i];
+    }
+    v_mean = (double)sum / n;
+    for (int i = 0; i < n; i++) {
+        sxy += (i - k_mean) * (v[i] - v_mean);
+        sxx += (i - k_mean) * (i - k_mean);
+    }
+    CHECK_EQ(stats.latest, v[n - 1]);
+    CHECK_EQ(stats.min, min);
+    CHECK_EQ(stats.max, max);
+    CHECK_EQ(stats.mean, div_round(sum, n));
+    if (n >= 2) {
+        double trend = sxy / sxx * 3600 / r->period_s;
+        CHECK(fabs(stats.trend_per_hour - trend) <= 1);
+    }
+
+    // The whole window decoded, then averaged down to a third of the points
+    CHECK_EQ(sensor_history_query(h, tier, points, SENSOR_HISTORY_LENGTH), n);
+    CHECK(memcmp(points, v, n * sizeof(int16_t)) == 0);
+    int max_points = (n + 2) / 3;
+    CHECK_EQ(sensor_history_query(h, tier, points, max_points), max_points);
+    for (int p = 0; p < max_points; p++) {
+        // Sample i goes to point i * max_points / n
+        int32_t group = 0;
+        int count = 0;
+        for (int i = 0; i < n; i++) {
+            if (i * max_points / n == p) {
+                group += v[i];
+                count++;
+            }
+        }
+        CHECK_EQ(points[p], div_round(group, count));
+    }
+}
+
+int main(void)
+{
+    static sensor_history_t h;
+    int32_t sum_5min = 0, sum_hour = 0;
+    int count_5min = 0, count_hour = 0;
+    uint32_t bucket_5min = 0, hour = 0;
+
+    sensor_history_init(&h, RAW_PERIOD_S);
+    s_ref[SENSOR_HISTORY_RAW].period_s = RAW_PERIOD_S;
+    s_ref[SENSOR_HISTORY_5MIN].period_s = 300;
+    s_ref[SENSOR_HISTORY_HOURLY].period_s = 3600;
+    for (int t = 0; t < SENSOR_HISTORY_TIERS; t++) {
+        check_tier(&h, t);
+    }
+
+    srand(50);
+    for (int i = 0; i < SAMPLES; i++) {
+        uint32_t now_s = 30 + i * RAW_PERIOD_S;
+        double cycle = 60 * sin(2 * M_PI * now_s / 86400.0);
+        int16_t value = (int16_t)(215 + cycle + rand() % 11 - 5);
+        if (i % 1000 == 500) {
+            value += (i % 2000 == 500) ? 400 : -400;      // A step the deltas cannot take at once
+        }
+
+        sensor_history_add(&h, value, now_s);
+        ref_push(&s_ref[SENSOR_HISTORY_RAW], value);
+
+        // A 5-minute mean of the samples as added is stored once a sample from
+        // a later 5 minutes arrives; an hourly mean of those once a 5-minute
+        // mean from a later hour is stored
+        if (count_5min > 0 && now_s / 300 != bucket_5min) {
+            int16_t mean = div_round(sum_5min, count_5min);
+            ref_push(&s_ref[SENSOR_HISTORY_5MIN], mean);
+            if (count_hour > 0 && bucket_5min * 300 / 3600 != hour) {
+                ref_push(&s_ref[SENSOR_HISTORY_HOURLY], div_round(sum_hour, count_hour));
+                sum_hour = 0;
+                count_hour = 0;
+            }
+            hour = bucket_5min * 300 / 3600;
+            sum_hour += mean;
+            count_hour++;
+            sum_5min = 0;
+            count_5min = 0;
+        }
+        bucket_5min = now_s / 300;
+        sum_5min += value;
+        count_5min++;
+
+        for (int t = 0; t < SENSOR_HISTORY_TIERS; t++) {
+            check_tier(&h, t);
+        }
+    }
+
+    sensor_history_stats_t stats;
+    sensor_history_get_stats(&h, SENSOR_HISTORY_HOURLY, &stats);
+    printf("%d samples: raw %d, 5-minute %d, hourly %d stored; last %d hours %d..%d, mean %d, trend %d/h\n",
+           SAMPLES, s_ref[0].count, s_ref[1].count, s_ref[2].count, stats.count, stats.min, stats.max,
+           stats.mean, (int)stats.trend_per_hour);
+    CHECK_EQ(stats.count, SENSOR_HISTORY_LENGTH);
+
+    HOST_TEST_EXIT();
+}
@@ -0,0 +1,123 @@
+// The clock across deep sleep: a unit that wakes, syncs and saves within a few
+// seconds, as the deep sleep cycle does, must find its clock again on the
+// next wake. The RTC counter runs off nominal, so a restore that did not
+// measure it shows as an error beyond the estimate.
+//
+// Virtual time drives esp_timer_get_time(); the wall clock the component
+// reads and sets is virtual too (gettimeofday/settimeofday are wrapped).
+
+#include <stdlib.h>
+#include <sys/time.h>
+#include "host_test.h"
+#include "host_clock.h"
+#include "esp_system.h"
+#include "time_manager.h"
+#include "ntp_client.h"
+
+#define RTC_HZ          148000              // 1.3 % slow of the nominal 150 kHz
+#define TRUE_EPOCH_US   (1760000000LL * 1000000)
+
+static int64_t s_wall_offset_us;            // Wall clock minus uptime
+static int64_t s_true_offset_us;            // Real time minus uptime
+static uint64_t s_rtc_us;                   // Time the RTC counter has run for
+static ntp_result_cb_t s_ntp_cb;
+
+int __wrap_gettimeofday(struct timeval *tv, void *tz)
+{
+    int64_t us = host_clock_now_us() + s_wall_offset_us;
+    tv->tv_sec = us / 1000000;
+    tv->tv_usec = us % 1000000;
+    return 0;
+}
+
+int __wrap_settimeofday(const struct timeval *tv, const void *tz)
+{
+    s_wall_offset_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec - host_clock_now_us();
+    return 0;
+}
+
+// The wake runs time_manager_init() again over the objects of the first
+// boot, which a real reset would have discarded
+const char *__lsan_default_suppressions(void)
+{
+    return "leak:time_manager_init\n";
+}
+
+// local_time.c is not under test
+void local_time_init(void) {}
+void local_time_clock_changed(void) {}
+
+esp_err_t ntp_client_start(const char *servers, ntp_result_cb_t cb)
+{
+    s_ntp_cb = cb;
+    return ESP_OK;
+}
+
+uint32_t ntp_client_poll_interval(void)
+{
+    return 900;
+}
+
+static void run_ms(int64_t ms)
+{
+    host_clock_advance_us(ms * 1000);
+    s_rtc_us += ms * 1000;
+    host_rtc_counter = (uint32_t)(s_rtc_us * RTC_HZ / 1000000);
+}
+
+// Deep sleep: only the RTC counter runs, and the system clock starts over
+static void sleep_ms(int64_t ms)
+{
+    s_rtc_us += ms * 1000;
+    host_rtc_counter = (uint32_t)(s_rtc_us * RTC_HZ / 1000000);
+    s_true_offset_us += ms * 1000;
+    s_wall_offset_us = -host_clock_now_us();
+}
+
+static int64_t clock_error_us(void)
+{
+    struct timeval tv;
+    __wrap_gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - (host_clock_now_us() + s_true_offset_us);
+}
+
+int main(void)
+{
+    time_clock_stats_t stats;
+
+    host_clock_set_virtual(true);
+    s_true_offset_us = TRUE_EPOCH_US;
+
+    // Cold boot: nothing to restore, then NTP answers a couple of seconds in
+    host_set_reset_reason(ESP_RST_POWERON);
+    time_manager_init();
+    time_manager_get_clock_stats(&stats);
+    CHECK_EQ(stats.source, TIME_SOURCE_NONE);
+    time_manager_start_sync();
+    CHECK(s_ntp_cb != NULL);
+    run_ms(2000);
+    ntp_result_t result = {
+        .server = "ntp.example", .offset_us = -clock_error_us(), .delay_us = 20000,
+        .answered = 1, .used = 1,
+    };
+    s_ntp_cb(&result);
+    CHECK(llabs(clock_error_us()) < 1000);
+
+    // Saved before sleeping, well short of the first periodic calibration
+    run_ms(8000);
+    time_manager_save();
+    sleep_ms(20000);
+
+    // The next wake finds the clock, within the error it estimates
+    host_set_reset_reason(ESP_RST_DEEPSLEEP);
+    time_manager_init();
+    time_manager_get_clock_stats(&stats);
+    printf("Restored after a 10 s boot and 20 s of sleep: %lld us off, estimated error %u ms, RTC at %u Hz\n",
+           (long long)clock_error_us(), stats.error_ms, stats.rtc_hz);
+    CHECK_EQ(stats.source, TIME_SOURCE_RTC);
+    CHECK(llabs(clock_error_us()) <= (int64_t)stats.error_ms * 1000);
+    CHECK(stats.error_ms < 50);
+    CHECK(abs((int)stats.rtc_hz - RTC_HZ) < RTC_HZ / 10000);
+
+    HOST_TEST_EXIT();
+}
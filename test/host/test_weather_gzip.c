@@ -0,0 +1,344 @@
+// Weather updates end to end (weather_api, net_http, net_dns, net_loop) against
+// a local stand-in for api.openweathermap.org that compresses like a web
+// server: gzip with the full 32 KB window whenever the request allows it.
+//
+// The forecast is served with the number of entries asked for, and the group
+// response with one entry per city ID. Bodies that fit the 8 KB inflate window
+// stay compressed; a group of 20 sites (built with GROUP_SITES=20) is asked for
+// plain from the first request. Then the server ignores cnt and sends all 40
+// forecast entries (16 KB), whose back-references reach past the window: that
+// update fetches the forecast again uncompressed, and later ones ask for it
+// plain while the other endpoints stay as they were.
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "host_test.h"
+#include "host_clock.h"
+#include "host_dns_server.h"
+#include "host_loop.h"
+#include "host_net.h"
+#include "host_sync.h"
+#include "lwip/sockets.h"
+#include "net_http.h"
+#include "net_loop.h"
+#include "power_manager.h"
+#include "weather_api.h"
+
+#define SERVED_MAX 32
+
+#ifndef GROUP_SITES
+#define GROUP_SITES 3
+#endif
+// Over the window with 20 sites (about 10 KB), so never compressed there
+#define GROUP_CODING (GROUP_SITES > 3 ? "group:plain" : "group:gz")
+
+typedef struct {
+    char endpoint[16];
+    bool gzip;
+    size_t body_bytes;
+    size_t wire_bytes;
+} served_t;
+
+static served_t s_served[SERVED_MAX];
+static int s_served_count;
+static int s_updates;
+static bool s_forecast_full;        // Ignore cnt, as a changed API might
+
+// The radio is not modelled here
+void power_radio_expect(uint32_t delay_ms) {}
+void power_radio_acquire(void) {}
+void power_radio_release(void) {}
+
+static char *load(const char *name, size_t *len)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "corpus/owm/%s", name);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("Cannot open %s\n", path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(*len + 1);
+    *len = fread(data, 1, *len, f);
+    data[*len] = '\0';
+    fclose(f);
+    return data;
+}
+
+// gzip as web servers send it: zlib level 6, 32 KB window
+static uint8_t *gzip_body(const char *data, size_t len, size_t *out_len)
+{
+    z_stream z = { 0 };
+    uint8_t *out = malloc(len + 128);
+
+    deflateInit2(&z, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    z.next_in = (Bytef *)data;
+    z.avail_in = len;
+    z.next_out = out;
+    z.avail_out = len + 128;
+    deflate(&z, Z_FINISH);
+    *out_len = z.total_out;
+    deflateEnd(&z);
+    return out;
+}
+
+// Forecast cut from the 40-entry recording, which has one entry per line
+static char *forecast_body(int cnt, size_t *len)
+{
+    size_t full_len;
+    char *full = load("forecast_cnt40.json", &full_len);
+    char *lines[42];
+    int count = 0;
+
+    for (char *line = strtok(full, "\n"); line != NULL && count < 42; line = strtok(NULL, "\n")) {
+        lines[count++] = line;
+    }
+    char *body = malloc(full_len + 16);
+    size_t pos = sprintf(body, "{\"cod\":\"200\",\"message\":0,\"cnt\":%d,\"list\":[", cnt);
+    for (int i = 0; i < cnt; i++) {
+        size_t entry_len = strlen(lines[1 + i]);
+        if (lines[1 + i][entry_len - 1] == ',') {
+            entry_len--;
+        }
+        pos += sprintf(body + pos, "%s%.*s", i ? "," : "", (int)entry_len, lines[1 + i]);
+    }
+    pos += sprintf(body + pos, "%s", lines[41]);
+    free(full);
+    *len = pos;
+    return body;
+}
+
+// Group response with one recorded entry per requested city ID
+static char *group_body(const char *request, size_t *len)
+{
+    const char *ids = strstr(request, "id=") + 3;
+    int sites = 1;
+
+    for (const char *p = ids; *p != '&' && *p != ' '; p++) {
+        sites += (*p == ',');
+    }
+    return load(sites > 3 ? "group_20.json" : "group_3.json", len);
+}
+
+static void serve(int fd)
+{
+    char request[1024] = "";
+    size_t got = 0;
+
+    while (got < sizeof(request) - 1 && strstr(request, "\r\n\r\n") == NULL) {
+        ssize_t n = recv(fd, request + got, sizeof(request) - 1 - got, 0);
+        if (n <= 0) {
+            return;
+        }
+        got += n;
+        request[got] = '\0';
+    }
+
+    static const struct { const char *path; const char *endpoint; } routes[] = {
+        { "GET /data/2.5/weather?", "weather" },
+        { "GET /data/2.5/forecast?", "forecast" },
+        { "GET /data/2.5/group?", "group" },
+    };
+    int route = -1;
+    for (int i = 0; i < 3; i++) {
+        if (strncmp(request, routes[i].path, strlen(routes[i].path)) == 0) {
+            route = i;
+        }
+    }
+    if (route < 0) {
+        const char *missing = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send(fd, missing, strlen(missing), 0);
+        return;
+    }
+
+    size_t body_len, wire_len;
+    char *body;
+    if (route == 0) {
+        body = load("current.json", &body_len);
+    } else if (route == 1) {
+        const char *cnt = strstr(request, "cnt=");
+        body = forecast_body(__atomic_load_n(&s_forecast_full, __ATOMIC_ACQUIRE) || cnt == NULL ? 40 : atoi(cnt + 4), &body_len);
+    } else {
+        body = group_body(request, &body_len);
+    }
+    bool gzip = strcasestr(request, "Accept-Encoding: gzip") != NULL;
+    uint8_t *wire = gzip ? gzip_body(body, body_len, &wire_len) : (uint8_t *)body;
+    if (!gzip) {
+        wire_len = body_len;
+    }
+
+    char header[256];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 200 OK\r\nContent-Type: application/json; charset=utf-8\r\n"
+                              "%sContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                              gzip ? "Content-Encoding: gzip\r\n" : "", wire_len);
+    host_sync_lock();
+    if (s_served_count < SERVED_MAX) {
+        served_t *s = &s_served[s_served_count++];
+        strcpy(s->endpoint, routes[route].endpoint);
+        s->gzip = gzip;
+        s->body_bytes = body_len;
+        s->wire_bytes = wire_len;
+    }
+    host_sync_unlock();
+
+    send(fd, header, header_len, 0);
+    send(fd, wire, wire_len, 0);
+    if (gzip) {
+        free(wire);
+    }
+    free(body);
+}
+
+static void *server(void *arg)
+{
+    int listener = *(int *)arg;
+
+    while (1) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd >= 0) {
+            serve(fd);
+            close(fd);
+        }
+    }
+    return NULL;
+}
+
+static void server_start(void)
+{
+    static int listener;
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+    pthread_t thread;
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    bind(listener, (struct sockaddr *)&addr, sizeof(addr));
+    listen(listener, 4);
+    getsockname(listener, (struct sockaddr *)&addr, &len);
+    host_net_redirect(80, ntohs(addr.sin_port));
+    pthread_create(&thread, NULL, server, &listener);
+    pthread_detach(thread);
+}
+
+static void on_update(void)
+{
+    host_sync_lock();
+    s_updates++;
+    host_sync_broadcast();
+    host_sync_unlock();
+}
+
+// Real time: the first update starts a second after init
+static void wait_update_real(int count, int timeout_ms)
+{
+    int64_t deadline = host_clock_now_us() + timeout_ms * 1000LL;
+
+    host_sync_lock();
+    while (s_updates < count && host_sync_wait(deadline)) {
+    }
+    host_sync_unlock();
+}
+
+static int s_updates_wanted;
+
+static bool updates_reached(void)
+{
+    return __atomic_load_n(&s_updates, __ATOMIC_ACQUIRE) >= s_updates_wanted;
+}
+
+// Endpoints in the order they were served since index first, as "name:gz name:plain ..."
+static void served_since(int first, char *out, size_t size)
+{
+    size_t len = 0;
+
+    out[0] = '\0';
+    host_sync_lock();
+    for (int i = first; i < s_served_count && len < size; i++) {
+        len += snprintf(out + len, size - len, "%s%s:%s", i > first ? " " : "",
+                        s_served[i].endpoint, s_served[i].gzip ? "gz" : "plain");
+    }
+    host_sync_unlock();
+}
+
+static int32_t corpus_temp(const char *file)
+{
+    size_t len;
+    char *json = load(file, &len);
+    double temp = strtod(strstr(json, "\"temp\":") + 7, NULL);
+    free(json);
+    return (int32_t)(temp < 0 ? temp * 10 - 0.5 : temp * 10 + 0.5);
+}
+
+// One update interval later in virtual time; the endpoints served meanwhile
+static void next_update(char *order, size_t size)
+{
+    int first = s_served_count;
+
+    s_updates_wanted = s_updates + 1;
+    host_loop_run_until(updates_reached, 1000, (CONFIG_OWM_UPDATE_INTERVAL * 60 + 60) * 1000);
+    CHECK_EQ(s_updates, s_updates_wanted);
+    CHECK(weather_is_valid());
+    served_since(first, order, size);
+}
+
+int main(void)
+{
+    char order[256], expect[256];
+    weather_forecast_t current;
+    weather_location_t location;
+
+    host_dns_server_start(3600);
+    server_start();
+    weather_set_update_hook(on_update);
+    weather_api_init();
+
+    // First update: current weather and the 8-entry forecast fit the window
+    // and come compressed
+    wait_update_real(1, 20000);
+    CHECK_EQ(s_updates, 1);
+    CHECK(weather_is_valid());
+    CHECK(weather_get_current(&current) == ESP_OK);
+    CHECK(abs(current.temp - corpus_temp("current.json")) <= 1);
+    CHECK_EQ(weather_get_location_count(), GROUP_SITES);
+    for (int i = 0; i < weather_get_location_count(); i++) {
+        CHECK(weather_get_location(i, &location) == ESP_OK);
+    }
+    served_since(0, order, sizeof(order));
+    printf("First update:  %s\n", order);
+    snprintf(expect, sizeof(expect), "weather:gz forecast:gz %s", GROUP_CODING);
+    CHECK(strcmp(order, expect) == 0);
+
+    // The forecast grows past the window: refused for it and fetched plain
+    host_clock_set_virtual(true);
+    __atomic_store_n(&s_forecast_full, true, __ATOMIC_RELEASE);
+    next_update(order, sizeof(order));
+    printf("Second update: %s\n", order);
+    snprintf(expect, sizeof(expect), "weather:gz forecast:gz forecast:plain %s", GROUP_CODING);
+    CHECK(strcmp(order, expect) == 0);
+
+    // From then on straight to the plain request, the rest as before
+    next_update(order, sizeof(order));
+    printf("Third update:  %s\n", order);
+    snprintf(expect, sizeof(expect), "weather:gz forecast:plain %s", GROUP_CODING);
+    CHECK(strcmp(order, expect) == 0);
+
+    net_http_stats_t http;
+    net_http_get_stats(&http);
+    printf("\n%-10s %-6s %8s %8s\n", "endpoint", "coding", "body", "wire");
+    for (int i = 0; i < s_served_count; i++) {
+        printf("%-10s %-6s %8zu %8zu\n", s_served[i].endpoint, s_served[i].gzip ? "gzip" : "plain",
+               s_served[i].body_bytes, s_served[i].wire_bytes);
+    }
+    printf("%u requests, %u failed, %u bytes received\n", http.requests, http.failures, http.rx_bytes);
+    CHECK_EQ(http.failures, 0);
+    CHECK(host_dns_server_queries() >= 1);
+
+    HOST_TEST_EXIT();
+}